@@ -26,15 +26,31 @@
 
 #include <mio-dns.h>
 #include <mio-sck.h>
+#include <mio-htb.h>
 #include "mio-prv.h"
 
 #include <netinet/in.h>
 
-struct mio_svc_dns_t
+typedef struct dnc_cache_ent_t dnc_cache_ent_t;
+
+/* an upstream server */
+struct dnc_serv_t
 {
-	MIO_SVC_HEADER;
-	/*MIO_DNS_SVC_HEADER;*/
+	mio_skad_t  addr;
+	mio_oow_t   srtt; /* smoothed round-trip time in microseconds. 0 if not measured yet */
+	mio_oow_t   fails; /* number of consecutive failures */
+	mio_ntime_t holdoff; /* not used until this time after too many failures */
+	mio_dev_sck_t* tcp_sck; /* connection shared by the requests over tcp */
+	mio_uint8_t cookie_server[MIO_DNS_COOKIE_SERVER_MAX_LEN]; /* server cookie received from the server */
+	mio_uint8_t cookie_server_len;
 };
+typedef struct dnc_serv_t dnc_serv_t;
+
+/* number of consecutive failures to put a server on hold */
+#define DNC_SERV_MAX_FAILS (3)
+/* number of seconds to keep a failing server on hold */
+#define DNC_SERV_HOLDOFF_SECS (10)
+#define DNC_SERV_NONE MIO_TYPE_MAX(mio_oow_t)
 
 struct mio_svc_dnc_t
 {
@@ -42,11 +58,19 @@ struct mio_svc_dnc_t
 	/*MIO_DNS_SVC_HEADER;*/
 
 	mio_dev_sck_t* udp_sck;
-	mio_dev_sck_t* tcp_sck;
-	mio_skad_t serv_addr;
+	int stopping;
+
+	struct
+	{
+		dnc_serv_t* ptr; /* the first one is the server given to mio_svc_dnc_start() */
+		mio_oow_t len;
+		mio_oow_t capa;
+	} serv;
+	mio_ntime_t hedge_delay; /* send the question to another server if no reply arrives in this time. 0 to disable */
 
 	mio_ntime_t send_tmout; 
 	mio_ntime_t reply_tmout; /* default reply timeout */
+	mio_ntime_t tcp_idle_tmout; /* close a tcp connection idle for this time. 0 to keep it */
 
 	/* For a question sent out, it may wait for a corresponding answer.
 	 * if max_tries is greater than 0, sending and waiting is limited
@@ -60,12 +84,40 @@ struct mio_svc_dnc_t
 
 	mio_oow_t seq;
 	mio_dns_msg_t* pending_req;
+
+	struct
+	{
+		mio_htb_t htb; /* dnc_cache_ent_t pointers keyed by resolve flags, qtype and qname */
+		dnc_cache_ent_t* head; /* most recently used */
+		dnc_cache_ent_t* tail; /* least recently used */
+		mio_oow_t capa;
+	} cache;
+};
+
+/* an entry in the resolver cache. it holds a response cached 
+ * and/or the request in flight for the same key */
+struct dnc_cache_ent_t
+{
+	mio_htb_pair_t*  pair;
+	mio_dns_msg_t*   leader; /* request in flight */
+	mio_uint8_t*     rsp; /* response packet cached */
+	mio_oow_t        rsplen;
+	mio_ntime_t      stored;
+	mio_ntime_t      expiry;
+	dnc_cache_ent_t* prev;
+	dnc_cache_ent_t* next;
 };
 
 struct dnc_sck_xtn_t
 {
 	mio_svc_dnc_t* dnc;
 
+	/* the following fields are used by tcp socket */
+	mio_oow_t servidx;
+	mio_oow_t nreqs; /* number of requests using the socket */
+	mio_tmridx_t itmridx; /* idle timer */
+	int connected;
+
 	struct
 	{
 		mio_uint8_t* ptr;
@@ -84,12 +136,21 @@ struct dnc_dns_msg_xtn_t
 	mio_dns_msg_t* prev;
 	mio_dns_msg_t* next;
 	mio_skad_t     servaddr;
+	mio_oow_t      servidx; /* index to the server the question has been sent to */
+	mio_ntime_t    sendtime;
+	mio_tmridx_t   htmridx; /* hedging timer */
+	mio_oow_t      hservidx; /* index to the server the hedged question has been sent to */
+	mio_ntime_t    hsendtime;
 	mio_svc_dnc_on_done_t on_done;
 	mio_ntime_t    wtmout;
 	mio_ntime_t    rtmout;
 	int            rmaxtries; /* maximum number of tries to receive a reply */
 	int            rtries; /* number of tries made so far */
 	int            pending;
+	int            treconn; /* resent over a new tcp connection */
+	int            cookie; /* the client cookie in the packet is derived from the server address */
+	mio_dns_msg_t* co_first; /* the first request coalesced into this request */
+	mio_dns_msg_t* co_next; /* the next request coalesced into the same request */
 };
 typedef struct dnc_dns_msg_xtn_t dnc_dns_msg_xtn_t;
 
@@ -119,6 +180,97 @@ static MIO_INLINE void unchain_pending_dns_reqmsg (mio_svc_dnc_t* dnc, mio_dns_m
 	dnc_dns_msg_getxtn(msg)->pending = 0;
 }
 
+static mio_oow_t select_serv (mio_svc_dnc_t* dnc, mio_oow_t excl)
+{
+	/* pick the server with the lowest smoothed rtt among those not on hold
+	 * except the server at the index excl. a server not measured yet comes
+	 * first so that it gets measured. if all servers are on hold, pick the
+	 * one to come out of the hold first. */
+	mio_ntime_t now;
+	mio_oow_t i, best = DNC_SERV_NONE, held = DNC_SERV_NONE;
+
+	mio_gettime (dnc->mio, &now);
+	for (i = 0; i < dnc->serv.len; i++)
+	{
+		dnc_serv_t* serv = &dnc->serv.ptr[i];
+
+		if (i == excl) continue;
+		if (MIO_CMP_NTIME(&serv->holdoff, &now) > 0)
+		{
+			if (held == DNC_SERV_NONE || MIO_CMP_NTIME(&serv->holdoff, &dnc->serv.ptr[held].holdoff) < 0) held = i;
+			continue;
+		}
+		if (best == DNC_SERV_NONE || serv->srtt < dnc->serv.ptr[best].srtt) best = i;
+	}
+
+	return (best == DNC_SERV_NONE)? held: best;
+}
+
+static void update_serv_rtt (mio_svc_dnc_t* dnc, mio_oow_t idx, const mio_ntime_t* sendtime)
+{
+	dnc_serv_t* serv = &dnc->serv.ptr[idx];
+	mio_ntime_t now, rtt;
+	mio_oow_t usec;
+
+	mio_gettime (dnc->mio, &now);
+	MIO_SUB_NTIME (&rtt, &now, sendtime);
+	usec = (rtt.sec < 0)? 1: MIO_SECNSEC_TO_USEC(rtt.sec, rtt.nsec);
+	if (usec <= 0) usec = 1;
+
+	/* smoothed with the gain of 1/8 as in RFC6298 */
+	serv->srtt = (serv->srtt <= 0)? usec: (serv->srtt - (serv->srtt >> 3) + (usec >> 3));
+	serv->fails = 0;
+	MIO_CLEAR_NTIME (&serv->holdoff);
+}
+
+static void penalize_serv_rtt (mio_svc_dnc_t* dnc, mio_oow_t idx, const mio_ntime_t* sendtime)
+{
+	dnc_serv_t* serv = &dnc->serv.ptr[idx];
+	mio_ntime_t now, rtt;
+	mio_oow_t usec;
+
+	mio_gettime (dnc->mio, &now);
+	MIO_SUB_NTIME (&rtt, &now, sendtime);
+	usec = (rtt.sec < 0)? 1: MIO_SECNSEC_TO_USEC(rtt.sec, rtt.nsec);
+	if (serv->srtt < usec) serv->srtt = usec;
+}
+
+static void mark_serv_failure (mio_svc_dnc_t* dnc, mio_oow_t idx, const mio_ntime_t* rtmout)
+{
+	dnc_serv_t* serv = &dnc->serv.ptr[idx];
+	mio_oow_t usec;
+
+	/* a server that hasn't replied in time must be no faster than the timeout */
+	usec = MIO_SECNSEC_TO_USEC(rtmout->sec, rtmout->nsec);
+	if (serv->srtt < usec) serv->srtt = usec;
+
+	serv->fails++;
+	if (serv->fails >= DNC_SERV_MAX_FAILS)
+	{
+		mio_gettime (dnc->mio, &serv->holdoff);
+		serv->holdoff.sec += DNC_SERV_HOLDOFF_SECS;
+	}
+}
+
+static void make_client_cookie (mio_svc_dnc_t* dnc, mio_oow_t servidx, mio_uint8_t* cookie)
+{
+	/* the client cookie is specific to the server address. RFC7873 4.1 */
+	mio_skad_t* addr = &dnc->serv.ptr[servidx].addr;
+	mio_sip_hash_24 (dnc->cookie.key, addr, MIO_SIZEOF(*addr), cookie);
+}
+
+static void set_client_cookie_in_msg (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg, mio_oow_t servidx)
+{
+	/* rewrite the client cookie in the packet for the server to send it to.
+	 * the server cookie is left intact. a server not recognizing it replies
+	 * with its new server cookie */
+	mio_uint8_t* cookie;
+
+	if (!dnc_dns_msg_getxtn(msg)->cookie) return;
+	cookie = mio_dns_find_client_cookie_in_msg(msg, MIO_NULL);
+	if (cookie) make_client_cookie (dnc, servidx, cookie);
+}
+
 static mio_dns_msg_t* make_dns_msg (mio_svc_dnc_t* dnc, mio_dns_bhdr_t* bdns, mio_dns_bqr_t* qr, mio_oow_t qr_count, mio_dns_brr_t* rr, mio_oow_t rr_count, mio_dns_bedns_t* edns, mio_svc_dnc_on_done_t on_done, mio_oow_t xtnsize)
 {
 	mio_dns_msg_t* msg;
@@ -142,11 +294,70 @@ static mio_dns_msg_t* make_dns_msg (mio_svc_dnc_t* dnc, mio_dns_bhdr_t* bdns, mi
 	msgxtn->rtmout = dnc->reply_tmout;
 	msgxtn->rmaxtries = dnc->max_tries; 
 	msgxtn->rtries = 0;
-	msgxtn->servaddr = dnc->serv_addr;
+	msgxtn->servidx = select_serv(dnc, DNC_SERV_NONE);
+	msgxtn->servaddr = dnc->serv.ptr[msgxtn->servidx].addr;
+	msgxtn->htmridx = MIO_TMRIDX_INVALID;
+	msgxtn->hservidx = DNC_SERV_NONE;
+	msgxtn->treconn = 0;
+	msgxtn->cookie = 0;
+	msgxtn->co_first = MIO_NULL;
+	msgxtn->co_next = MIO_NULL;
 
 	return msg;
 }
 
+static void on_tcp_idle_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_dev_sck_t* dev = (mio_dev_sck_t*)job->ctx;
+
+	MIO_ASSERT (mio, ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->itmridx == MIO_TMRIDX_INVALID);
+	MIO_ASSERT (mio, ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->nreqs == 0);
+
+	MIO_DEBUG1 (mio, "DNC - closing idle tcp connection %p\n", dev);
+	mio_dev_sck_kill (dev);
+}
+
+static void attach_reqmsg_to_tcp (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg, mio_dev_sck_t* dev)
+{
+	dnc_sck_xtn_t* sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	if (sckxtn->itmridx != MIO_TMRIDX_INVALID)
+	{
+		mio_deltmrjob (dnc->mio, sckxtn->itmridx);
+		MIO_ASSERT (dnc->mio, sckxtn->itmridx == MIO_TMRIDX_INVALID);
+	}
+
+	dnc_dns_msg_getxtn(msg)->dev = dev;
+	sckxtn->nreqs++;
+}
+
+static void detach_reqmsg_from_tcp (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg)
+{
+	dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(msg);
+	mio_dev_sck_t* dev = msgxtn->dev;
+	dnc_sck_xtn_t* sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	MIO_ASSERT (dnc->mio, sckxtn->nreqs > 0);
+	msgxtn->dev = MIO_NULL;
+	sckxtn->nreqs--;
+
+	if (sckxtn->nreqs <= 0 && dnc->serv.ptr[sckxtn->servidx].tcp_sck == dev && MIO_IS_POS_NTIME(&dnc->tcp_idle_tmout))
+	{
+		/* keep the connection for the next request for a while. 
+		 * the connection stays open if the timer can't be scheduled */
+		mio_tmrjob_t tmrjob;
+
+		MIO_ASSERT (dnc->mio, sckxtn->itmridx == MIO_TMRIDX_INVALID);
+		MIO_MEMSET (&tmrjob, 0, MIO_SIZEOF(tmrjob));
+		tmrjob.ctx = dev;
+		mio_gettime (dnc->mio, &tmrjob.when);
+		MIO_ADD_NTIME (&tmrjob.when, &tmrjob.when, &dnc->tcp_idle_tmout);
+		tmrjob.handler = on_tcp_idle_timeout;
+		tmrjob.idxptr = &sckxtn->itmridx;
+		sckxtn->itmridx = mio_instmrjob(dnc->mio, &tmrjob);
+	}
+}
+
 static void release_dns_msg (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg)
 {
 	mio_t* mio = dnc->mio;
@@ -166,6 +377,22 @@ MIO_DEBUG1 (mio, "DNC - releasing dns message - msgid:%d\n", (int)mio_ntoh16(mio
 		MIO_ASSERT (mio, msgxtn->rtmridx == MIO_TMRIDX_INVALID);
 	}
 
+	if (msgxtn->htmridx != MIO_TMRIDX_INVALID)
+	{
+		mio_deltmrjob (mio, msgxtn->htmridx);
+		MIO_ASSERT (mio, msgxtn->htmridx == MIO_TMRIDX_INVALID);
+	}
+
+	if (msgxtn->dev && msgxtn->dev != dnc->udp_sck) detach_reqmsg_from_tcp (dnc, msg);
+
+	while (msgxtn->co_first)
+	{
+		/* the requests coalesced haven't got the answer */
+		mio_dns_msg_t* comsg = msgxtn->co_first;
+		msgxtn->co_first = dnc_dns_msg_getxtn(comsg)->co_next;
+		release_dns_msg (dnc, comsg);
+	}
+
 /* TODO: add it to the free msg list instead of just freeing it. */
 	mio_dns_free_msg (dnc->mio, msg);
 }
@@ -311,7 +538,7 @@ static void on_tcp_reply_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob
 	mio_svc_dnc_t* dnc = ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dnc;
 
 	MIO_ASSERT (mio, reqmsgxtn->rtmridx == MIO_TMRIDX_INVALID);
-	MIO_ASSERT (mio, dev == dnc->tcp_sck);
+	MIO_ASSERT (mio, dev != dnc->udp_sck);
 
 MIO_DEBUG1 (mio, "DNC - unable to receive dns response in time over TCP - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id));
 
@@ -398,10 +625,12 @@ static int write_dns_msg_over_tcp (mio_dev_sck_t* dev, mio_dns_msg_t* msg)
 static void on_tcp_connect (mio_dev_sck_t* dev)
 {
 	mio_t* mio = dev->mio;
-	mio_svc_dnc_t* dnc = ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dnc;
+	dnc_sck_xtn_t* sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_svc_dnc_t* dnc = sckxtn->dnc;
 	mio_dns_msg_t* reqmsg;
 
-	MIO_ASSERT (mio, dev == dnc->tcp_sck);
+	MIO_DEBUG1 (mio, "DNC - tcp connected %p\n", dev);
+	sckxtn->connected = 1;
 
 	reqmsg = dnc->pending_req;
 	while (reqmsg)
@@ -421,10 +650,13 @@ static void on_tcp_connect (mio_dev_sck_t* dev)
 	}
 }
 
+static int switch_reqmsg_transport_to_tcp (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg);
+
 static void on_tcp_disconnect (mio_dev_sck_t* dev)
 {
 	mio_t* mio = dev->mio;
-	mio_svc_dnc_t* dnc = ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dnc;
+	dnc_sck_xtn_t* sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_svc_dnc_t* dnc = sckxtn->dnc;
 	mio_dns_msg_t* reqmsg;
 	int status;
 
@@ -440,6 +672,14 @@ static void on_tcp_disconnect (mio_dev_sck_t* dev)
 		MIO_DEBUG2 (mio, "DNC - TCP UNABLE TO CONNECT  %d -> %js\n", status, mio_errnum_to_errstr(status));
 	}
 
+	/* let's forget about the tcp socket so that the requests to retry get a new connection */
+	if (dnc->serv.ptr[sckxtn->servidx].tcp_sck == dev) dnc->serv.ptr[sckxtn->servidx].tcp_sck = MIO_NULL;
+	if (sckxtn->itmridx != MIO_TMRIDX_INVALID)
+	{
+		mio_deltmrjob (mio, sckxtn->itmridx);
+		MIO_ASSERT (mio, sckxtn->itmridx == MIO_TMRIDX_INVALID);
+	}
+
 	reqmsg = dnc->pending_req;
 	while (reqmsg)
 	{
@@ -448,29 +688,54 @@ static void on_tcp_disconnect (mio_dev_sck_t* dev)
 
 		if (reqmsgxtn->dev == dev)
 		{
+			if (sckxtn->connected && !reqmsgxtn->treconn && !dnc->stopping && mio_dns_msg_to_pkt(reqmsg)->qr == 0)
+			{
+				/* the established connection has been closed with the question
+				 * outstanding. the server may have closed the connection idle on
+				 * its side or reached its limit of queries per connection.
+				 * retry once over a new connection */
+				if (reqmsgxtn->rtmridx != MIO_TMRIDX_INVALID)
+				{
+					mio_deltmrjob (mio, reqmsgxtn->rtmridx);
+					MIO_ASSERT (mio, reqmsgxtn->rtmridx == MIO_TMRIDX_INVALID);
+				}
+				detach_reqmsg_from_tcp (dnc, reqmsg);
+				reqmsgxtn->treconn = 1;
+				if (switch_reqmsg_transport_to_tcp(dnc, reqmsg) >= 0) goto next;
+			}
+
 			if (MIO_LIKELY(reqmsgxtn->on_done)) reqmsgxtn->on_done (dnc, reqmsg, MIO_ENORSP, MIO_NULL, 0);
 			release_dns_msg (dnc, reqmsg);
 		}
 
+	next:
 		reqmsg = nextreqmsg;
 	}
 
-	/* let's forget about the tcp socket */
-	dnc->tcp_sck = MIO_NULL; 
+	if (sckxtn->rbuf.ptr)
+	{
+		mio_freemem (mio, sckxtn->rbuf.ptr);
+		sckxtn->rbuf.ptr = MIO_NULL;
+		sckxtn->rbuf.capa = 0;
+		sckxtn->rbuf.len = 0;
+	}
 }
 
 static int switch_reqmsg_transport_to_tcp (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg)
 {
 	mio_t* mio = dnc->mio;
 	dnc_dns_msg_xtn_t* reqmsgxtn = dnc_dns_msg_getxtn(reqmsg);
+	dnc_serv_t* serv = &dnc->serv.ptr[reqmsgxtn->servidx];
 	dnc_sck_xtn_t* sckxtn;
 
 	mio_dev_sck_make_t mkinfo;
 	mio_dev_sck_connect_t cinfo;
 
-/* TODO: more reliable way to check if connection is ok.
- * even if tcp_sck is not null, the connection could have been torn down... */
-	if (!dnc->tcp_sck)
+	/* the connection to the server is shared by all requests over tcp.
+	 * the requests are pipelined on it and the responses are matched by 
+	 * the message id. it's closed when idle for dnc->tcp_idle_tmout and
+	 * is made again by the next request. */
+	if (!serv->tcp_sck)
 	{
 		MIO_MEMSET (&mkinfo, 0, MIO_SIZEOF(mkinfo));
 		switch (mio_skad_family(&reqmsgxtn->servaddr))
@@ -492,33 +757,35 @@ static int switch_reqmsg_transport_to_tcp (mio_svc_dnc_t* dnc, mio_dns_msg_t* re
 		mkinfo.on_read = on_tcp_read;
 		mkinfo.on_connect = on_tcp_connect;
 		mkinfo.on_disconnect = on_tcp_disconnect;
-		dnc->tcp_sck = mio_dev_sck_make(mio, MIO_SIZEOF(*sckxtn), &mkinfo);
-		if (!dnc->tcp_sck) return -1;
+		serv->tcp_sck = mio_dev_sck_make(mio, MIO_SIZEOF(*sckxtn), &mkinfo);
+		if (!serv->tcp_sck) return -1;
 
-		sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(dnc->tcp_sck);
+		sckxtn = (dnc_sck_xtn_t*)mio_dev_sck_getxtn(serv->tcp_sck);
 		sckxtn->dnc = dnc;
+		sckxtn->servidx = reqmsgxtn->servidx;
+		sckxtn->itmridx = MIO_TMRIDX_INVALID;
 
 		MIO_MEMSET (&cinfo, 0, MIO_SIZEOF(cinfo));
-		cinfo.remoteaddr = reqmsgxtn->servaddr;
+		cinfo.remoteaddr = serv->addr;
 		cinfo.connect_tmout = reqmsgxtn->rtmout; /* TOOD: create a separate connect timeout or treate rtmout as a whole transaction time and calculate the remaining time from the transaction start, and use it */
 
-		if (mio_dev_sck_connect(dnc->tcp_sck, &cinfo) <= -1) 
+		if (mio_dev_sck_connect(serv->tcp_sck, &cinfo) <= -1) 
 		{
-			mio_dev_sck_kill (dnc->tcp_sck);
-			dnc->tcp_sck = MIO_NULL;
+			mio_dev_sck_kill (serv->tcp_sck);
+			serv->tcp_sck = MIO_NULL;
 			return -1; /* the connect request hasn't been honored. */
 		}
 	}
 	
 	/* switch the belonging device to the tcp socket since the connect request has been acknowledged. */
 	MIO_ASSERT (mio, reqmsgxtn->rtmridx == MIO_TMRIDX_INVALID); /* ensure no timer job scheduled at this moment */
-	reqmsgxtn->dev = dnc->tcp_sck;
+	attach_reqmsg_to_tcp (dnc, reqmsg, serv->tcp_sck);
 	reqmsgxtn->rtries = 0;
 	if (!reqmsgxtn->pending && mio_dns_msg_to_pkt(reqmsg)->qr == 0) chain_pending_dns_reqmsg (dnc, reqmsg);
 
-MIO_DEBUG6 (mio, "DNC - switched transport to tcp - msgid:%d %p %p %p %p %p\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id), reqmsg, reqmsgxtn, reqmsgxtn->dev, dnc->udp_sck, dnc->tcp_sck);
+MIO_DEBUG6 (mio, "DNC - switched transport to tcp - msgid:%d %p %p %p %p %p\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id), reqmsg, reqmsgxtn, reqmsgxtn->dev, dnc->udp_sck, serv->tcp_sck);
 
-	if (MIO_DEV_SCK_GET_PROGRESS(dnc->tcp_sck) & MIO_DEV_SCK_CONNECTED)
+	if (MIO_DEV_SCK_GET_PROGRESS(serv->tcp_sck) & MIO_DEV_SCK_CONNECTED)
 	{
 		if (write_dns_msg_over_tcp(reqmsgxtn->dev, reqmsg) <= -1)
 		{
@@ -570,14 +837,36 @@ static int on_udp_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen,
 		mio_dns_pkt_t* reqpkt = mio_dns_msg_to_pkt(reqmsg);
 		dnc_dns_msg_xtn_t* reqmsgxtn = dnc_dns_msg_getxtn(reqmsg);
 
-		if (reqmsgxtn->dev == dev && pkt->id == reqpkt->id && mio_equal_skads(&reqmsgxtn->servaddr, srcaddr, 0))
+		if (reqmsgxtn->dev == dev && pkt->id == reqpkt->id)
 		{
+			if (mio_equal_skads(&reqmsgxtn->servaddr, srcaddr, 0))
+			{
+				update_serv_rtt (dnc, reqmsgxtn->servidx, &reqmsgxtn->sendtime);
+			}
+			else if (reqmsgxtn->hservidx != DNC_SERV_NONE && mio_equal_skads(&dnc->serv.ptr[reqmsgxtn->hservidx].addr, srcaddr, 0))
+			{
+				/* the hedged question has won. the original server is slower
+				 * than the time elapsed since the original question */
+				penalize_serv_rtt (dnc, reqmsgxtn->servidx, &reqmsgxtn->sendtime);
+				update_serv_rtt (dnc, reqmsgxtn->hservidx, &reqmsgxtn->hsendtime);
+				reqmsgxtn->servidx = reqmsgxtn->hservidx;
+				reqmsgxtn->servaddr = dnc->serv.ptr[reqmsgxtn->servidx].addr;
+				/* the reply carries the client cookie for the hedged server */
+				set_client_cookie_in_msg (dnc, reqmsg, reqmsgxtn->servidx);
+			}
+			else goto next;
+
 			if (reqmsgxtn->rtmridx != MIO_TMRIDX_INVALID)
 			{
 				/* unschedule a timer job if any */
 				mio_deltmrjob (mio, reqmsgxtn->rtmridx);
 				MIO_ASSERT (mio, reqmsgxtn->rtmridx == MIO_TMRIDX_INVALID);
 			}
+			if (reqmsgxtn->htmridx != MIO_TMRIDX_INVALID)
+			{
+				mio_deltmrjob (mio, reqmsgxtn->htmridx);
+				MIO_ASSERT (mio, reqmsgxtn->htmridx == MIO_TMRIDX_INVALID);
+			}
 
 ////////////////////////
 // for simple testing without actual truncated dns response
@@ -596,6 +885,7 @@ MIO_DEBUG1 (mio, "DNC - received dns response over udp for msgid:%d\n", id);
 			return 0;
 		}
 
+	next:
 		reqmsg = reqmsgxtn->next;
 	}
 
@@ -616,9 +906,31 @@ static void on_udp_reply_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob
 	MIO_ASSERT (mio, dev == dnc->udp_sck);
 
 MIO_DEBUG1 (mio, "DNC - unable to receive dns response in time over udp - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id));
+	mark_serv_failure (dnc, msgxtn->servidx, &msgxtn->rtmout);
+	if (msgxtn->htmridx != MIO_TMRIDX_INVALID)
+	{
+		mio_deltmrjob (mio, msgxtn->htmridx);
+		MIO_ASSERT (mio, msgxtn->htmridx == MIO_TMRIDX_INVALID);
+	}
+	if (msgxtn->hservidx != DNC_SERV_NONE)
+	{
+		mark_serv_failure (dnc, msgxtn->hservidx, &msgxtn->rtmout);
+		msgxtn->hservidx = DNC_SERV_NONE;
+	}
+
 	if (msgxtn->rtries < msgxtn->rmaxtries)
 	{
 		mio_ntime_t* tmout;
+		mio_oow_t idx;
+
+		/* fail over to the best of the other servers if any */
+		idx = select_serv(dnc, msgxtn->servidx);
+		if (idx != DNC_SERV_NONE)
+		{
+			msgxtn->servidx = idx;
+			msgxtn->servaddr = dnc->serv.ptr[idx].addr;
+			set_client_cookie_in_msg (dnc, reqmsg, idx);
+		}
 
 		tmout = MIO_IS_POS_NTIME(&msgxtn->wtmout)? &msgxtn->wtmout: MIO_NULL;
 MIO_DEBUG1 (mio, "DNC - sending dns question again over udp - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id));
@@ -632,14 +944,47 @@ MIO_DEBUG1 (mio, "DNC - sending dns question again over udp - msgid:%d\n", (int)
 	release_dns_msg (dnc, reqmsg);
 }
 
+static void on_udp_hedge_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_dns_msg_t* reqmsg = (mio_dns_msg_t*)job->ctx;
+	dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(reqmsg);
+	mio_dev_sck_t* dev = msgxtn->dev;
+	mio_svc_dnc_t* dnc = ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dnc;
+	mio_ntime_t* tmout;
+	mio_oow_t idx;
+
+	MIO_ASSERT (mio, msgxtn->htmridx == MIO_TMRIDX_INVALID);
+	MIO_ASSERT (mio, dev == dnc->udp_sck);
+
+	idx = select_serv(dnc, msgxtn->servidx);
+	if (idx == DNC_SERV_NONE) return;
+
+MIO_DEBUG1 (mio, "DNC - sending hedged dns question over udp - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(reqmsg)->id));
+	/* the write context is null. the reply timer of the original question
+	 * stays in charge of the request and the first reply wins. */
+	tmout = MIO_IS_POS_NTIME(&msgxtn->wtmout)? &msgxtn->wtmout: MIO_NULL;
+	/* the packet is copied if not written immediately. so the client cookie
+	 * for the original server can be put back after writing */
+	set_client_cookie_in_msg (dnc, reqmsg, idx);
+	if (mio_dev_sck_timedwrite(dev, mio_dns_msg_to_pkt(reqmsg), reqmsg->pktlen, tmout, MIO_NULL, &dnc->serv.ptr[idx].addr) >= 0)
+	{
+		msgxtn->hservidx = idx;
+		msgxtn->hsendtime = *now;
+	}
+	set_client_cookie_in_msg (dnc, reqmsg, msgxtn->servidx);
+}
+
 static int on_udp_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
 {
 	mio_t* mio = dev->mio;
 	mio_dns_msg_t* msg = (mio_dns_msg_t*)wrctx;
-	dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(msg);
+	dnc_dns_msg_xtn_t* msgxtn;
 	mio_svc_dnc_t* dnc = ((dnc_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dnc;
 	mio_errnum_t status;
 
+	if (!msg) return 0; /* hedged question. nothing to do */
+
+	msgxtn = dnc_dns_msg_getxtn(msg);
 	MIO_ASSERT (mio, dev == (mio_dev_sck_t*)msgxtn->dev);
 
 	if (wrlen <= -1)
@@ -668,6 +1013,20 @@ static int on_udp_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, con
 			MIO_DEBUG1 (mio, "DNC - unable to schedule udp timeout - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(msg)->id));
 			goto finalize;
 		}
+		msgxtn->sendtime = tmrjob.when;
+		MIO_SUB_NTIME (&msgxtn->sendtime, &msgxtn->sendtime, &msgxtn->rtmout);
+
+		if (MIO_IS_POS_NTIME(&dnc->hedge_delay) && dnc->serv.len > 1 && MIO_CMP_NTIME(&dnc->hedge_delay, &msgxtn->rtmout) < 0)
+		{
+			/* race another server if no reply arrives before the hedging delay.
+			 * no hedging is a minor loss. so the failure is ignored */
+			MIO_MEMSET (&tmrjob, 0, MIO_SIZEOF(tmrjob));
+			tmrjob.ctx = msg;
+			MIO_ADD_NTIME (&tmrjob.when, &msgxtn->sendtime, &dnc->hedge_delay);
+			tmrjob.handler = on_udp_hedge_timeout;
+			tmrjob.idxptr = &msgxtn->htmridx;
+			msgxtn->htmridx = mio_instmrjob(mio, &tmrjob);
+		}
 
 		if (msgxtn->rtries == 0)
 		{
@@ -720,6 +1079,217 @@ static void on_udp_disconnect (mio_dev_sck_t* dev)
 	}
 }
 
+/* ----------------------------------------------------------------------- */
+
+static void free_cache_ent (mio_svc_dnc_t* dnc, dnc_cache_ent_t* ent)
+{
+	MIO_ASSERT (dnc->mio, ent->leader == MIO_NULL);
+
+	if (ent->prev) ent->prev->next = ent->next;
+	else dnc->cache.head = ent->next;
+	if (ent->next) ent->next->prev = ent->prev;
+	else dnc->cache.tail = ent->prev;
+
+	if (ent->rsp) mio_freemem (dnc->mio, ent->rsp);
+	mio_htb_delete (&dnc->cache.htb, MIO_HTB_KPTR(ent->pair), MIO_HTB_KLEN(ent->pair));
+	mio_freemem (dnc->mio, ent);
+}
+
+static MIO_INLINE void touch_cache_ent (mio_svc_dnc_t* dnc, dnc_cache_ent_t* ent)
+{
+	if (ent != dnc->cache.head)
+	{
+		/* move it to the head */
+		ent->prev->next = ent->next;
+		if (ent->next) ent->next->prev = ent->prev;
+		else dnc->cache.tail = ent->prev;
+
+		ent->prev = MIO_NULL;
+		ent->next = dnc->cache.head;
+		dnc->cache.head->prev = ent;
+		dnc->cache.head = ent;
+	}
+}
+
+static mio_oow_t make_cache_key (mio_uint8_t* key, const mio_bch_t* qname, mio_dns_rrt_t qtype, int resolve_flags)
+{
+	/* the key is composed of the flags affecting the answer, 
+	 * the query type and the query name in lower case. the buffer
+	 * must be large enough to hold 3 + 255 bytes.  */
+	mio_oow_t i;
+
+	key[0] = (resolve_flags & (MIO_SVC_DNC_RESOLVE_FLAG_COOKIE | MIO_SVC_DNC_RESOLVE_FLAG_DNSSEC)) >> 8;
+	key[1] = (qtype >> 8) & 0xFF;
+	key[2] = qtype & 0xFF;
+	for (i = 0; qname[i] != '\0'; i++)
+	{
+		if (i >= 255) return 0; /* too long to cache */
+		key[3 + i] = ((qname[i] >= 'A' && qname[i] <= 'Z')? (qname[i] - 'A' + 'a'): qname[i]);
+	}
+
+	return 3 + i;
+}
+
+static dnc_cache_ent_t* find_cache_ent (mio_svc_dnc_t* dnc, const mio_uint8_t* key, mio_oow_t klen)
+{
+	mio_htb_pair_t* pair;
+	pair = mio_htb_search(&dnc->cache.htb, key, klen);
+	return pair? (dnc_cache_ent_t*)MIO_HTB_VPTR(pair): MIO_NULL;
+}
+
+static dnc_cache_ent_t* add_cache_ent (mio_svc_dnc_t* dnc, const mio_uint8_t* key, mio_oow_t klen)
+{
+	dnc_cache_ent_t* ent, * victim;
+
+	/* make room by evicting the least recently used entries not waiting for a response */
+	victim = dnc->cache.tail;
+	while (victim && MIO_HTB_SIZE(&dnc->cache.htb) >= dnc->cache.capa)
+	{
+		dnc_cache_ent_t* prev = victim->prev;
+		if (!victim->leader) free_cache_ent (dnc, victim);
+		victim = prev;
+	}
+
+	ent = (dnc_cache_ent_t*)mio_callocmem(dnc->mio, MIO_SIZEOF(*ent));
+	if (MIO_UNLIKELY(!ent)) return MIO_NULL;
+
+	ent->pair = mio_htb_insert(&dnc->cache.htb, (void*)key, klen, ent, 0);
+	if (MIO_UNLIKELY(!ent->pair))
+	{
+		mio_freemem (dnc->mio, ent);
+		return MIO_NULL;
+	}
+
+	ent->next = dnc->cache.head;
+	if (dnc->cache.head) dnc->cache.head->prev = ent;
+	else dnc->cache.tail = ent;
+	dnc->cache.head = ent;
+
+	return ent;
+}
+
+static mio_uint32_t get_cacheable_ttl (const void* data, mio_oow_t dlen)
+{
+	/* return the number of seconds to cache the response for. 0 if not cacheable.
+	 * the response is inspected in place without decoding it */
+	mio_dns_pkt_cur_t cur;
+	mio_dns_pkt_edns_t edns;
+	mio_dns_crr_t rr;
+	mio_uint32_t ttl = MIO_TYPE_MAX(mio_uint32_t);
+	mio_uint32_t minimum;
+	int n;
+
+	if (mio_dns_init_pkt_cur(&cur, (const mio_dns_pkt_t*)data, dlen) <= -1) return 0;
+	if (cur.hdr.tc) return 0; /* truncated */
+
+	if (mio_dns_get_edns_in_pkt_cur(&cur, &edns) <= -1) return 0;
+	if (edns.xrcode != 0) return 0; /* extended rcode like BADVERS */
+
+	if (cur.hdr.rcode == MIO_DNS_RCODE_NOERROR && cur.ancount > 0)
+	{
+		while ((n = mio_dns_next_rr_in_pkt_cur(&cur, &rr)) > 0 && rr.part != MIO_DNS_RR_PART_ADDITIONAL)
+		{
+			if (rr.ttl < ttl) ttl = rr.ttl;
+		}
+		if (n <= -1) return 0;
+		if (ttl > MIO_SVC_DNC_CACHE_MAX_TTL) ttl = MIO_SVC_DNC_CACHE_MAX_TTL;
+		return ttl;
+	}
+
+	if (cur.hdr.rcode == MIO_DNS_RCODE_NXDOMAIN || cur.hdr.rcode == MIO_DNS_RCODE_NOERROR)
+	{
+		/* NXDOMAIN or NODATA. RFC2308 - the negative answer is cached for
+		 * the minimum of the SOA TTL and the SOA MINIMUM field. not
+		 * cacheable without a SOA record in the authority section */
+		while ((n = mio_dns_next_rr_in_pkt_cur(&cur, &rr)) > 0 && rr.part != MIO_DNS_RR_PART_ADDITIONAL)
+		{
+			if (rr.part == MIO_DNS_RR_PART_AUTHORITY && rr.rrtype == MIO_DNS_RRT_SOA)
+			{
+				/* the minimum field is the last 4 bytes of the data */
+				if (rr.dlen < 22) return 0;
+				MIO_MEMCPY (&minimum, &rr.dptr[rr.dlen - 4], 4);
+				minimum = mio_ntoh32(minimum);
+
+				ttl = rr.ttl;
+				if (minimum < ttl) ttl = minimum;
+				if (ttl > MIO_SVC_DNC_CACHE_MAX_NEG_TTL) ttl = MIO_SVC_DNC_CACHE_MAX_NEG_TTL;
+				return ttl;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void cache_response (mio_svc_dnc_t* dnc, dnc_cache_ent_t* ent, const void* data, mio_oow_t dlen)
+{
+	mio_uint32_t ttl;
+
+	if (dnc->cache.capa <= 0) return;
+
+	ttl = get_cacheable_ttl(data, dlen);
+	if (ttl <= 0) return;
+
+	if (dlen != ent->rsplen)
+	{
+		mio_uint8_t* tmp;
+		tmp = (mio_uint8_t*)mio_reallocmem(dnc->mio, ent->rsp, dlen);
+		if (MIO_UNLIKELY(!tmp)) return;
+		ent->rsp = tmp;
+		ent->rsplen = dlen;
+	}
+
+	MIO_MEMCPY (ent->rsp, data, dlen);
+	mio_gettime (dnc->mio, &ent->stored);
+	ent->expiry = ent->stored;
+	ent->expiry.sec += ttl;
+}
+
+static void age_pkt_info (mio_dns_pkt_info_t* pi, mio_uint32_t age)
+{
+	mio_uint16_t i;
+
+	for (i = 0; i < pi->ancount; i++) pi->rr.an[i].ttl = (pi->rr.an[i].ttl > age)? (pi->rr.an[i].ttl - age): 0;
+	for (i = 0; i < pi->nscount; i++) pi->rr.ns[i].ttl = (pi->rr.ns[i].ttl > age)? (pi->rr.ns[i].ttl - age): 0;
+	for (i = 0; i < pi->arcount; i++) 
+	{
+		if (pi->rr.ar[i].rrtype == MIO_DNS_RRT_OPT) continue; /* the ttl field holds edns flags */
+		pi->rr.ar[i].ttl = (pi->rr.ar[i].ttl > age)? (pi->rr.ar[i].ttl - age): 0;
+	}
+}
+
+void mio_svc_dnc_setcachecapa (mio_svc_dnc_t* dnc, mio_oow_t capa)
+{
+	dnc->cache.capa = capa;
+	if (capa <= 0) mio_svc_dnc_purgecache (dnc);
+}
+
+void mio_svc_dnc_purgecache (mio_svc_dnc_t* dnc)
+{
+	dnc_cache_ent_t* ent, * next;
+
+	for (ent = dnc->cache.head; ent; ent = next)
+	{
+		next = ent->next;
+		if (ent->leader)
+		{
+			/* keep the entry for coalescing until the response arrives */
+			if (ent->rsp) 
+			{
+				mio_freemem (dnc->mio, ent->rsp);
+				ent->rsp = MIO_NULL;
+				ent->rsplen = 0;
+			}
+		}
+		else
+		{
+			free_cache_ent (dnc, ent);
+		}
+	}
+}
+
+/* ----------------------------------------------------------------------- */
+
 mio_svc_dnc_t* mio_svc_dnc_start (mio_t* mio, const mio_skad_t* serv_addr, const mio_skad_t* bind_addr, const mio_ntime_t* send_tmout, const mio_ntime_t* reply_tmout, mio_oow_t max_tries)
 {
 	mio_svc_dnc_t* dnc = MIO_NULL;
@@ -731,12 +1301,27 @@ mio_svc_dnc_t* mio_svc_dnc_start (mio_t* mio, const mio_skad_t* serv_addr, const
 	if (MIO_UNLIKELY(!dnc)) goto oops;
 
 	dnc->mio = mio;
-	dnc->svc_stop = mio_svc_dnc_stop;
-	dnc->serv_addr = *serv_addr;
+	dnc->svc_stop = (mio_svc_stop_t)mio_svc_dnc_stop;
 	dnc->send_tmout = *send_tmout;
 	dnc->reply_tmout = *reply_tmout;
+	dnc->tcp_idle_tmout.sec = MIO_SVC_DNC_TCP_IDLE_TMOUT_DEFAULT;
 	dnc->max_tries = max_tries;
 
+	if (mio_htb_init(&dnc->cache.htb, mio, 128, 70, 1, 1) <= -1) 
+	{
+		mio_freemem (mio, dnc);
+		dnc = MIO_NULL;
+		goto oops;
+	}
+
+	dnc->serv.ptr = (dnc_serv_t*)mio_callocmem(mio, MIO_SIZEOF(*dnc->serv.ptr) * 4);
+	if (MIO_UNLIKELY(!dnc->serv.ptr)) goto oops;
+	dnc->serv.capa = 4;
+	dnc->serv.ptr[0].addr = *serv_addr;
+	dnc->serv.len = 1;
+	mio_htb_setstyle (&dnc->cache.htb, mio_get_htb_style(MIO_HTB_STYLE_INLINE_KEY_COPIER));
+	dnc->cache.capa = MIO_SVC_DNC_CACHE_CAPA_DEFAULT;
+
 	MIO_MEMSET (&mkinfo, 0, MIO_SIZEOF(mkinfo));
 	switch (mio_skad_family(serv_addr))
 	{
@@ -784,6 +1369,8 @@ oops:
 	if (dnc)
 	{
 		if (dnc->udp_sck) mio_dev_sck_kill (dnc->udp_sck);
+		if (dnc->serv.ptr) mio_freemem (mio, dnc->serv.ptr);
+		mio_htb_fini (&dnc->cache.htb);
 		mio_freemem (mio, dnc);
 	}
 	return MIO_NULL;
@@ -792,15 +1379,76 @@ oops:
 void mio_svc_dnc_stop (mio_svc_dnc_t* dnc)
 {
 	mio_t* mio = dnc->mio;
+	mio_oow_t i;
 
 	MIO_DEBUG1 (mio, "DNC - STOPPING SERVICE %p\n", dnc);
+	dnc->stopping = 1;
 	if (dnc->udp_sck) mio_dev_sck_kill (dnc->udp_sck);
-	if (dnc->tcp_sck) mio_dev_sck_kill (dnc->tcp_sck);
-	while (dnc->pending_req) release_dns_msg (dnc, dnc->pending_req);
+	for (i = 0; i < dnc->serv.len; i++)
+	{
+		if (dnc->serv.ptr[i].tcp_sck) mio_dev_sck_kill (dnc->serv.ptr[i].tcp_sck);
+	}
+	while (dnc->pending_req) 
+	{
+		/* let the requester know of the requests not to be answered.
+		 * the requests over the sockets killed above have been handled
+		 * in the disconnect handlers */
+		mio_dns_msg_t* reqmsg = dnc->pending_req;
+		dnc_dns_msg_xtn_t* reqmsgxtn = dnc_dns_msg_getxtn(reqmsg);
+		if (MIO_LIKELY(reqmsgxtn->on_done)) reqmsgxtn->on_done (dnc, reqmsg, MIO_ENORSP, MIO_NULL, 0);
+		release_dns_msg (dnc, reqmsg);
+	}
+	while (dnc->cache.head) 
+	{
+		dnc->cache.head->leader = MIO_NULL; /* released above */
+		free_cache_ent (dnc, dnc->cache.head);
+	}
+	mio_htb_fini (&dnc->cache.htb);
+	mio_freemem (mio, dnc->serv.ptr);
 	MIO_SVCL_UNLINK_SVC (dnc);
 	mio_freemem (mio, dnc);
 }
 
+int mio_svc_dnc_addserv (mio_svc_dnc_t* dnc, const mio_skad_t* serv_addr)
+{
+	/* all servers are reached via the same udp socket */
+	if (mio_skad_family(serv_addr) != mio_skad_family(&dnc->serv.ptr[0].addr))
+	{
+		mio_seterrbfmt (dnc->mio, MIO_EINVAL, "server address family mismatch");
+		return -1;
+	}
+
+	if (dnc->serv.len >= dnc->serv.capa)
+	{
+		dnc_serv_t* tmp;
+		mio_oow_t newcapa;
+
+		newcapa = dnc->serv.capa + 4;
+		tmp = (dnc_serv_t*)mio_reallocmem(dnc->mio, dnc->serv.ptr, MIO_SIZEOF(*tmp) * newcapa);
+		if (MIO_UNLIKELY(!tmp)) return -1;
+
+		dnc->serv.ptr = tmp;
+		dnc->serv.capa = newcapa;
+	}
+
+	MIO_MEMSET (&dnc->serv.ptr[dnc->serv.len], 0, MIO_SIZEOF(*dnc->serv.ptr));
+	dnc->serv.ptr[dnc->serv.len].addr = *serv_addr;
+	dnc->serv.len++;
+	return 0;
+}
+
+void mio_svc_dnc_settcpidletmout (mio_svc_dnc_t* dnc, const mio_ntime_t* tmout)
+{
+	if (tmout) dnc->tcp_idle_tmout = *tmout;
+	else MIO_CLEAR_NTIME (&dnc->tcp_idle_tmout);
+}
+
+void mio_svc_dnc_sethedgedelay (mio_svc_dnc_t* dnc, const mio_ntime_t* delay)
+{
+	if (delay) dnc->hedge_delay = *delay;
+	else MIO_CLEAR_NTIME (&dnc->hedge_delay);
+}
+
 
 static MIO_INLINE int send_dns_msg (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg, int send_flags)
 {
@@ -812,7 +1460,6 @@ static MIO_INLINE int send_dns_msg (mio_svc_dnc_t* dnc, mio_dns_msg_t* msg, int
 	MIO_DEBUG1 (dnc->mio, "DNC - sending dns message over udp - msgid:%d\n", (int)mio_ntoh16(mio_dns_msg_to_pkt(msg)->id));
 
 	tmout = MIO_IS_POS_NTIME(&msgxtn->wtmout)? &msgxtn->wtmout: MIO_NULL;
-/* TODO: optionally, override dnc->serv_addr and use the target address passed as a parameter */
 	return mio_dev_sck_timedwrite(dnc->udp_sck, mio_dns_msg_to_pkt(msg), msg->pktlen, tmout, msg, &msgxtn->servaddr);
 }
 
@@ -854,6 +1501,11 @@ struct dnc_dns_msg_resolve_xtn_t
 	int flags;
 	mio_uint8_t client_cookie[MIO_DNS_COOKIE_CLIENT_LEN];
 	mio_svc_dnc_on_resolve_t on_resolve;
+	mio_svc_dnc_t* dnc;
+	dnc_cache_ent_t* cent; /* cache entry if this request is in flight for it */
+	mio_oow_t xtnsize; /* size of the caller's extension */
+	mio_uint32_t cage; /* age of the cached response in seconds */
+	mio_oow_t crsplen; /* length of the cached response placed after the caller's extension */
 };
 typedef struct dnc_dns_msg_resolve_xtn_t dnc_dns_msg_resolve_xtn_t;
 
@@ -863,103 +1515,182 @@ typedef struct dnc_dns_msg_resolve_xtn_t dnc_dns_msg_resolve_xtn_t;
 #	define dnc_dns_msg_resolve_getxtn(msg) ((dnc_dns_msg_resolve_xtn_t*)((mio_uint8_t*)dnc_dns_msg_getxtn(msg) + MIO_SIZEOF(dnc_dns_msg_xtn_t)))
 #endif
 
-static void on_dnc_resolve (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_errnum_t status, const void* data, mio_oow_t dlen)
+static MIO_INLINE int is_brief_match (mio_dns_rrt_t qtype, mio_uint16_t rrtype)
 {
-	mio_t* mio = mio_svc_dnc_getmio(dnc);
-	mio_dns_pkt_info_t* pi = MIO_NULL;
+	/* it is a bit time taking to retreive the query type from the packet
+	 * bundled in reqmsg as it requires parsing of the packet. the caller
+	 * passes the query type stored in the extension space. */
+	switch (qtype)
+	{
+		case MIO_DNS_RRT_Q_ANY: 
+		case MIO_DNS_RRT_Q_AFXR: /* AFXR doesn't make sense in the brief mode. just treat it like ANY */
+			/* no A or AAAA found. so give the first entry in the answer */
+			return 1;
+
+		case MIO_DNS_RRT_Q_MAILA:
+			/* if you want to get the full RRs, don't use the brief mode. */
+			return rrtype == MIO_DNS_RRT_MD || rrtype == MIO_DNS_RRT_MF;
+
+		case MIO_DNS_RRT_Q_MAILB:
+			/* if you want to get the full RRs, don't use the brief mode. */
+			return rrtype == MIO_DNS_RRT_MB || rrtype == MIO_DNS_RRT_MG ||
+			       rrtype == MIO_DNS_RRT_MR || rrtype == MIO_DNS_RRT_MINFO;
+
+		default:
+			return rrtype == qtype;
+	}
+}
+
+static void deliver_resolve_reply (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_errnum_t status, const void* data, mio_oow_t dlen, mio_uint32_t age, mio_dns_pkt_info_t** pi)
+{
+	/* the reply packet is inspected in place with a cursor. the packet
+	 * is decoded into *pi only if the full reply is requested. *pi is 
+	 * shared by the coalesced requests and freed by the caller. */
 	dnc_dns_msg_resolve_xtn_t* resolxtn = dnc_dns_msg_resolve_getxtn(reqmsg);
 
 	if (data)
 	{
-		mio_uint32_t i;
+		mio_dns_pkt_cur_t cur, xcur;
+		mio_dns_pkt_edns_t edns;
+		mio_dns_crr_t rr;
+		mio_dns_brr_t brr;
+		union
+		{
+			mio_dns_brrd_soa_t soa; /* for alignment */
+			mio_uint8_t b[MIO_DNS_CRR_DECODE_BUF_LEN];
+		} rrbuf;
+		int n;
 
-		MIO_ASSERT (mio, status == MIO_ENOERR);
+		MIO_ASSERT (dnc->mio, status == MIO_ENOERR);
 
-		pi = mio_dns_make_pkt_info(mio, data, dlen);
-		if (!pi)
+		if (mio_dns_init_pkt_cur(&cur, (const mio_dns_pkt_t*)data, dlen) <= -1 ||
+		    mio_dns_get_edns_in_pkt_cur(&cur, &edns) <= -1) 
 		{
-			status = mio_geterrnum(mio);
+			status = MIO_EINVAL;
 			goto no_data;
 		}
 
 		if (resolxtn->flags & MIO_SVC_DNC_RESOLVE_FLAG_COOKIE)
 		{
-			if (pi->edns.cookie.server_len > 0)
+			if (edns.cookie.server_len > 0)
 			{
-				/* remember the received server cookie to use it with other new requests */
-				MIO_MEMCPY (dnc->cookie.data.server, pi->edns.cookie.data.server, pi->edns.cookie.server_len);
-				dnc->cookie.server_len = pi->edns.cookie.server_len;
+				/* remember the server cookie received to use it with other new
+				 * requests to the same server */
+				dnc_serv_t* serv = &dnc->serv.ptr[dnc_dns_msg_getxtn(reqmsg)->servidx];
+				MIO_MEMCPY (serv->cookie_server, edns.cookie.data.server, edns.cookie.server_len);
+				serv->cookie_server_len = edns.cookie.server_len;
 			}
 		}
 
 		if (!(resolxtn->flags & MIO_SVC_DNC_RESOLVE_FLAG_BRIEF))
 		{
 			/* the full reply packet is requested. */
-			if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, pi, 0);
-			goto done;
+			if (!*pi)
+			{
+				*pi = mio_dns_make_pkt_info(dnc->mio, data, dlen);
+				if (!*pi)
+				{
+					status = mio_geterrnum(dnc->mio);
+					goto no_data;
+				}
+				if (age > 0) age_pkt_info (*pi, age);
+			}
+			if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, *pi, 0);
+			return;
 		}
 
-		if (pi->hdr.rcode != MIO_DNS_RCODE_NOERROR) 
+		if (cur.hdr.rcode != MIO_DNS_RCODE_NOERROR || edns.xrcode != 0) 
 		{
 			status = MIO_EINVAL;
 			goto no_data;
 		}
 
-		if (pi->ancount < 0) goto no_data;
-
 		/* in the brief mode, we inspect the answer section only */
 		if (resolxtn->qtype == MIO_DNS_RRT_Q_ANY)
 		{
 			/* return A or AAAA for ANY in the brief mode */
-			for (i = 0; i < pi->ancount; i++)
+			xcur = cur;
+			while ((n = mio_dns_next_rr_in_pkt_cur(&xcur, &rr)) > 0 && rr.part == MIO_DNS_RR_PART_ANSWER)
 			{
-				if (pi->rr.an[i].rrtype == MIO_DNS_RRT_A || pi->rr.an[i].rrtype == MIO_DNS_RRT_AAAA)
-				{
-				match_found:
-					if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, &pi->rr.an[i], MIO_SIZEOF(pi->rr.an[i]));
-					goto done;
-				}
+				if (rr.rrtype == MIO_DNS_RRT_A || rr.rrtype == MIO_DNS_RRT_AAAA) goto match_found;
 			}
 		}
 
-		for (i = 0; i < pi->ancount; i++)
+		while ((n = mio_dns_next_rr_in_pkt_cur(&cur, &rr)) > 0 && rr.part == MIO_DNS_RR_PART_ANSWER)
 		{
-			/* it is a bit time taking to retreive the query type from the packet
-			 * bundled in reqmsg as it requires parsing of the packet. let me use
-			 * the query type i stored in the extension space. */
-			switch (resolxtn->qtype)
+			if (is_brief_match(resolxtn->qtype, rr.rrtype))
 			{
-				case MIO_DNS_RRT_Q_ANY: 
-				case MIO_DNS_RRT_Q_AFXR: /* AFXR doesn't make sense in the brief mode. just treat it like ANY */
-					/* no A or AAAA found. so give the first entry in the answer */
-					goto match_found;
-
-				case MIO_DNS_RRT_Q_MAILA:
-					/* if you want to get the full RRs, don't use the brief mode. */
-					if (pi->rr.an[i].rrtype == MIO_DNS_RRT_MD || pi->rr.an[i].rrtype == MIO_DNS_RRT_MF) goto match_found;
-					break;
-
-				case MIO_DNS_RRT_Q_MAILB:
-					/* if you want to get the full RRs, don't use the brief mode. */
-					if (pi->rr.an[i].rrtype == MIO_DNS_RRT_MB || pi->rr.an[i].rrtype == MIO_DNS_RRT_MG ||
-					    pi->rr.an[i].rrtype == MIO_DNS_RRT_MR || pi->rr.an[i].rrtype == MIO_DNS_RRT_MINFO) goto match_found;
-					break;
-
-				default:
-					if (pi->rr.an[i].rrtype == resolxtn->qtype) goto match_found;
-					break;
+			match_found:
+				/* decode the matching record only */
+				if (mio_dns_decode_rr_in_pkt_cur(&cur, &rr, &brr, &rrbuf, MIO_SIZEOF(rrbuf)) <= -1)
+				{
+					status = MIO_EINVAL;
+					goto no_data;
+				}
+				brr.ttl = (brr.ttl > age)? (brr.ttl - age): 0;
+				if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, &brr, MIO_SIZEOF(brr));
+				return;
 			}
 		}
-		goto no_data;
+		if (n <= -1) status = MIO_EINVAL;
 	}
-	else
+
+no_data:
+	if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, MIO_NULL, 0);
+}
+
+static void on_dnc_resolve (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_errnum_t status, const void* data, mio_oow_t dlen)
+{
+	mio_t* mio = mio_svc_dnc_getmio(dnc);
+	mio_dns_pkt_info_t* pi = MIO_NULL;
+	dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(reqmsg);
+	dnc_dns_msg_resolve_xtn_t* resolxtn = dnc_dns_msg_resolve_getxtn(reqmsg);
+	dnc_cache_ent_t* ent;
+
+	MIO_ASSERT (mio, !data || status == MIO_ENOERR);
+
+	ent = resolxtn->cent;
+	if (ent)
 	{
-	no_data:
-		if (resolxtn->on_resolve) resolxtn->on_resolve (dnc, reqmsg, status, MIO_NULL, 0);
+		/* this request has been in flight for the cache entry */
+		MIO_ASSERT (mio, ent->leader == reqmsg);
+		ent->leader = MIO_NULL;
+		resolxtn->cent = MIO_NULL;
+
+		if (data) cache_response (dnc, ent, data, dlen);
+		if (!ent->rsp) free_cache_ent (dnc, ent); /* nothing to keep */
 	}
 
-done:
-	if (pi) mio_dns_free_pkt_info(mio_svc_dnc_getmio(dnc), pi);
+	deliver_resolve_reply (dnc, reqmsg, status, data, dlen, 0, &pi);
+
+	/* the requests coalesced get the same result */
+	while (msgxtn->co_first)
+	{
+		mio_dns_msg_t* comsg = msgxtn->co_first;
+		msgxtn->co_first = dnc_dns_msg_getxtn(comsg)->co_next;
+		deliver_resolve_reply (dnc, comsg, status, data, dlen, 0, &pi);
+		release_dns_msg (dnc, comsg);
+	}
+
+	if (pi) mio_dns_free_pkt_info(mio, pi);
+}
+
+static void on_cached_reply (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_dns_msg_t* reqmsg = (mio_dns_msg_t*)job->ctx;
+	dnc_dns_msg_resolve_xtn_t* resolxtn = dnc_dns_msg_resolve_getxtn(reqmsg);
+	mio_svc_dnc_t* dnc = resolxtn->dnc;
+	mio_dns_pkt_t* pkt;
+	mio_dns_pkt_info_t* pi = MIO_NULL;
+
+	/* the cached response is placed after the caller's extension */
+	pkt = (mio_dns_pkt_t*)((mio_uint8_t*)(resolxtn + 1) + resolxtn->xtnsize);
+	pkt->id = mio_dns_msg_to_pkt(reqmsg)->id;
+
+	deliver_resolve_reply (dnc, reqmsg, MIO_ENOERR, pkt, resolxtn->crsplen, resolxtn->cage, &pi);
+	if (pi) mio_dns_free_pkt_info(mio, pi);
+
+	release_dns_msg (dnc, reqmsg);
 }
 
 mio_dns_msg_t* mio_svc_dnc_resolve (mio_svc_dnc_t* dnc, const mio_bch_t* qname, mio_dns_rrt_t qtype, int resolve_flags, mio_svc_dnc_on_resolve_t on_resolve, mio_oow_t xtnsize)
@@ -990,26 +1721,69 @@ mio_dns_msg_t* mio_svc_dnc_resolve (mio_svc_dnc_t* dnc, const mio_bch_t* qname,
 	};
 
 	mio_dns_beopt_t beopt_cookie;
+	mio_oow_t servidx = DNC_SERV_NONE;
+	dnc_serv_t* serv = MIO_NULL;
 
 	mio_dns_bqr_t qr;
 	mio_dns_msg_t* reqmsg;
 	dnc_dns_msg_resolve_xtn_t* resolxtn;
 
+	mio_uint8_t key[3 + 256];
+	mio_oow_t klen;
+	dnc_cache_ent_t* ent = MIO_NULL;
+	mio_oow_t crsplen = 0;
+
 	qr.qname = (mio_bch_t*)qname;
 	qr.qtype = qtype;
 	qr.qclass = MIO_DNS_RRC_IN;
 
+	klen = (qtype == MIO_DNS_RRT_Q_AFXR)? 0: make_cache_key(key, qname, qtype, resolve_flags);
+	if (klen > 0)
+	{
+		ent = find_cache_ent(dnc, key, klen);
+		if (ent && ent->rsp)
+		{
+			mio_ntime_t now;
+			mio_gettime (dnc->mio, &now);
+			if (MIO_CMP_NTIME(&now, &ent->expiry) >= 0)
+			{
+				/* expired */
+				mio_freemem (dnc->mio, ent->rsp);
+				ent->rsp = MIO_NULL;
+				ent->rsplen = 0;
+				if (!ent->leader) 
+				{
+					free_cache_ent (dnc, ent);
+					ent = MIO_NULL;
+				}
+			}
+			else if (!(resolve_flags & MIO_SVC_DNC_RESOLVE_FLAG_NO_CACHE))
+			{
+				touch_cache_ent (dnc, ent);
+				crsplen = ent->rsplen;
+			}
+		}
+	}
+
 	if (resolve_flags & MIO_SVC_DNC_RESOLVE_FLAG_COOKIE)
 	{
 		beopt_cookie.code = MIO_DNS_EOPT_COOKIE;
 		beopt_cookie.dptr = &dnc->cookie.data;
 
+		/* choose the server now as the cookies are specific to it */
+		servidx = select_serv(dnc, DNC_SERV_NONE);
+		serv = &dnc->serv.ptr[servidx];
+
 		beopt_cookie.dlen = MIO_DNS_COOKIE_CLIENT_LEN; 
-		if (dnc->cookie.server_len > 0) beopt_cookie.dlen += dnc->cookie.server_len;
+		if (serv->cookie_server_len > 0)
+		{
+			MIO_MEMCPY (dnc->cookie.data.server, serv->cookie_server, serv->cookie_server_len);
+			beopt_cookie.dlen += serv->cookie_server_len;
+		}
 
 		/* compute the client cookie */
 		MIO_STATIC_ASSERT (MIO_SIZEOF(dnc->cookie.data.client) == MIO_DNS_COOKIE_CLIENT_LEN);
-		mio_sip_hash_24 (dnc->cookie.key, &dnc->serv_addr, MIO_SIZEOF(dnc->serv_addr), dnc->cookie.data.client);
+		make_client_cookie (dnc, servidx, dnc->cookie.data.client);
 
 		qedns.beonum = 1;
 		qedns.beoptr = &beopt_cookie;
@@ -1020,11 +1794,20 @@ mio_dns_msg_t* mio_svc_dnc_resolve (mio_svc_dnc_t* dnc, const mio_bch_t* qname,
 		qedns.dnssecok = 1;
 	}
 
-	reqmsg = make_dns_msg(dnc, &qhdr, &qr, 1, MIO_NULL, 0, &qedns, on_dnc_resolve, MIO_SIZEOF(*resolxtn) + xtnsize);
+	reqmsg = make_dns_msg(dnc, &qhdr, &qr, 1, MIO_NULL, 0, &qedns, on_dnc_resolve, MIO_SIZEOF(*resolxtn) + xtnsize + crsplen);
 	if (reqmsg)
 	{
 		int send_flags;
 
+		if (resolve_flags & MIO_SVC_DNC_RESOLVE_FLAG_COOKIE)
+		{
+			/* send it to the server the cookies have been chosen for */
+			dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(reqmsg);
+			msgxtn->servidx = servidx;
+			msgxtn->servaddr = serv->addr;
+			msgxtn->cookie = 1;
+		}
+
 #if 0
 		if ((resolve_flags & MIO_SVC_DNC_RESOLVE_FLAG_COOKIE) && dnc->cookie.server_len == 0)
 		{
@@ -1055,15 +1838,78 @@ mio_dns_msg_t* mio_svc_dnc_resolve (mio_svc_dnc_t* dnc, const mio_bch_t* qname,
 
 		resolxtn = dnc_dns_msg_resolve_getxtn(reqmsg);
 		resolxtn->on_resolve = on_resolve;
+		resolxtn->dnc = dnc;
 		resolxtn->qtype = qtype;
 		resolxtn->flags = resolve_flags;
+		resolxtn->cent = MIO_NULL;
+		resolxtn->xtnsize = xtnsize;
+		resolxtn->crsplen = crsplen;
 		/* store in the extension area the client cookie set in the packet */
 		MIO_MEMCPY (resolxtn->client_cookie, dnc->cookie.data.client, MIO_DNS_COOKIE_CLIENT_LEN);
 
+		if (crsplen > 0)
+		{
+			/* answer from the cache. the callback is invoked from a timer job
+			 * so that the caller gets the request message before the callback */
+			dnc_dns_msg_xtn_t* msgxtn = dnc_dns_msg_getxtn(reqmsg);
+			mio_ntime_t age;
+			mio_tmrjob_t tmrjob;
+
+			MIO_MEMCPY ((mio_uint8_t*)(resolxtn + 1) + xtnsize, ent->rsp, crsplen);
+
+			MIO_MEMSET (&tmrjob, 0, MIO_SIZEOF(tmrjob));
+			mio_gettime (dnc->mio, &tmrjob.when);
+			MIO_SUB_NTIME (&age, &tmrjob.when, &ent->stored);
+			resolxtn->cage = (mio_uint32_t)age.sec;
+
+			tmrjob.ctx = reqmsg;
+			tmrjob.handler = on_cached_reply;
+			tmrjob.idxptr = &msgxtn->rtmridx;
+			msgxtn->rtmridx = mio_instmrjob(dnc->mio, &tmrjob);
+			if (msgxtn->rtmridx == MIO_TMRIDX_INVALID)
+			{
+				release_dns_msg (dnc, reqmsg);
+				return MIO_NULL;
+			}
+
+			/* chain it so that mio_svc_dnc_stop() can release it. it never
+			 * matches a response as it's not associated with a device */
+			msgxtn->dev = MIO_NULL;
+			chain_pending_dns_reqmsg (dnc, reqmsg);
+			return reqmsg;
+		}
+
+		if (ent && ent->leader)
+		{
+			/* the same question is in flight. wait for its answer */
+			dnc_dns_msg_xtn_t* leadxtn = dnc_dns_msg_getxtn(ent->leader);
+			dnc_dns_msg_getxtn(reqmsg)->co_next = leadxtn->co_first;
+			leadxtn->co_first = reqmsg;
+			return reqmsg;
+		}
+
+		if (klen > 0)
+		{
+			/* remember the request in flight so that other requests 
+			 * for the same key can share the response. failure to
+			 * allocate a cache entry is not fatal */
+			if (!ent) ent = add_cache_ent(dnc, key, klen);
+			if (ent)
+			{
+				ent->leader = reqmsg;
+				resolxtn->cent = ent;
+			}
+		}
+
 		send_flags = (resolve_flags & MIO_SVC_DNC_SEND_FLAG_ALL);
 		if (MIO_UNLIKELY(qtype == MIO_DNS_RRT_Q_AFXR)) send_flags |= MIO_SVC_DNC_SEND_FLAG_PREFER_TCP;
 		if (send_dns_msg(dnc, reqmsg, send_flags) <= -1)
 		{
+			if (resolxtn->cent)
+			{
+				ent->leader = MIO_NULL;
+				if (!ent->rsp) free_cache_ent (dnc, ent);
+			}
 			release_dns_msg (dnc, reqmsg);
 			return MIO_NULL;
 		}
@@ -1072,7 +1918,12 @@ mio_dns_msg_t* mio_svc_dnc_resolve (mio_svc_dnc_t* dnc, const mio_bch_t* qname,
 	return reqmsg;
 }
 
-int mio_svc_dnc_checkclientcookie (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_dns_pkt_info_t* respi)
+void* mio_svc_dnc_getresolvextn (mio_dns_msg_t* reqmsg)
+{
+	return (void*)(dnc_dns_msg_resolve_getxtn(reqmsg) + 1);
+}
+
+static int check_client_cookie (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, const mio_dns_cookie_t* rescookie)
 {
 	mio_uint8_t xb[MIO_DNS_COOKIE_CLIENT_LEN];
 	mio_uint8_t* x;
@@ -1081,10 +1932,10 @@ int mio_svc_dnc_checkclientcookie (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mi
 	if (x)
 	{
 		/* there is a client cookie in the request. */
-		if (respi->edns.cookie.client_len > 0)
+		if (rescookie->client_len > 0)
 		{
-			MIO_ASSERT (dnc->mio, respi->edns.cookie.client_len == MIO_DNS_COOKIE_CLIENT_LEN);
-			return MIO_MEMCMP(x, respi->edns.cookie.data.client, MIO_DNS_COOKIE_CLIENT_LEN) == 0; /* 1 if ok, 0 if not */
+			MIO_ASSERT (dnc->mio, rescookie->client_len == MIO_DNS_COOKIE_CLIENT_LEN);
+			return MIO_MEMCMP(x, rescookie->data.client, MIO_DNS_COOKIE_CLIENT_LEN) == 0; /* 1 if ok, 0 if not */
 		}
 		else
 		{
@@ -1096,6 +1947,22 @@ int mio_svc_dnc_checkclientcookie (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mi
 	return 2; /* ok because the request doesn't include the client cookie */
 }
 
+int mio_svc_dnc_checkclientcookie (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_dns_pkt_info_t* respi)
+{
+	return check_client_cookie(dnc, reqmsg, &respi->edns.cookie);
+}
+
+int mio_svc_dnc_checkclientcookieinpkt (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, const mio_dns_pkt_t* respkt, mio_oow_t respktlen)
+{
+	mio_dns_pkt_cur_t cur;
+	mio_dns_pkt_edns_t edns;
+
+	if (mio_dns_init_pkt_cur(&cur, respkt, respktlen) <= -1 ||
+	    mio_dns_get_edns_in_pkt_cur(&cur, &edns) <= -1) return 0; /* malformed */
+
+	return check_client_cookie(dnc, reqmsg, &edns.cookie);
+}
+
 /* TODO: upon startup, read /etc/hosts. setup inotify or find a way to detect file changes..
  *       in resolve, add an option to use entries from /etc/hosts */
 
@@ -0,0 +1,1103 @@
+/*
+ * $Id$
+ *
+    Copyright (c) 2016-2020 Chung, Hyung-Hwan. All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions
+    are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+    IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WAfRRANTIES
+    OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+    INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+    THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <mio-dns.h>
+#include <mio-sck.h>
+#include "mio-prv.h"
+
+/* ----------------------------------------------------------------------- */
+
+#define DNS_DN_MAX (255) /* maximum length of a name in the wire format */
+#define DNS_UDP_PAYLOAD_MIN (512)
+#define DNS_UDP_PAYLOAD_MAX (4096)
+#define DNS_TCP_PAYLOAD_MAX (65535)
+#define DNS_MAX_CNAME_CHAIN (8)
+#define DNS_OPT_RR_LEN (1 + MIO_SIZEOF(mio_dns_rrtr_t))
+
+#define LOWER_BYTE(c) (((c) >= 'A' && (c) <= 'Z')? ((c) + ('a' - 'A')): (c))
+
+typedef struct dns_node_t dns_node_t;
+typedef struct dns_rrset_t dns_rrset_t;
+typedef struct dns_fwd_t dns_fwd_t;
+
+/* records of the same type owned by a name. the records are kept
+ * encoded as they appear in the answer section of a response. each
+ * record begins with a 2-byte compression pointer to the owner name
+ * which is 0xC00C(the name in the question) in the template and is
+ * patched when the records are placed for another name. */
+struct dns_rrset_t
+{
+	dns_rrset_t* next;
+	mio_uint16_t type;
+	mio_uint16_t count;
+	mio_oow_t    len;
+	mio_oow_t    capa;
+	mio_uint8_t* tmpl;
+};
+
+/* a node in the label trie. the path from the root to a node spells
+ * the owner name in the reverse order of labels. */
+struct dns_node_t
+{
+	dns_node_t** child; /* sorted by the label length and the label */
+	mio_oow_t    nchilds;
+	mio_oow_t    capa;
+	dns_rrset_t* rrset;
+	dns_rrset_t* soa; /* not MIO_NULL if the node is the apex of a zone */
+	mio_uint8_t  len;
+	mio_uint8_t  label[1]; /* lowercased. actual size is len */
+};
+
+/* query information needed to compose a response */
+struct dns_query_t
+{
+	const mio_uint8_t* qptr; /* question section */
+	mio_uint16_t qlen; /* length of the question section. 0 if no question */
+	mio_uint16_t qtype;
+	mio_uint16_t qclass;
+	mio_uint16_t id; /* in the network byte order */
+	mio_uint16_t uplen; /* udp payload size advertised in the edns OPT RR */
+	mio_uint8_t  opcode;
+	mio_uint8_t  rd;
+	mio_uint8_t  cd;
+	mio_uint8_t  edns;
+	mio_uint8_t  dnssecok;
+};
+typedef struct dns_query_t dns_query_t;
+
+/* a response being composed in the response buffer */
+struct dns_rsp_t
+{
+	mio_uint8_t* ptr;
+	mio_oow_t    len;
+	mio_oow_t    max;
+	mio_oow_t    qend; /* end of the question section */
+	mio_uint16_t count[3]; /* answer, authority, additional */
+	int          aa;
+	int          tc;
+};
+typedef struct dns_rsp_t dns_rsp_t;
+
+/* a question forwarded. it lives in the extension area of the request
+ * message of mio_svc_dnc_resolve() */
+struct dns_fwd_t
+{
+	mio_svc_dns_t* dns; /* MIO_NULL if the service has been stopped */
+	mio_dev_sck_t* sck; /* MIO_NULL if the client connection has gone */
+	mio_skad_t     srcaddr; /* valid for udp only */
+	int            udp;
+	dns_fwd_t*     prev;
+	dns_fwd_t*     next;
+	dns_query_t    q;
+	mio_uint8_t    qbuf[DNS_DN_MAX + MIO_SIZEOF(mio_dns_qrtr_t)];
+};
+
+struct dns_sck_xtn_t
+{
+	mio_svc_dns_t* dns;
+
+	/* the following fields are used by tcp sockets accepted */
+	mio_dev_sck_t* prev;
+	mio_dev_sck_t* next;
+	struct
+	{
+		mio_uint8_t* ptr;
+		mio_oow_t  len;
+		mio_oow_t  capa;
+	} rbuf;
+};
+typedef struct dns_sck_xtn_t dns_sck_xtn_t;
+
+struct mio_svc_dns_t
+{
+	MIO_SVC_HEADER;
+	/*MIO_DNS_SVC_HEADER;*/
+
+	mio_dev_sck_t* udp_sck;
+	mio_dev_sck_t* tcp_lsck;
+	mio_dev_sck_t* tcp_cli; /* tcp connections accepted */
+
+	mio_svc_dnc_t* fwd; /* forwarder for questions not answered from the zone store */
+	dns_fwd_t*     fwd_pending;
+
+	dns_node_t root;
+
+	/* response buffer. the first 2 bytes are for the length over tcp */
+	mio_uint8_t rspbuf[2 + 65535];
+};
+
+/* ----------------------------------------------------------------------- */
+
+static MIO_INLINE int cmp_label (const mio_uint8_t* x, mio_uint8_t xlen, const mio_uint8_t* y, mio_uint8_t ylen)
+{
+	/* x is lowercased already */
+	mio_uint8_t i, c;
+
+	if (xlen != ylen) return (int)xlen - (int)ylen;
+	for (i = 0; i < xlen; i++)
+	{
+		c = LOWER_BYTE(y[i]);
+		if (x[i] != c) return (int)x[i] - (int)c;
+	}
+	return 0;
+}
+
+static dns_node_t* find_child (dns_node_t* node, const mio_uint8_t* label, mio_uint8_t len, mio_oow_t* pos)
+{
+	mio_oow_t lo = 0, hi = node->nchilds, mid;
+	dns_node_t* c;
+	int n;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		c = node->child[mid];
+		n = cmp_label(c->label, c->len, label, len);
+		if (n == 0)
+		{
+			*pos = mid;
+			return c;
+		}
+		if (n < 0) lo = mid + 1;
+		else hi = mid;
+	}
+
+	*pos = lo;
+	return MIO_NULL;
+}
+
+static mio_oow_t split_labels (const mio_uint8_t* msg, mio_oow_t off, mio_oow_t end, mio_uint16_t* lab, mio_oow_t* nlabs)
+{
+	/* find the beginning of each label in an uncompressed name.
+	 * return the offset past the terminating zero. 0 on failure */
+	mio_oow_t n = 0;
+	mio_uint8_t seglen;
+
+	while (1)
+	{
+		if (off >= end) return 0;
+		seglen = msg[off];
+		if (seglen == 0) break;
+		if (seglen > 63 || n >= 128 || end - off - 1 < seglen) return 0;
+		lab[n++] = off;
+		off += seglen + 1;
+	}
+
+	*nlabs = n;
+	return off + 1;
+}
+
+/* find the node for the name at the offset off in the message. it also
+ * finds the apex of the closest enclosing zone. */
+static dns_node_t* find_node (mio_svc_dns_t* dns, const mio_uint8_t* msg, mio_oow_t off, mio_oow_t end, dns_node_t** apex, mio_oow_t* apexoff)
+{
+	mio_uint16_t lab[128];
+	mio_oow_t nlabs, pos, zoff;
+	dns_node_t* node;
+
+	*apex = MIO_NULL;
+
+	zoff = split_labels(msg, off, end, lab, &nlabs);
+	if (zoff <= 0) return MIO_NULL;
+
+	node = &dns->root;
+	if (node->soa)
+	{
+		*apex = node;
+		*apexoff = zoff - 1; /* the root name */
+	}
+
+	while (nlabs > 0)
+	{
+		nlabs--;
+		node = find_child(node, &msg[lab[nlabs] + 1], msg[lab[nlabs]], &pos);
+		if (!node) return MIO_NULL;
+		if (node->soa)
+		{
+			*apex = node;
+			*apexoff = lab[nlabs];
+		}
+	}
+
+	return node;
+}
+
+static dns_node_t* make_node (mio_svc_dns_t* dns, const mio_uint8_t* dn, mio_oow_t dnlen)
+{
+	mio_t* mio = dns->mio;
+	mio_uint16_t lab[128];
+	mio_oow_t nlabs, pos, i;
+	dns_node_t* node, * c;
+
+	if (split_labels(dn, 0, dnlen, lab, &nlabs) <= 0)
+	{
+		mio_seterrbfmt (mio, MIO_EINVAL, "invalid owner name");
+		return MIO_NULL;
+	}
+
+	node = &dns->root;
+	while (nlabs > 0)
+	{
+		const mio_uint8_t* label;
+		mio_uint8_t len;
+
+		nlabs--;
+		len = dn[lab[nlabs]];
+		label = &dn[lab[nlabs] + 1];
+
+		c = find_child(node, label, len, &pos);
+		if (!c)
+		{
+			if (node->nchilds >= node->capa)
+			{
+				dns_node_t** tmp;
+				mio_oow_t newcapa;
+
+				newcapa = node->capa <= 0? 4: node->capa * 2;
+				tmp = (dns_node_t**)mio_reallocmem(mio, node->child, MIO_SIZEOF(*tmp) * newcapa);
+				if (MIO_UNLIKELY(!tmp)) return MIO_NULL;
+				node->child = tmp;
+				node->capa = newcapa;
+			}
+
+			c = (dns_node_t*)mio_callocmem(mio, MIO_SIZEOF(*c) + len);
+			if (MIO_UNLIKELY(!c)) return MIO_NULL;
+			c->len = len;
+			for (i = 0; i < len; i++) c->label[i] = LOWER_BYTE(label[i]);
+
+			MIO_MEMMOVE (&node->child[pos + 1], &node->child[pos], (node->nchilds - pos) * MIO_SIZEOF(*node->child));
+			node->child[pos] = c;
+			node->nchilds++;
+		}
+
+		node = c;
+	}
+
+	return node;
+}
+
+static void free_node_contents (mio_t* mio, dns_node_t* node)
+{
+	mio_oow_t i;
+
+	while (node->rrset)
+	{
+		dns_rrset_t* rrset = node->rrset;
+		node->rrset = rrset->next;
+		if (rrset->tmpl) mio_freemem (mio, rrset->tmpl);
+		mio_freemem (mio, rrset);
+	}
+	node->soa = MIO_NULL;
+
+	for (i = 0; i < node->nchilds; i++)
+	{
+		free_node_contents (mio, node->child[i]);
+		mio_freemem (mio, node->child[i]);
+	}
+	if (node->child) mio_freemem (mio, node->child);
+	node->child = MIO_NULL;
+	node->nchilds = 0;
+	node->capa = 0;
+}
+
+static MIO_INLINE dns_rrset_t* find_rrset (dns_node_t* node, mio_uint16_t type)
+{
+	dns_rrset_t* rrset;
+	for (rrset = node->rrset; rrset; rrset = rrset->next)
+	{
+		if (rrset->type == type) break;
+	}
+	return rrset;
+}
+
+/* ----------------------------------------------------------------------- */
+
+int mio_svc_dns_addrr (mio_svc_dns_t* dns, const mio_dns_brr_t* rr)
+{
+	mio_t* mio = dns->mio;
+	mio_dns_bhdr_t bhdr;
+	mio_dns_brr_t brr;
+	mio_dns_msg_t* msg;
+	mio_uint8_t* dn, * rec;
+	mio_oow_t dnlen, reclen, off;
+	dns_node_t* node;
+	dns_rrset_t* rrset;
+
+	if (rr->rrclass != MIO_DNS_RRC_IN || rr->rrtype == MIO_DNS_RRT_OPT || rr->rrtype >= MIO_DNS_RRT_Q_AFXR)
+	{
+		mio_seterrbfmt (mio, MIO_EINVAL, "unsupported record type %d or class %d", (int)rr->rrtype, (int)rr->rrclass);
+		return -1;
+	}
+
+	/* let the dns codec encode the record */
+	MIO_MEMSET (&bhdr, 0, MIO_SIZEOF(bhdr));
+	brr = *rr;
+	brr.part = MIO_DNS_RR_PART_ANSWER;
+	msg = mio_dns_make_msg(mio, &bhdr, MIO_NULL, 0, &brr, 1, MIO_NULL, 0);
+	if (MIO_UNLIKELY(!msg)) return -1;
+
+	dn = (mio_uint8_t*)(mio_dns_msg_to_pkt(msg) + 1);
+	dnlen = 0;
+	while (dn[dnlen] != 0) dnlen += dn[dnlen] + 1;
+	dnlen++;
+	rec = dn + dnlen; /* rrtr and the record data */
+	reclen = msg->pktlen - MIO_SIZEOF(mio_dns_pkt_t) - dnlen;
+
+	node = make_node(dns, dn, dnlen);
+	if (MIO_UNLIKELY(!node)) goto oops;
+
+	rrset = find_rrset(node, rr->rrtype);
+	if (!rrset)
+	{
+		rrset = (dns_rrset_t*)mio_callocmem(mio, MIO_SIZEOF(*rrset));
+		if (MIO_UNLIKELY(!rrset)) goto oops;
+		rrset->type = rr->rrtype;
+		rrset->next = node->rrset;
+		node->rrset = rrset;
+		if (rr->rrtype == MIO_DNS_RRT_SOA) node->soa = rrset;
+	}
+	else if (rr->rrtype == MIO_DNS_RRT_SOA)
+	{
+		/* a zone has only one SOA record. replace it */
+		rrset->len = 0;
+		rrset->count = 0;
+	}
+
+	for (off = 0; off < rrset->len; )
+	{
+		mio_dns_rrtr_t* rrtr = (mio_dns_rrtr_t*)(rrset->tmpl + off + 2);
+		mio_oow_t xlen = MIO_SIZEOF(*rrtr) + mio_ntoh16(rrtr->dlen);
+
+		if (xlen == reclen && MIO_MEMCMP(rrtr + 1, (mio_dns_rrtr_t*)rec + 1, xlen - MIO_SIZEOF(*rrtr)) == 0)
+		{
+			/* the same record exists. just update the ttl */
+			rrtr->ttl = ((mio_dns_rrtr_t*)rec)->ttl;
+			goto done;
+		}
+
+		off += 2 + xlen;
+	}
+
+	if (rrset->capa - rrset->len < 2 + reclen)
+	{
+		mio_uint8_t* tmp;
+		mio_oow_t newcapa;
+
+		newcapa = MIO_ALIGN_POW2(rrset->len + 2 + reclen, 64);
+		tmp = (mio_uint8_t*)mio_reallocmem(mio, rrset->tmpl, newcapa);
+		if (MIO_UNLIKELY(!tmp)) goto oops;
+		rrset->tmpl = tmp;
+		rrset->capa = newcapa;
+	}
+
+	rrset->tmpl[rrset->len++] = 0xC0;
+	rrset->tmpl[rrset->len++] = MIO_SIZEOF(mio_dns_pkt_t);
+	MIO_MEMCPY (&rrset->tmpl[rrset->len], rec, reclen);
+	rrset->len += reclen;
+	rrset->count++;
+
+done:
+	mio_dns_free_msg (mio, msg);
+	return 0;
+
+oops:
+	mio_dns_free_msg (mio, msg);
+	return -1;
+}
+
+void mio_svc_dns_setforwarder (mio_svc_dns_t* dns, mio_svc_dnc_t* dnc)
+{
+	dns->fwd = dnc;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int parse_query (const mio_uint8_t* req, mio_oow_t len, dns_query_t* q)
+{
+	/* return -1 if the request must be dropped. otherwise, return the
+	 * response code. the question is available if q->qlen > 0. */
+	const mio_dns_pkt_t* pkt = (const mio_dns_pkt_t*)req;
+	mio_oow_t off, nlen;
+	mio_uint8_t seglen;
+
+	if (len < MIO_SIZEOF(*pkt) || pkt->qr) return -1;
+
+	MIO_MEMSET (q, 0, MIO_SIZEOF(*q));
+	q->id = pkt->id;
+	q->opcode = pkt->opcode;
+	q->rd = pkt->rd;
+	q->cd = pkt->cd;
+
+	if (pkt->opcode != MIO_DNS_OPCODE_QUERY) return MIO_DNS_RCODE_NOTIMPL;
+	if (pkt->qdcount != MIO_CONST_HTON16(1)) return MIO_DNS_RCODE_FORMERR;
+
+	off = MIO_SIZEOF(*pkt);
+	nlen = 0;
+	do
+	{
+		if (off >= len) return MIO_DNS_RCODE_FORMERR;
+		seglen = req[off];
+		if (seglen > 63 || len - off - 1 < seglen) return MIO_DNS_RCODE_FORMERR; /* compression not allowed in the question */
+		nlen += seglen + 1;
+		if (nlen > DNS_DN_MAX) return MIO_DNS_RCODE_FORMERR;
+		off += seglen + 1;
+	}
+	while (seglen > 0);
+
+	if (len - off < MIO_SIZEOF(mio_dns_qrtr_t)) return MIO_DNS_RCODE_FORMERR;
+	q->qtype = ((mio_uint16_t)req[off] << 8) | req[off + 1];
+	q->qclass = ((mio_uint16_t)req[off + 2] << 8) | req[off + 3];
+	off += MIO_SIZEOF(mio_dns_qrtr_t);
+	q->qptr = req + MIO_SIZEOF(*pkt);
+	q->qlen = off - MIO_SIZEOF(*pkt);
+
+	if (pkt->arcount != 0 && pkt->ancount == 0 && pkt->nscount == 0 && len - off >= DNS_OPT_RR_LEN && req[off] == 0)
+	{
+		/* the OPT pseudo-RR right after the question */
+		mio_dns_rrtr_t rrtr;
+		mio_uint32_t ttl;
+
+		MIO_MEMCPY (&rrtr, &req[off + 1], MIO_SIZEOF(rrtr));
+		if (rrtr.rrtype == MIO_CONST_HTON16(MIO_DNS_RRT_OPT))
+		{
+			ttl = mio_ntoh32(rrtr.ttl);
+			q->edns = 1;
+			q->uplen = mio_ntoh16(rrtr.rrclass);
+			q->dnssecok = (ttl >> 15) & 1;
+			if (((ttl >> 16) & 0xFF) != 0) return MIO_DNS_RCODE_BADVERS;
+		}
+	}
+
+	return MIO_DNS_RCODE_NOERROR;
+}
+
+static MIO_INLINE mio_oow_t get_udp_payload_max (const dns_query_t* q)
+{
+	if (!q->edns || q->uplen <= DNS_UDP_PAYLOAD_MIN) return DNS_UDP_PAYLOAD_MIN;
+	return q->uplen > DNS_UDP_PAYLOAD_MAX? DNS_UDP_PAYLOAD_MAX: q->uplen;
+}
+
+static void begin_response (mio_svc_dns_t* dns, dns_rsp_t* rsp, const dns_query_t* q, mio_oow_t max)
+{
+	mio_dns_pkt_t* pkt;
+
+	MIO_MEMSET (rsp, 0, MIO_SIZEOF(*rsp));
+	rsp->ptr = &dns->rspbuf[2];
+	rsp->max = max;
+	if (q->edns) rsp->max -= DNS_OPT_RR_LEN; /* reserve space for the OPT RR */
+
+	pkt = (mio_dns_pkt_t*)rsp->ptr;
+	MIO_MEMSET (pkt, 0, MIO_SIZEOF(*pkt));
+	pkt->id = q->id;
+	pkt->qr = 1;
+	pkt->opcode = q->opcode;
+	pkt->rd = q->rd;
+	pkt->cd = q->cd;
+	pkt->ra = (dns->fwd != MIO_NULL);
+	rsp->len = MIO_SIZEOF(*pkt);
+
+	if (q->qlen > 0)
+	{
+		MIO_MEMCPY (&rsp->ptr[rsp->len], q->qptr, q->qlen);
+		rsp->len += q->qlen;
+		pkt->qdcount = MIO_CONST_HTON16(1);
+	}
+	rsp->qend = rsp->len;
+}
+
+static void finish_response (dns_rsp_t* rsp, const dns_query_t* q, int rcode)
+{
+	mio_dns_pkt_t* pkt = (mio_dns_pkt_t*)rsp->ptr;
+
+	if (rsp->tc)
+	{
+		/* drop all records for the client to retry over tcp */
+		rsp->len = rsp->qend;
+		rsp->count[0] = rsp->count[1] = rsp->count[2] = 0;
+		pkt->tc = 1;
+	}
+
+	pkt->aa = rsp->aa;
+	pkt->rcode = rcode & 0x0F;
+
+	if (q->edns)
+	{
+		mio_dns_rrtr_t rrtr;
+
+		rsp->ptr[rsp->len++] = 0; /* root */
+		rrtr.rrtype = MIO_CONST_HTON16(MIO_DNS_RRT_OPT);
+		rrtr.rrclass = MIO_CONST_HTON16(DNS_UDP_PAYLOAD_MAX);
+		rrtr.ttl = mio_hton32(MIO_DNS_EDNS_MAKE_TTL(rcode, 0, q->dnssecok));
+		rrtr.dlen = 0;
+		MIO_MEMCPY (&rsp->ptr[rsp->len], &rrtr, MIO_SIZEOF(rrtr));
+		rsp->len += MIO_SIZEOF(rrtr);
+		rsp->count[2]++;
+	}
+
+	pkt->ancount = mio_hton16(rsp->count[0]);
+	pkt->nscount = mio_hton16(rsp->count[1]);
+	pkt->arcount = mio_hton16(rsp->count[2]);
+}
+
+static void send_response (mio_svc_dns_t* dns, mio_dev_sck_t* sck, dns_rsp_t* rsp, const mio_skad_t* dstaddr)
+{
+	if (dstaddr)
+	{
+		if (mio_dev_sck_write(sck, rsp->ptr, rsp->len, MIO_NULL, dstaddr) <= -1)
+		{
+			MIO_DEBUG1 (dns->mio, "DNS - unable to send response over udp - %js\n", mio_geterrmsg(dns->mio));
+		}
+	}
+	else
+	{
+		/* prefix the length over tcp */
+		rsp->ptr[-2] = (mio_uint8_t)(rsp->len >> 8);
+		rsp->ptr[-1] = (mio_uint8_t)(rsp->len & 0xFF);
+		if (mio_dev_sck_write(sck, rsp->ptr - 2, rsp->len + 2, MIO_NULL, MIO_NULL) <= -1) mio_dev_sck_halt (sck);
+	}
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int append_rrset (dns_rsp_t* rsp, int sect, const dns_rrset_t* rrset, mio_oow_t owner)
+{
+	mio_uint8_t* ptr, * end;
+
+	if (rsp->max - rsp->len < rrset->len)
+	{
+		rsp->tc = 1;
+		return -1;
+	}
+
+	ptr = &rsp->ptr[rsp->len];
+	MIO_MEMCPY (ptr, rrset->tmpl, rrset->len);
+	if (owner != MIO_SIZEOF(mio_dns_pkt_t))
+	{
+		/* point to the owner name other than the name in the question */
+		end = ptr + rrset->len;
+		while (ptr < end)
+		{
+			ptr[0] = 0xC0 | (mio_uint8_t)(owner >> 8);
+			ptr[1] = (mio_uint8_t)(owner & 0xFF);
+			ptr += 2 + MIO_SIZEOF(mio_dns_rrtr_t) + (((mio_oow_t)ptr[10] << 8) | ptr[11]);
+		}
+	}
+
+	rsp->len += rrset->len;
+	rsp->count[sect] += rrset->count;
+	return 0;
+}
+
+static int answer_from_zone (mio_svc_dns_t* dns, dns_rsp_t* rsp, const dns_query_t* q)
+{
+	/* return -1 if the zone store has no authority over the name.
+	 * otherwise, return the response code */
+	dns_node_t* node, * apex;
+	dns_rrset_t* rrset;
+	mio_oow_t owner, apexoff, chain;
+
+	owner = MIO_SIZEOF(mio_dns_pkt_t);
+	node = find_node(dns, rsp->ptr, owner, rsp->qend, &apex, &apexoff);
+	if (!node)
+	{
+		if (!apex) return -1;
+
+		/* a name in the zone that doesn't exist */
+		rsp->aa = 1;
+		append_rrset (rsp, 1, apex->soa, apexoff);
+		return MIO_DNS_RCODE_NXDOMAIN;
+	}
+
+	if (q->qtype == MIO_DNS_RRT_Q_AFXR) return MIO_DNS_RCODE_REFUSED; /* zone transfer not supported */
+
+	if (q->qtype == MIO_DNS_RRT_Q_ANY)
+	{
+		if (!node->rrset && !apex) return -1;
+		for (rrset = node->rrset; rrset; rrset = rrset->next)
+		{
+			if (append_rrset(rsp, 0, rrset, owner) <= -1) break;
+		}
+		goto check;
+	}
+
+	for (chain = 0; ; chain++)
+	{
+		rrset = find_rrset(node, q->qtype);
+		if (rrset)
+		{
+			append_rrset (rsp, 0, rrset, owner);
+			break;
+		}
+
+		rrset = (q->qtype != MIO_DNS_RRT_CNAME)? find_rrset(node, MIO_DNS_RRT_CNAME): MIO_NULL;
+		if (!rrset) break;
+
+		/* follow the alias within the zone store. the target name in the
+		 * first record is uncompressed and can be pointed to as the owner
+		 * name of the records of the target. */
+		if (append_rrset(rsp, 0, rrset, owner) <= -1) break;
+		owner = rsp->len - rrset->len + 2 + MIO_SIZEOF(mio_dns_rrtr_t);
+		if (chain >= DNS_MAX_CNAME_CHAIN || owner > 0x3FFF) break;
+
+		node = find_node(dns, rsp->ptr, owner, rsp->len, &apex, &apexoff);
+		if (!node) break;
+	}
+
+check:
+	if (rsp->count[0] <= 0)
+	{
+		if (!apex) return -1;
+
+		/* no data for the type. RFC2308 */
+		rsp->aa = 1;
+		append_rrset (rsp, 1, apex->soa, apexoff);
+		return MIO_DNS_RCODE_NOERROR;
+	}
+
+	rsp->aa = (apex != MIO_NULL);
+	return MIO_DNS_RCODE_NOERROR;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static MIO_INLINE void chain_fwd (mio_svc_dns_t* dns, dns_fwd_t* fwd)
+{
+	fwd->prev = MIO_NULL;
+	fwd->next = dns->fwd_pending;
+	if (fwd->next) fwd->next->prev = fwd;
+	dns->fwd_pending = fwd;
+}
+
+static MIO_INLINE void unchain_fwd (mio_svc_dns_t* dns, dns_fwd_t* fwd)
+{
+	if (fwd->next) fwd->next->prev = fwd->prev;
+	if (fwd->prev) fwd->prev->next = fwd->next;
+	else dns->fwd_pending = fwd->next;
+	fwd->prev = fwd->next = MIO_NULL;
+}
+
+static int relay_answer (mio_svc_dns_t* dns, dns_rsp_t* rsp, const dns_query_t* q, const mio_dns_pkt_info_t* pi)
+{
+	mio_t* mio = dns->mio;
+	mio_dns_bhdr_t bhdr;
+	mio_dns_brr_t* rr;
+	mio_dns_msg_t* msg;
+	mio_dns_pkt_t* pkt;
+	mio_oow_t n, i, bodylen;
+	int rcode;
+
+	rcode = pi->hdr.rcode;
+	if (rcode > 0x0F && !q->edns) return MIO_DNS_RCODE_SERVFAIL;
+
+	n = (mio_oow_t)pi->ancount + pi->nscount + pi->arcount;
+	if (n <= 0) return rcode;
+
+	rr = (mio_dns_brr_t*)mio_allocmem(mio, MIO_SIZEOF(*rr) * n);
+	if (MIO_UNLIKELY(!rr)) return MIO_DNS_RCODE_SERVFAIL;
+
+	n = 0;
+	for (i = 0; i < pi->ancount; i++) rr[n++] = pi->rr.an[i];
+	for (i = 0; i < pi->nscount; i++) rr[n++] = pi->rr.ns[i];
+	for (i = 0; i < pi->arcount; i++)
+	{
+		if (pi->rr.ar[i].rrtype != MIO_DNS_RRT_OPT) rr[n++] = pi->rr.ar[i];
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		/* the decoded data of these types includes the names pointed to */
+		if (rr[i].rrtype == MIO_DNS_RRT_MX) rr[i].dlen = MIO_SIZEOF(mio_dns_brrd_mx_t);
+		else if (rr[i].rrtype == MIO_DNS_RRT_SOA) rr[i].dlen = MIO_SIZEOF(mio_dns_brrd_soa_t);
+	}
+
+	MIO_MEMSET (&bhdr, 0, MIO_SIZEOF(bhdr));
+	msg = mio_dns_make_msg(mio, &bhdr, MIO_NULL, 0, rr, n, MIO_NULL, 0);
+	mio_freemem (mio, rr);
+	if (MIO_UNLIKELY(!msg)) return MIO_DNS_RCODE_SERVFAIL;
+
+	pkt = mio_dns_msg_to_pkt(msg);
+	bodylen = msg->pktlen - MIO_SIZEOF(*pkt);
+	if (rsp->max - rsp->len < bodylen)
+	{
+		rsp->tc = 1;
+	}
+	else
+	{
+		MIO_MEMCPY (&rsp->ptr[rsp->len], pkt + 1, bodylen);
+		rsp->len += bodylen;
+		rsp->count[0] = mio_ntoh16(pkt->ancount);
+		rsp->count[1] = mio_ntoh16(pkt->nscount);
+		rsp->count[2] = mio_ntoh16(pkt->arcount);
+	}
+
+	mio_dns_free_msg (mio, msg);
+	return rcode;
+}
+
+static void on_forward_resolve (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_errnum_t status, const void* data, mio_oow_t dlen)
+{
+	dns_fwd_t* fwd = (dns_fwd_t*)mio_svc_dnc_getresolvextn(reqmsg);
+	mio_svc_dns_t* dns = fwd->dns;
+	dns_rsp_t rsp;
+	int rcode;
+
+	if (!dns) return; /* the service has been stopped */
+	unchain_fwd (dns, fwd);
+	if (!fwd->sck) return; /* the client has gone */
+
+	begin_response (dns, &rsp, &fwd->q, (fwd->udp? get_udp_payload_max(&fwd->q): DNS_TCP_PAYLOAD_MAX));
+	if (status == MIO_ENOERR && data)
+		rcode = relay_answer(dns, &rsp, &fwd->q, (const mio_dns_pkt_info_t*)data);
+	else
+		rcode = MIO_DNS_RCODE_SERVFAIL;
+	finish_response (&rsp, &fwd->q, rcode);
+	send_response (dns, fwd->sck, &rsp, (fwd->udp? &fwd->srcaddr: MIO_NULL));
+}
+
+static int forward_query (mio_svc_dns_t* dns, mio_dev_sck_t* sck, const dns_query_t* q, const mio_skad_t* srcaddr)
+{
+	mio_bch_t qname[DNS_DN_MAX];
+	mio_oow_t off, len, i;
+	mio_uint8_t seglen;
+	mio_dns_msg_t* reqmsg;
+	dns_fwd_t* fwd;
+
+	/* the client service takes the name in text. a label containing
+	 * a dot or a null byte can't be expressed */
+	off = 0;
+	len = 0;
+	while ((seglen = q->qptr[off++]) > 0)
+	{
+		for (i = 0; i < seglen; i++)
+		{
+			mio_uint8_t c = q->qptr[off++];
+			if (c == '.' || c == '\0') return -1;
+			qname[len++] = c;
+		}
+		qname[len++] = '.';
+	}
+	if (len > 0) len--;
+	qname[len] = '\0';
+
+	reqmsg = mio_svc_dnc_resolve(dns->fwd, qname, (mio_dns_rrt_t)q->qtype, (q->dnssecok? MIO_SVC_DNC_RESOLVE_FLAG_DNSSEC: 0), on_forward_resolve, MIO_SIZEOF(*fwd));
+	if (!reqmsg) return -1;
+
+	/* the callback is never invoked before mio_svc_dnc_resolve() returns */
+	fwd = (dns_fwd_t*)mio_svc_dnc_getresolvextn(reqmsg);
+	fwd->dns = dns;
+	fwd->sck = sck;
+	fwd->udp = (srcaddr != MIO_NULL);
+	if (srcaddr) fwd->srcaddr = *srcaddr;
+	fwd->q = *q;
+	MIO_MEMCPY (fwd->qbuf, q->qptr, q->qlen);
+	fwd->q.qptr = fwd->qbuf;
+	chain_fwd (dns, fwd);
+	return 0;
+}
+
+static void forget_fwd_sck (mio_svc_dns_t* dns, mio_dev_sck_t* sck)
+{
+	dns_fwd_t* fwd;
+	for (fwd = dns->fwd_pending; fwd; fwd = fwd->next)
+	{
+		if (fwd->sck == sck) fwd->sck = MIO_NULL;
+	}
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void handle_query (mio_svc_dns_t* dns, mio_dev_sck_t* sck, const mio_uint8_t* req, mio_oow_t len, const mio_skad_t* srcaddr)
+{
+	dns_query_t q;
+	dns_rsp_t rsp;
+	int rcode;
+
+	rcode = parse_query(req, len, &q);
+	if (rcode <= -1) return; /* drop it */
+
+	begin_response (dns, &rsp, &q, (srcaddr? get_udp_payload_max(&q): DNS_TCP_PAYLOAD_MAX));
+	if (rcode == MIO_DNS_RCODE_NOERROR)
+	{
+		if (q.qclass != MIO_DNS_RRC_IN && q.qclass != MIO_DNS_RRC_Q_ANY)
+		{
+			rcode = MIO_DNS_RCODE_REFUSED;
+		}
+		else
+		{
+			rcode = answer_from_zone(dns, &rsp, &q);
+			if (rcode <= -1)
+			{
+				/* not an authority. forward it if possible */
+				if (dns->fwd)
+				{
+					if (forward_query(dns, sck, &q, srcaddr) >= 0) return;
+					rcode = MIO_DNS_RCODE_SERVFAIL;
+				}
+				else rcode = MIO_DNS_RCODE_REFUSED;
+			}
+		}
+	}
+
+	finish_response (&rsp, &q, rcode);
+	send_response (dns, sck, &rsp, srcaddr);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int on_udp_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	mio_svc_dns_t* dns = ((dns_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dns;
+
+	if (MIO_UNLIKELY(dlen <= -1))
+	{
+		MIO_DEBUG1 (dns->mio, "DNS - dns udp read error ....%js\n", mio_geterrmsg(dns->mio));
+		return 0;
+	}
+
+	handle_query (dns, dev, (const mio_uint8_t*)data, dlen, srcaddr);
+	return 0;
+}
+
+static int on_udp_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	return 0;
+}
+
+static void on_udp_connect (mio_dev_sck_t* dev)
+{
+}
+
+static void on_udp_disconnect (mio_dev_sck_t* dev)
+{
+	mio_svc_dns_t* dns = ((dns_sck_xtn_t*)mio_dev_sck_getxtn(dev))->dns;
+	forget_fwd_sck (dns, dev);
+	if (dns->udp_sck == dev) dns->udp_sck = MIO_NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int on_tcp_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	mio_t* mio = dev->mio;
+	dns_sck_xtn_t* sckxtn = (dns_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_oow_t off, pktlen;
+
+	if (MIO_UNLIKELY(dlen <= 0))
+	{
+		if (dlen <= -1) MIO_DEBUG1 (mio, "DNS - dns tcp read error ....%js\n", mio_geterrmsg(mio));
+		goto oops;
+	}
+
+	if (sckxtn->rbuf.capa - sckxtn->rbuf.len < dlen)
+	{
+		mio_uint8_t* tmp;
+		mio_oow_t newcapa;
+
+		newcapa = MIO_ALIGN_POW2(sckxtn->rbuf.len + dlen, 512);
+		tmp = (mio_uint8_t*)mio_reallocmem(mio, sckxtn->rbuf.ptr, newcapa);
+		if (MIO_UNLIKELY(!tmp)) goto oops;
+		sckxtn->rbuf.ptr = tmp;
+		sckxtn->rbuf.capa = newcapa;
+	}
+	MIO_MEMCPY (&sckxtn->rbuf.ptr[sckxtn->rbuf.len], data, dlen);
+	sckxtn->rbuf.len += dlen;
+
+	/* handle all complete messages. each is prefixed with the 2-byte length */
+	off = 0;
+	while (sckxtn->rbuf.len - off >= 2)
+	{
+		pktlen = ((mio_oow_t)sckxtn->rbuf.ptr[off] << 8) | sckxtn->rbuf.ptr[off + 1];
+		if (sckxtn->rbuf.len - off - 2 < pktlen) break;
+		handle_query (sckxtn->dns, dev, &sckxtn->rbuf.ptr[off + 2], pktlen, MIO_NULL);
+		off += 2 + pktlen;
+	}
+
+	if (off > 0)
+	{
+		sckxtn->rbuf.len -= off;
+		MIO_MEMMOVE (sckxtn->rbuf.ptr, &sckxtn->rbuf.ptr[off], sckxtn->rbuf.len);
+	}
+
+	return 0;
+
+oops:
+	mio_dev_sck_halt (dev);
+	return 0;
+}
+
+static int on_tcp_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	if (wrlen <= -1) mio_dev_sck_halt (dev);
+	return 0;
+}
+
+static void on_tcp_connect (mio_dev_sck_t* dev)
+{
+	dns_sck_xtn_t* sckxtn = (dns_sck_xtn_t*)mio_dev_sck_getxtn(dev); /* copied from the listening socket */
+	mio_svc_dns_t* dns = sckxtn->dns;
+
+	if (dev->state & MIO_DEV_SCK_ACCEPTED)
+	{
+		MIO_DEBUG2 (dns->mio, "DNS(%p) - accepted tcp client %p\n", dns, dev);
+
+		sckxtn->rbuf.ptr = MIO_NULL;
+		sckxtn->rbuf.len = 0;
+		sckxtn->rbuf.capa = 0;
+
+		sckxtn->prev = MIO_NULL;
+		sckxtn->next = dns->tcp_cli;
+		if (sckxtn->next) ((dns_sck_xtn_t*)mio_dev_sck_getxtn(sckxtn->next))->prev = dev;
+		dns->tcp_cli = dev;
+	}
+}
+
+static void on_tcp_disconnect (mio_dev_sck_t* dev)
+{
+	dns_sck_xtn_t* sckxtn = (dns_sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_svc_dns_t* dns = sckxtn->dns;
+
+	if (dev == dns->tcp_lsck)
+	{
+		dns->tcp_lsck = MIO_NULL;
+		return;
+	}
+
+	if (MIO_DEV_SCK_GET_PROGRESS(dev) != MIO_DEV_SCK_ACCEPTED) return; /* not linked */
+
+	MIO_DEBUG2 (dns->mio, "DNS(%p) - tcp client %p disconnected\n", dns, dev);
+	forget_fwd_sck (dns, dev);
+
+	if (sckxtn->next) ((dns_sck_xtn_t*)mio_dev_sck_getxtn(sckxtn->next))->prev = sckxtn->prev;
+	if (sckxtn->prev) ((dns_sck_xtn_t*)mio_dev_sck_getxtn(sckxtn->prev))->next = sckxtn->next;
+	else dns->tcp_cli = sckxtn->next;
+
+	if (sckxtn->rbuf.ptr)
+	{
+		mio_freemem (dns->mio, sckxtn->rbuf.ptr);
+		sckxtn->rbuf.ptr = MIO_NULL;
+	}
+}
+
+/* ----------------------------------------------------------------------- */
+
+mio_svc_dns_t* mio_svc_dns_start (mio_t* mio, const mio_skad_t* bind_addr)
+{
+	mio_svc_dns_t* dns = MIO_NULL;
+	union
+	{
+		mio_dev_sck_make_t m;
+		mio_dev_sck_listen_t l;
+	} info;
+	mio_dev_sck_bind_t bi;
+
+	dns = (mio_svc_dns_t*)mio_callocmem(mio, MIO_SIZEOF(*dns));
+	if (MIO_UNLIKELY(!dns)) goto oops;
+
+	dns->mio = mio;
+	dns->svc_stop = (mio_svc_stop_t)mio_svc_dns_stop;
+
+	MIO_MEMSET (&bi, 0, MIO_SIZEOF(bi));
+	bi.localaddr = *bind_addr;
+
+	MIO_MEMSET (&info, 0, MIO_SIZEOF(info));
+	switch (mio_skad_family(bind_addr))
+	{
+		case MIO_AF_INET:
+			info.m.type = MIO_DEV_SCK_UDP4;
+			break;
+
+		case MIO_AF_INET6:
+			info.m.type = MIO_DEV_SCK_UDP6;
+			break;
+
+		default:
+			mio_seterrnum (mio, MIO_EINVAL);
+			goto oops;
+	}
+	info.m.on_write = on_udp_write;
+	info.m.on_read = on_udp_read;
+	info.m.on_connect = on_udp_connect;
+	info.m.on_disconnect = on_udp_disconnect;
+	dns->udp_sck = mio_dev_sck_make(mio, MIO_SIZEOF(dns_sck_xtn_t), &info.m);
+	if (!dns->udp_sck) goto oops;
+	((dns_sck_xtn_t*)mio_dev_sck_getxtn(dns->udp_sck))->dns = dns;
+	if (mio_dev_sck_bind(dns->udp_sck, &bi) <= -1) goto oops;
+
+	MIO_MEMSET (&info, 0, MIO_SIZEOF(info));
+	info.m.type = (mio_skad_family(bind_addr) == MIO_AF_INET)? MIO_DEV_SCK_TCP4: MIO_DEV_SCK_TCP6;
+	info.m.on_write = on_tcp_write;
+	info.m.on_read = on_tcp_read;
+	info.m.on_connect = on_tcp_connect;
+	info.m.on_disconnect = on_tcp_disconnect;
+	dns->tcp_lsck = mio_dev_sck_make(mio, MIO_SIZEOF(dns_sck_xtn_t), &info.m);
+	if (!dns->tcp_lsck) goto oops;
+	/* the extension area is copied to the sockets accepted */
+	((dns_sck_xtn_t*)mio_dev_sck_getxtn(dns->tcp_lsck))->dns = dns;
+
+	bi.options = MIO_DEV_SCK_BIND_REUSEADDR;
+	if (mio_dev_sck_bind(dns->tcp_lsck, &bi) <= -1) goto oops;
+
+	MIO_MEMSET (&info, 0, MIO_SIZEOF(info));
+	info.l.backlogs = 128;
+	if (mio_dev_sck_listen(dns->tcp_lsck, &info.l) <= -1) goto oops;
+
+	MIO_SVCL_APPEND_SVC (&mio->actsvc, (mio_svc_t*)dns);
+	MIO_DEBUG1 (mio, "DNS - STARTED SERVICE %p\n", dns);
+	return dns;
+
+oops:
+	if (dns)
+	{
+		if (dns->tcp_lsck) mio_dev_sck_kill (dns->tcp_lsck);
+		if (dns->udp_sck) mio_dev_sck_kill (dns->udp_sck);
+		mio_freemem (mio, dns);
+	}
+	return MIO_NULL;
+}
+
+void mio_svc_dns_stop (mio_svc_dns_t* dns)
+{
+	mio_t* mio = dns->mio;
+
+	MIO_DEBUG1 (mio, "DNS - STOPPING SERVICE %p\n", dns);
+
+	/* the questions forwarded may get answered after this service is gone */
+	while (dns->fwd_pending)
+	{
+		dns_fwd_t* fwd = dns->fwd_pending;
+		unchain_fwd (dns, fwd);
+		fwd->dns = MIO_NULL;
+	}
+
+	if (dns->udp_sck) mio_dev_sck_kill (dns->udp_sck);
+	if (dns->tcp_lsck) mio_dev_sck_kill (dns->tcp_lsck);
+	while (dns->tcp_cli) mio_dev_sck_kill (dns->tcp_cli);
+
+	free_node_contents (mio, &dns->root);
+
+	MIO_SVCL_UNLINK_SVC (dns);
+	mio_freemem (mio, dns);
+}
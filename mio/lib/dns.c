@@ -128,6 +128,74 @@ static mio_oow_t dn_length (mio_uint8_t* ptr, mio_oow_t len)
 
 /* ----------------------------------------------------------------------- */
 
+static int decode_edns_opt (mio_uint16_t rrclass, mio_uint32_t ttl, const mio_uint8_t* dptr, mio_uint16_t dlen, mio_dns_pkt_edns_t* edns)
+{
+	mio_uint16_t eopt_tot_len, eopt_len;
+	const mio_dns_eopt_t* eopt;
+
+	/* RFC 6891
+	The extended RCODE and flags, which OPT stores in the RR Time to Live
+	(TTL) field, are structured as follows:
+
+	   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+	0: |         EXTENDED-RCODE        |            VERSION            |
+	   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+	2: | DO|                           Z                               |
+	   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+
+	EXTENDED-RCODE
+	 Forms the upper 8 bits of extended 12-bit RCODE (together with the
+	 4 bits defined in [RFC1035].  Note that EXTENDED-RCODE value 0
+	 indicates that an unextended RCODE is in use (values 0 through
+	 15).
+	*/
+	edns->exist++; /* you may treat this as the number of OPT RRs */
+	edns->uplen = rrclass;
+	edns->xrcode = (ttl >> 24) & 0xFF;
+	edns->version = (ttl >> 16) & 0xFF;
+	edns->dnssecok = ((ttl & 0x8000) >> 15);
+	/*if ((ttl & 0x7FFF) != 0) return -1;*/ /* Z not 0 - ignore this for now */
+
+	eopt = (const mio_dns_eopt_t*)dptr;
+	eopt_tot_len = dlen;
+	while (eopt_tot_len > 0)
+	{
+		if (eopt_tot_len < MIO_SIZEOF(mio_dns_eopt_t)) return -1;
+
+		eopt_len = mio_ntoh16(eopt->dlen);
+		if (eopt_tot_len - MIO_SIZEOF(mio_dns_eopt_t) < eopt_len) return -1; /* wrong eopt length */
+
+		if (eopt->code == MIO_CONST_HTON16(MIO_DNS_EOPT_COOKIE))
+		{
+			if (eopt_len == MIO_DNS_COOKIE_CLIENT_LEN)
+			{
+				/* client cookie only */
+				MIO_MEMCPY (edns->cookie.data.client, eopt + 1, eopt_len);
+				edns->cookie.client_len = eopt_len;
+				edns->cookie.server_len = 0;
+			}
+			else if (eopt_len >= (MIO_DNS_COOKIE_CLIENT_LEN + MIO_DNS_COOKIE_SERVER_MIN_LEN) &&
+			         eopt_len <= (MIO_DNS_COOKIE_CLIENT_LEN + MIO_DNS_COOKIE_SERVER_MAX_LEN))
+			{
+				/* both client and server cookie */
+				MIO_MEMCPY (&edns->cookie.data, eopt + 1, eopt_len);
+				edns->cookie.client_len = MIO_DNS_COOKIE_CLIENT_LEN;
+				edns->cookie.server_len = eopt_len - MIO_DNS_COOKIE_CLIENT_LEN;
+			}
+			else
+			{
+				/* wrong cookie length */
+				return -1;
+			}
+		}
+
+		eopt_tot_len -= MIO_SIZEOF(mio_dns_eopt_t) + eopt_len;
+		eopt = (const mio_dns_eopt_t*)((const mio_uint8_t*)eopt + MIO_SIZEOF(mio_dns_eopt_t) + eopt_len);
+	}
+
+	return 0;
+}
+
 static int parse_domain_name (mio_t* mio, mio_dns_pkt_info_t* pi)
 {
 	mio_oow_t seglen;
@@ -138,7 +206,7 @@ static int parse_domain_name (mio_t* mio, mio_dns_pkt_info_t* pi)
 
 	if ((seglen = *pi->_ptr++) == 0)
 	{
-		if (pi->_rrdptr) pi->_rrdptr[0] = '\0';
+		if (pi->_rrdptr) *pi->_rrdptr++ = '\0';
 		pi->_rrdlen++; /* for a terminating null */
 		return 0;
 	}
@@ -256,72 +324,11 @@ static int parse_answer_rr (mio_t* mio, mio_dns_rr_part_t rr_part, mio_oow_t pos
 	{
 		case MIO_DNS_RRT_OPT:
 		{
-			mio_uint16_t eopt_tot_len, eopt_len;
-			mio_dns_eopt_t* eopt;
-
-			/* RFC 6891
-			The extended RCODE and flags, which OPT stores in the RR Time to Live
-			(TTL) field, are structured as follows:
-
-			   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
-			0: |         EXTENDED-RCODE        |            VERSION            |
-			   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
-			2: | DO|                           Z                               |
-			   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
-
-			EXTENDED-RCODE
-			 Forms the upper 8 bits of extended 12-bit RCODE (together with the
-			 4 bits defined in [RFC1035].  Note that EXTENDED-RCODE value 0
-			 indicates that an unextended RCODE is in use (values 0 through
-			 15).
-			*/
-
 			/* TODO: do i need to check if rrname is <ROOT>? */
 			/* TODO: do i need to check if rr_part  is MIO_DNS_RR_PART_ADDITIONAL? the OPT pseudo-RR may exist in the ADDITIONAL section only */
 			/* TODO: do i need to check if there is more than 1 OPT RRs */
-			pi->edns.exist++; /* you may treat this as the number of OPT RRs */
-			pi->edns.uplen = mio_ntoh16(rrtr->rrclass);
-			pi->hdr.rcode |= (rrtr->ttl >> 24);
-			pi->edns.version = (rrtr->ttl >> 16) & 0xFF;
-			pi->edns.dnssecok = ((rrtr->ttl & 0x8000) >> 15);
-			/*if ((rrtr->ttl & 0x7FFF) != 0) goto oops;*/ /* Z not 0 - ignore this for now */
-
-			eopt = (mio_dns_eopt_t*)(rrtr + 1);
-			eopt_tot_len = dlen;
-			while (eopt_tot_len > 0)
-			{
-				if (eopt_tot_len < MIO_SIZEOF(mio_dns_eopt_t)) goto oops;
-
-				eopt_len = mio_ntoh16(eopt->dlen);
-				if (eopt_tot_len - MIO_SIZEOF(mio_dns_eopt_t) < eopt_len) goto oops; /* wrong eopt length */
-
-				if (eopt->code == MIO_CONST_HTON16(MIO_DNS_EOPT_COOKIE))
-				{
-					if (eopt_len == MIO_DNS_COOKIE_CLIENT_LEN)
-					{
-						/* client cookie only */
-						MIO_MEMCPY (pi->edns.cookie.data.client, eopt + 1, eopt_len);
-						pi->edns.cookie.client_len = eopt_len;
-						pi->edns.cookie.server_len = 0;
-					}
-					else if (eopt_len >= (MIO_DNS_COOKIE_CLIENT_LEN + MIO_DNS_COOKIE_SERVER_MIN_LEN) &&
-					         eopt_len <= (MIO_DNS_COOKIE_CLIENT_LEN + MIO_DNS_COOKIE_SERVER_MAX_LEN))
-					{
-						/* both client and server cookie */
-						MIO_MEMCPY (&pi->edns.cookie.data, eopt + 1, eopt_len);
-						pi->edns.cookie.client_len = MIO_DNS_COOKIE_CLIENT_LEN;
-						pi->edns.cookie.server_len = eopt_len - MIO_DNS_COOKIE_CLIENT_LEN;
-					}
-					else
-					{
-						/* wrong cookie length */
-						goto oops;
-					}
-				}
-
-				eopt_tot_len -= MIO_SIZEOF(mio_dns_eopt_t) + eopt_len;
-				eopt = (mio_dns_eopt_t*)((mio_uint8_t*)eopt + MIO_SIZEOF(mio_dns_eopt_t) + eopt_len);
-			}
+			if (decode_edns_opt(mio_ntoh16(rrtr->rrclass), mio_ntoh32(rrtr->ttl), (const mio_uint8_t*)(rrtr + 1), dlen, &pi->edns) <= -1) goto oops;
+			pi->hdr.rcode |= pi->edns.xrcode << 4;
 
 			goto verbatim; /* keep the entire option data including cookies */
 		}
@@ -550,6 +557,320 @@ void mio_dns_free_pkt_info (mio_t* mio, mio_dns_pkt_info_t* pi)
 	mio_freemem (mio, pi);
 }
 
+/* ----------------------------------------------------------------------- */
+
+int mio_dns_init_pkt_cur (mio_dns_pkt_cur_t* cur, const mio_dns_pkt_t* pkt, mio_oow_t len)
+{
+	if (MIO_UNLIKELY(len < MIO_SIZEOF(*pkt))) return -1;
+
+	cur->_start = (const mio_uint8_t*)pkt;
+	cur->_end = (const mio_uint8_t*)pkt + len;
+	cur->_ptr = (const mio_uint8_t*)(pkt + 1);
+
+	cur->hdr.id = mio_ntoh16(pkt->id);
+	cur->hdr.qr = pkt->qr & 0x01;
+	cur->hdr.opcode = pkt->opcode & 0x0F;
+	cur->hdr.aa = pkt->aa & 0x01;
+	cur->hdr.tc = pkt->tc & 0x01; 
+	cur->hdr.rd = pkt->rd & 0x01; 
+	cur->hdr.ra = pkt->ra & 0x01;
+	cur->hdr.ad = pkt->ad & 0x01;
+	cur->hdr.cd = pkt->cd & 0x01;
+	cur->hdr.rcode = pkt->rcode & 0x0F;
+	cur->qdcount = mio_ntoh16(pkt->qdcount);
+	cur->ancount = mio_ntoh16(pkt->ancount);
+	cur->nscount = mio_ntoh16(pkt->nscount);
+	cur->arcount = mio_ntoh16(pkt->arcount);
+
+	cur->_sect = 0;
+	cur->_left = cur->qdcount;
+	return 0;
+}
+
+static MIO_INLINE const mio_uint8_t* skip_name_in_pkt_cur (const mio_dns_pkt_cur_t* cur, const mio_uint8_t* ptr)
+{
+	/* skip the name without following a pointer. the name is validated
+	 * when it gets decoded */
+	mio_uint8_t seglen;
+
+	while (1)
+	{
+		if (MIO_UNLIKELY(ptr >= cur->_end)) return MIO_NULL;
+		seglen = *ptr++;
+		if (seglen == 0) return ptr;
+		if (seglen >= 192) return (ptr < cur->_end)? (ptr + 1): MIO_NULL;
+		if (MIO_UNLIKELY(seglen >= 64)) return MIO_NULL;
+		ptr += seglen;
+	}
+}
+
+int mio_dns_next_qr_in_pkt_cur (mio_dns_pkt_cur_t* cur, mio_dns_cqr_t* qr)
+{
+	const mio_uint8_t* ptr;
+	mio_dns_qrtr_t qrtr;
+
+	if (cur->_sect > 0 || cur->_left <= 0) return 0;
+
+	ptr = skip_name_in_pkt_cur(cur, cur->_ptr);
+	if (MIO_UNLIKELY(!ptr || cur->_end - ptr < MIO_SIZEOF(qrtr))) return -1;
+
+	MIO_MEMCPY (&qrtr, ptr, MIO_SIZEOF(qrtr)); /* the trailer may not be aligned */
+	qr->qnameoff = cur->_ptr - cur->_start;
+	qr->qtype = mio_ntoh16(qrtr.qtype);
+	qr->qclass = mio_ntoh16(qrtr.qclass);
+
+	cur->_ptr = ptr + MIO_SIZEOF(qrtr);
+	cur->_left--;
+	return 1;
+}
+
+int mio_dns_next_rr_in_pkt_cur (mio_dns_pkt_cur_t* cur, mio_dns_crr_t* rr)
+{
+	const mio_uint8_t* ptr;
+	mio_dns_rrtr_t rrtr;
+	mio_uint16_t dlen;
+
+	while (cur->_left <= 0 || cur->_sect == 0)
+	{
+		if (cur->_sect == 0 && cur->_left > 0)
+		{
+			/* skip the questions not visited */
+			mio_dns_cqr_t qr;
+			if (mio_dns_next_qr_in_pkt_cur(cur, &qr) <= -1) return -1;
+			continue;
+		}
+
+		switch (cur->_sect)
+		{
+			case 0: cur->_left = cur->ancount; break;
+			case 1: cur->_left = cur->nscount; break;
+			case 2: cur->_left = cur->arcount; break;
+			default: return 0;
+		}
+		cur->_sect++;
+	}
+
+	ptr = skip_name_in_pkt_cur(cur, cur->_ptr);
+	if (MIO_UNLIKELY(!ptr || cur->_end - ptr < MIO_SIZEOF(rrtr))) return -1;
+
+	MIO_MEMCPY (&rrtr, ptr, MIO_SIZEOF(rrtr));
+	ptr += MIO_SIZEOF(rrtr);
+	dlen = mio_ntoh16(rrtr.dlen);
+	if (MIO_UNLIKELY(cur->_end - ptr < dlen)) return -1;
+
+	rr->part = (mio_dns_rr_part_t)(MIO_DNS_RR_PART_ANSWER + cur->_sect - 1);
+	rr->rrnameoff = cur->_ptr - cur->_start;
+	rr->rrtype = mio_ntoh16(rrtr.rrtype);
+	rr->rrclass = mio_ntoh16(rrtr.rrclass);
+	rr->ttl = mio_ntoh32(rrtr.ttl);
+	rr->dlen = dlen;
+	rr->dptr = ptr;
+
+	cur->_ptr = ptr + dlen;
+	cur->_left--;
+	return 1;
+}
+
+mio_ooi_t mio_dns_decode_name_in_pkt_cur (const mio_dns_pkt_cur_t* cur, mio_oow_t off, mio_bch_t* buf, mio_oow_t bufsz, mio_oow_t* endoff)
+{
+	mio_oow_t len, wlen, tlen, xoff, lastptr;
+	mio_uint8_t seglen;
+
+	len = cur->_end - cur->_start;
+	wlen = 0; /* length in the wire format */
+	tlen = 0; /* length decoded */
+	xoff = 0; /* offset after the first pointer */
+	lastptr = len;
+
+	while (1)
+	{
+		if (MIO_UNLIKELY(off >= len)) return -1;
+
+		seglen = cur->_start[off];
+		if (seglen == 0)
+		{
+			off++;
+			break;
+		}
+		else if (seglen < 64)
+		{
+			if (MIO_UNLIKELY(seglen >= len - off)) return -1;
+			wlen += seglen + 1;
+			if (MIO_UNLIKELY(wlen >= 255)) return -1; /* 255 including the terminating zero */
+
+			if (buf)
+			{
+				if (tlen > 0) 
+				{
+					if (tlen >= bufsz) return -1;
+					buf[tlen++] = '.';
+				}
+				if (seglen >= bufsz - tlen) return -1; /* leave room for a terminating null */
+				MIO_MEMCPY (&buf[tlen], &cur->_start[off + 1], seglen);
+				tlen += seglen;
+			}
+			else tlen += (tlen > 0) + seglen;
+
+			off += seglen + 1;
+		}
+		else if (seglen >= 192)
+		{
+			/* compressed. a pointer must point to a position before where the
+			 * previous pointer pointed to. it may chain but never loops. */
+			mio_oow_t ptr;
+
+			if (MIO_UNLIKELY(off + 1 >= len)) return -1;
+			ptr = ((mio_oow_t)(seglen & 0x3F) << 8) | cur->_start[off + 1];
+			if (MIO_UNLIKELY(ptr >= lastptr || ptr >= off)) return -1;
+
+			if (lastptr >= len) xoff = off + 2;
+			lastptr = ptr;
+			off = ptr;
+		}
+		else
+		{
+			/* 64 to 191. 01XXXXXXXX or 10XXXXXXXX */
+			return -1;
+		}
+	}
+
+	if (buf)
+	{
+		if (tlen >= bufsz) return -1;
+		buf[tlen] = '\0';
+	}
+	if (endoff) *endoff = (lastptr >= len)? off: xoff;
+	return tlen;
+}
+
+int mio_dns_decode_rr_in_pkt_cur (const mio_dns_pkt_cur_t* cur, const mio_dns_crr_t* rr, mio_dns_brr_t* brr, void* buf, mio_oow_t bufsz)
+{
+	mio_uint8_t* bp = (mio_uint8_t*)buf;
+	mio_uint8_t* be = bp + bufsz;
+	mio_oow_t doff, dend, xoff;
+	mio_ooi_t n;
+
+	doff = rr->dptr - cur->_start;
+	dend = doff + rr->dlen;
+
+	brr->part = rr->part;
+	brr->rrtype = rr->rrtype;
+	brr->rrclass = rr->rrclass;
+	brr->ttl = rr->ttl;
+
+	/* the structure for the data goes first for alignment */
+	switch (rr->rrtype)
+	{
+		case MIO_DNS_RRT_A:
+			if (MIO_UNLIKELY(rr->dlen != MIO_SIZEOF(mio_ip4ad_t))) return -1;
+			goto verbatim;
+
+		case MIO_DNS_RRT_AAAA:
+			if (MIO_UNLIKELY(rr->dlen != MIO_SIZEOF(mio_ip6ad_t))) return -1;
+			goto verbatim;
+
+		case MIO_DNS_RRT_CNAME:
+		case MIO_DNS_RRT_NS:
+		case MIO_DNS_RRT_PTR:
+			n = mio_dns_decode_name_in_pkt_cur(cur, doff, (mio_bch_t*)bp, be - bp, &xoff);
+			if (MIO_UNLIKELY(n <= -1 || xoff != dend)) return -1;
+			brr->dptr = bp;
+			brr->dlen = n + 1;
+			bp += n + 1;
+			break;
+
+		case MIO_DNS_RRT_MX:
+		{
+			mio_dns_brrd_mx_t* mx;
+
+			if (MIO_UNLIKELY(rr->dlen < 3 || be - bp < MIO_SIZEOF(*mx))) return -1;
+			mx = (mio_dns_brrd_mx_t*)bp;
+			bp += MIO_SIZEOF(*mx);
+
+			mx->preference = ((mio_uint16_t)rr->dptr[0] << 8) | rr->dptr[1];
+			mx->exchange = (mio_bch_t*)bp;
+			n = mio_dns_decode_name_in_pkt_cur(cur, doff + 2, (mio_bch_t*)bp, be - bp, &xoff);
+			if (MIO_UNLIKELY(n <= -1 || xoff != dend)) return -1;
+			bp += n + 1;
+
+			brr->dptr = mx;
+			brr->dlen = bp - (mio_uint8_t*)mx;
+			break;
+		}
+
+		case MIO_DNS_RRT_SOA:
+		{
+			mio_dns_brrd_soa_t* soa;
+			mio_uint32_t v[5];
+
+			if (MIO_UNLIKELY(be - bp < MIO_SIZEOF(*soa))) return -1;
+			soa = (mio_dns_brrd_soa_t*)bp;
+			bp += MIO_SIZEOF(*soa);
+
+			soa->mname = (mio_bch_t*)bp;
+			n = mio_dns_decode_name_in_pkt_cur(cur, doff, (mio_bch_t*)bp, be - bp, &xoff);
+			if (MIO_UNLIKELY(n <= -1 || xoff >= dend)) return -1;
+			bp += n + 1;
+
+			soa->rname = (mio_bch_t*)bp;
+			n = mio_dns_decode_name_in_pkt_cur(cur, xoff, (mio_bch_t*)bp, be - bp, &xoff);
+			if (MIO_UNLIKELY(n <= -1 || dend - xoff != 20)) return -1;
+			bp += n + 1;
+
+			MIO_MEMCPY (v, &cur->_start[xoff], 20);
+			soa->serial = mio_ntoh32(v[0]);
+			soa->refresh = mio_ntoh32(v[1]);
+			soa->retry = mio_ntoh32(v[2]);
+			soa->expire = mio_ntoh32(v[3]);
+			soa->minimum = mio_ntoh32(v[4]);
+
+			brr->dptr = soa;
+			brr->dlen = bp - (mio_uint8_t*)soa;
+			break;
+		}
+
+		default:
+		verbatim:
+			/* point to the data in the packet */
+			brr->dptr = (void*)rr->dptr;
+			brr->dlen = rr->dlen;
+			break;
+	}
+
+	n = mio_dns_decode_name_in_pkt_cur(cur, rr->rrnameoff, (mio_bch_t*)bp, be - bp, MIO_NULL);
+	if (MIO_UNLIKELY(n <= -1)) return -1;
+	brr->rrname = (mio_bch_t*)bp;
+
+	return 0;
+}
+
+int mio_dns_get_edns_in_pkt_cur (const mio_dns_pkt_cur_t* cur, mio_dns_pkt_edns_t* edns)
+{
+	mio_dns_pkt_cur_t xcur;
+	mio_dns_crr_t rr;
+	int n;
+
+	MIO_MEMSET (edns, 0, MIO_SIZEOF(*edns));
+	if (cur->arcount <= 0) return 0;
+
+	/* walk from the beginning with a copy */
+	xcur = *cur;
+	xcur._ptr = xcur._start + MIO_SIZEOF(mio_dns_pkt_t);
+	xcur._sect = 0;
+	xcur._left = xcur.qdcount;
+	while ((n = mio_dns_next_rr_in_pkt_cur(&xcur, &rr)) > 0)
+	{
+		if (rr.part == MIO_DNS_RR_PART_ADDITIONAL && rr.rrtype == MIO_DNS_RRT_OPT)
+		{
+			if (decode_edns_opt(rr.rrclass, rr.ttl, rr.dptr, rr.dlen, edns) <= -1) return -1;
+			/* stop at the first one */
+			break;
+		}
+	}
+
+	return (n <= -1)? -1: 0;
+}
+
 
 /* ----------------------------------------------------------------------- */
 
@@ -247,6 +247,70 @@ static style_t style[] =
 		MIO_HTB_KEEPER_DEFAULT,
 		MIO_HTB_SIZER_DEFAULT,
 		MIO_HTB_HASHER_DEFAULT
+	},
+
+	/* == MIO_HTB_STYLE_KEYED == */
+	{
+		{
+			MIO_HTB_COPIER_DEFAULT,
+			MIO_HTB_COPIER_DEFAULT
+		},
+		{
+			MIO_HTB_FREEER_DEFAULT,
+			MIO_HTB_FREEER_DEFAULT
+		},
+		MIO_HTB_COMPER_DEFAULT,
+		MIO_HTB_KEEPER_DEFAULT,
+		MIO_HTB_SIZER_DEFAULT,
+		MIO_HTB_HASHER_KEYED
+	},
+
+	/* == MIO_HTB_STYLE_INLINE_COPIERS_KEYED == */
+	{
+		{
+			MIO_HTB_COPIER_INLINE,
+			MIO_HTB_COPIER_INLINE
+		},
+		{
+			MIO_HTB_FREEER_DEFAULT,
+			MIO_HTB_FREEER_DEFAULT
+		},
+		MIO_HTB_COMPER_DEFAULT,
+		MIO_HTB_KEEPER_DEFAULT,
+		MIO_HTB_SIZER_DEFAULT,
+		MIO_HTB_HASHER_KEYED
+	},
+
+	/* == MIO_HTB_STYLE_INLINE_KEY_COPIER_KEYED == */
+	{
+		{
+			MIO_HTB_COPIER_INLINE,
+			MIO_HTB_COPIER_DEFAULT
+		},
+		{
+			MIO_HTB_FREEER_DEFAULT,
+			MIO_HTB_FREEER_DEFAULT
+		},
+		MIO_HTB_COMPER_DEFAULT,
+		MIO_HTB_KEEPER_DEFAULT,
+		MIO_HTB_SIZER_DEFAULT,
+		MIO_HTB_HASHER_KEYED
+	},
+
+	/* == MIO_HTB_STYLE_INLINE_VALUE_COPIER_KEYED == */
+	{
+		{
+			MIO_HTB_COPIER_DEFAULT,
+			MIO_HTB_COPIER_INLINE
+		},
+		{
+			MIO_HTB_FREEER_DEFAULT,
+			MIO_HTB_FREEER_DEFAULT
+		},
+		MIO_HTB_COMPER_DEFAULT,
+		MIO_HTB_KEEPER_DEFAULT,
+		MIO_HTB_SIZER_DEFAULT,
+		MIO_HTB_HASHER_KEYED
 	}
 };
 
@@ -367,40 +431,20 @@ pair_t* mio_htb_search (const mio_htb_t* htb, const void* kptr, mio_oow_t klen)
 	return MIO_NULL;
 }
 
-static MIO_INLINE int reorganize (mio_htb_t* htb)
+static int rehash (mio_htb_t* htb, mio_oow_t new_capa, int keyed)
 {
-	mio_oow_t i, hc, new_capa;
+	mio_oow_t i, hc;
 	pair_t** new_buck;
 
-	if (htb->style->sizer)
-	{
-		new_capa = htb->style->sizer (htb, htb->capa + 1);
-
-		/* if no change in capacity, return success 
-		 * without reorganization */
-		if (new_capa == htb->capa) return 0; 
-
-		/* adjust to 1 if the new capacity is not reasonable */
-		if (new_capa <= 0) new_capa = 1;
-	}
-	else
-	{
-		/* the bucket is doubled until it grows up to 65536 slots.
-		 * once it has reached it, it grows by 65536 slots */
-		new_capa = (htb->capa >= 65536)? (htb->capa + 65536): (htb->capa << 1);
-	}
-
 	new_buck = (pair_t**)mio_allocmem(htb->mio, new_capa * MIO_SIZEOF(pair_t*));
-	if (MIO_UNLIKELY(!new_buck)) 
-	{
-		/* reorganization is disabled once it fails */
-		htb->threshold = 0;
-		return -1;
-	}
+	if (MIO_UNLIKELY(!new_buck)) return -1;
 
 	/*for (i = 0; i < new_capa; i++) new_buck[i] = MIO_NULL;*/
 	MIO_MEMSET (new_buck, 0, new_capa * MIO_SIZEOF(pair_t*));
 
+	/* the hasher depends on this field if it is the default hasher */
+	htb->keyed = keyed;
+
 	for (i = 0; i < htb->capa; i++)
 	{
 		pair_t* pair = htb->bucket[i];
@@ -426,6 +470,49 @@ static MIO_INLINE int reorganize (mio_htb_t* htb)
 	return 0;
 }
 
+static MIO_INLINE int reorganize (mio_htb_t* htb)
+{
+	mio_oow_t new_capa;
+
+	if (htb->style->sizer)
+	{
+		new_capa = htb->style->sizer (htb, htb->capa + 1);
+
+		/* if no change in capacity, return success 
+		 * without reorganization */
+		if (new_capa == htb->capa) return 0; 
+
+		/* adjust to 1 if the new capacity is not reasonable */
+		if (new_capa <= 0) new_capa = 1;
+	}
+	else
+	{
+		/* the bucket is doubled until it grows up to 65536 slots.
+		 * once it has reached it, it grows by 65536 slots */
+		new_capa = (htb->capa >= 65536)? (htb->capa + 65536): (htb->capa << 1);
+	}
+
+	if (rehash(htb, new_capa, htb->keyed) <= -1)
+	{
+		/* reorganization is disabled once it fails */
+		htb->threshold = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* an insertion that walks a chain this long switches the default hasher
+ * to the keyed hash. such a chain is hardly formed by chance under a
+ * reasonable load factor but is easily formed by keys crafted against
+ * the unkeyed hash. */
+#define CHAIN_LEN_MAX 16
+
+static MIO_INLINE int need_keyed_hash (mio_htb_t* htb, mio_oow_t chain_len)
+{
+	return chain_len >= CHAIN_LEN_MAX && !htb->keyed && htb->style->hasher == mio_htb_dflhash;
+}
+
 /* insert options */
 #define UPSERT 1
 #define UPDATE 2
@@ -435,7 +522,7 @@ static MIO_INLINE int reorganize (mio_htb_t* htb)
 static MIO_INLINE pair_t* insert (mio_htb_t* htb, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen, int opt)
 {
 	pair_t* pair, * p, * prev, * next;
-	mio_oow_t hc;
+	mio_oow_t hc, chain_len = 0;
 
 	hc = htb->style->hasher(htb,kptr,klen) % htb->capa;
 	pair = htb->bucket[hc];
@@ -482,6 +569,7 @@ static MIO_INLINE pair_t* insert (mio_htb_t* htb, void* kptr, mio_oow_t klen, vo
 
 		prev = pair;
 		pair = next;
+		chain_len++;
 	}
 
 	if (opt == UPDATE) 
@@ -490,6 +578,15 @@ static MIO_INLINE pair_t* insert (mio_htb_t* htb, void* kptr, mio_oow_t klen, vo
 		return MIO_NULL;
 	}
 
+	if (need_keyed_hash(htb, chain_len))
+	{
+		/* ignore the failure. the chain just stays long */
+		if (rehash(htb, htb->capa, 1) == 0)
+		{
+			hc = htb->style->hasher(htb,kptr,klen) % htb->capa;
+		}
+	}
+
 	if (htb->threshold > 0 && htb->size >= htb->threshold)
 	{
 		/* ingore reorganization error as it simply means
@@ -536,7 +633,7 @@ pair_t* mio_htb_update (mio_htb_t* htb, void* kptr, mio_oow_t klen, void* vptr,
 pair_t* mio_htb_cbsert (mio_htb_t* htb, void* kptr, mio_oow_t klen, cbserter_t cbserter, void* ctx)
 {
 	pair_t* pair, * p, * prev, * next;
-	mio_oow_t hc;
+	mio_oow_t hc, chain_len = 0;
 
 	hc = htb->style->hasher(htb,kptr,klen) % htb->capa;
 	pair = htb->bucket[hc];
@@ -569,6 +666,15 @@ pair_t* mio_htb_cbsert (mio_htb_t* htb, void* kptr, mio_oow_t klen, cbserter_t c
 
 		prev = pair;
 		pair = next;
+		chain_len++;
+	}
+
+	if (need_keyed_hash(htb, chain_len))
+	{
+		if (rehash(htb, htb->capa, 1) == 0)
+		{
+			hc = htb->style->hasher(htb,kptr,klen) % htb->capa;
+		}
 	}
 
 	if (htb->threshold > 0 && htb->size >= htb->threshold)
@@ -719,10 +825,21 @@ pair_t* mio_htb_getnextpair (mio_htb_t* htb, mio_htb_itr_t* itr)
 mio_oow_t mio_htb_dflhash (const mio_htb_t* htb, const void* kptr, mio_oow_t klen)
 {
 	mio_oow_t h;
+	if (MIO_UNLIKELY(htb->keyed)) return mio_htb_keyedhash(htb, kptr, klen);
 	MIO_HASH_BYTES (h, kptr, klen);
 	return h ; 
 }
 
+mio_oow_t mio_htb_keyedhash (const mio_htb_t* htb, const void* kptr, mio_oow_t klen)
+{
+	mio_uint8_t out[8];
+	mio_oow_t h;
+
+	mio_sip_hash_24 (htb->mio->hashkey, kptr, KTOB(htb,klen), out);
+	MIO_MEMCPY (&h, out, (MIO_SIZEOF(h) < 8? MIO_SIZEOF(h): 8));
+	return h;
+}
+
 int mio_htb_dflcomp (const mio_htb_t* htb, const void* kptr1, mio_oow_t klen1, const void* kptr2, mio_oow_t klen2)
 {
 	if (klen1 == klen2) return MIO_MEMCMP (kptr1, kptr2, KTOB(htb,klen1));
@@ -0,0 +1,713 @@
+/*
+ * $Id$
+ *
+    Copyright (c) 2016-2020 Chung, Hyung-Hwan. All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions
+    are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+    IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+    OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+    INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+    THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <mio-hto.h>
+#include <mio-utl.h>
+#include "mio-prv.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#	include <emmintrin.h>
+#	define USE_SSE2_PROBE
+#endif
+
+#define pair_t          mio_hto_pair_t
+#define copier_t        mio_hto_copier_t
+#define walker_t        mio_hto_walker_t
+#define style_t         mio_hto_style_t
+#define style_kind_t    mio_hto_style_kind_t
+
+#define KPTR(p)  MIO_HTO_KPTR(p)
+#define KLEN(p)  MIO_HTO_KLEN(p)
+#define VPTR(p)  MIO_HTO_VPTR(p)
+#define VLEN(p)  MIO_HTO_VLEN(p)
+
+#define KTOB(hto,len) ((len)*(hto)->scale[MIO_HTO_KEY])
+#define VTOB(hto,len) ((len)*(hto)->scale[MIO_HTO_VAL])
+
+/* slots are probed in groups of GROUP_WIDTH slots. a control code of a
+ * slot in use holds the lowest 7 bits of the key hash. the other codes
+ * have the highest bit set. */
+#define GROUP_WIDTH    16
+#define CTRL_EMPTY     ((mio_uint8_t)0x80)
+#define CTRL_DELETED   ((mio_uint8_t)0xFE)
+#define IS_FULL(c)     (!((c) & 0x80))
+
+#define H1(hc)         ((hc) >> 7)
+#define H2(hc)         ((mio_uint8_t)((hc) & 0x7F))
+
+/* the table grows when 7/8 of the slots are in use or deleted */
+#define THRESHOLD(capa) ((capa) - ((capa) >> 3))
+
+#define IN_IBUF(p,ptr) ((mio_uint8_t*)(ptr) >= (p)->ibuf && (mio_uint8_t*)(ptr) <= (p)->ibuf + MIO_HTO_IBUF_SIZE)
+
+/* ------------------------------------------------------------------------ */
+
+static MIO_INLINE mio_uint32_t match_ctrl (const mio_uint8_t* grp, mio_uint8_t code)
+{
+#if defined(USE_SSE2_PROBE)
+	__m128i g = _mm_loadu_si128((const __m128i*)grp);
+	return (mio_uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)code)));
+#else
+	mio_uint32_t mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; i++) if (grp[i] == code) mask |= ((mio_uint32_t)1 << i);
+	return mask;
+#endif
+}
+
+static MIO_INLINE mio_uint32_t match_free (const mio_uint8_t* grp)
+{
+	/* empty or deleted */
+#if defined(USE_SSE2_PROBE)
+	return (mio_uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)grp));
+#else
+	mio_uint32_t mask = 0;
+	int i;
+	for (i = 0; i < GROUP_WIDTH; i++) if (!IS_FULL(grp[i])) mask |= ((mio_uint32_t)1 << i);
+	return mask;
+#endif
+}
+
+static MIO_INLINE int lowest_bit (mio_uint32_t mask)
+{
+#if defined(MIO_HAVE_BUILTIN_CTZ)
+	return __builtin_ctz(mask);
+#else
+	int n = 0;
+	while (!(mask & 1)) { mask >>= 1; n++; }
+	return n;
+#endif
+}
+
+/* ------------------------------------------------------------------------ */
+
+static MIO_INLINE void move_pair (pair_t* dst, const pair_t* src)
+{
+	*dst = *src;
+	/* rebase the data placed in the inline buffer */
+	if (IN_IBUF(src, KPTR(src))) KPTR(dst) = dst->ibuf + ((mio_uint8_t*)KPTR(src) - src->ibuf);
+	if (IN_IBUF(src, VPTR(src))) VPTR(dst) = dst->ibuf + ((mio_uint8_t*)VPTR(src) - src->ibuf);
+}
+
+static int init_pair (mio_hto_t* hto, pair_t* n, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen)
+{
+	copier_t kcop, vcop;
+	mio_oow_t kas = 0, vas = 0;
+	mio_uint8_t* base = MIO_NULL;
+
+	kcop = hto->style->copier[MIO_HTO_KEY];
+	vcop = hto->style->copier[MIO_HTO_VAL];
+
+	if (kcop == MIO_HTO_COPIER_INLINE) kas = MIO_ALIGN_POW2(KTOB(hto,klen), MIO_SIZEOF_VOID_P);
+	if (vcop == MIO_HTO_COPIER_INLINE) vas = VTOB(hto,vlen);
+	if (kcop == MIO_HTO_COPIER_INLINE || vcop == MIO_HTO_COPIER_INLINE)
+	{
+		/* the inlined key and value share a single block. it is
+		 * the inline buffer of the slot if they are small enough */
+		if (kas + vas <= MIO_HTO_IBUF_SIZE) base = n->ibuf;
+		else
+		{
+			base = (mio_uint8_t*)mio_allocmem(hto->mio, kas + vas);
+			if (MIO_UNLIKELY(!base)) return -1;
+		}
+	}
+
+	KLEN(n) = klen;
+	if (kcop == MIO_HTO_COPIER_SIMPLE)
+	{
+		KPTR(n) = kptr;
+	}
+	else if (kcop == MIO_HTO_COPIER_INLINE)
+	{
+		KPTR(n) = base;
+		if (kptr) MIO_MEMCPY (KPTR(n), kptr, KTOB(hto,klen));
+	}
+	else
+	{
+		KPTR(n) = kcop(hto, kptr, klen);
+		if (MIO_UNLIKELY(!KPTR(n))) goto oops;
+	}
+
+	VLEN(n) = vlen;
+	if (vcop == MIO_HTO_COPIER_SIMPLE)
+	{
+		VPTR(n) = vptr;
+	}
+	else if (vcop == MIO_HTO_COPIER_INLINE)
+	{
+		VPTR(n) = base + kas;
+		if (vptr) MIO_MEMCPY (VPTR(n), vptr, VTOB(hto,vlen));
+	}
+	else
+	{
+		VPTR(n) = vcop(hto, vptr, vlen);
+		if (MIO_UNLIKELY(!VPTR(n)))
+		{
+			if (hto->style->freeer[MIO_HTO_KEY])
+				hto->style->freeer[MIO_HTO_KEY] (hto, KPTR(n), KLEN(n));
+			goto oops;
+		}
+	}
+
+	return 0;
+
+oops:
+	if (base && base != n->ibuf) mio_freemem (hto->mio, base);
+	return -1;
+}
+
+static void fini_pair (mio_hto_t* hto, pair_t* pair)
+{
+	if (hto->style->freeer[MIO_HTO_KEY])
+		hto->style->freeer[MIO_HTO_KEY] (hto, KPTR(pair), KLEN(pair));
+	if (hto->style->freeer[MIO_HTO_VAL])
+		hto->style->freeer[MIO_HTO_VAL] (hto, VPTR(pair), VLEN(pair));
+
+	/* the block holding inlined data begins with the key if the key is inlined */
+	if (hto->style->copier[MIO_HTO_KEY] == MIO_HTO_COPIER_INLINE)
+	{
+		if (!IN_IBUF(pair, KPTR(pair))) mio_freemem (hto->mio, KPTR(pair));
+	}
+	else if (hto->style->copier[MIO_HTO_VAL] == MIO_HTO_COPIER_INLINE)
+	{
+		if (!IN_IBUF(pair, VPTR(pair))) mio_freemem (hto->mio, VPTR(pair));
+	}
+}
+
+static MIO_INLINE int change_pair_val (mio_hto_t* hto, pair_t* pair, void* vptr, mio_oow_t vlen)
+{
+	if (VPTR(pair) == vptr && VLEN(pair) == vlen)
+	{
+		/* if the old value and the new value are the same,
+		 * it just calls the handler for this condition.
+		 * No value replacement occurs. */
+		if (hto->style->keeper) hto->style->keeper (hto, vptr, vlen);
+	}
+	else
+	{
+		copier_t vcop = hto->style->copier[MIO_HTO_VAL];
+		void* ovptr = VPTR(pair);
+		mio_oow_t ovlen = VLEN(pair);
+
+		/* place the new value according to the copier */
+		if (vcop == MIO_HTO_COPIER_SIMPLE)
+		{
+			VPTR(pair) = vptr;
+			VLEN(pair) = vlen;
+		}
+		else if (vcop == MIO_HTO_COPIER_INLINE)
+		{
+			if (ovlen == vlen)
+			{
+				if (vptr) MIO_MEMCPY (VPTR(pair), vptr, VTOB(hto,vlen));
+			}
+			else
+			{
+				/* need to reconstruct the pair */
+				pair_t tmp;
+				if (init_pair(hto, &tmp, KPTR(pair), KLEN(pair), vptr, vlen) <= -1) return -1;
+				fini_pair (hto, pair);
+				move_pair (pair, &tmp);
+				return 0;
+			}
+		}
+		else
+		{
+			void* nvptr = vcop(hto, vptr, vlen);
+			if (MIO_UNLIKELY(!nvptr)) return -1;
+			VPTR(pair) = nvptr;
+			VLEN(pair) = vlen;
+		}
+
+		/* free up the old value */
+		if (hto->style->freeer[MIO_HTO_VAL])
+			hto->style->freeer[MIO_HTO_VAL] (hto, ovptr, ovlen);
+	}
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static style_t style[] =
+{
+	/* == MIO_HTO_STYLE_DEFAULT == */
+	{
+		{
+			MIO_HTO_COPIER_DEFAULT,
+			MIO_HTO_COPIER_DEFAULT
+		},
+		{
+			MIO_HTO_FREEER_DEFAULT,
+			MIO_HTO_FREEER_DEFAULT
+		},
+		MIO_HTO_COMPER_DEFAULT,
+		MIO_HTO_KEEPER_DEFAULT,
+		MIO_HTO_HASHER_DEFAULT
+	},
+
+	/* == MIO_HTO_STYLE_INLINE_COPIERS == */
+	{
+		{
+			MIO_HTO_COPIER_INLINE,
+			MIO_HTO_COPIER_INLINE
+		},
+		{
+			MIO_HTO_FREEER_DEFAULT,
+			MIO_HTO_FREEER_DEFAULT
+		},
+		MIO_HTO_COMPER_DEFAULT,
+		MIO_HTO_KEEPER_DEFAULT,
+		MIO_HTO_HASHER_DEFAULT
+	},
+
+	/* == MIO_HTO_STYLE_INLINE_KEY_COPIER == */
+	{
+		{
+			MIO_HTO_COPIER_INLINE,
+			MIO_HTO_COPIER_DEFAULT
+		},
+		{
+			MIO_HTO_FREEER_DEFAULT,
+			MIO_HTO_FREEER_DEFAULT
+		},
+		MIO_HTO_COMPER_DEFAULT,
+		MIO_HTO_KEEPER_DEFAULT,
+		MIO_HTO_HASHER_DEFAULT
+	},
+
+	/* == MIO_HTO_STYLE_INLINE_VALUE_COPIER == */
+	{
+		{
+			MIO_HTO_COPIER_DEFAULT,
+			MIO_HTO_COPIER_INLINE
+		},
+		{
+			MIO_HTO_FREEER_DEFAULT,
+			MIO_HTO_FREEER_DEFAULT
+		},
+		MIO_HTO_COMPER_DEFAULT,
+		MIO_HTO_KEEPER_DEFAULT,
+		MIO_HTO_HASHER_DEFAULT
+	}
+};
+
+const style_t* mio_get_hto_style (style_kind_t kind)
+{
+	return &style[kind];
+}
+
+/* ------------------------------------------------------------------------ */
+
+static int alloc_slots (mio_hto_t* hto, mio_oow_t capa, mio_uint8_t** ctrl, pair_t** slot)
+{
+	mio_uint8_t* ptr;
+
+	/* a single block holds the slots followed by the control codes */
+	ptr = (mio_uint8_t*)mio_allocmem(hto->mio, capa * (MIO_SIZEOF(pair_t) + 1));
+	if (MIO_UNLIKELY(!ptr)) return -1;
+
+	*slot = (pair_t*)ptr;
+	*ctrl = ptr + capa * MIO_SIZEOF(pair_t);
+	MIO_MEMSET (*ctrl, CTRL_EMPTY, capa);
+	return 0;
+}
+
+mio_hto_t* mio_hto_open (mio_t* mio, mio_oow_t xtnsize, mio_oow_t capa, int kscale, int vscale)
+{
+	mio_hto_t* hto;
+
+	hto = (mio_hto_t*)mio_allocmem(mio, MIO_SIZEOF(mio_hto_t) + xtnsize);
+	if (MIO_UNLIKELY(!hto)) return MIO_NULL;
+
+	if (mio_hto_init(hto, mio, capa, kscale, vscale) <= -1)
+	{
+		mio_freemem (mio, hto);
+		return MIO_NULL;
+	}
+
+	MIO_MEMSET (hto + 1, 0, xtnsize);
+	return hto;
+}
+
+void mio_hto_close (mio_hto_t* hto)
+{
+	mio_hto_fini (hto);
+	mio_freemem (hto->mio, hto);
+}
+
+int mio_hto_init (mio_hto_t* hto, mio_t* mio, mio_oow_t capa, int kscale, int vscale)
+{
+	mio_oow_t ncapa;
+
+	MIO_ASSERT (mio, kscale >= 0 && kscale <= MIO_TYPE_MAX(mio_uint8_t));
+	MIO_ASSERT (mio, vscale >= 0 && vscale <= MIO_TYPE_MAX(mio_uint8_t));
+
+	/* do not zero out the extension */
+	MIO_MEMSET (hto, 0, MIO_SIZEOF(*hto));
+	hto->mio = mio;
+
+	/* the number of slots is a power of 2 not less than GROUP_WIDTH
+	 * such that the requested number of pairs stays under the threshold */
+	ncapa = GROUP_WIDTH;
+	while (THRESHOLD(ncapa) < capa) ncapa <<= 1;
+
+	if (alloc_slots(hto, ncapa, &hto->ctrl, &hto->slot) <= -1) return -1;
+
+	hto->scale[MIO_HTO_KEY] = (kscale < 1)? 1: kscale;
+	hto->scale[MIO_HTO_VAL] = (vscale < 1)? 1: vscale;
+
+	hto->size = 0;
+	hto->tombs = 0;
+	hto->capa = ncapa;
+	hto->threshold = THRESHOLD(ncapa);
+
+	/* use the random key of the mio object to seed the default hasher */
+	MIO_MEMCPY (hto->seed, mio->hashkey, MIO_SIZEOF(hto->seed));
+
+	hto->style = &style[0];
+	return 0;
+}
+
+void mio_hto_fini (mio_hto_t* hto)
+{
+	mio_hto_clear (hto);
+	mio_freemem (hto->mio, hto->slot);
+}
+
+const style_t* mio_hto_getstyle (const mio_hto_t* hto)
+{
+	return hto->style;
+}
+
+void mio_hto_setstyle (mio_hto_t* hto, const style_t* style)
+{
+	MIO_ASSERT (hto->mio, style != MIO_NULL);
+	hto->style = style;
+}
+
+mio_oow_t mio_hto_getsize (const mio_hto_t* hto)
+{
+	return hto->size;
+}
+
+mio_oow_t mio_hto_getcapa (const mio_hto_t* hto)
+{
+	return hto->capa;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static MIO_INLINE mio_oow_t find_slot (const mio_hto_t* hto, const void* kptr, mio_oow_t klen, mio_oow_t hc)
+{
+	mio_oow_t gmask, g, step;
+	mio_uint8_t h2;
+
+	gmask = (hto->capa / GROUP_WIDTH) - 1;
+	g = H1(hc) & gmask;
+	h2 = H2(hc);
+
+	for (step = 0; step <= gmask; step++)
+	{
+		const mio_uint8_t* grp = &hto->ctrl[g * GROUP_WIDTH];
+		mio_uint32_t mask;
+
+		mask = match_ctrl(grp, h2);
+		while (mask)
+		{
+			mio_oow_t i = g * GROUP_WIDTH + lowest_bit(mask);
+			pair_t* pair = &hto->slot[i];
+			if (hto->style->comper(hto, KPTR(pair), KLEN(pair), kptr, klen) == 0) return i;
+			mask &= mask - 1;
+		}
+
+		/* a key is never placed past a group with an empty slot */
+		if (match_ctrl(grp, CTRL_EMPTY)) break;
+
+		/* triangular probing visits every group once
+		 * as the number of groups is a power of 2 */
+		g = (g + step + 1) & gmask;
+	}
+
+	return hto->capa;
+}
+
+static MIO_INLINE mio_oow_t find_free_slot (const mio_hto_t* hto, mio_oow_t hc)
+{
+	mio_oow_t gmask, g, step;
+
+	gmask = (hto->capa / GROUP_WIDTH) - 1;
+	g = H1(hc) & gmask;
+
+	for (step = 0; step <= gmask; step++)
+	{
+		mio_uint32_t mask = match_free(&hto->ctrl[g * GROUP_WIDTH]);
+		if (mask) return g * GROUP_WIDTH + lowest_bit(mask);
+		g = (g + step + 1) & gmask;
+	}
+
+	/* never reached as the table grows before it fills up */
+	return hto->capa;
+}
+
+static int reorganize (mio_hto_t* hto)
+{
+	mio_oow_t i, new_capa;
+	mio_uint8_t* old_ctrl;
+	pair_t* old_slot;
+	mio_oow_t old_capa;
+
+	/* double the slots if more than half of the threshold is used by
+	 * live pairs. otherwise, rebuild at the same size to purge the
+	 * deleted slots */
+	new_capa = (hto->size >= hto->threshold / 2)? (hto->capa << 1): hto->capa;
+
+	old_ctrl = hto->ctrl;
+	old_slot = hto->slot;
+	old_capa = hto->capa;
+
+	if (alloc_slots(hto, new_capa, &hto->ctrl, &hto->slot) <= -1)
+	{
+		hto->ctrl = old_ctrl;
+		hto->slot = old_slot;
+		return -1;
+	}
+
+	hto->capa = new_capa;
+	hto->threshold = THRESHOLD(new_capa);
+	hto->tombs = 0;
+
+	for (i = 0; i < old_capa; i++)
+	{
+		if (IS_FULL(old_ctrl[i]))
+		{
+			pair_t* pair = &old_slot[i];
+			mio_oow_t hc, j;
+
+			hc = hto->style->hasher(hto, KPTR(pair), KLEN(pair));
+			j = find_free_slot(hto, hc);
+			hto->ctrl[j] = H2(hc);
+			move_pair (&hto->slot[j], pair);
+		}
+	}
+
+	mio_freemem (hto->mio, old_slot);
+	return 0;
+}
+
+/* insert options */
+#define UPSERT 1
+#define UPDATE 2
+#define ENSERT 3
+#define INSERT 4
+
+static MIO_INLINE pair_t* insert (mio_hto_t* hto, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen, int opt)
+{
+	mio_oow_t hc, i;
+	pair_t* pair;
+
+	hc = hto->style->hasher(hto, kptr, klen);
+	i = find_slot(hto, kptr, klen, hc);
+	if (i < hto->capa)
+	{
+		/* found a pair with a matching key */
+		pair = &hto->slot[i];
+		switch (opt)
+		{
+			case UPSERT:
+			case UPDATE:
+				if (change_pair_val(hto, pair, vptr, vlen) <= -1) return MIO_NULL;
+				return pair;
+
+			case ENSERT:
+				/* return existing pair */
+				return pair;
+
+			case INSERT:
+				/* return failure */
+				mio_seterrnum (hto->mio, MIO_EEXIST);
+				return MIO_NULL;
+		}
+	}
+
+	if (opt == UPDATE)
+	{
+		mio_seterrnum (hto->mio, MIO_ENOENT);
+		return MIO_NULL;
+	}
+
+	i = find_free_slot(hto, hc);
+	if (hto->ctrl[i] == CTRL_EMPTY && hto->size + hto->tombs >= hto->threshold)
+	{
+		/* taking an empty slot may leave no empty slot to stop probing at.
+		 * unlike mio_htb_t, a failure to grow is an error here. */
+		if (reorganize(hto) <= -1 && hto->size + hto->tombs + 1 >= hto->capa) return MIO_NULL;
+		i = find_free_slot(hto, hc);
+	}
+
+	pair = &hto->slot[i];
+	if (init_pair(hto, pair, kptr, klen, vptr, vlen) <= -1) return MIO_NULL;
+
+	if (hto->ctrl[i] == CTRL_DELETED) hto->tombs--;
+	hto->ctrl[i] = H2(hc);
+	hto->size++;
+
+	return pair; /* new key added */
+}
+
+pair_t* mio_hto_search (const mio_hto_t* hto, const void* kptr, mio_oow_t klen)
+{
+	mio_oow_t i;
+
+	i = find_slot(hto, kptr, klen, hto->style->hasher(hto, kptr, klen));
+	if (i < hto->capa) return &hto->slot[i];
+
+	mio_seterrnum (hto->mio, MIO_ENOENT);
+	return MIO_NULL;
+}
+
+pair_t* mio_hto_upsert (mio_hto_t* hto, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen)
+{
+	return insert(hto, kptr, klen, vptr, vlen, UPSERT);
+}
+
+pair_t* mio_hto_ensert (mio_hto_t* hto, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen)
+{
+	return insert(hto, kptr, klen, vptr, vlen, ENSERT);
+}
+
+pair_t* mio_hto_insert (mio_hto_t* hto, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen)
+{
+	return insert(hto, kptr, klen, vptr, vlen, INSERT);
+}
+
+pair_t* mio_hto_update (mio_hto_t* hto, void* kptr, mio_oow_t klen, void* vptr, mio_oow_t vlen)
+{
+	return insert(hto, kptr, klen, vptr, vlen, UPDATE);
+}
+
+int mio_hto_delete (mio_hto_t* hto, const void* kptr, mio_oow_t klen)
+{
+	mio_oow_t i;
+
+	i = find_slot(hto, kptr, klen, hto->style->hasher(hto, kptr, klen));
+	if (i >= hto->capa)
+	{
+		mio_seterrnum (hto->mio, MIO_ENOENT);
+		return -1;
+	}
+
+	fini_pair (hto, &hto->slot[i]);
+
+	/* a group that has an empty slot has never been full. so no probing
+	 * has gone past it and the slot can become empty again. otherwise,
+	 * it must be marked deleted not to stop probing for other keys */
+	if (match_ctrl(&hto->ctrl[i & ~(mio_oow_t)(GROUP_WIDTH - 1)], CTRL_EMPTY))
+	{
+		hto->ctrl[i] = CTRL_EMPTY;
+	}
+	else
+	{
+		hto->ctrl[i] = CTRL_DELETED;
+		hto->tombs++;
+	}
+	hto->size--;
+
+	return 0;
+}
+
+void mio_hto_clear (mio_hto_t* hto)
+{
+	mio_oow_t i;
+
+	if (hto->size > 0)
+	{
+		for (i = 0; i < hto->capa; i++)
+		{
+			if (IS_FULL(hto->ctrl[i])) fini_pair (hto, &hto->slot[i]);
+		}
+	}
+
+	MIO_MEMSET (hto->ctrl, CTRL_EMPTY, hto->capa);
+	hto->size = 0;
+	hto->tombs = 0;
+}
+
+void mio_hto_walk (mio_hto_t* hto, walker_t walker, void* ctx)
+{
+	mio_oow_t i;
+
+	for (i = 0; i < hto->capa; i++)
+	{
+		if (IS_FULL(hto->ctrl[i]) && walker(hto, &hto->slot[i], ctx) == MIO_HTO_WALK_STOP) return;
+	}
+}
+
+void mio_init_hto_itr (mio_hto_itr_t* itr)
+{
+	itr->slotno = 0;
+}
+
+pair_t* mio_hto_getfirstpair (mio_hto_t* hto, mio_hto_itr_t* itr)
+{
+	itr->slotno = 0;
+	return mio_hto_getnextpair(hto, itr);
+}
+
+pair_t* mio_hto_getnextpair (mio_hto_t* hto, mio_hto_itr_t* itr)
+{
+	mio_oow_t i;
+
+	for (i = itr->slotno; i < hto->capa; i++)
+	{
+		if (IS_FULL(hto->ctrl[i]))
+		{
+			/* the next call resumes from the slot after this */
+			itr->slotno = i + 1;
+			return &hto->slot[i];
+		}
+	}
+
+	itr->slotno = hto->capa;
+	return MIO_NULL;
+}
+
+mio_oow_t mio_hto_dflhash (const mio_hto_t* hto, const void* kptr, mio_oow_t klen)
+{
+	mio_uint8_t out[8];
+	mio_oow_t h;
+
+	mio_sip_hash_24 (hto->seed, kptr, KTOB(hto,klen), out);
+	MIO_MEMCPY (&h, out, (MIO_SIZEOF(h) < 8? MIO_SIZEOF(h): 8));
+	return h;
+}
+
+int mio_hto_dflcomp (const mio_hto_t* hto, const void* kptr1, mio_oow_t klen1, const void* kptr2, mio_oow_t klen2)
+{
+	if (klen1 == klen2) return MIO_MEMCMP(kptr1, kptr2, KTOB(hto,klen1));
+	/* it just returns 1 to indicate that they are different. */
+	return 1;
+}
@@ -46,6 +46,11 @@ typedef enum cgi_res_mode_t cgi_res_mode_t;
 
 #define CGI_PENDING_IO_THRESHOLD 5
 
+/* the peer output is not read while the data queued to the client
+ * is above the high watermark till it falls to the low watermark */
+#define CGI_CLIENT_WQ_HIGH_WATERMARK 131072
+#define CGI_CLIENT_WQ_LOW_WATERMARK 32768
+
 #define CGI_OVER_READ_FROM_CLIENT (1 << 0)
 #define CGI_OVER_READ_FROM_PEER   (1 << 1)
 #define CGI_OVER_WRITE_TO_CLIENT  (1 << 2)
@@ -69,6 +74,8 @@ struct cgi_t
 	unsigned int ever_attempted_to_write_to_client: 1;
 	unsigned int client_disconnected: 1;
 	unsigned int client_htrd_recbs_changed: 1;
+	unsigned int res_forwardable: 1;
+	unsigned int res_forwarding: 1;
 	mio_oow_t req_content_length; /* client request content length */
 	cgi_res_mode_t res_mode_to_cli;
 
@@ -109,11 +116,6 @@ static int cgi_write_to_client (cgi_t* cgi, const void* data, mio_iolen_t dlen)
 		return -1;
 	}
 
-	if (cgi->num_pending_writes_to_client > CGI_PENDING_IO_THRESHOLD)
-	{
-		/* disable reading on the output stream of the peer */
-		if (mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 0) <= -1) return -1;
-	}
 	return 0;
 }
 
@@ -128,10 +130,26 @@ static int cgi_writev_to_client (cgi_t* cgi, mio_iovec_t* iov, mio_iolen_t iovcn
 		return -1;
 	}
 
-	if (cgi->num_pending_writes_to_client > CGI_PENDING_IO_THRESHOLD)
-	{
-		if (mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 0) <= -1) return -1;
-	}
+	return 0;
+}
+
+static int cgi_client_on_pressure (mio_dev_t* dev, void* ctx)
+{
+	cgi_t* cgi = (cgi_t*)ctx;
+
+	/* disable reading on the output stream of the peer. 
+	 * the forwarded output is not queued to the client */
+	if (cgi->peer && !cgi->res_forwarding &&
+	    mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 0) <= -1) return -1;
+	return 0;
+}
+
+static int cgi_client_on_drain (mio_dev_t* dev, void* ctx)
+{
+	cgi_t* cgi = (cgi_t*)ctx;
+
+	if (cgi->peer && !cgi->res_forwarding && !(cgi->over & CGI_OVER_READ_FROM_PEER) &&
+	    mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 1) <= -1) return -1;
 	return 0;
 }
 
@@ -170,6 +188,23 @@ static int cgi_write_last_chunk_to_client (cgi_t* cgi)
 	return 0;
 }
 
+static int cgi_forward_to_client (cgi_t* cgi)
+{
+	/* forward the rest of the peer output to the client inside the kernel.
+	 * the peer's on_read callback gets called for EOF only from now on.
+	 * the write context is the cgi state itself so that cgi_client_on_write()
+	 * can tell the completion of forwarding from other writes */
+	cgi->num_pending_writes_to_client++;
+	if (mio_dev_pro_forward(cgi->peer, MIO_DEV_PRO_OUT, (mio_dev_t*)cgi->client->sck, -1, cgi) <= -1)
+	{
+		cgi->num_pending_writes_to_client--;
+		return -1;
+	}
+
+	cgi->res_forwarding = 1;
+	return 0;
+}
+
 static int cgi_write_to_peer (cgi_t* cgi, const void* data, mio_iolen_t dlen)
 {
 	cgi->num_pending_writes_to_peer++;
@@ -289,6 +324,9 @@ static void cgi_on_kill (cgi_t* cgi)
 		mio_htrd_setrecbs (cgi->client->htrd, &cgi->client_htrd_org_recbs);
 	}
 
+	/* the watermark callbacks refer to the cgi state */
+	mio_dev_setwmark ((mio_dev_t*)cgi->client->sck, MIO_NULL);
+
 	if (!cgi->client_disconnected)
 	{
 /*printf ("ENABLING INPUT WATCHING on CLIENT %p. \n", cgi->client->sck);*/
@@ -410,6 +448,15 @@ static int cgi_peer_on_read (mio_dev_pro_t* pro, mio_dev_pro_sid_t sid, const vo
 printf ("AAAAAAAAAAAAAAAAAa EEEEEXcessive DATA..................\n");
 /* TODO: or drop this request?? */
 		}
+
+		if (cgi->res_forwardable && !cgi->res_forwarding && !(cgi->over & CGI_OVER_READ_FROM_PEER) && !cgi->client->sck->wq_pressured)
+		{
+			/* the response header and the content read so far have been
+			 * queued to the client. the rest can bypass the peer htrd.
+			 * it is deferred to the next read if the peer output has 
+			 * been paused for the data queued to the client */
+			if (cgi_forward_to_client(cgi) <= -1) goto oops;
+		}
 	}
 
 	return 0;
@@ -499,6 +546,10 @@ printf ("CGI PEER HTRD PEEK...\n");
 
 	if (mio_becs_cat(cli->sbuf, "\r\n") == (mio_oow_t)-1) return -1;
 
+	/* the content doesn't need any transformation when the response ends
+	 * at EOF. it can be spliced to the client if the socket allows it */
+	cgi->res_forwardable = (cgi->res_mode_to_cli == CGI_RES_MODE_CLOSE && mio_dev_sck_forwardok(cli->sck));
+
 	return cgi_write_to_client(cgi, MIO_BECS_PTR(cli->sbuf), MIO_BECS_LEN(cli->sbuf));
 }
 
@@ -554,11 +605,6 @@ static int cgi_peer_htrd_push_content (mio_htrd_t* htrd, mio_htre_t* req, const
 			break;
 	}
 
-	if (cgi->num_pending_writes_to_client > CGI_PENDING_IO_THRESHOLD)
-	{
-		if (mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 0) <= -1) goto oops;
-	}
-
 	return 0;
 
 oops:
@@ -732,7 +778,23 @@ static int cgi_client_on_write (mio_dev_sck_t* sck, mio_iolen_t wrlen, void* wrc
 		goto oops;
 	}
 
-	if (wrlen == 0)
+	if (wrctx == cgi)
+	{
+		/* forwarding the peer output has finished. EOF from the peer has
+		 * been handled by cgi_peer_on_read() with the last write queued
+		 * behind the forwarding request. */
+		MIO_ASSERT (mio, cgi->res_forwarding);
+		MIO_ASSERT (mio, cgi->num_pending_writes_to_client > 0);
+		cgi->num_pending_writes_to_client--;
+		cgi->res_forwarding = 0;
+		cgi->res_forwardable = 0;
+
+		if ((cgi->over & CGI_OVER_READ_FROM_PEER) && cgi->num_pending_writes_to_client <= 0)
+		{
+			cgi_mark_over (cgi, CGI_OVER_WRITE_TO_CLIENT);
+		}
+	}
+	else if (wrlen == 0)
 	{
 		/* if the connect is keep-alive, this part may not be called */
 		cgi->num_pending_writes_to_client--;
@@ -748,12 +810,6 @@ static int cgi_client_on_write (mio_dev_sck_t* sck, mio_iolen_t wrlen, void* wrc
 		MIO_ASSERT (mio, cgi->num_pending_writes_to_client > 0);
 
 		cgi->num_pending_writes_to_client--;
-		if (cgi->peer && cgi->num_pending_writes_to_client == CGI_PENDING_IO_THRESHOLD)
-		{
-			if (!(cgi->over & CGI_OVER_READ_FROM_PEER) &&
-			    mio_dev_pro_read(cgi->peer, MIO_DEV_PRO_OUT, 1) <= -1) goto oops;
-		}
-
 		if ((cgi->over & CGI_OVER_READ_FROM_PEER) && cgi->num_pending_writes_to_client <= 0)
 		{
 			cgi_mark_over (cgi, CGI_OVER_WRITE_TO_CLIENT);
@@ -909,6 +965,7 @@ int mio_svc_htts_docgi (mio_svc_htts_t* htts, mio_dev_sck_t* csck, mio_htre_t* r
 	cgi_t* cgi = MIO_NULL;
 	cgi_peer_xtn_t* cgi_peer;
 	mio_dev_pro_make_t mi;
+	mio_dev_wmark_t wmark;
 	cgi_peer_fork_ctx_t fc;
 
 	/* ensure that you call this function before any contents is received */
@@ -947,6 +1004,14 @@ int mio_svc_htts_docgi (mio_svc_htts_t* htts, mio_dev_sck_t* csck, mio_htre_t* r
 	csck->on_write = cgi_client_on_write;
 	csck->on_disconnect = cgi_client_on_disconnect;
 
+	MIO_MEMSET (&wmark, 0, MIO_SIZEOF(wmark));
+	wmark.high = CGI_CLIENT_WQ_HIGH_WATERMARK;
+	wmark.low = CGI_CLIENT_WQ_LOW_WATERMARK;
+	wmark.on_pressure = cgi_client_on_pressure;
+	wmark.on_drain = cgi_client_on_drain;
+	wmark.ctx = cgi;
+	mio_dev_setwmark ((mio_dev_t*)csck, &wmark);
+
 	MIO_ASSERT (mio, cli->rsrc == MIO_NULL);
 	MIO_SVC_HTTS_RSRC_ATTACH (cgi, cli->rsrc);
 
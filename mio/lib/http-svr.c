@@ -329,7 +329,7 @@ mio_svc_htts_t* mio_svc_htts_start (mio_t* mio, mio_dev_sck_bind_t* sck_bind, mi
 	if (MIO_UNLIKELY(!htts)) goto oops;
 
 	htts->mio = mio;
-	htts->svc_stop = mio_svc_htts_stop;
+	htts->svc_stop = (mio_svc_stop_t)mio_svc_htts_stop;
 	htts->proc_req = proc_req;
 	htts->idle_tmridx = MIO_TMRIDX_INVALID;
 
@@ -351,7 +351,10 @@ mio_svc_htts_t* mio_svc_htts_start (mio_t* mio, mio_dev_sck_bind_t* sck_bind, mi
 			break;
 
 	}
+	/* coalesce the data received in a row over tls to feed the request
+	 * parser less often. a tls record yields little data per read */
 	info.m.options = MIO_DEV_SCK_MAKE_LENIENT;
+	if (sck_bind->ssl_certfile) info.m.options |= MIO_DEV_SCK_MAKE_COALESCE_READ;
 	info.m.on_write = listener_on_write;
 	info.m.on_read = listener_on_read;
 	info.m.on_connect = listener_on_connect;
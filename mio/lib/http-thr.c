@@ -42,6 +42,11 @@ typedef enum thr_state_res_mode_t thr_state_res_mode_t;
 
 #define THR_STATE_PENDING_IO_THRESHOLD 5
 
+/* the peer output is not read while the data queued to the client
+ * is above the high watermark till it falls to the low watermark */
+#define THR_STATE_CLIENT_WQ_HIGH_WATERMARK 131072
+#define THR_STATE_CLIENT_WQ_LOW_WATERMARK 32768
+
 #define THR_STATE_OVER_READ_FROM_CLIENT (1 << 0)
 #define THR_STATE_OVER_READ_FROM_PEER   (1 << 1)
 #define THR_STATE_OVER_WRITE_TO_CLIENT  (1 << 2)
@@ -103,6 +108,24 @@ static void thr_state_halt_participating_devices (thr_state_t* thr_state)
 	if (thr_state->peer) mio_dev_thr_halt (thr_state->peer);
 }
 
+static int thr_state_client_on_pressure (mio_dev_t* dev, void* ctx)
+{
+	thr_state_t* thr_state = (thr_state_t*)ctx;
+
+	/* disable reading on the output stream of the peer */
+	if (thr_state->peer && mio_dev_thr_read(thr_state->peer, 0) <= -1) return -1;
+	return 0;
+}
+
+static int thr_state_client_on_drain (mio_dev_t* dev, void* ctx)
+{
+	thr_state_t* thr_state = (thr_state_t*)ctx;
+
+	if (thr_state->peer && !(thr_state->over & THR_STATE_OVER_READ_FROM_PEER) &&
+	    mio_dev_thr_read(thr_state->peer, 1) <= -1) return -1;
+	return 0;
+}
+
 static int thr_state_write_to_client (thr_state_t* thr_state, const void* data, mio_iolen_t dlen)
 {
 	thr_state->ever_attempted_to_write_to_client = 1;
@@ -114,10 +137,6 @@ static int thr_state_write_to_client (thr_state_t* thr_state, const void* data,
 		return -1;
 	}
 
-	if (thr_state->num_pending_writes_to_client > THR_STATE_PENDING_IO_THRESHOLD)
-	{
-		if (mio_dev_thr_read(thr_state->peer, 0) <= -1) return -1;
-	}
 	return 0;
 }
 
@@ -132,10 +151,6 @@ static int thr_state_writev_to_client (thr_state_t* thr_state, mio_iovec_t* iov,
 		return -1;
 	}
 
-	if (thr_state->num_pending_writes_to_client > THR_STATE_PENDING_IO_THRESHOLD)
-	{
-		if (mio_dev_thr_read(thr_state->peer, 0) <= -1) return -1;
-	}
 	return 0;
 }
 
@@ -293,6 +308,9 @@ static void thr_state_on_kill (thr_state_t* thr_state)
 		mio_htrd_setrecbs (thr_state->client->htrd, &thr_state->client_htrd_org_recbs); 
 	}
 
+	/* the watermark callbacks refer to the thr state */
+	mio_dev_setwmark ((mio_dev_t*)thr_state->client->sck, MIO_NULL);
+
 	if (!thr_state->client_disconnected)
 	{
 /*printf ("ENABLING INPUT WATCHING on CLIENT %p. \n", thr_state->client->sck);*/
@@ -557,14 +575,6 @@ static int thr_peer_htrd_push_content (mio_htrd_t* htrd, mio_htre_t* req, const
 			break;
 	}
 
-	if (thr_state->num_pending_writes_to_client > THR_STATE_PENDING_IO_THRESHOLD)
-	{
-		if (mio_dev_thr_read(thr_state->peer, 0) <= -1) 
-		{
-			goto oops;
-		}
-	}
-
 	return 0;
 
 oops:
@@ -752,12 +762,6 @@ static int thr_client_on_write (mio_dev_sck_t* sck, mio_iolen_t wrlen, void* wrc
 		MIO_ASSERT (mio, thr_state->num_pending_writes_to_client > 0);
 
 		thr_state->num_pending_writes_to_client--;
-		if (thr_state->peer && thr_state->num_pending_writes_to_client == THR_STATE_PENDING_IO_THRESHOLD)
-		{
-			if (!(thr_state->over & THR_STATE_OVER_READ_FROM_PEER) &&
-			    mio_dev_thr_read(thr_state->peer, 1) <= -1) goto oops;
-		}
-
 		if ((thr_state->over & THR_STATE_OVER_READ_FROM_PEER) && thr_state->num_pending_writes_to_client <= 0)
 		{
 			thr_state_mark_over (thr_state, THR_STATE_OVER_WRITE_TO_CLIENT);
@@ -821,6 +825,7 @@ int mio_svc_htts_dothr (mio_svc_htts_t* htts, mio_dev_sck_t* csck, mio_htre_t* r
 	thr_state_t* thr_state = MIO_NULL;
 	thr_peer_xtn_t* thr_peer;
 	mio_dev_thr_make_t mi;
+	mio_dev_wmark_t wmark;
 	thr_func_start_t* tfs;
 
 	/* ensure that you call this function before any contents is received */
@@ -872,6 +877,14 @@ int mio_svc_htts_dothr (mio_svc_htts_t* htts, mio_dev_sck_t* csck, mio_htre_t* r
 	csck->on_write = thr_client_on_write;
 	csck->on_disconnect = thr_client_on_disconnect;
 
+	MIO_MEMSET (&wmark, 0, MIO_SIZEOF(wmark));
+	wmark.high = THR_STATE_CLIENT_WQ_HIGH_WATERMARK;
+	wmark.low = THR_STATE_CLIENT_WQ_LOW_WATERMARK;
+	wmark.on_pressure = thr_state_client_on_pressure;
+	wmark.on_drain = thr_state_client_on_drain;
+	wmark.ctx = thr_state;
+	mio_dev_setwmark ((mio_dev_t*)csck, &wmark);
+
 	MIO_ASSERT (mio, cli->rsrc == MIO_NULL);
 	MIO_SVC_HTTS_RSRC_ATTACH (thr_state, cli->rsrc);
 
@@ -29,6 +29,11 @@
 #include <mio-fmt.h>
 #include "mio-prv.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#	include <emmintrin.h>
+#	define USE_SSE2_SCAN
+#endif
+
 #define MIO_JSON_TOKEN_NAME_ALIGN 64
 
 /* this must not overlap with MIO_JSON_INST_XXXX enumerators in mio-json.h */
@@ -86,11 +91,9 @@ static int add_char_to_token (mio_json_t* json, mio_ooch_t ch, int handle_surrog
 	return 0;
 }
 
-static int add_chars_to_token (mio_json_t* json, const mio_ooch_t* ptr, mio_oow_t len)
+static int ensure_token_capa (mio_json_t* json, mio_oow_t len)
 {
-	mio_oow_t i;
-	
-	if (json->tok_capa - json->tok.len > len)
+	if (len > json->tok_capa - json->tok.len)
 	{
 		mio_ooch_t* tmp;
 		mio_oow_t newcapa;
@@ -103,9 +106,37 @@ static int add_chars_to_token (mio_json_t* json, const mio_ooch_t* ptr, mio_oow_
 		json->tok.ptr = tmp;
 	}
 
-	for (i = 0; i < len; i++) json->tok.ptr[json->tok.len++] = ptr[i];
+	return 0;
+}
+
+static int add_chars_to_token (mio_json_t* json, const mio_ooch_t* ptr, mio_oow_t len)
+{
+	if (ensure_token_capa(json, len) <= -1) return -1;
+
+	MIO_MEMCPY (&json->tok.ptr[json->tok.len], ptr, len * MIO_SIZEOF(*ptr));
+	json->tok.len += len;
+	json->tok.ptr[json->tok.len] = '\0';
+	return 0;
+}
+
+static int add_plain_bchars_to_token (mio_json_t* json, const mio_bch_t* ptr, mio_oow_t len)
+{
+	/* the caller must ensure that the bytes don't need conversion.
+	 * see scan_plain_bchars() */
+#if defined(MIO_OOCH_IS_UCH)
+	mio_ooch_t* dst;
+	mio_oow_t i;
+
+	if (ensure_token_capa(json, len) <= -1) return -1;
+
+	dst = &json->tok.ptr[json->tok.len];
+	for (i = 0; i < len; i++) dst[i] = (mio_bcu_t)ptr[i];
+	json->tok.len += len;
 	json->tok.ptr[json->tok.len] = '\0';
 	return 0;
+#else
+	return add_chars_to_token(json, ptr, len);
+#endif
 }
 
 static MIO_INLINE mio_ooch_t unescape (mio_ooch_t c)
@@ -129,8 +160,18 @@ static int push_read_state (mio_json_t* json, mio_json_state_t state)
 {
 	mio_json_state_node_t* ss;
 
-	ss = (mio_json_state_node_t*)mio_callocmem(json->mio, MIO_SIZEOF(*ss));
-	if (MIO_UNLIKELY(!ss)) return -1;
+	if (json->state_free)
+	{
+		/* reuse a node released by pop_read_state() */
+		ss = json->state_free;
+		json->state_free = ss->next;
+		MIO_MEMSET (ss, 0, MIO_SIZEOF(*ss));
+	}
+	else
+	{
+		ss = (mio_json_state_node_t*)mio_callocmem(json->mio, MIO_SIZEOF(*ss));
+		if (MIO_UNLIKELY(!ss)) return -1;
+	}
 
 	ss->state = state;
 	ss->level = json->state_stack->level; /* copy from the parent */
@@ -159,8 +200,10 @@ static void pop_read_state (mio_json_t* json)
 		json->state_stack->u.io.state++;
 	}
 
-/* TODO: don't free this. move it to the free list? */
-	mio_freemem (json->mio, ss);
+	/* keep the node for reuse. a string or a number value pushes and pops
+	 * a state node, which would otherwise cost an allocation per value */
+	ss->next = json->state_free;
+	json->state_free = ss;
 }
 
 static void pop_all_read_states (mio_json_t* json)
@@ -168,15 +211,29 @@ static void pop_all_read_states (mio_json_t* json)
 	while (json->state_stack != &json->state_top) pop_read_state (json);
 }
 
+static void free_read_states (mio_json_t* json)
+{
+	while (json->state_free)
+	{
+		mio_json_state_node_t* ss = json->state_free;
+		json->state_free = ss->next;
+		mio_freemem (json->mio, ss);
+	}
+}
+
 /* ========================================================================= */
 
 static int invoke_data_inst (mio_json_t* json, mio_json_inst_t inst)
 {
 	mio_json_state_node_t* ss;
 	int is_obj_val = 0;
+	int report;
 
 	ss = json->state_stack;
 
+	/* in the query mode, nothing is reported outside a value on a matching path */
+	report = (json->query.len <= 0 || json->query.hit);
+
 	if (ss->state == MIO_JSON_STATE_IN_OBJECT)
 	{
 		if (ss->u.io.state == 1) 
@@ -221,14 +278,15 @@ static int invoke_data_inst (mio_json_t* json, mio_json_inst_t inst)
 			nss = json->state_stack;
 			nss->u.ia.got_value = 0;
 			nss->level++;
+			nss->qmask = json->query.next_qmask;
 
 			MIO_ASSERT (json->mio, nss->level == ss->level + 1);
-			return json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, MIO_NULL, json->rctx);
+			return report? json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, MIO_NULL, json->rctx): 0;
 			/* no increment on ss->index here. incremented on END */
 		}
 
 		case MIO_JSON_INST_END_ARRAY:
-			if (json->instcb(json, MIO_JSON_INST_END_ARRAY, ss->level, ss->index, ss->state, MIO_NULL, json->rctx) <= -1) return -1;
+			if (report && json->instcb(json, MIO_JSON_INST_END_ARRAY, ss->level, ss->index, ss->state, MIO_NULL, json->rctx) <= -1) return -1;
 			if (ss->state != MIO_JSON_STATE_IN_OBJECT || ss->u.io.state == 3) ss->index++;
 			break;
 
@@ -240,26 +298,130 @@ static int invoke_data_inst (mio_json_t* json, mio_json_inst_t inst)
 			nss = json->state_stack;
 			nss->u.io.state = 0;
 			nss->level++;
+			nss->qmask = json->query.next_qmask;
 
 			MIO_ASSERT (json->mio, nss->level == ss->level + 1);
-			return json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, MIO_NULL, json->rctx);
+			return report? json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, MIO_NULL, json->rctx): 0;
 			/* no increment on ss->index here. incremented on END */
 		}
 
 		case MIO_JSON_INST_END_OBJECT:
-			if (json->instcb(json, MIO_JSON_INST_END_OBJECT, ss->level, ss->index, ss->state, MIO_NULL, json->rctx) <= -1) return -1;
+			if (report && json->instcb(json, MIO_JSON_INST_END_OBJECT, ss->level, ss->index, ss->state, MIO_NULL, json->rctx) <= -1) return -1;
 			if (ss->state != MIO_JSON_STATE_IN_OBJECT || ss->u.io.state == 3) ss->index++;
 			break;
 
+		case MIO_JSON_INST_KEY:
+			/* a key in the query mode is kept in the token for matching 
+			 * the value that follows. see query_value() */
+			if (report && json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, &json->tok, json->rctx) <= -1) return -1;
+			return 0;
+
 		default:
-			if (json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, &json->tok, json->rctx) <= -1) return -1;
+			if (report && json->instcb(json, inst, (is_obj_val? 0: ss->level), ss->index, ss->state, &json->tok, json->rctx) <= -1) return -1;
 			if (ss->state != MIO_JSON_STATE_IN_OBJECT || ss->u.io.state == 3) ss->index++;
 			break;
 	}
 
+	/* the value on a matching path has been reported in full */
+	if (json->query.hit && ss->level == json->query.hit_level) json->query.hit = 0;
+	return 0;
+}
+
+/* ========================================================================= */
+
+static MIO_INLINE int match_path_seg (mio_json_t* json, const mio_json_path_seg_t* seg, mio_json_state_node_t* ss)
+{
+	switch (seg->type)
+	{
+		case MIO_JSON_PATH_SEG_ANY:
+			return 1;
+
+		case MIO_JSON_PATH_SEG_KEY:
+			/* the key of the current value is still in the token */
+			return ss->state == MIO_JSON_STATE_IN_OBJECT && mio_comp_oochars(seg->key.ptr, seg->key.len, json->tok.ptr, json->tok.len, 0) == 0;
+
+		case MIO_JSON_PATH_SEG_INDEX:
+			return ss->state == MIO_JSON_STATE_IN_ARRAY && seg->index == ss->index;
+	}
+
 	return 0;
 }
 
+static int query_value (mio_json_t* json, mio_ooci_t c)
+{
+	/* called at the first character of a value in the query mode.
+	 * it returns 1 if the value has to be skipped and 0 otherwise. */
+	mio_json_state_node_t* ss;
+	mio_oow_t mask, level, i;
+
+	if (c != '\"' && c != '[' && c != '{' && c != '+' && c != '-' && !mio_is_ooch_digit(c) && !mio_is_ooch_alpha(c))
+	{
+		/* let the caller handle an invalid character */
+		return 0;
+	}
+
+	ss = json->state_stack;
+	level = ss->level;
+
+	if (ss->state == MIO_JSON_STATE_START)
+	{
+		mask = (json->query.len >= MIO_SIZEOF(mio_oow_t) * 8)? ~(mio_oow_t)0: (((mio_oow_t)1 << json->query.len) - 1);
+	}
+	else
+	{
+		/* the paths in ss->qmask have matched down to this container and 
+		 * have at least 'level' segments */
+		mask = 0;
+		for (i = 0; i < json->query.len; i++)
+		{
+			mio_oow_t bit = (mio_oow_t)1 << i;
+			if ((ss->qmask & bit) && match_path_seg(json, &json->query.ptr[i]->seg[level - 1], ss)) mask |= bit;
+		}
+	}
+
+	for (i = 0; i < json->query.len; i++)
+	{
+		if ((mask & ((mio_oow_t)1 << i)) && json->query.ptr[i]->nsegs == level)
+		{
+			/* the value is on this path. report everything in it */
+			json->query.hit = 1;
+			json->query.hit_level = level;
+			json->query.hit_path = i;
+			return 0;
+		}
+	}
+
+	if (mask && (c == '[' || c == '{'))
+	{
+		/* some paths go deeper into this container */
+		json->query.next_qmask = mask;
+		return 0;
+	}
+
+	/* no path goes through this value. skip it. c is already consumed */
+	json->query.skip.active = 1;
+	json->query.skip.depth = (c == '[' || c == '{');
+	json->query.skip.in_str = (c == '\"');
+	json->query.skip.scalar = !json->query.skip.depth && !json->query.skip.in_str;
+	json->query.skip.escaped = 0;
+	json->query.skip.in_comment = 0;
+	return 1;
+}
+
+static void finish_skipped_value (mio_json_t* json)
+{
+	/* update the container as if the skipped value has been processed. 
+	 * see pop_read_state() and invoke_data_inst() */
+	mio_json_state_node_t* ss = json->state_stack;
+
+	json->query.skip.active = 0;
+
+	if (ss->state == MIO_JSON_STATE_IN_ARRAY) ss->u.ia.got_value = 1;
+	else if (ss->state == MIO_JSON_STATE_IN_OBJECT) ss->u.io.state++;
+
+	if (ss->state != MIO_JSON_STATE_IN_OBJECT || ss->u.io.state == 3) ss->index++;
+}
+
 static int handle_string_value_char (mio_json_t* json, mio_ooci_t c)
 {
 	int ret = 1;
@@ -479,6 +641,10 @@ static int handle_start_char (mio_json_t* json, mio_ooci_t c)
 		json->state_stack->in_comment = 1;
 		return 1;
 	}
+	else if (json->query.len > 0 && !json->query.hit && query_value(json, c))
+	{
+		return 1;
+	}
 	else if (c == '\"')
 	{
 		if (push_read_state(json, MIO_JSON_STATE_IN_STRING_VALUE) <= -1) return -1;
@@ -559,7 +725,11 @@ static int handle_char_in_array (mio_json_t* json, mio_ooci_t c)
 			}
 		}
 
-		if (c == '\"')
+		if (json->query.len > 0 && !json->query.hit && query_value(json, c))
+		{
+			return 1;
+		}
+		else if (c == '\"')
 		{
 			if (push_read_state(json, MIO_JSON_STATE_IN_STRING_VALUE) <= -1) return -1;
 			clear_token (json);
@@ -661,7 +831,12 @@ static int handle_char_in_object (mio_json_t* json, mio_ooci_t c)
 			}
 		}
 
-		if (c == '\"')
+		if (json->state_stack->u.io.state == 2 && json->query.len > 0 && !json->query.hit && query_value(json, c))
+		{
+			/* skipping a value after a colon. a key is never skipped */
+			return 1;
+		}
+		else if (c == '\"')
 		{
 			if (push_read_state(json, MIO_JSON_STATE_IN_STRING_VALUE) <= -1) return -1;
 			clear_token (json);
@@ -758,6 +933,202 @@ start_over:
 
 /* ========================================================================= */
 
+/* return the length of the leading run of bytes that can be consumed in bulk
+ * inside a string or a comment. the run stops at a double quote, a backslash
+ * and a new line. in the wide character mode, it also stops at a non-ASCII
+ * byte which must go through the character set conversion. */
+static MIO_INLINE mio_oow_t scan_plain_bchars (const mio_bch_t* ptr, mio_oow_t len)
+{
+	mio_oow_t i = 0;
+
+#if defined(USE_SSE2_SCAN)
+	const __m128i dq = _mm_set1_epi8('\"');
+	const __m128i bs = _mm_set1_epi8('\\');
+	const __m128i nl = _mm_set1_epi8(MIO_EOL);
+
+	while (len - i >= 16)
+	{
+		__m128i v;
+		int mask;
+
+		v = _mm_loadu_si128((const __m128i*)(ptr + i));
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, bs)), _mm_cmpeq_epi8(v, nl)));
+	#if defined(MIO_OOCH_IS_UCH)
+		mask |= _mm_movemask_epi8(v); /* the high bit of each byte */
+	#endif
+		if (mask) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < len)
+	{
+		mio_bcu_t b = ptr[i];
+		if (b == '\"' || b == '\\' || b == MIO_EOL) break;
+	#if defined(MIO_OOCH_IS_UCH)
+		if (b >= 0x80) break;
+	#endif
+		i++;
+	}
+
+	return i;
+}
+
+/* return the length of the leading run of bytes that can't change the
+ * nesting depth of a value being skipped */
+static MIO_INLINE mio_oow_t scan_unstructured_bchars (const mio_bch_t* ptr, mio_oow_t len)
+{
+	mio_oow_t i = 0;
+
+#if defined(USE_SSE2_SCAN)
+	const __m128i dq = _mm_set1_epi8('\"');
+	const __m128i nl = _mm_set1_epi8(MIO_EOL);
+	const __m128i hs = _mm_set1_epi8('#');
+	const __m128i m20 = _mm_set1_epi8(0x20);
+	const __m128i lb = _mm_set1_epi8('{'); /* '[' | 0x20 */
+	const __m128i rb = _mm_set1_epi8('}'); /* ']' | 0x20 */
+
+	while (len - i >= 16)
+	{
+		__m128i v, f;
+		int mask;
+
+		v = _mm_loadu_si128((const __m128i*)(ptr + i));
+		f = _mm_or_si128(v, m20); /* fold [ ] onto { } */
+		mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, nl)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, hs), _mm_or_si128(_mm_cmpeq_epi8(f, lb), _mm_cmpeq_epi8(f, rb)))));
+		mask |= _mm_movemask_epi8(v);
+		if (mask) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < len)
+	{
+		mio_bcu_t b = ptr[i];
+		if (b == '\"' || b == MIO_EOL || b == '#' || b == '[' || b == ']' || b == '{' || b == '}' || b >= 0x80) break;
+		i++;
+	}
+
+	return i;
+}
+
+static MIO_INLINE int is_bch_blank (mio_bch_t b)
+{
+	return b == ' ' || b == '\t' || b == '\r';
+}
+
+static MIO_INLINE void count_skipped_bch (mio_json_t* json, mio_bcu_t b)
+{
+	if (b == MIO_EOL)
+	{
+		json->c_col = 0;
+		json->c_line++;
+	}
+#if defined(MIO_OOCH_IS_UCH)
+	else if ((b & 0xC0) != 0x80) json->c_col++; /* don't count utf8 continuation bytes */
+#else
+	else json->c_col++;
+#endif
+}
+
+static mio_oow_t skip_value_bchars (mio_json_t* json, const mio_bch_t* ptr, mio_oow_t len)
+{
+	/* skip over the rest of a value that no registered path goes through.
+	 * it only counts brackets without building tokens. it returns the number
+	 * of bytes consumed and clears json->query.skip.active when the value
+	 * has ended. */
+	mio_oow_t i = 0;
+
+	while (i < len)
+	{
+		mio_bcu_t b = ptr[i];
+
+		if (json->query.skip.in_str)
+		{
+			if (!json->query.skip.escaped)
+			{
+				mio_oow_t n;
+				n = scan_plain_bchars(&ptr[i], len - i);
+				if (n > 0)
+				{
+					json->c_col += n;
+					i += n;
+					continue;
+				}
+			}
+
+			count_skipped_bch (json, b);
+			i++;
+
+			if (json->query.skip.escaped) json->query.skip.escaped = 0;
+			else if (b == '\\') json->query.skip.escaped = 1;
+			else if (b == '\"')
+			{
+				json->query.skip.in_str = 0;
+				if (json->query.skip.depth <= 0) goto done;
+			}
+		}
+		else if (json->query.skip.in_comment)
+		{
+			count_skipped_bch (json, b);
+			i++;
+			if (b == MIO_EOL) json->query.skip.in_comment = 0;
+		}
+		else if (json->query.skip.scalar)
+		{
+			/* a number or a word ends at the first character not belonging to it.
+			 * leave the character to the normal path */
+			if (!mio_is_bch_alnum(b) && b != '+' && b != '-' && b != '.' && b != '_') goto done;
+			json->c_col++;
+			i++;
+		}
+		else
+		{
+			mio_oow_t n;
+
+			n = scan_unstructured_bchars(&ptr[i], len - i);
+			if (n > 0)
+			{
+				json->c_col += n;
+				i += n;
+				continue;
+			}
+
+			count_skipped_bch (json, b);
+			i++;
+
+			switch (b)
+			{
+				case '\"':
+					json->query.skip.in_str = 1;
+					break;
+
+				case '[':
+				case '{':
+					json->query.skip.depth++;
+					break;
+
+				case ']':
+				case '}':
+					if (--json->query.skip.depth <= 0) goto done;
+					break;
+
+				case '#':
+					if (json->option & MIO_JSON_LINE_COMMENT) json->query.skip.in_comment = 1;
+					break;
+			}
+		}
+	}
+
+	return i;
+
+done:
+	finish_skipped_value (json);
+	return i;
+}
+
 static int feed_json_data (mio_json_t* json, const mio_bch_t* data, mio_oow_t len, mio_oow_t* xlen, int stop_if_ever_completed)
 {
 	const mio_bch_t* ptr;
@@ -771,13 +1142,56 @@ static int feed_json_data (mio_json_t* json, const mio_bch_t* data, mio_oow_t le
 	{
 		mio_ooci_t c;
 		const mio_bch_t* optr;
-
 	#if defined(MIO_OOCH_IS_UCH)
 		mio_ooch_t uc;
 		mio_oow_t bcslen;
 		mio_oow_t n;
+	#endif
+
+		if (json->query.skip.active)
+		{
+			ptr += skip_value_bchars(json, ptr, end - ptr);
+			if (json->query.skip.active) break; /* more to skip in the next feed */
+			if (json->state_stack->state == MIO_JSON_STATE_START) ever_completed = 1;
+			continue;
+		}
+
+		/* consume a run of plain string characters, comment text, or blanks
+		 * between tokens in bulk before falling back to the character-wise
+		 * state machine below. a new line is always left to the slow path
+		 * for line counting. */
+		if (json->state_stack->in_comment || 
+		    (json->state_stack->state == MIO_JSON_STATE_IN_STRING_VALUE && json->state_stack->u.sv.escaped == 0))
+		{
+			mio_oow_t n;
+
+			n = scan_plain_bchars(ptr, end - ptr);
+			if (n > 0)
+			{
+				if (!json->state_stack->in_comment && add_plain_bchars_to_token(json, ptr, n) <= -1) goto oops;
+				json->c_col += n;
+				ptr += n;
+				if (ptr >= end) break;
+			}
+		}
+		else if (json->state_stack->state <= MIO_JSON_STATE_IN_OBJECT && is_bch_blank(*ptr))
+		{
+			/* MIO_JSON_STATE_START, MIO_JSON_STATE_IN_ARRAY, MIO_JSON_STATE_IN_OBJECT */
+			optr = ptr;
+			do { ptr++; } while (ptr < end && is_bch_blank(*ptr));
+			json->c_col += ptr - optr;
+			if (ptr >= end) break;
+		}
 
+	#if defined(MIO_OOCH_IS_UCH)
 		optr = ptr;
+		if ((mio_bcu_t)*ptr < 0x80)
+		{
+			/* no conversion for an ASCII character */
+			c = (mio_bcu_t)*ptr++;
+			goto got_char;
+		}
+
 		bcslen = end - ptr;
 		n = json->mio->_cmgr->bctouc(ptr, bcslen, &uc);
 		if (n == 0)
@@ -795,6 +1209,7 @@ static int feed_json_data (mio_json_t* json, const mio_bch_t* data, mio_oow_t le
 
 		ptr += n;
 		c = uc;
+	got_char:
 	#else
 		optr = ptr;
 		c = *ptr++;
@@ -891,6 +1306,14 @@ int mio_json_init (mio_json_t* json, mio_t* mio)
 void mio_json_fini (mio_json_t* json)
 {
 	pop_all_read_states (json);
+	free_read_states (json);
+	mio_json_clearpaths (json);
+	if (json->query.ptr)
+	{
+		mio_freemem (json->mio, json->query.ptr);
+		json->query.ptr = MIO_NULL;
+		json->query.capa = 0;
+	}
 	if (json->tok.ptr) 
 	{
 		mio_freemem (json->mio, json->tok.ptr);
@@ -925,6 +1348,8 @@ void mio_json_resetstates (mio_json_t* json)
 	pop_all_read_states (json);
 	MIO_ASSERT (json->mio, json->state_stack == &json->state_top);
 	json->state_stack->state = MIO_JSON_STATE_START;
+	json->query.hit = 0;
+	json->query.skip.active = 0;
 }
 
 void mio_json_resetfeedloc (mio_json_t* json)
@@ -933,6 +1358,152 @@ void mio_json_resetfeedloc (mio_json_t* json)
 	json->c_col = 0;
 }
 
+static int parse_path (mio_json_t* json, const mio_bch_t* bpath, mio_json_path_t* path)
+{
+	/* path->str holds the converted path. fill path->seg with the segments */
+	mio_ooch_t* p = path->str;
+
+	if (*p != '$') goto oops;
+	p++;
+
+	path->nsegs = 0;
+	while (*p != '\0')
+	{
+		mio_json_path_seg_t* seg = &path->seg[path->nsegs];
+
+		if (*p == '.')
+		{
+			p++;
+			if (*p == '*')
+			{
+				seg->type = MIO_JSON_PATH_SEG_ANY;
+				p++;
+			}
+			else
+			{
+				seg->type = MIO_JSON_PATH_SEG_KEY;
+				seg->key.ptr = p;
+				while (*p != '\0' && *p != '.' && *p != '[') p++;
+				seg->key.len = p - seg->key.ptr;
+				if (seg->key.len <= 0) goto oops;
+			}
+		}
+		else if (*p == '[')
+		{
+			p++;
+			if (*p == '*')
+			{
+				seg->type = MIO_JSON_PATH_SEG_ANY;
+				p++;
+			}
+			else if (*p == '\"' || *p == '\'')
+			{
+				mio_ooch_t q = *p++;
+				seg->type = MIO_JSON_PATH_SEG_KEY;
+				seg->key.ptr = p;
+				while (*p != '\0' && *p != q) p++;
+				if (*p != q) goto oops;
+				seg->key.len = p - seg->key.ptr;
+				p++;
+			}
+			else if (mio_is_ooch_digit(*p))
+			{
+				seg->type = MIO_JSON_PATH_SEG_INDEX;
+				seg->index = 0;
+				do { seg->index = seg->index * 10 + (*p - '0'); p++; } while (mio_is_ooch_digit(*p));
+			}
+			else goto oops;
+
+			if (*p != ']') goto oops;
+			p++;
+		}
+		else goto oops;
+
+		path->nsegs++;
+	}
+
+	return 0;
+
+oops:
+	mio_seterrbfmt (json->mio, MIO_EINVAL, "invalid json path - %hs", bpath);
+	return -1;
+}
+
+int mio_json_addpath (mio_json_t* json, const mio_bch_t* path)
+{
+	mio_json_path_t* jp;
+	mio_ooch_t* str;
+	mio_oow_t maxsegs;
+	const mio_bch_t* p;
+
+	if (json->query.len >= MIO_SIZEOF(mio_oow_t) * 8)
+	{
+		mio_seterrbfmt (json->mio, MIO_EBUFFULL, "too many json paths");
+		return -1;
+	}
+
+	if (json->query.len >= json->query.capa)
+	{
+		mio_json_path_t** tmp;
+		mio_oow_t newcapa;
+
+		newcapa = MIO_ALIGN_POW2(json->query.len + 1, 8);
+		tmp = (mio_json_path_t**)mio_reallocmem(json->mio, json->query.ptr, newcapa * MIO_SIZEOF(*tmp));
+		if (MIO_UNLIKELY(!tmp)) return -1;
+
+		json->query.ptr = tmp;
+		json->query.capa = newcapa;
+	}
+
+	/* each segment begins with . or [ */
+	for (maxsegs = 0, p = path; *p != '\0'; p++) 
+	{
+		if (*p == '.' || *p == '[') maxsegs++;
+	}
+
+#if defined(MIO_OOCH_IS_UCH)
+	str = mio_dupbtoucstr(json->mio, path, MIO_NULL, 1);
+#else
+	str = mio_dupbcstr(json->mio, path, MIO_NULL);
+#endif
+	if (MIO_UNLIKELY(!str)) return -1;
+
+	jp = (mio_json_path_t*)mio_allocmem(json->mio, MIO_SIZEOF(*jp) + maxsegs * MIO_SIZEOF(jp->seg[0]));
+	if (MIO_UNLIKELY(!jp))
+	{
+		mio_freemem (json->mio, str);
+		return -1;
+	}
+
+	jp->str = str;
+	if (parse_path(json, path, jp) <= -1)
+	{
+		mio_freemem (json->mio, str);
+		mio_freemem (json->mio, jp);
+		return -1;
+	}
+
+	json->query.ptr[json->query.len] = jp;
+	return (int)json->query.len++;
+}
+
+void mio_json_clearpaths (mio_json_t* json)
+{
+	while (json->query.len > 0)
+	{
+		mio_json_path_t* jp = json->query.ptr[--json->query.len];
+		mio_freemem (json->mio, jp->str);
+		mio_freemem (json->mio, jp);
+	}
+	json->query.hit = 0;
+	json->query.skip.active = 0;
+}
+
+int mio_json_getpathmatch (mio_json_t* json)
+{
+	return (json->query.len > 0 && json->query.hit)? (int)json->query.hit_path: -1;
+}
+
 int mio_json_feed (mio_json_t* json, const void* ptr, mio_oow_t len, mio_oow_t* rem, int stop_if_ever_completed)
 {
 	int x;
@@ -962,20 +1533,544 @@ int mio_json_feed (mio_json_t* json, const void* ptr, mio_oow_t len, mio_oow_t*
 
 /* ========================================================================= */
 
-static int push_write_state (mio_jsonwr_t* jsonwr, mio_json_state_t state)
+/* return the length of the leading run of bytes inside a string that
+ * don't need decoding. the run stops at a double quote and a backslash */
+static MIO_INLINE mio_oow_t scan_raw_string_bchars (const mio_bch_t* ptr, mio_oow_t len)
 {
-	mio_jsonwr_state_node_t* ss;
+	mio_oow_t i = 0;
 
-	ss = (mio_jsonwr_state_node_t*)mio_callocmem(jsonwr->mio, MIO_SIZEOF(*ss));
-	if (MIO_UNLIKELY(!ss)) return -1;
+#if defined(USE_SSE2_SCAN)
+	const __m128i dq = _mm_set1_epi8('\"');
+	const __m128i bs = _mm_set1_epi8('\\');
 
-	ss->state = state;
-	ss->level = jsonwr->state_stack->level; /* copy from the parent */
-	ss->next = jsonwr->state_stack;
+	while (len - i >= 16)
+	{
+		__m128i v;
+		int mask;
 
-	jsonwr->state_stack = ss;
-	return 0;
-}
+		v = _mm_loadu_si128((const __m128i*)(ptr + i));
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, bs)));
+		if (mask) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < len && ptr[i] != '\"' && ptr[i] != '\\') i++;
+	return i;
+}
+
+/* count the characters that can precede a value or a key. the number of 
+ * nodes in a document can't exceed this count plus 1 for the root. the
+ * characters inside strings are counted too as it is only an upper bound */
+static mio_oow_t count_node_introducers (const mio_bch_t* ptr, mio_oow_t len)
+{
+	mio_oow_t i = 0, count = 0;
+
+#if defined(USE_SSE2_SCAN)
+	const __m128i cm = _mm_set1_epi8(',');
+	const __m128i cl = _mm_set1_epi8(':');
+	const __m128i m20 = _mm_set1_epi8(0x20);
+	const __m128i lb = _mm_set1_epi8('{'); /* '[' | 0x20 */
+
+	while (len - i >= 16)
+	{
+		__m128i v;
+		int mask;
+
+		v = _mm_loadu_si128((const __m128i*)(ptr + i));
+		mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, cm), _mm_cmpeq_epi8(v, cl)),
+			_mm_cmpeq_epi8(_mm_or_si128(v, m20), lb)));
+		count += __builtin_popcount(mask);
+		i += 16;
+	}
+#endif
+
+	for (; i < len; i++)
+	{
+		mio_bch_t b = ptr[i];
+		if (b == ',' || b == ':' || b == '[' || b == '{') count++;
+	}
+
+	return count;
+}
+
+static MIO_INLINE int is_json_ws (mio_bch_t b)
+{
+	return b == ' ' || b == '\t' || b == '\r' || b == '\n';
+}
+
+static MIO_INLINE int hex_to_int (mio_bch_t b)
+{
+	if (b >= '0' && b <= '9') return b - '0';
+	if (b >= 'a' && b <= 'f') return b - 'a' + 10;
+	if (b >= 'A' && b <= 'F') return b - 'A' + 10;
+	return -1;
+}
+
+static mio_oow_t encode_utf8 (mio_uint32_t uc, mio_bch_t* buf)
+{
+	if (uc < 0x80)
+	{
+		buf[0] = uc;
+		return 1;
+	}
+	else if (uc < 0x800)
+	{
+		buf[0] = 0xC0 | (uc >> 6);
+		buf[1] = 0x80 | (uc & 0x3F);
+		return 2;
+	}
+	else if (uc < 0x10000)
+	{
+		buf[0] = 0xE0 | (uc >> 12);
+		buf[1] = 0x80 | ((uc >> 6) & 0x3F);
+		buf[2] = 0x80 | (uc & 0x3F);
+		return 3;
+	}
+	else
+	{
+		buf[0] = 0xF0 | (uc >> 18);
+		buf[1] = 0x80 | ((uc >> 12) & 0x3F);
+		buf[2] = 0x80 | ((uc >> 6) & 0x3F);
+		buf[3] = 0x80 | (uc & 0x3F);
+		return 4;
+	}
+}
+
+typedef struct doc_parser_t doc_parser_t;
+struct doc_parser_t
+{
+	mio_t* mio;
+	const mio_bch_t* start;
+	const mio_bch_t* ptr;
+	const mio_bch_t* end;
+
+	mio_json_node_t* node; /* node area */
+	mio_oow_t nnodes;
+	mio_oow_t maxnodes;
+	mio_json_node_t** item; /* item pointer area. bumped when a container is closed */
+	mio_json_node_t** stack; /* children of open containers */
+	mio_oow_t sp;
+	mio_bch_t* sbuf; /* decoded strings */
+};
+
+static void set_doc_error (doc_parser_t* dp, const char* msg)
+{
+	const mio_bch_t* p;
+	mio_oow_t line = 1, col = 1;
+
+	/* compute the location only on error */
+	for (p = dp->start; p < dp->ptr; p++)
+	{
+		if (*p == '\n') { line++; col = 1; }
+		else col++;
+	}
+
+	mio_seterrbfmt (dp->mio, MIO_EINVAL, "%hs at %zu:%zu", msg, line, col);
+}
+
+static int parse_doc_string (doc_parser_t* dp, mio_bcs_t* str)
+{
+	const mio_bch_t* p = dp->ptr + 1; /* skip the opening quote */
+	const mio_bch_t* esc;
+	mio_bch_t* out;
+	mio_oow_t n;
+
+	n = scan_raw_string_bchars(p, dp->end - p);
+	if (p + n < dp->end && p[n] == '\"')
+	{
+		/* no escape sequence. refer to the input */
+		str->ptr = (mio_bch_t*)p;
+		str->len = n;
+		dp->ptr = p + n + 1;
+		return 0;
+	}
+
+	/* the decoded string is never longer than its source */
+	out = dp->sbuf;
+	str->ptr = out;
+	while (1)
+	{
+		MIO_MEMCPY (out, p, n);
+		out += n;
+		p += n;
+
+		if (p >= dp->end) goto unterminated;
+		if (*p == '\"') break;
+
+		/* backslash */
+		esc = p;
+		if (++p >= dp->end) goto unterminated;
+		switch (*p++)
+		{
+			case '\"': *out++ = '\"'; break;
+			case '\\': *out++ = '\\'; break;
+			case '/': *out++ = '/'; break;
+			case 'b': *out++ = '\b'; break;
+			case 'f': *out++ = '\f'; break;
+			case 'n': *out++ = '\n'; break;
+			case 'r': *out++ = '\r'; break;
+			case 't': *out++ = '\t'; break;
+
+			case 'u':
+			{
+				mio_uint32_t uc = 0;
+				int i, d;
+
+				if (dp->end - p < 4) goto unterminated;
+				for (i = 0; i < 4; i++)
+				{
+					if ((d = hex_to_int(p[i])) <= -1) goto bad_escape;
+					uc = uc * 16 + d;
+				}
+				p += 4;
+
+				if (uc >= 0xD800 && uc <= 0xDBFF && dp->end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+				{
+					/* combine a surrogate pair */
+					mio_uint32_t lc = 0;
+					for (i = 2; i < 6; i++)
+					{
+						if ((d = hex_to_int(p[i])) <= -1) goto bad_escape;
+						lc = lc * 16 + d;
+					}
+					if (lc >= 0xDC00 && lc <= 0xDFFF)
+					{
+						uc = (((uc - 0xD800) << 10) | (lc - 0xDC00)) + 0x10000;
+						p += 6;
+					}
+				}
+
+				out += encode_utf8(uc, out);
+				break;
+			}
+
+			default:
+				goto bad_escape;
+		}
+
+		n = scan_raw_string_bchars(p, dp->end - p);
+	}
+
+	str->len = out - str->ptr;
+	dp->sbuf = out;
+	dp->ptr = p + 1;
+	return 0;
+
+unterminated:
+	dp->ptr = p;
+	set_doc_error (dp, "unterminated string");
+	return -1;
+
+bad_escape:
+	dp->ptr = esc; /* point to the backslash */
+	set_doc_error (dp, "invalid escape sequence");
+	return -1;
+}
+
+static int parse_doc_number (doc_parser_t* dp, mio_bcs_t* str)
+{
+	const mio_bch_t* p = dp->ptr;
+	const mio_bch_t* end = dp->end;
+
+	if (p < end && *p == '-') p++;
+	if (p >= end || !mio_is_bch_digit(*p)) goto oops;
+	if (*p == '0') p++;
+	else while (p < end && mio_is_bch_digit(*p)) p++;
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		if (p >= end || !mio_is_bch_digit(*p)) goto oops;
+		while (p < end && mio_is_bch_digit(*p)) p++;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		if (p < end && (*p == '+' || *p == '-')) p++;
+		if (p >= end || !mio_is_bch_digit(*p)) goto oops;
+		while (p < end && mio_is_bch_digit(*p)) p++;
+	}
+
+	str->ptr = (mio_bch_t*)dp->ptr;
+	str->len = p - dp->ptr;
+	dp->ptr = p;
+	return 0;
+
+oops:
+	dp->ptr = p;
+	set_doc_error (dp, "invalid numeric value");
+	return -1;
+}
+
+static int parse_doc_word (doc_parser_t* dp, mio_json_node_t* node)
+{
+	mio_oow_t rem = dp->end - dp->ptr;
+
+	if (rem >= 4 && MIO_MEMCMP(dp->ptr, "null", 4) == 0) { node->type = MIO_JSON_NODE_NIL; dp->ptr += 4; }
+	else if (rem >= 4 && MIO_MEMCMP(dp->ptr, "true", 4) == 0) { node->type = MIO_JSON_NODE_TRUE; dp->ptr += 4; }
+	else if (rem >= 5 && MIO_MEMCMP(dp->ptr, "false", 5) == 0) { node->type = MIO_JSON_NODE_FALSE; dp->ptr += 5; }
+	else
+	{
+		set_doc_error (dp, "invalid word value");
+		return -1;
+	}
+
+	if (dp->ptr < dp->end && mio_is_bch_alnum(*dp->ptr))
+	{
+		set_doc_error (dp, "invalid word value");
+		return -1;
+	}
+
+	return 0;
+}
+
+static MIO_INLINE void skip_doc_ws (doc_parser_t* dp)
+{
+	while (dp->ptr < dp->end && is_json_ws(*dp->ptr)) dp->ptr++;
+}
+
+static MIO_INLINE mio_json_node_t* new_doc_node (doc_parser_t* dp, mio_json_node_t* parent)
+{
+	mio_json_node_t* node;
+
+	/* count_node_introducers() guarantees enough nodes for a valid document.
+	 * an invalid document may fail here before a syntax error is found */
+	if (dp->nnodes >= dp->maxnodes) return MIO_NULL;
+
+	node = &dp->node[dp->nnodes++];
+	node->parent = parent;
+	if (parent) dp->stack[dp->sp++] = node;
+	return node;
+}
+
+static int parse_doc (doc_parser_t* dp, mio_json_node_t** root)
+{
+	mio_json_node_t* cur = MIO_NULL; /* innermost open container */
+	mio_json_node_t* node;
+
+	skip_doc_ws (dp);
+
+value:
+	node = new_doc_node(dp, cur);
+	if (MIO_UNLIKELY(!node)) goto too_many;
+	if (!cur) *root = node;
+
+	if (dp->ptr >= dp->end)
+	{
+		set_doc_error (dp, "unexpected end of data");
+		return -1;
+	}
+
+	switch (*dp->ptr)
+	{
+		case '[':
+		case '{':
+			node->type = (*dp->ptr == '[')? MIO_JSON_NODE_ARRAY: MIO_JSON_NODE_OBJECT;
+			node->u.c.count = dp->sp; /* remember where the children begin in the stack */
+			cur = node;
+			dp->ptr++;
+			skip_doc_ws (dp);
+			if (dp->ptr < dp->end && *dp->ptr == ((cur->type == MIO_JSON_NODE_ARRAY)? ']': '}')) goto close;
+			if (cur->type == MIO_JSON_NODE_OBJECT) goto key;
+			goto value;
+
+		case '\"':
+			node->type = MIO_JSON_NODE_STRING;
+			if (parse_doc_string(dp, &node->u.str) <= -1) return -1;
+			break;
+
+		case '-': case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			node->type = MIO_JSON_NODE_NUMBER;
+			if (parse_doc_number(dp, &node->u.str) <= -1) return -1;
+			break;
+
+		default:
+			if (parse_doc_word(dp, node) <= -1) return -1;
+			break;
+	}
+
+next:
+	skip_doc_ws (dp);
+	if (!cur)
+	{
+		if (dp->ptr < dp->end)
+		{
+			set_doc_error (dp, "trailing data");
+			return -1;
+		}
+		return 0;
+	}
+
+	if (dp->ptr >= dp->end)
+	{
+		set_doc_error (dp, "unexpected end of data");
+		return -1;
+	}
+
+	if (*dp->ptr == ',')
+	{
+		dp->ptr++;
+		skip_doc_ws (dp);
+		if (cur->type == MIO_JSON_NODE_OBJECT) goto key;
+		goto value;
+	}
+	else if (*dp->ptr == ((cur->type == MIO_JSON_NODE_ARRAY)? ']': '}'))
+	{
+		mio_oow_t base, n;
+
+	close:
+		/* move the children from the stack to the item area */
+		base = cur->u.c.count;
+		n = dp->sp - base;
+		cur->u.c.item = dp->item;
+		MIO_MEMCPY (dp->item, &dp->stack[base], n * MIO_SIZEOF(*dp->item));
+		dp->item += n;
+		dp->sp = base;
+		cur->u.c.count = (cur->type == MIO_JSON_NODE_OBJECT)? (n / 2): n;
+
+		dp->ptr++;
+		cur = cur->parent;
+		goto next;
+	}
+	else
+	{
+		set_doc_error (dp, (cur->type == MIO_JSON_NODE_ARRAY)? "comma or ] expected in array": "comma or } expected in object");
+		return -1;
+	}
+
+key:
+	if (dp->ptr >= dp->end || *dp->ptr != '\"')
+	{
+		set_doc_error (dp, "object key not a string");
+		return -1;
+	}
+
+	node = new_doc_node(dp, cur);
+	if (MIO_UNLIKELY(!node)) goto too_many;
+	node->type = MIO_JSON_NODE_STRING;
+	if (parse_doc_string(dp, &node->u.str) <= -1) return -1;
+
+	skip_doc_ws (dp);
+	if (dp->ptr >= dp->end || *dp->ptr != ':')
+	{
+		set_doc_error (dp, "colon required in object");
+		return -1;
+	}
+	dp->ptr++;
+	skip_doc_ws (dp);
+	goto value;
+
+too_many:
+	set_doc_error (dp, "invalid json text");
+	return -1;
+}
+
+mio_json_doc_t* mio_json_parsedoc (mio_t* mio, const mio_bch_t* ptr, mio_oow_t len)
+{
+	mio_json_doc_t* doc;
+	doc_parser_t dp;
+	mio_oow_t maxnodes;
+
+	/* lay out everything in a single block.
+	 *   doc | nodes | item pointers | stack | decoded strings 
+	 * the number of item pointers and the stack depth never exceed 
+	 * the number of nodes. */
+	maxnodes = count_node_introducers(ptr, len) + 1;
+	doc = (mio_json_doc_t*)mio_allocmem(mio, MIO_SIZEOF(*doc) + (maxnodes * (MIO_SIZEOF(mio_json_node_t) + MIO_SIZEOF(mio_json_node_t*) * 2)) + len);
+	if (MIO_UNLIKELY(!doc)) return MIO_NULL;
+
+	MIO_MEMSET (&dp, 0, MIO_SIZEOF(dp));
+	dp.mio = mio;
+	dp.start = ptr;
+	dp.ptr = ptr;
+	dp.end = ptr + len;
+	dp.node = (mio_json_node_t*)(doc + 1);
+	dp.maxnodes = maxnodes;
+	dp.item = (mio_json_node_t**)(dp.node + maxnodes);
+	dp.stack = dp.item + maxnodes;
+	dp.sbuf = (mio_bch_t*)(dp.stack + maxnodes);
+
+	doc->mio = mio;
+	doc->node = dp.node;
+	if (parse_doc(&dp, &doc->root) <= -1)
+	{
+		mio_freemem (mio, doc);
+		return MIO_NULL;
+	}
+	doc->nnodes = dp.nnodes;
+
+	return doc;
+}
+
+void mio_json_freedoc (mio_json_doc_t* doc)
+{
+	mio_freemem (doc->mio, doc);
+}
+
+mio_json_node_t* mio_json_getitem (const mio_json_node_t* node, mio_oow_t index)
+{
+	if (node->type == MIO_JSON_NODE_ARRAY)
+	{
+		return (index < node->u.c.count)? node->u.c.item[index]: MIO_NULL;
+	}
+	else if (node->type == MIO_JSON_NODE_OBJECT)
+	{
+		return (index < node->u.c.count)? node->u.c.item[index * 2 + 1]: MIO_NULL;
+	}
+
+	return MIO_NULL;
+}
+
+mio_json_node_t* mio_json_getkey (const mio_json_node_t* node, mio_oow_t index)
+{
+	if (node->type != MIO_JSON_NODE_OBJECT || index >= node->u.c.count) return MIO_NULL;
+	return node->u.c.item[index * 2];
+}
+
+mio_json_node_t* mio_json_findvalue (const mio_json_node_t* node, const mio_bch_t* key, mio_oow_t keylen)
+{
+	mio_oow_t i;
+
+	if (node->type != MIO_JSON_NODE_OBJECT) return MIO_NULL;
+
+	for (i = 0; i < node->u.c.count; i++)
+	{
+		const mio_bcs_t* k = &node->u.c.item[i * 2]->u.str;
+		if (k->len == keylen && MIO_MEMCMP(k->ptr, key, keylen) == 0) return node->u.c.item[i * 2 + 1];
+	}
+
+	return MIO_NULL;
+}
+
+/* ========================================================================= */
+
+static int push_write_state (mio_jsonwr_t* jsonwr, mio_json_state_t state)
+{
+	mio_jsonwr_state_node_t* ss;
+
+	if (jsonwr->state_free)
+	{
+		ss = jsonwr->state_free;
+		jsonwr->state_free = ss->next;
+		MIO_MEMSET (ss, 0, MIO_SIZEOF(*ss));
+	}
+	else
+	{
+		ss = (mio_jsonwr_state_node_t*)mio_callocmem(jsonwr->mio, MIO_SIZEOF(*ss));
+		if (MIO_UNLIKELY(!ss)) return -1;
+	}
+
+	ss->state = state;
+	ss->level = jsonwr->state_stack->level; /* copy from the parent */
+	ss->next = jsonwr->state_stack;
+
+	jsonwr->state_stack = ss;
+	return 0;
+}
 
 static void pop_write_state (mio_jsonwr_t* jsonwr)
 {
@@ -985,8 +2080,8 @@ static void pop_write_state (mio_jsonwr_t* jsonwr)
 	MIO_ASSERT (jsonwr->mio, ss != MIO_NULL && ss != &jsonwr->state_top);
 	jsonwr->state_stack = ss->next;
 
-/* TODO: don't free this. move it to the free list? */
-	mio_freemem (jsonwr->mio, ss);
+	ss->next = jsonwr->state_free;
+	jsonwr->state_free = ss;
 }
 
 static void pop_all_write_states (mio_jsonwr_t* jsonwr)
@@ -994,6 +2089,16 @@ static void pop_all_write_states (mio_jsonwr_t* jsonwr)
 	while (jsonwr->state_stack != &jsonwr->state_top) pop_write_state (jsonwr);
 }
 
+static void free_write_states (mio_jsonwr_t* jsonwr)
+{
+	while (jsonwr->state_free)
+	{
+		mio_jsonwr_state_node_t* ss = jsonwr->state_free;
+		jsonwr->state_free = ss->next;
+		mio_freemem (jsonwr->mio, ss);
+	}
+}
+
 mio_jsonwr_t* mio_jsonwr_open (mio_t* mio, mio_oow_t xtnsize, int flags)
 {
 	mio_jsonwr_t* jsonwr;
@@ -1044,7 +2149,16 @@ static int flush_wbuf (mio_jsonwr_t* jsonwr)
 {
 	int ret = 0;
 
-	if (jsonwr->writecb(jsonwr, jsonwr->wbuf, jsonwr->wbuf_len, jsonwr->wctx) <= -1) ret = -1;
+	if (jsonwr->writevcb)
+	{
+		if (jsonwr->iovcnt > 0 && jsonwr->writevcb(jsonwr, jsonwr->iov, jsonwr->iovcnt, jsonwr->wctx) <= -1) ret = -1;
+		jsonwr->iovcnt = 0;
+		jsonwr->iov_ext = 0;
+	}
+	else
+	{
+		if (jsonwr->writecb(jsonwr, jsonwr->wbuf, jsonwr->wbuf_len, jsonwr->wctx) <= -1) ret = -1;
+	}
 	jsonwr->wbuf_len = 0; /* reset the buffer length regardless of writing result */
 
 	return ret;
@@ -1052,8 +2166,9 @@ static int flush_wbuf (mio_jsonwr_t* jsonwr)
 
 void mio_jsonwr_fini (mio_jsonwr_t* jsonwr)
 {
-	if (jsonwr->wbuf_len > 0) flush_wbuf (jsonwr); /* don't care about actual write failure */
+	if (jsonwr->wbuf_len > 0 || jsonwr->iovcnt > 0) flush_wbuf (jsonwr); /* don't care about actual write failure */
 	pop_all_write_states (jsonwr);
+	free_write_states (jsonwr);
 }
 
 /* ========================================================================= */
@@ -1064,6 +2179,14 @@ void mio_jsonwr_setwritecb (mio_jsonwr_t* jsonwr, mio_jsonwr_writecb_t writecb,
 	jsonwr->wctx = ctx;
 }
 
+void mio_jsonwr_setwritevcb (mio_jsonwr_t* jsonwr, mio_jsonwr_writevcb_t writevcb, void* ctx)
+{
+	/* flush what's been buffered with the previous callback */
+	if (jsonwr->wbuf_len > 0 || jsonwr->iovcnt > 0) flush_wbuf (jsonwr);
+	jsonwr->writevcb = writevcb;
+	jsonwr->wctx = ctx;
+}
+
 static int escape_char (mio_uch_t uch, mio_uch_t* xch)
 {
 	int x = 1;
@@ -1075,10 +2198,6 @@ static int escape_char (mio_uch_t uch, mio_uch_t* xch)
 			*xch = uch;
 			break;
 
-		case '\a':
-			*xch = 'a';
-			break;
-
 		case '\b':
 			*xch = 'b';
 			break;
@@ -1099,11 +2218,8 @@ static int escape_char (mio_uch_t uch, mio_uch_t* xch)
 			*xch = 't';
 			break;
 
-		case '\v':
-			*xch = 'v';
-			break;
-
 		default:
+			/* json has no short form for \a and \v */
 			x = (uch >= 0 && uch <= 0x1f)? 2: 0;
 			break;
 	}
@@ -1111,22 +2227,63 @@ static int escape_char (mio_uch_t uch, mio_uch_t* xch)
 	return x;
 }
 
+/* a run of the caller's data at least this long is passed to writevcb
+ * without being copied to the buffer */
+#define JSONWR_DIRECT_MIN 512
+
+static const mio_bch_t hex_digits[] = "0123456789abcdef";
+
+static MIO_INLINE int can_extend_wbuf_iov (mio_jsonwr_t* jsonwr)
+{
+	/* check if the last segment ends at the current end of wbuf */
+	mio_iovec_t* last;
+
+	if (jsonwr->iovcnt <= 0) return 0;
+	last = &jsonwr->iov[jsonwr->iovcnt - 1];
+	return (mio_bch_t*)last->iov_ptr >= jsonwr->wbuf && 
+	       (mio_bch_t*)last->iov_ptr + last->iov_len == &jsonwr->wbuf[jsonwr->wbuf_len];
+}
+
+static MIO_INLINE void add_wbuf_iov (mio_jsonwr_t* jsonwr, mio_oow_t len)
+{
+	/* the data has been copied at the end of wbuf. wbuf_len is not updated yet */
+	if (can_extend_wbuf_iov(jsonwr))
+	{
+		jsonwr->iov[jsonwr->iovcnt - 1].iov_len += len;
+	}
+	else
+	{
+		MIO_ASSERT (jsonwr->mio, jsonwr->iovcnt < MIO_COUNTOF(jsonwr->iov));
+		jsonwr->iov[jsonwr->iovcnt].iov_ptr = &jsonwr->wbuf[jsonwr->wbuf_len];
+		jsonwr->iov[jsonwr->iovcnt].iov_len = len;
+		jsonwr->iovcnt++;
+	}
+}
+
 static int write_bytes_noesc (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_oow_t dlen)
 {
 	mio_oow_t rem;
 	do
 	{
+		if (jsonwr->writevcb && jsonwr->iovcnt >= MIO_COUNTOF(jsonwr->iov) && !can_extend_wbuf_iov(jsonwr))
+		{
+			/* no more segments available */
+			if (flush_wbuf(jsonwr) <= -1) return -1;
+		}
+
 		rem = MIO_COUNTOF(jsonwr->wbuf) - jsonwr->wbuf_len;
 
 		if (dlen <= rem) 
 		{
 			MIO_MEMCPY (&jsonwr->wbuf[jsonwr->wbuf_len], dptr, dlen);
+			if (jsonwr->writevcb) add_wbuf_iov (jsonwr, dlen);
 			jsonwr->wbuf_len += dlen;
 			if (dlen == rem && flush_wbuf(jsonwr) <= -1) return -1;
 			break;
 		}
 
 		MIO_MEMCPY (&jsonwr->wbuf[jsonwr->wbuf_len], dptr, rem);
+		if (jsonwr->writevcb) add_wbuf_iov (jsonwr, rem);
 		jsonwr->wbuf_len += rem;
 		dptr += rem;
 		dlen -= rem;
@@ -1137,36 +2294,98 @@ static int write_bytes_noesc (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_o
 	return 0;
 }
 
+static int write_bytes_direct (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_oow_t dlen)
+{
+	/* dptr must point to the caller's data that stays valid until the 
+	 * current write function returns. see FLUSH_IF_IOV_EXT() */
+	if (!jsonwr->writevcb || dlen < JSONWR_DIRECT_MIN) return write_bytes_noesc(jsonwr, dptr, dlen);
+
+	if (jsonwr->iovcnt >= MIO_COUNTOF(jsonwr->iov) && flush_wbuf(jsonwr) <= -1) return -1;
+	jsonwr->iov[jsonwr->iovcnt].iov_ptr = (void*)dptr;
+	jsonwr->iov[jsonwr->iovcnt].iov_len = dlen;
+	jsonwr->iovcnt++;
+	jsonwr->iov_ext = 1;
+	return 0;
+}
+
+/* return the length of the leading run of bytes that don't need escaping */
+static MIO_INLINE mio_oow_t scan_noesc_bchars (const mio_bch_t* ptr, mio_oow_t len)
+{
+	mio_oow_t i = 0;
+
+#if defined(USE_SSE2_SCAN)
+	const __m128i dq = _mm_set1_epi8('\"');
+	const __m128i bs = _mm_set1_epi8('\\');
+	const __m128i c1f = _mm_set1_epi8(0x1F);
+
+	while (len - i >= 16)
+	{
+		__m128i v;
+		int mask;
+
+		v = _mm_loadu_si128((const __m128i*)(ptr + i));
+		mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, bs)),
+			_mm_cmpeq_epi8(_mm_max_epu8(v, c1f), c1f))); /* v <= 0x1F */
+		if (mask) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < len)
+	{
+		mio_bcu_t b = ptr[i];
+		if (b == '\"' || b == '\\' || b <= 0x1F) break;
+		i++;
+	}
+
+	return i;
+}
+
+static MIO_INLINE mio_oow_t format_escape (mio_uch_t uch, mio_bch_t* buf)
+{
+	int e;
+	mio_uch_t ec;
+
+	e = escape_char(uch, &ec);
+	if (e <= 0) return 0;
+
+	buf[0] = '\\';
+	if (e == 1)
+	{
+		buf[1] = ec;
+		return 2;
+	}
+
+	buf[1] = 'u';
+	buf[2] = hex_digits[(uch >> 12) & 0xF];
+	buf[3] = hex_digits[(uch >> 8) & 0xF];
+	buf[4] = hex_digits[(uch >> 4) & 0xF];
+	buf[5] = hex_digits[uch & 0xF];
+	return 6;
+}
+
 static int write_bytes_esc (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_oow_t dlen)
 {
 	const mio_bch_t* dend = dptr + dlen;
 
 	while (dptr < dend)
 	{
-		int e;
-		mio_uch_t ec;
-		e = escape_char(*dptr, &ec);
-		if (e <= 0)
-		{
-			jsonwr->wbuf[jsonwr->wbuf_len++] = *dptr;
-			if (jsonwr->wbuf_len >= MIO_COUNTOF(jsonwr->wbuf) && flush_wbuf(jsonwr) <= -1) return -1;
-		}
-		else if (e == 1)
-		{
-			jsonwr->wbuf[jsonwr->wbuf_len++] = '\\';
-			if (jsonwr->wbuf_len >= MIO_COUNTOF(jsonwr->wbuf) && flush_wbuf(jsonwr) <= -1) return -1;
-			jsonwr->wbuf[jsonwr->wbuf_len++] = ec;
-			if (jsonwr->wbuf_len >= MIO_COUNTOF(jsonwr->wbuf) && flush_wbuf(jsonwr) <= -1) return -1;
-		}
-		else
+		mio_oow_t n;
+		mio_bch_t bcsbuf[6];
+
+		/* copy a clean run in one go */
+		n = scan_noesc_bchars(dptr, dend - dptr);
+		if (n > 0)
 		{
-			mio_bch_t bcsbuf[7];
-			bcsbuf[0] = '\\';
-			bcsbuf[1] = 'u';
-			mio_fmt_uintmax_to_bcstr(&bcsbuf[2], 5, *dptr, 10, 4, '0', MIO_NULL);
-			if (write_bytes_noesc(jsonwr, bcsbuf, 6) <= -1) return -1;
+			if (write_bytes_direct(jsonwr, dptr, n) <= -1) return -1;
+			dptr += n;
+			if (dptr >= dend) break;
 		}
 
+		n = format_escape((mio_bcu_t)*dptr, bcsbuf);
+		MIO_ASSERT (jsonwr->mio, n > 0);
+		if (write_bytes_noesc(jsonwr, bcsbuf, n) <= -1) return -1;
 		dptr++;
 	}
 
@@ -1185,23 +2404,8 @@ static int write_uchars (mio_jsonwr_t* jsonwr, int escape, const mio_uch_t* ptr,
 	{
 		if (escape)
 		{
-			int e;
-			mio_uch_t ec;
-			e = escape_char(*ptr, &ec);
-			if (e <= 0) goto no_escape;
-			else if (e == 1)
-			{
-				bcsbuf[0] = '\\';
-				bcsbuf[1] = ec;
-				n = 2;
-			}
-			else
-			{
-				bcsbuf[0] = '\\';
-				bcsbuf[1] = 'u';
-				mio_fmt_uintmax_to_bcstr(&bcsbuf[2], 5, *ptr, 10, 4, '0', MIO_NULL);
-				n = 6;
-			}
+			n = format_escape(*ptr, bcsbuf);
+			if (n <= 0) goto no_escape;
 		}
 		else
 		{
@@ -1223,8 +2427,12 @@ static int write_uchars (mio_jsonwr_t* jsonwr, int escape, const mio_uch_t* ptr,
 
 
 #define WRITE_BYTES_NOESC(jsonwr,dptr,dlen) do { if (write_bytes_noesc(jsonwr, dptr, dlen) <= -1) return -1; } while(0)
+#define WRITE_BYTES_DIRECT(jsonwr,dptr,dlen) do { if (write_bytes_direct(jsonwr, dptr, dlen) <= -1) return -1; } while(0)
 #define WRITE_BYTES_ESC(jsonwr,dptr,dlen) do { if (write_bytes_esc(jsonwr, dptr, dlen) <= -1) return -1; } while(0)
 
+/* pass the segments referring to the caller's data before returning to the caller */
+#define FLUSH_IF_IOV_EXT(jsonwr) do { if ((jsonwr)->iov_ext && flush_wbuf(jsonwr) <= -1) return -1; } while(0)
+
 #define WRITE_UCHARS(jsonwr,esc,dptr,dlen) do { if (write_uchars(jsonwr, esc, dptr, dlen) <= -1) return -1; } while(0)
 
 #define WRITE_LINE_BREAK(jsonwr) WRITE_BYTES_NOESC(jsonwr, "\n", 1)
@@ -1239,7 +2447,16 @@ static int write_uchars (mio_jsonwr_t* jsonwr, int escape, const mio_uch_t* ptr,
 	if ((jsonwr->flags & MIO_JSONWR_FLAG_PRETTY) && sn->state == MIO_JSON_STATE_IN_ARRAY) WRITE_INDENT (jsonwr); \
 } while(0)
 
-#define WRITE_INDENT(jsonwr) do { mio_oow_t i; for (i = 0; i < jsonwr->state_stack->level; i++) WRITE_BYTES_NOESC (jsonwr, "\t", 1); } while(0)
+#define WRITE_INDENT(jsonwr) do { \
+	mio_oow_t i, n; \
+	for (i = 0; i < jsonwr->state_stack->level; i += n) { \
+		n = jsonwr->state_stack->level - i; \
+		if (n > MIO_COUNTOF(indent_tabs) - 1) n = MIO_COUNTOF(indent_tabs) - 1; \
+		WRITE_BYTES_NOESC (jsonwr, indent_tabs, n); \
+	} \
+} while(0)
+
+static const mio_bch_t indent_tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
 
 int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars, const void* dptr, mio_oow_t dlen)
 {
@@ -1250,7 +2467,8 @@ int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars,
 		case MIO_JSON_INST_START_ARRAY:
 			if (sn->state != MIO_JSON_STATE_START && sn->state != MIO_JSON_STATE_IN_ARRAY &&
 			    !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val)) goto incompatible_inst;
-			if (sn->index > 0) WRITE_COMMA (jsonwr);
+			/* the comma for an object value has been written before the key */
+			if (sn->index > 0 && !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val)) WRITE_COMMA (jsonwr);
 			sn->index++;
 			if ((jsonwr->flags & MIO_JSONWR_FLAG_PRETTY) &&
 			    !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val))
@@ -1267,7 +2485,7 @@ int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars,
 		case MIO_JSON_INST_START_OBJECT:
 			if (sn->state != MIO_JSON_STATE_START && sn->state != MIO_JSON_STATE_IN_ARRAY &&
 			    !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val)) goto incompatible_inst; 
-			if (sn->index > 0) WRITE_COMMA (jsonwr);
+			if (sn->index > 0 && !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val)) WRITE_COMMA (jsonwr);
 			sn->index++;
 			if ((jsonwr->flags & MIO_JSONWR_FLAG_PRETTY) &&
 			    !(sn->state == MIO_JSON_STATE_IN_OBJECT && sn->obj_awaiting_val))
@@ -1328,7 +2546,7 @@ int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars,
 
 		case MIO_JSON_INST_NIL:
 			PREACTION_FOR_VALUE (jsonwr, sn);
-			WRITE_BYTES_NOESC (jsonwr, "nil", 3);
+			WRITE_BYTES_NOESC (jsonwr, "null", 4);
 			break;
 
 		case MIO_JSON_INST_TRUE:
@@ -1346,7 +2564,7 @@ int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars,
 			if (is_uchars)
 				WRITE_UCHARS (jsonwr, 0, dptr, dlen);
 			else
-				WRITE_BYTES_NOESC (jsonwr, dptr, dlen);
+				WRITE_BYTES_DIRECT (jsonwr, dptr, dlen);
 			break;
 
 		case MIO_JSON_INST_STRING:
@@ -1364,19 +2582,55 @@ int mio_jsonwr_write (mio_jsonwr_t* jsonwr, mio_json_inst_t inst, int is_uchars,
 			return -1;
 	}
 
+	FLUSH_IF_IOV_EXT (jsonwr);
 	return 0;
 }
 
+/* format an unsigned integer backward from the end of a buffer two digits at a time */
+static const mio_bch_t dec_digit_pairs[] = 
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static MIO_INLINE mio_bch_t* format_uintmax_dec (mio_uintmax_t v, mio_bch_t* end)
+{
+	mio_bch_t* p = end;
+
+	while (v >= 100)
+	{
+		mio_oow_t i = (mio_oow_t)(v % 100) * 2;
+		v /= 100;
+		*--p = dec_digit_pairs[i + 1];
+		*--p = dec_digit_pairs[i];
+	}
+
+	if (v >= 10)
+	{
+		mio_oow_t i = (mio_oow_t)v * 2;
+		*--p = dec_digit_pairs[i + 1];
+		*--p = dec_digit_pairs[i];
+	}
+	else
+	{
+		*--p = '0' + (mio_bch_t)v;
+	}
+
+	return p;
+}
+
 
 int mio_jsonwr_writeintmax (mio_jsonwr_t* jsonwr, mio_intmax_t v)
 {
 	mio_jsonwr_state_node_t* sn = jsonwr->state_stack;
 	mio_bch_t tmp[((MIO_SIZEOF_UINTMAX_T * MIO_BITS_PER_BYTE) / 3) + 3]; /* there can be a sign. so +3 instead of +2 */
-	mio_oow_t len;
+	mio_bch_t* end = tmp + MIO_COUNTOF(tmp);
+	mio_bch_t* p;
 
 	PREACTION_FOR_VALUE (jsonwr, sn);
-	len = mio_fmt_intmax_to_bcstr(tmp, MIO_COUNTOF(tmp), v, 10, 0, '\0', MIO_NULL);
-	WRITE_BYTES_NOESC (jsonwr, tmp, len);
+	/* negate in the unsigned type not to overflow on the minimum value */
+	p = format_uintmax_dec((v < 0)? ((mio_uintmax_t)0 - (mio_uintmax_t)v): (mio_uintmax_t)v, end);
+	if (v < 0) *--p = '-';
+	WRITE_BYTES_NOESC (jsonwr, p, end - p);
 	return 0;
 
 incompatible_inst:
@@ -1389,11 +2643,12 @@ int mio_jsonwr_writeuintmax (mio_jsonwr_t* jsonwr, mio_uintmax_t v)
 {
 	mio_jsonwr_state_node_t* sn = jsonwr->state_stack;
 	mio_bch_t tmp[((MIO_SIZEOF_UINTMAX_T * MIO_BITS_PER_BYTE) / 3) + 2];
-	mio_oow_t len;
+	mio_bch_t* end = tmp + MIO_COUNTOF(tmp);
+	mio_bch_t* p;
 
 	PREACTION_FOR_VALUE (jsonwr, sn);
-	len = mio_fmt_uintmax_to_bcstr(tmp, MIO_COUNTOF(tmp), v, 10, 0, '\0', MIO_NULL);
-	WRITE_BYTES_NOESC (jsonwr, tmp, len);
+	p = format_uintmax_dec(v, end);
+	WRITE_BYTES_NOESC (jsonwr, p, end - p);
 	return 0;
 
 incompatible_inst:
@@ -1416,12 +2671,14 @@ int mio_jsonwr_writerawucstr (mio_jsonwr_t* jsonwr, const mio_uch_t* dptr)
 
 int mio_jsonwr_writerawbchars (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_oow_t dlen)
 {
-	WRITE_BYTES_NOESC (jsonwr, dptr, dlen);
+	WRITE_BYTES_DIRECT (jsonwr, dptr, dlen);
+	FLUSH_IF_IOV_EXT (jsonwr);
 	return 0;
 }
 
 int mio_jsonwr_writerawbcstr (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr)
 {
-	WRITE_BYTES_NOESC (jsonwr, dptr, mio_count_bcstr(dptr));
+	WRITE_BYTES_DIRECT (jsonwr, dptr, mio_count_bcstr(dptr));
+	FLUSH_IF_IOV_EXT (jsonwr);
 	return 0;
 }
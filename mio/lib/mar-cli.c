@@ -37,6 +37,7 @@
 
 typedef struct sess_t sess_t;
 typedef struct sess_qry_t sess_qry_t;
+typedef struct sess_stmt_t sess_stmt_t;
 
 struct mio_svc_marc_t
 {
@@ -49,6 +50,7 @@ struct mio_svc_marc_t
 	mio_svc_marc_tmout_t tmout;
 
 	MYSQL* edev;
+	mio_oow_t stmt_cache_capa;
 
 	struct
 	{
@@ -64,11 +66,27 @@ struct sess_qry_t
 	void*        qctx;
 	unsigned int sent: 1;
 	unsigned int need_fetch: 1;
+	unsigned int batched: 1;
+	unsigned int stmt: 1; /* execute as a prepared statement */
+
+	mio_svc_marc_param_t* params;
+	mio_oow_t    nparams;
 
 	mio_svc_marc_on_result_t on_result;
 	sess_qry_t*  sq_next;
 };
 
+/* a prepared statement cached by the query text */
+struct sess_stmt_t
+{
+	mio_dev_mar_stmt_t* stmt;
+	mio_oow_t    hv;
+	mio_oow_t    qlen;
+	sess_stmt_t* prev; /* more recently used */
+	sess_stmt_t* next; /* less recently used */
+	/* the query text follows */
+};
+
 struct sess_t
 {
 	mio_oow_t sid;
@@ -78,6 +96,14 @@ struct sess_t
 
 	sess_qry_t* q_head;
 	sess_qry_t* q_tail;
+
+	/* statement cache in the order of use. the least recently used at the tail */
+	struct
+	{
+		sess_stmt_t* head;
+		sess_stmt_t* tail;
+		mio_oow_t count;
+	} stc;
 };
 
 typedef struct dev_xtn_t dev_xtn_t;
@@ -99,8 +125,9 @@ mio_svc_marc_t* mio_svc_marc_start (mio_t* mio, const mio_svc_marc_connect_t* ci
 	if (MIO_UNLIKELY(!marc->edev)) goto oops;
 
 	marc->mio = mio;
-	marc->svc_stop = mio_svc_marc_stop;
+	marc->svc_stop = (mio_svc_stop_t)mio_svc_marc_stop;
 	marc->ci = *ci;
+	marc->stmt_cache_capa = MIO_SVC_MARC_STMT_CACHE_CAPA_DEFAULT;
 	if (tmout) 
 	{
 		marc->tmout = *tmout;
@@ -137,19 +164,48 @@ void mio_svc_marc_stop (mio_svc_marc_t* marc)
 
 /* ------------------------------------------------------------------- */
 
-static sess_qry_t* make_session_query (mio_t* mio, mio_svc_marc_qtype_t qtype, const mio_bch_t* qptr, mio_oow_t qlen, void* qctx, mio_svc_marc_on_result_t on_result)
+static sess_qry_t* make_session_query (mio_t* mio, mio_svc_marc_qtype_t qtype, const mio_bch_t* qptr, mio_oow_t qlen, const mio_svc_marc_param_t* params, mio_oow_t nparams, void* qctx, mio_svc_marc_on_result_t on_result)
 {
 	sess_qry_t* sq;
+	mio_oow_t hdrsize, i, xlen = 0;
+	mio_uint8_t* ptr;
+
+	/* the parameters and the data pointed to by them are copied
+	 * into the same memory block as the query itself */
+	hdrsize = MIO_ALIGN_POW2(MIO_SIZEOF(*sq), MIO_SIZEOF(mio_uint64_t));
+	for (i = 0; i < nparams; i++)
+	{
+		if (params[i].type == MIO_DEV_MAR_PARAM_BCHARS || params[i].type == MIO_DEV_MAR_PARAM_BLOB) xlen += params[i].u.b.len;
+	}
 
-	sq = mio_allocmem(mio, MIO_SIZEOF(*sq) + (MIO_SIZEOF(*qptr) * qlen));
+	sq = mio_allocmem(mio, hdrsize + (MIO_SIZEOF(*params) * nparams) + (MIO_SIZEOF(*qptr) * qlen) + xlen);
 	if (MIO_UNLIKELY(!sq)) return MIO_NULL;
 
-	MIO_MEMCPY (sq + 1, qptr, (MIO_SIZEOF(*qptr) * qlen));
+	ptr = (mio_uint8_t*)sq + hdrsize;
+	sq->params = (mio_svc_marc_param_t*)ptr;
+	sq->nparams = nparams;
+	MIO_MEMCPY (ptr, params, MIO_SIZEOF(*params) * nparams);
+	ptr += MIO_SIZEOF(*params) * nparams;
 
-	sq->sent = 0;
-	sq->need_fetch = (qtype == MIO_SVC_MARC_QTYPE_SELECT);
-	sq->qptr = (mio_bch_t*)(sq + 1);
+	sq->qptr = (mio_bch_t*)ptr;
 	sq->qlen = qlen;
+	MIO_MEMCPY (ptr, qptr, (MIO_SIZEOF(*qptr) * qlen));
+	ptr += MIO_SIZEOF(*qptr) * qlen;
+
+	for (i = 0; i < nparams; i++)
+	{
+		if (params[i].type == MIO_DEV_MAR_PARAM_BCHARS || params[i].type == MIO_DEV_MAR_PARAM_BLOB)
+		{
+			MIO_MEMCPY (ptr, params[i].u.b.ptr, params[i].u.b.len);
+			sq->params[i].u.b.ptr = ptr;
+			ptr += params[i].u.b.len;
+		}
+	}
+
+	sq->sent = 0;
+	sq->need_fetch = (qtype == MIO_SVC_MARC_QTYPE_SELECT || qtype == MIO_SVC_MARC_QTYPE_SELECT_BATCHED);
+	sq->batched = (qtype == MIO_SVC_MARC_QTYPE_SELECT_BATCHED);
+	sq->stmt = 0;
 	sq->qctx = qctx;
 	sq->on_result = on_result;
 	sq->sq_next = MIO_NULL;
@@ -186,6 +242,99 @@ static MIO_INLINE sess_qry_t* get_first_session_query (sess_t* sess)
 
 /* ------------------------------------------------------------------- */
 
+static MIO_INLINE void unlink_cached_stmt (sess_t* sess, sess_stmt_t* ss)
+{
+	if (ss->prev) ss->prev->next = ss->next;
+	else sess->stc.head = ss->next;
+	if (ss->next) ss->next->prev = ss->prev;
+	else sess->stc.tail = ss->prev;
+	sess->stc.count--;
+}
+
+static MIO_INLINE void link_cached_stmt_at_head (sess_t* sess, sess_stmt_t* ss)
+{
+	ss->prev = MIO_NULL;
+	ss->next = sess->stc.head;
+	if (sess->stc.head) sess->stc.head->prev = ss;
+	else sess->stc.tail = ss;
+	sess->stc.head = ss;
+	sess->stc.count++;
+}
+
+static sess_stmt_t* find_cached_stmt (sess_t* sess, const mio_bch_t* qptr, mio_oow_t qlen)
+{
+	sess_stmt_t* ss;
+	mio_oow_t hv;
+
+	MIO_HASH_BCHARS (hv, qptr, qlen);
+	for (ss = sess->stc.head; ss; ss = ss->next)
+	{
+		if (ss->hv == hv && ss->qlen == qlen && MIO_MEMCMP(ss + 1, qptr, MIO_SIZEOF(*qptr) * qlen) == 0)
+		{
+			/* move it to the head as the most recently used */
+			if (ss != sess->stc.head)
+			{
+				unlink_cached_stmt (sess, ss);
+				link_cached_stmt_at_head (sess, ss);
+			}
+			return ss;
+		}
+	}
+
+	return MIO_NULL;
+}
+
+static int cache_stmt (sess_t* sess, mio_dev_mar_stmt_t* stmt, const mio_bch_t* qptr, mio_oow_t qlen)
+{
+	mio_t* mio = sess->svc->mio;
+	sess_stmt_t* ss;
+
+	ss = (sess_stmt_t*)mio_allocmem(mio, MIO_SIZEOF(*ss) + (MIO_SIZEOF(*qptr) * qlen));
+	if (MIO_UNLIKELY(!ss)) return -1;
+
+	ss->stmt = stmt;
+	MIO_HASH_BCHARS (ss->hv, qptr, qlen);
+	ss->qlen = qlen;
+	MIO_MEMCPY (ss + 1, qptr, MIO_SIZEOF(*qptr) * qlen);
+	link_cached_stmt_at_head (sess, ss);
+
+	while (sess->stc.count > sess->svc->stmt_cache_capa && sess->stc.tail != ss)
+	{
+		/* evict the least recently used. it's never the one in progress */
+		sess_stmt_t* lru = sess->stc.tail;
+		unlink_cached_stmt (sess, lru);
+		mio_dev_mar_closestmt (sess->dev, lru->stmt);
+		mio_freemem (mio, lru);
+	}
+
+	return 0;
+}
+
+static void clear_cached_stmts (sess_t* sess)
+{
+	/* the statements themselves are closed when the device is killed */
+	while (sess->stc.head)
+	{
+		sess_stmt_t* ss = sess->stc.head;
+		unlink_cached_stmt (sess, ss);
+		mio_freemem (sess->svc->mio, ss);
+	}
+	MIO_ASSERT (sess->svc->mio, sess->stc.count == 0);
+}
+
+static int send_session_query (sess_t* sess, sess_qry_t* sq)
+{
+	sess_stmt_t* ss;
+
+	if (!sq->stmt) return mio_dev_mar_querywithbchars(sess->dev, sq->qptr, sq->qlen);
+
+	ss = find_cached_stmt(sess, sq->qptr, sq->qlen);
+	if (ss) return mio_dev_mar_executestmtwithcursor(sess->dev, ss->stmt, sq->params, sq->nparams);
+
+	/* the statement gets executed in mar_on_stmt_prepared() */
+	return mio_dev_mar_preparestmt(sess->dev, sq->qptr, sq->qlen);
+}
+
 static int send_pending_query_if_any (sess_t* sess)
 {
 	sess_qry_t* sq;
@@ -195,7 +344,7 @@ static int send_pending_query_if_any (sess_t* sess)
 	{
 		sq->sent = 1;
 printf ("sending... %.*s\n", (int)sq->qlen, sq->qptr);
-		if (mio_dev_mar_querywithbchars(sess->dev, sq->qptr, sq->qlen) <= -1) 
+		if (send_session_query(sess, sq) <= -1) 
 		{
 MIO_DEBUG1 (sess->svc->mio, "QQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQ SEND FAIL %js\n", mio_geterrmsg(sess->svc->mio));
 			sq->sent = 0;
@@ -222,6 +371,9 @@ static void mar_on_disconnect (mio_dev_mar_t* dev)
 	MIO_DEBUG6 (mio, "MARC(%p) - device disconnected - sid %lu session %p session-connected %d device %p device-broken %d\n", sess->svc, (unsigned long int)sess->sid, sess, (int)sess->connected, dev, (int)dev->broken); 
 	MIO_ASSERT (mio, dev == sess->dev);
 
+	/* the statements prepared are gone with the device */
+	clear_cached_stmts (sess);
+
 	if (MIO_UNLIKELY(!sess->svc->stopping && mio->stopreq == MIO_STOPREQ_NONE))
 	{
 		if (sess->connected && sess->dev->broken) /* risk of infinite cycle if the underlying db suffers never-ending 'broken' issue after getting connected */
@@ -304,7 +456,7 @@ printf ("QUERY FAILED...%d -> %s\n", mar_ret, mar_errmsg);
 printf ("QUERY STARTED\n");
 		if (sq->need_fetch)
 		{
-			if (mio_dev_mar_fetchrows(dev) <= -1)
+			if ((sq->batched? mio_dev_mar_fetchrowsbatched(dev): mio_dev_mar_fetchrows(dev)) <= -1)
 			{
 //printf ("FETCH ROW FAILURE - %s\n", mysql_error(dev->hnd));
 				mio_dev_mar_halt (dev);
@@ -334,6 +486,87 @@ static void mar_on_row_fetched (mio_dev_mar_t* dev, void* data)
 	}
 }
 
+static void mar_on_rows_fetched (mio_dev_mar_t* dev, void** rows, mio_oow_t count)
+{
+	dev_xtn_t* xtn = (dev_xtn_t*)mio_dev_mar_getxtn(dev);
+	sess_t* sess = xtn->sess;
+	sess_qry_t* sq = get_first_session_query(sess);
+
+	if (count > 0)
+	{
+		mio_svc_marc_rows_t r;
+		r.ptr = rows;
+		r.count = count;
+		sq->on_result (sess->svc, sess->sid, MIO_SVC_MARC_RCODE_ROWS, &r, sq->qctx);
+	}
+	else
+	{
+		sq->on_result (sess->svc, sess->sid, MIO_SVC_MARC_RCODE_DONE, MIO_NULL, sq->qctx);
+		dequeue_session_query (sess->svc->mio, sess);
+		send_pending_query_if_any (sess);
+	}
+}
+
+static void mar_on_stmt_prepared (mio_dev_mar_t* dev, mio_dev_mar_stmt_t* stmt, int mar_ret, const mio_bch_t* mar_errmsg)
+{
+	dev_xtn_t* xtn = (dev_xtn_t*)mio_dev_mar_getxtn(dev);
+	sess_t* sess = xtn->sess;
+	sess_qry_t* sq = get_first_session_query(sess);
+	mio_svc_marc_dev_error_t err;
+
+	if (mar_ret)
+	{
+		err.mar_errcode = mar_ret;
+		err.mar_errmsg = mar_errmsg;
+		goto fail;
+	}
+
+	if (cache_stmt(sess, stmt, sq->qptr, sq->qlen) <= -1)
+	{
+		mio_dev_mar_closestmt (dev, stmt);
+		err.mar_errcode = CR_OUT_OF_MEMORY;
+		err.mar_errmsg = "unable to cache statement";
+		goto fail;
+	}
+
+	if (mio_dev_mar_executestmtwithcursor(dev, stmt, sq->params, sq->nparams) <= -1) mio_dev_mar_halt (dev);
+	return;
+
+fail:
+	sq->on_result (sess->svc, sess->sid, MIO_SVC_MARC_RCODE_ERROR, &err, sq->qctx);
+	dequeue_session_query (sess->svc->mio, sess);
+	send_pending_query_if_any (sess);
+}
+
+static void mar_on_stmt_executed (mio_dev_mar_t* dev, mio_dev_mar_stmt_t* stmt, int mar_ret, const mio_bch_t* mar_errmsg)
+{
+	dev_xtn_t* xtn = (dev_xtn_t*)mio_dev_mar_getxtn(dev);
+	sess_t* sess = xtn->sess;
+	sess_qry_t* sq = get_first_session_query(sess);
+
+	if (mar_ret)
+	{
+		mio_svc_marc_dev_error_t err;
+		err.mar_errcode = mar_ret;
+		err.mar_errmsg = mar_errmsg;
+		sq->on_result (sess->svc, sess->sid, MIO_SVC_MARC_RCODE_ERROR, &err, sq->qctx);
+	}
+	else if (mio_dev_mar_getstmtfieldcount(stmt) > 0)
+	{
+		/* the result set must be consumed regardless of the query type 
+		 * before the connection can be used again */
+		if ((sq->batched? mio_dev_mar_fetchstmtrowsbatched(dev): mio_dev_mar_fetchstmtrows(dev)) <= -1) mio_dev_mar_halt (dev);
+		return;
+	}
+	else
+	{
+		sq->on_result (sess->svc, sess->sid, MIO_SVC_MARC_RCODE_DONE, MIO_NULL, sq->qctx);
+	}
+
+	dequeue_session_query (sess->svc->mio, sess);
+	send_pending_query_if_any (sess);
+}
+
 static mio_dev_mar_t* alloc_device (mio_svc_marc_t* marc, sess_t* sess)
 {
 	mio_t* mio = (mio_t*)marc->mio;
@@ -352,6 +585,9 @@ static mio_dev_mar_t* alloc_device (mio_svc_marc_t* marc, sess_t* sess)
 	mi.on_disconnect = mar_on_disconnect;
 	mi.on_query_started = mar_on_query_started;
 	mi.on_row_fetched = mar_on_row_fetched;
+	mi.on_rows_fetched = mar_on_rows_fetched;
+	mi.on_stmt_prepared = mar_on_stmt_prepared;
+	mi.on_stmt_executed = mar_on_stmt_executed;
 
 	mar = mio_dev_mar_make(mio, MIO_SIZEOF(*xtn), &mi);
 	if (!mar) return MIO_NULL;
@@ -402,7 +638,7 @@ static sess_t* get_session (mio_svc_marc_t* marc, mio_oow_t sid)
 	{
 		sess_qry_t* sq;
 
-		sq = make_session_query(mio, MIO_SVC_MARC_QTYPE_ACTION, "", 0, MIO_NULL, 0); /* this is a place holder */
+		sq = make_session_query(mio, MIO_SVC_MARC_QTYPE_ACTION, "", 0, MIO_NULL, 0, MIO_NULL, 0); /* this is a place holder */
 		if (MIO_UNLIKELY(!sq)) return MIO_NULL;
 
 		sess->dev = alloc_device(marc, sess);
@@ -439,17 +675,9 @@ static sess_t* get_session (mio_svc_marc_t* marc, mio_oow_t sid)
 }
 
 
-int mio_svc_marc_querywithbchars (mio_svc_marc_t* marc, mio_oow_t sid, mio_svc_marc_qtype_t qtype, const mio_bch_t* qptr, mio_oow_t qlen, mio_svc_marc_on_result_t on_result, void* qctx)
+static int submit_session_query (sess_t* sess, sess_qry_t* sq)
 {
-	mio_t* mio = marc->mio;
-	sess_t* sess;
-	sess_qry_t* sq;
-
-	sess = get_session(marc, sid);
-	if (MIO_UNLIKELY(!sess)) return -1;
-
-	sq = make_session_query(mio, qtype, qptr, qlen, qctx, on_result);
-	if (MIO_UNLIKELY(!sq)) return -1;
+	mio_t* mio = sess->svc->mio;
 
 	if (get_first_session_query(sess) || !sess->connected)
 	{
@@ -466,7 +694,7 @@ int mio_svc_marc_querywithbchars (mio_svc_marc_t* marc, mio_oow_t sid, mio_svc_m
 		MIO_ASSERT (mio, sq->sent == 0);
 
 		sq->sent = 1;
-		if (mio_dev_mar_querywithbchars(sess->dev, sq->qptr, sq->qlen) <= -1) 
+		if (send_session_query(sess, sq) <= -1) 
 		{
 			sq->sent = 0;
 			if (!sess->dev->broken)
@@ -488,6 +716,75 @@ int mio_svc_marc_querywithbchars (mio_svc_marc_t* marc, mio_oow_t sid, mio_svc_m
 	return 0;
 }
 
+int mio_svc_marc_querywithbchars (mio_svc_marc_t* marc, mio_oow_t sid, mio_svc_marc_qtype_t qtype, const mio_bch_t* qptr, mio_oow_t qlen, mio_svc_marc_on_result_t on_result, void* qctx)
+{
+	mio_t* mio = marc->mio;
+	sess_t* sess;
+	sess_qry_t* sq;
+
+	sess = get_session(marc, sid);
+	if (MIO_UNLIKELY(!sess)) return -1;
+
+	sq = make_session_query(mio, qtype, qptr, qlen, MIO_NULL, 0, qctx, on_result);
+	if (MIO_UNLIKELY(!sq)) return -1;
+
+	return submit_session_query(sess, sq);
+}
+
+int mio_svc_marc_execstmtwithbchars (mio_svc_marc_t* marc, mio_oow_t sid, mio_svc_marc_qtype_t qtype, const mio_bch_t* qptr, mio_oow_t qlen, const mio_svc_marc_param_t* params, mio_oow_t nparams, mio_svc_marc_on_result_t on_result, void* qctx)
+{
+	mio_t* mio = marc->mio;
+	sess_t* sess;
+	sess_qry_t* sq;
+
+	sess = get_session(marc, sid);
+	if (MIO_UNLIKELY(!sess)) return -1;
+
+	sq = make_session_query(mio, qtype, qptr, qlen, params, nparams, qctx, on_result);
+	if (MIO_UNLIKELY(!sq)) return -1;
+	sq->stmt = 1;
+
+	return submit_session_query(sess, sq);
+}
+
+void mio_svc_marc_setstmtcachecapa (mio_svc_marc_t* marc, mio_oow_t capa)
+{
+	marc->stmt_cache_capa = (capa > 0)? capa: 1;
+}
+
+static sess_t* find_connected_session (mio_svc_marc_t* marc, mio_oow_t sid)
+{
+	sess_t* sess;
+
+	if (sid >= marc->sess.capa || !(sess = &marc->sess.ptr[sid])->dev || !sess->connected)
+	{
+		mio_seterrbfmt (marc->mio, MIO_ENOENT, "no connected session for %zu", sid);
+		return MIO_NULL;
+	}
+
+	return sess;
+}
+
+int mio_svc_marc_pausefetch (mio_svc_marc_t* marc, mio_oow_t sid)
+{
+	sess_t* sess;
+
+	sess = find_connected_session(marc, sid);
+	if (MIO_UNLIKELY(!sess)) return -1;
+
+	return mio_dev_mar_pausefetch(sess->dev);
+}
+
+int mio_svc_marc_resumefetch (mio_svc_marc_t* marc, mio_oow_t sid)
+{
+	sess_t* sess;
+
+	sess = find_connected_session(marc, sid);
+	if (MIO_UNLIKELY(!sess)) return -1;
+
+	return mio_dev_mar_resumefetch(sess->dev);
+}
+
 mio_oow_t mio_svc_marc_escapebchars (mio_svc_marc_t* marc, const mio_bch_t* qptr, mio_oow_t qlen, mio_bch_t* buf)
 {
 	return mysql_real_escape_string(marc->edev, buf, qptr, qlen);
@@ -37,6 +37,41 @@
 
 #include <sys/socket.h>
 
+typedef struct stmt_col_t stmt_col_t;
+struct stmt_col_t
+{
+	char* buf;
+	mio_oow_t capa;
+	unsigned long len;
+	my_bool null;
+};
+
+struct mio_dev_mar_stmt_t
+{
+	MYSQL_STMT* hnd;
+	mio_dev_mar_t* dev;
+
+	mio_oow_t nparams;
+	mio_oow_t nfields;
+
+	MYSQL_BIND* pbind;
+	unsigned long* plen;
+
+	MYSQL_BIND* rbind;
+	stmt_col_t* rcol;
+	char** row;
+	int rebind; /* a column buffer has grown since the result was bound */
+
+	mio_dev_mar_stmt_t* prev;
+	mio_dev_mar_stmt_t* next;
+};
+
+/* the initial buffer size for a column of a prepared statement result 
+ * excluding the terminating null. the column length declared is used
+ * within this range. a buffer grows when a value gets truncated */
+#define STMT_COLUMN_BUF_MIN 64
+#define STMT_COLUMN_BUF_MAX 1024
+
 /* ========================================================================= */
 
 static int dev_mar_make (mio_dev_t* dev, void* ctx)
@@ -91,15 +126,45 @@ static int dev_mar_make (mio_dev_t* dev, void* ctx)
 	rdev->on_disconnect = mi->on_disconnect;
 	rdev->on_query_started = mi->on_query_started;
 	rdev->on_row_fetched = mi->on_row_fetched;
+	rdev->on_rows_fetched = mi->on_rows_fetched;
+	rdev->on_stmt_prepared = mi->on_stmt_prepared;
+	rdev->on_stmt_executed = mi->on_stmt_executed;
+	rdev->row_batch_max = mi->row_batch_max > 0? mi->row_batch_max: MIO_DEV_MAR_ROW_BATCH_MAX_DEFAULT;
 
 	rdev->progress = MIO_DEV_MAR_INITIAL;
 
 	return 0;
 }
 
+static void free_stmt (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt)
+{
+	mio_t* mio = rdev->mio;
+
+	if (stmt->prev) stmt->prev->next = stmt->next;
+	else rdev->stmt_list = stmt->next;
+	if (stmt->next) stmt->next->prev = stmt->prev;
+	if (rdev->stmt == stmt) rdev->stmt = MIO_NULL;
+
+	/* COM_STMT_CLOSE has no server response. mysql_stmt_close() 
+	 * doesn't wait for anything but a small write */
+	mysql_stmt_close (stmt->hnd);
+
+	if (stmt->pbind) mio_freemem (mio, stmt->pbind);
+	if (stmt->rbind) 
+	{
+		mio_oow_t i;
+		for (i = 0; i < stmt->nfields; i++) 
+		{
+			if (stmt->rcol[i].buf) mio_freemem (mio, stmt->rcol[i].buf);
+		}
+		mio_freemem (mio, stmt->rbind);
+	}
+	mio_freemem (mio, stmt);
+}
+
 static int dev_mar_kill (mio_dev_t* dev, int force)
 {
-	/*mio_t* mio = dev->mio;*/
+	mio_t* mio = dev->mio;
 	mio_dev_mar_t* rdev = (mio_dev_mar_t*)dev;
 
 	/* if rdev->connected is 0 at this point, 
@@ -126,12 +191,29 @@ static int dev_mar_kill (mio_dev_t* dev, int force)
 		rdev->res = MIO_NULL;
 	}
 
+	/* the statement handles must be closed before mysql_close() */
+	while (rdev->stmt_list) free_stmt (rdev, rdev->stmt_list);
+
 	if (rdev->hnd)
 	{
 		mysql_close (rdev->hnd); 
 		rdev->hnd = MIO_NULL;
 	}
 
+	if (rdev->row_batch)
+	{
+		mio_freemem (mio, rdev->row_batch);
+		rdev->row_batch = MIO_NULL;
+	}
+
+	if (rdev->row_batch_buf)
+	{
+		mio_freemem (mio, rdev->row_batch_buf);
+		rdev->row_batch_buf = MIO_NULL;
+		rdev->row_batch_buf_capa = 0;
+		rdev->row_batch_buf_len = 0;
+	}
+
 	rdev->connected = 0;
 	rdev->broken = 0;
 
@@ -164,39 +246,705 @@ static int mysql_wstatus_to_events (int wstatus)
 	return events;
 }
 
-static MIO_INLINE void watch_mysql (mio_dev_mar_t* rdev, int wstatus)
-{
-	if (mio_dev_watch((mio_dev_t*)rdev, MIO_DEV_WATCH_UPDATE, mysql_wstatus_to_events(wstatus)) <= -1)
-	{
-		/* watcher update failure. it's critical */
-		mio_stop (rdev->mio, MIO_STOPREQ_WATCHER_ERROR);
-	}
-}
+static MIO_INLINE void watch_mysql (mio_dev_mar_t* rdev, int wstatus)
+{
+	if (mio_dev_watch((mio_dev_t*)rdev, MIO_DEV_WATCH_UPDATE, mysql_wstatus_to_events(wstatus)) <= -1)
+	{
+		/* watcher update failure. it's critical */
+		mio_stop (rdev->mio, MIO_STOPREQ_WATCHER_ERROR);
+	}
+}
+
+static void start_fetch_row (mio_dev_mar_t* rdev)
+{
+	MYSQL_ROW row;
+	int status;
+
+	status = mysql_fetch_row_start(&row, rdev->res);
+
+	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+	if (status)
+	{
+		/* row not fetched */
+		rdev->row_fetched_deferred = 0;
+		rdev->row_fetch_waiting = 1;
+		rdev->row_wstatus = status;
+		watch_mysql (rdev, (rdev->row_fetch_paused? 0: status));
+	}
+	else
+	{
+		/* row fetched - don't handle it immediately here */
+		rdev->row_fetched_deferred = 1;
+		rdev->row_fetch_waiting = 0;
+		rdev->row_wstatus = status;
+		rdev->row = row;
+		watch_mysql (rdev, (rdev->row_fetch_paused? 0: (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE)));
+	}
+}
+
+static MIO_INLINE void end_fetch_rows (mio_dev_mar_t* rdev)
+{
+	MIO_ASSERT (rdev->mio, rdev->res != MIO_NULL);
+	mysql_free_result (rdev->res); /* this doesn't block after the last row */
+	rdev->res = MIO_NULL;
+	rdev->row_fetch_waiting = 0;
+	rdev->row_fetch_batched = 0;
+	rdev->row_fetch_paused = 0; /* pausing is effective for the current result set only */
+	rdev->row_fetch_stopped = 0;
+}
+
+static int fetch_rows (mio_dev_mar_t* rdev, int events)
+{
+	/* deliver as many rows as available without blocking up to
+	 * rdev->row_batch_max rows. a row returned by mysql_fetch_row_start()
+	 * or mysql_fetch_row_cont() stays valid until the next fetch call over
+	 * an unbuffered result. so the callback is invoked for each row */
+	mio_oow_t budget = rdev->row_batch_max;
+	MYSQL_ROW row;
+	int status;
+
+	if (rdev->row_fetched_deferred)
+	{
+		row = (MYSQL_ROW)rdev->row;
+		rdev->row_fetched_deferred = 0;
+		goto row_available;
+	}
+
+	if (MIO_UNLIKELY(!rdev->res))
+	{
+		mio_seterrbfmt (rdev->mio, MIO_EINTERN, "no result set to fetch rows from");
+		return -1;
+	}
+	if (!rdev->row_fetch_waiting) return 0; /* stopped between rows for pausing */
+	status = mysql_fetch_row_cont(&row, rdev->res, events_to_mysql_wstatus(events));
+
+	while (1)
+	{
+		if (status)
+		{
+			/* no row is available */
+			rdev->row_fetch_waiting = 1;
+			rdev->row_wstatus = status;
+			watch_mysql (rdev, status);
+			return 0;
+		}
+
+		rdev->row_fetch_waiting = 0;
+
+	row_available:
+		if (!row)
+		{
+			/* the last row has been received - cleanup before invoking the callback */
+			watch_mysql (rdev, 0);
+			end_fetch_rows (rdev);
+
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+			if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, MIO_NULL);
+			return 0;
+		}
+
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+		if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, row);
+
+		if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return 0; /* halted inside the callback */
+		if (rdev->row_fetch_paused) 
+		{
+			/* the next row is fetched in mio_dev_mar_resumefetch() */
+			rdev->row_fetch_stopped = 1;
+			watch_mysql (rdev, 0);
+			return 0;
+		}
+
+		if (--budget <= 0)
+		{
+			/* give other devices a chance. arrange to fetch the next row in the next wakeup */
+			start_fetch_row (rdev);
+			return 0;
+		}
+
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+		status = mysql_fetch_row_start(&row, rdev->res);
+	}
+}
+
+static void fetch_row_batch (mio_dev_mar_t* rdev)
+{
+	/* the result set has been stored on the client side. 
+	 * mysql_fetch_row() doesn't block and rows stay valid until
+	 * the result is freed */
+	MYSQL_ROW row = MIO_NULL;
+	mio_oow_t count = 0;
+
+	while (count < rdev->row_batch_max)
+	{
+		row = mysql_fetch_row(rdev->res);
+		if (!row) break;
+		rdev->row_batch[count++] = row;
+	}
+
+	if (count > 0)
+	{
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+		rdev->on_rows_fetched (rdev, rdev->row_batch, count);
+		if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return; /* halted inside the callback */
+	}
+
+	if (!row)
+	{
+		watch_mysql (rdev, 0);
+		end_fetch_rows (rdev);
+
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+		rdev->on_rows_fetched (rdev, MIO_NULL, 0);
+	}
+	else
+	{
+		/* more rows to deliver. the socket is idle at this point. 
+		 * watching it for writing triggers the ready() callback in the next wakeup */
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+		watch_mysql (rdev, (rdev->row_fetch_paused? 0: (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE)));
+	}
+}
+
+static int store_result (mio_dev_mar_t* rdev, int events)
+{
+	mio_t* mio = rdev->mio;
+	MYSQL_RES* res;
+	int status;
+
+	if (rdev->result_stored_deferred)
+	{
+		res = (MYSQL_RES*)rdev->res;
+		rdev->result_stored_deferred = 0;
+	}
+	else
+	{
+		status = mysql_store_result_cont(&res, rdev->hnd, events_to_mysql_wstatus(events));
+		if (status)
+		{
+			rdev->row_wstatus = status;
+			watch_mysql (rdev, status);
+			return 0;
+		}
+	}
+
+	rdev->row_fetch_waiting = 0;
+	rdev->res = res;
+	if (!res)
+	{
+		if (mysql_errno(rdev->hnd))
+		{
+			mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_error(rdev->hnd));
+			return -1;
+		}
+
+		/* no result set for the query. report the end immediately */
+		watch_mysql (rdev, 0);
+		rdev->row_fetch_batched = 0;
+		rdev->row_fetch_paused = 0;
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+		rdev->on_rows_fetched (rdev, MIO_NULL, 0);
+		return 0;
+	}
+
+	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+	if (rdev->row_fetch_paused) watch_mysql (rdev, 0);
+	else fetch_row_batch (rdev);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static MIO_INLINE int is_server_lost (int err)
+{
+	return err == CR_SERVER_LOST || err == CR_SERVER_GONE_ERROR;
+}
+
+static void break_connection (mio_dev_mar_t* rdev, mio_syshnd_t syshnd)
+{
+	/* the underlying socket must have gotten closed by the mariadb library */
+	rdev->broken = 1;
+	rdev->broken_syshnd = syshnd;
+	watch_mysql (rdev, 0);
+	mio_dev_mar_halt (rdev); /* i can't keep this device alive regardless of the caller's post-action */
+}
+
+static void finish_prepare_stmt (mio_dev_mar_t* rdev, int err, mio_syshnd_t syshnd)
+{
+	mio_dev_mar_stmt_t* stmt = rdev->stmt;
+
+	watch_mysql (rdev, 0);
+
+	if (err)
+	{
+		err = mysql_stmt_errno(stmt->hnd);
+		if (is_server_lost(err))
+		{
+			/* don't invoke on_stmt_prepared(). on_disconnect() will be called later */
+			free_stmt (rdev, stmt);
+			break_connection (rdev, syshnd);
+		}
+		else
+		{
+			mio_bch_t errmsg[256];
+			mio_copy_bcstr (errmsg, MIO_COUNTOF(errmsg), mysql_stmt_error(stmt->hnd));
+			free_stmt (rdev, stmt);
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_CONNECTED);
+			if (rdev->on_stmt_prepared) rdev->on_stmt_prepared (rdev, MIO_NULL, err, errmsg);
+		}
+		return;
+	}
+
+	stmt->nparams = mysql_stmt_param_count(stmt->hnd);
+	stmt->nfields = mysql_stmt_field_count(stmt->hnd);
+	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_PREPARED);
+	if (rdev->on_stmt_prepared) rdev->on_stmt_prepared (rdev, stmt, 0, MIO_NULL);
+}
+
+static void finish_execute_stmt (mio_dev_mar_t* rdev, int err, mio_syshnd_t syshnd)
+{
+	mio_dev_mar_stmt_t* stmt = rdev->stmt;
+
+	watch_mysql (rdev, 0);
+
+	if (err)
+	{
+		err = mysql_stmt_errno(stmt->hnd);
+		if (is_server_lost(err))
+		{
+			/* don't invoke on_stmt_executed(). on_disconnect() will be called later */
+			break_connection (rdev, syshnd);
+		}
+		else
+		{
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_PREPARED);
+			if (rdev->on_stmt_executed) rdev->on_stmt_executed (rdev, stmt, err, mysql_stmt_error(stmt->hnd));
+		}
+		return;
+	}
+
+	stmt->nfields = mysql_stmt_field_count(stmt->hnd);
+	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_EXECUTED);
+	if (rdev->on_stmt_executed) rdev->on_stmt_executed (rdev, stmt, 0, MIO_NULL);
+}
+
+static int bind_stmt_params (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt, const mio_dev_mar_param_t* params)
+{
+	mio_t* mio = rdev->mio;
+	mio_oow_t i;
+
+	if (stmt->nparams <= 0) return 0;
+
+	if (!stmt->pbind)
+	{
+		/* allocate the bindings and the length array in a single block */
+		stmt->pbind = (MYSQL_BIND*)mio_allocmem(mio, (MIO_SIZEOF(*stmt->pbind) + MIO_SIZEOF(*stmt->plen)) * stmt->nparams);
+		if (MIO_UNLIKELY(!stmt->pbind)) return -1;
+		stmt->plen = (unsigned long*)&stmt->pbind[stmt->nparams];
+	}
+
+	MIO_MEMSET (stmt->pbind, 0, MIO_SIZEOF(*stmt->pbind) * stmt->nparams);
+	for (i = 0; i < stmt->nparams; i++)
+	{
+		MYSQL_BIND* b = &stmt->pbind[i];
+		const mio_dev_mar_param_t* p = &params[i];
+
+		switch (p->type)
+		{
+			case MIO_DEV_MAR_PARAM_NULL:
+				b->buffer_type = MYSQL_TYPE_NULL;
+				break;
+
+			case MIO_DEV_MAR_PARAM_INT:
+				b->buffer_type = MYSQL_TYPE_LONGLONG;
+				b->buffer = (void*)&p->u.i;
+				break;
+
+			case MIO_DEV_MAR_PARAM_UINT:
+				b->buffer_type = MYSQL_TYPE_LONGLONG;
+				b->buffer = (void*)&p->u.ui;
+				b->is_unsigned = 1;
+				break;
+
+			case MIO_DEV_MAR_PARAM_DOUBLE:
+				b->buffer_type = MYSQL_TYPE_DOUBLE;
+				b->buffer = (void*)&p->u.d;
+				break;
+
+			case MIO_DEV_MAR_PARAM_BCHARS:
+			case MIO_DEV_MAR_PARAM_BLOB:
+				b->buffer_type = (p->type == MIO_DEV_MAR_PARAM_BLOB)? MYSQL_TYPE_BLOB: MYSQL_TYPE_STRING;
+				b->buffer = (void*)p->u.b.ptr;
+				b->buffer_length = p->u.b.len;
+				stmt->plen[i] = p->u.b.len;
+				b->length = &stmt->plen[i];
+				break;
+
+			default:
+				mio_seterrbfmt (mio, MIO_EINVAL, "invalid type of parameter %zu", i);
+				return -1;
+		}
+	}
+
+	if (mysql_stmt_bind_param(stmt->hnd, stmt->pbind))
+	{
+		mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+		return -1;
+	}
+
+	return 0;
+}
+
+static MIO_INLINE mio_oow_t stmt_column_buf_size (MYSQL_FIELD* field)
+{
+	/* the result is not stored on the client side. max_length of a field
+	 * is not available. the length declared for the column is used as a hint */
+	if (field->length < STMT_COLUMN_BUF_MIN) return STMT_COLUMN_BUF_MIN;
+	if (field->length > STMT_COLUMN_BUF_MAX) return STMT_COLUMN_BUF_MAX;
+	return field->length;
+}
+
+static MIO_INLINE enum enum_field_types stmt_column_buf_type (MYSQL_FIELD* field)
+{
+	/* a row is delivered as an array of null-terminated strings like MYSQL_ROW.
+	 * the value of a binary column is copied as it is. the values of other
+	 * columns are converted to text by the client library */
+	switch (field->type)
+	{
+		case MYSQL_TYPE_TINY_BLOB:
+		case MYSQL_TYPE_MEDIUM_BLOB:
+		case MYSQL_TYPE_LONG_BLOB:
+		case MYSQL_TYPE_BLOB:
+		case MYSQL_TYPE_STRING:
+		case MYSQL_TYPE_VAR_STRING:
+			/* 63 is the number of the binary character set */
+			return (field->charsetnr == 63)? MYSQL_TYPE_BLOB: MYSQL_TYPE_STRING;
+
+		case MYSQL_TYPE_BIT:
+		case MYSQL_TYPE_GEOMETRY:
+			return MYSQL_TYPE_BLOB;
+
+		default:
+			return MYSQL_TYPE_STRING;
+	}
+}
+
+static int bind_stmt_result (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt)
+{
+	mio_t* mio = rdev->mio;
+	MYSQL_RES* meta;
+	MYSQL_FIELD* fields;
+	mio_oow_t i, nfields;
+
+	meta = mysql_stmt_result_metadata(stmt->hnd);
+	if (MIO_UNLIKELY(!meta))
+	{
+		mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+		return -1;
+	}
+	fields = mysql_fetch_fields(meta);
+	nfields = mysql_num_fields(meta);
+
+	if (!stmt->rbind || stmt->nfields != nfields)
+	{
+		void* tmp;
+
+		if (stmt->rbind)
+		{
+			for (i = 0; i < stmt->nfields; i++) 
+			{
+				if (stmt->rcol[i].buf) mio_freemem (mio, stmt->rcol[i].buf);
+			}
+			mio_freemem (mio, stmt->rbind);
+			stmt->rbind = MIO_NULL;
+		}
+
+		/* allocate the bindings, the column states and the row in a single block */
+		tmp = mio_callocmem(mio, (MIO_SIZEOF(*stmt->rbind) + MIO_SIZEOF(*stmt->rcol) + MIO_SIZEOF(*stmt->row)) * nfields);
+		if (MIO_UNLIKELY(!tmp)) goto oops;
+
+		stmt->nfields = nfields;
+		stmt->rbind = (MYSQL_BIND*)tmp;
+		stmt->rcol = (stmt_col_t*)&stmt->rbind[nfields];
+		stmt->row = (char**)&stmt->rcol[nfields];
+	}
+
+	MIO_MEMSET (stmt->rbind, 0, MIO_SIZEOF(*stmt->rbind) * stmt->nfields);
+	for (i = 0; i < stmt->nfields; i++)
+	{
+		MYSQL_BIND* b = &stmt->rbind[i];
+		stmt_col_t* col = &stmt->rcol[i];
+		mio_oow_t size;
+
+		/* keep the buffer grown for the previous execution if it is large enough */
+		size = stmt_column_buf_size(&fields[i]) + 1;
+		if (col->capa < size)
+		{
+			char* tmp;
+			tmp = (char*)mio_reallocmem(mio, col->buf, size);
+			if (MIO_UNLIKELY(!tmp)) goto oops;
+			col->buf = tmp;
+			col->capa = size;
+		}
+
+		b->buffer_type = stmt_column_buf_type(&fields[i]);
+		b->buffer = col->buf;
+		b->buffer_length = col->capa;
+		b->length = &col->len;
+		b->is_null = &col->null;
+	}
+
+	mysql_free_result (meta);
+
+	if (mysql_stmt_bind_result(stmt->hnd, stmt->rbind))
+	{
+		mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+		return -1;
+	}
+
+	stmt->rebind = 0;
+	return 0;
+
+oops:
+	mysql_free_result (meta);
+	return -1;
+}
+
+static int complete_stmt_row (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt)
+{
+	/* fetch the columns truncated again into larger buffers and 
+	 * terminate the values with a null */
+	mio_t* mio = rdev->mio;
+	mio_oow_t i;
+
+	for (i = 0; i < stmt->nfields; i++)
+	{
+		stmt_col_t* col = &stmt->rcol[i];
+
+		if (col->null)
+		{
+			stmt->row[i] = MIO_NULL;
+			continue;
+		}
+
+		if (col->len >= col->capa)
+		{
+			MYSQL_BIND* b = &stmt->rbind[i];
+			char* tmp;
+
+			tmp = (char*)mio_reallocmem(mio, col->buf, col->len + 1);
+			if (MIO_UNLIKELY(!tmp)) return -1;
+			col->buf = tmp;
+			col->capa = col->len + 1;
+
+			b->buffer = col->buf;
+			b->buffer_length = col->capa;
+			if (mysql_stmt_fetch_column(stmt->hnd, b, i, 0))
+			{
+				mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+				return -1;
+			}
+
+			/* the new buffer must be bound before the next fetch */
+			stmt->rebind = 1;
+		}
+
+		col->buf[col->len] = '\0';
+		stmt->row[i] = col->buf;
+	}
+
+	return 0;
+}
+
+static int add_stmt_row_to_batch (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt, mio_oow_t index)
+{
+	/* the bound buffers are overwritten by the next fetch. copy the row to 
+	 * the batch buffer as an array of column value offsets followed by the
+	 * values. the offsets are turned to pointers in deliver_stmt_row_batch()
+	 * as the buffer may move while growing */
+	mio_t* mio = rdev->mio;
+	mio_oow_t i, need, off;
+	char** row;
+	char* ptr;
+
+	need = MIO_SIZEOF(*row) * stmt->nfields;
+	for (i = 0; i < stmt->nfields; i++)
+	{
+		if (stmt->row[i]) need += stmt->rcol[i].len + 1;
+	}
+
+	off = MIO_ALIGN_POW2(rdev->row_batch_buf_len, MIO_SIZEOF(*row));
+	if (off + need > rdev->row_batch_buf_capa)
+	{
+		mio_oow_t newcapa;
+		char* tmp;
+
+		newcapa = MIO_ALIGN_POW2(off + need, 4096);
+		tmp = (char*)mio_reallocmem(mio, rdev->row_batch_buf, newcapa);
+		if (MIO_UNLIKELY(!tmp)) return -1;
+		rdev->row_batch_buf = tmp;
+		rdev->row_batch_buf_capa = newcapa;
+	}
+
+	row = (char**)(rdev->row_batch_buf + off);
+	ptr = (char*)&row[stmt->nfields];
+	for (i = 0; i < stmt->nfields; i++)
+	{
+		if (stmt->row[i])
+		{
+			MIO_MEMCPY (ptr, stmt->row[i], stmt->rcol[i].len + 1);
+			row[i] = (char*)(mio_uintptr_t)(ptr - rdev->row_batch_buf);
+			ptr += stmt->rcol[i].len + 1;
+		}
+		else row[i] = MIO_NULL;
+	}
+
+	rdev->row_batch[index] = (void*)(mio_uintptr_t)off;
+	rdev->row_batch_buf_len = ptr - rdev->row_batch_buf;
+	return 0;
+}
+
+static void deliver_stmt_row_batch (mio_dev_mar_t* rdev, mio_dev_mar_stmt_t* stmt, mio_oow_t count)
+{
+	mio_oow_t i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		char** row = (char**)(rdev->row_batch_buf + (mio_uintptr_t)rdev->row_batch[i]);
+		for (j = 0; j < stmt->nfields; j++)
+		{
+			if (row[j]) row[j] = rdev->row_batch_buf + (mio_uintptr_t)row[j];
+		}
+		rdev->row_batch[i] = row;
+	}
+
+	rdev->row_batch_buf_len = 0;
+	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+	rdev->on_rows_fetched (rdev, rdev->row_batch, count);
+}
+
+static MIO_INLINE void end_fetch_stmt_rows (mio_dev_mar_t* rdev)
+{
+	/* mysql_stmt_free_result() is not called as it may block to reset 
+	 * the cursor on the server side. the statement gets reset when it is
+	 * executed again or closed */
+	rdev->row_fetch_stmt = 0;
+	rdev->row_fetch_batched = 0;
+	rdev->row_fetch_waiting = 0;
+	rdev->row_fetch_paused = 0;
+	rdev->row_fetch_stopped = 0;
+}
+
+static int fetch_stmt_rows (mio_dev_mar_t* rdev, int events)
+{
+	/* without a cursor, the rows are read off the socket as the server
+	 * sends them. with a read-only cursor, the server sends the rows in
+	 * chunks of the number of prefetch rows on demand and
+	 * mysql_stmt_fetch_start() requests the next chunk once the current
+	 * one is exhausted. deliver the rows available up to 
+	 * rdev->row_batch_max rows per wakeup */
+	mio_t* mio = rdev->mio;
+	mio_dev_mar_stmt_t* stmt = rdev->stmt;
+	mio_oow_t budget = rdev->row_batch_max;
+	mio_oow_t count = 0;
+	int batched = rdev->row_fetch_batched;
+	int n, status;
+
+	while (1)
+	{
+		if (rdev->row_fetch_waiting)
+		{
+			status = mysql_stmt_fetch_cont(&n, stmt->hnd, events_to_mysql_wstatus(events));
+		}
+		else
+		{
+			if (stmt->rebind)
+			{
+				if (mysql_stmt_bind_result(stmt->hnd, stmt->rbind))
+				{
+					mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+					return -1;
+				}
+				stmt->rebind = 0;
+			}
+			status = mysql_stmt_fetch_start(&n, stmt->hnd);
+		}
+
+		if (status)
+		{
+			/* the next chunk is on the way. hand over the rows collected so far */
+			rdev->row_fetch_waiting = 1;
+			rdev->row_wstatus = status;
+			if (count > 0)
+			{
+				deliver_stmt_row_batch (rdev, stmt, count);
+				if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return 0; /* halted inside the callback */
+				MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+			}
+			watch_mysql (rdev, (rdev->row_fetch_paused? 0: status));
+			return 0;
+		}
+
+		rdev->row_fetch_waiting = 0;
+		if (n == MYSQL_NO_DATA)
+		{
+			if (count > 0)
+			{
+				deliver_stmt_row_batch (rdev, stmt, count);
+				if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return 0;
+			}
+
+			/* the last row has been received - cleanup before invoking the callback */
+			watch_mysql (rdev, 0);
+			end_fetch_stmt_rows (rdev);
+
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+			if (batched) rdev->on_rows_fetched (rdev, MIO_NULL, 0);
+			else if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, MIO_NULL);
+			return 0;
+		}
+		else if (n != 0 && n != MYSQL_DATA_TRUNCATED)
+		{
+			mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+			return -1;
+		}
+
+		if (complete_stmt_row(rdev, stmt) <= -1) return -1;
 
-static void start_fetch_row (mio_dev_mar_t* rdev)
-{
-	MYSQL_ROW row;
-	int status;
+		if (batched)
+		{
+			if (add_stmt_row_to_batch(rdev, stmt, count) <= -1) return -1;
+			if (++count < budget) continue;
 
-	status = mysql_fetch_row_start(&row, rdev->res);
+			deliver_stmt_row_batch (rdev, stmt, count);
+			if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return 0;
+		}
+		else
+		{
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
+			if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, stmt->row);
+			if (rdev->dev_cap & MIO_DEV_CAP_HALTED) return 0;
+			if (--budget > 0 && !rdev->row_fetch_paused) continue;
+		}
 
-	MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
-	if (status)
-	{
-		/* row not fetched */
-		rdev->row_fetched_deferred = 0;
-		watch_mysql (rdev, status);
-	}
-	else
-	{
-		/* row fetched - don't handle it immediately here */
-		rdev->row_fetched_deferred = 1;
-		rdev->row_wstatus = status;
-		rdev->row = row;
-		watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+		/* paused or the budget used up */
+		MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+		if (rdev->row_fetch_paused)
+		{
+			rdev->row_fetch_stopped = 1;
+			watch_mysql (rdev, 0);
+		}
+		else
+		{
+			/* the socket is idle. watching it for writing triggers the ready() callback in the next wakeup */
+			watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+		}
+		return 0;
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+
 static int dev_mar_ioctl (mio_dev_t* dev, int cmd, void* arg)
 {
 	mio_t* mio = dev->mio;
@@ -259,7 +1007,7 @@ static int dev_mar_ioctl (mio_dev_t* dev, int cmd, void* arg)
 				return -1;
 			}
 
-			if (rdev->res) /* TODO: more accurate check */
+			if (rdev->res || rdev->row_fetch_stmt) /* TODO: more accurate check */
 			{
 				mio_seterrbfmt (mio, MIO_EPERM, "operation in progress. disallowed to query again");
 				return -1;
@@ -315,11 +1063,299 @@ static int dev_mar_ioctl (mio_dev_t* dev, int cmd, void* arg)
 					return -1;
 				}
 			}
+			else if (rdev->row_fetch_batched)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "operation in progress. disallowed to fetch rows one by one");
+				return -1;
+			}
 
 			start_fetch_row (rdev);
 			return 0;
 		}
 
+		case MIO_DEV_MAR_FETCH_ROWS_BATCHED:
+		{
+			MYSQL_RES* res;
+			int status;
+
+			if (!rdev->on_rows_fetched)
+			{
+				mio_seterrbfmt (mio, MIO_EINVAL, "on_rows_fetched callback not set. disallowed to fetch rows in batches");
+				return -1;
+			}
+
+			if (rdev->res)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "operation in progress. disallowed to fetch rows in batches");
+				return -1;
+			}
+
+			if (!rdev->row_batch)
+			{
+				rdev->row_batch = (void**)mio_allocmem(mio, MIO_SIZEOF(*rdev->row_batch) * rdev->row_batch_max);
+				if (MIO_UNLIKELY(!rdev->row_batch)) return -1;
+			}
+
+			rdev->row_fetch_batched = 1;
+			status = mysql_store_result_start(&res, rdev->hnd);
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_RESULT_STORING);
+			if (status)
+			{
+				/* not stored yet */
+				rdev->row_fetch_waiting = 1;
+				rdev->row_wstatus = status;
+				watch_mysql (rdev, (rdev->row_fetch_paused? 0: status));
+			}
+			else
+			{
+				/* stored immediately. postpone actual handling to the ready() callback */
+				rdev->result_stored_deferred = 1;
+				rdev->res = res;
+				watch_mysql (rdev, (rdev->row_fetch_paused? 0: (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE)));
+			}
+			return 0;
+		}
+
+		case MIO_DEV_MAR_PAUSE_FETCH:
+		{
+			mio_dev_mar_progress_t progress = MIO_DEV_MAR_GET_PROGRESS(rdev);
+
+			if (progress != MIO_DEV_MAR_RESULT_STORING && progress != MIO_DEV_MAR_ROW_FETCHING && progress != MIO_DEV_MAR_ROW_FETCHED)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "not fetching rows. disallowed to pause");
+				return -1;
+			}
+
+			if (!rdev->res && !rdev->row_fetch_stmt && !rdev->row_fetch_batched)
+			{
+				/* called in the callback for the end of the result set. the query
+				 * has completed. setting the flag would stall the next query */
+				return 0;
+			}
+
+			if (!rdev->row_fetch_paused)
+			{
+				rdev->row_fetch_paused = 1;
+				/* inside the fetch callback, the watcher is updated on return */
+				if (progress != MIO_DEV_MAR_ROW_FETCHED) watch_mysql (rdev, 0);
+			}
+			return 0;
+		}
+
+		case MIO_DEV_MAR_RESUME_FETCH:
+		{
+			if (rdev->row_fetch_paused)
+			{
+				rdev->row_fetch_paused = 0;
+
+				if (rdev->row_fetch_stmt)
+				{
+					/* the ready() callback continues storing or fetching the statement result */
+					rdev->row_fetch_stopped = 0;
+					watch_mysql (rdev, (rdev->row_fetch_waiting? rdev->row_wstatus: (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE)));
+				}
+				else if (!rdev->res && !rdev->row_fetch_waiting) 
+				{
+					/* the result set is over. nothing to resume */
+				}
+				else if (rdev->row_fetch_waiting)
+				{
+					/* resume the pending I/O of mysql_fetch_row_cont() or mysql_store_result_cont() */
+					watch_mysql (rdev, rdev->row_wstatus);
+				}
+				else if (rdev->row_fetched_deferred || rdev->result_stored_deferred || rdev->row_fetch_batched)
+				{
+					/* let the ready() callback deliver the pending row or the next batch */
+					watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+				}
+				else if (rdev->row_fetch_stopped)
+				{
+					/* paused between rows. if called inside the row callback,
+					 * row_fetch_stopped is not set and fetching goes on when
+					 * the callback returns */
+					rdev->row_fetch_stopped = 0;
+					start_fetch_row (rdev);
+				}
+			}
+			return 0;
+		}
+
+		case MIO_DEV_MAR_PREPARE_STMT:
+		{
+			const mio_bcs_t* qstr = (const mio_bcs_t*)arg;
+			mio_dev_mar_stmt_t* stmt;
+			int err, status;
+			mio_syshnd_t syshnd;
+
+			if (!rdev->connected)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "not connected. disallowed to prepare a statement");
+				return -1;
+			}
+
+			if (rdev->res || rdev->row_fetch_stmt)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "operation in progress. disallowed to prepare a statement");
+				return -1;
+			}
+
+			stmt = (mio_dev_mar_stmt_t*)mio_callocmem(mio, MIO_SIZEOF(*stmt));
+			if (MIO_UNLIKELY(!stmt)) return -1;
+
+			stmt->hnd = mysql_stmt_init(rdev->hnd);
+			if (MIO_UNLIKELY(!stmt->hnd))
+			{
+				mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_error(rdev->hnd));
+				mio_freemem (mio, stmt);
+				return -1;
+			}
+			/* link it so that dev_mar_kill() can close it even while being prepared */
+			stmt->dev = rdev;
+			stmt->next = rdev->stmt_list;
+			if (rdev->stmt_list) rdev->stmt_list->prev = stmt;
+			rdev->stmt_list = stmt;
+			rdev->stmt = stmt;
+
+			syshnd = mysql_get_socket(rdev->hnd);
+			status = mysql_stmt_prepare_start(&err, stmt->hnd, qstr->ptr, qstr->len);
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_PREPARING);
+			if (status)
+			{
+				watch_mysql (rdev, status);
+			}
+			else
+			{
+				if (err)
+				{
+					err = mysql_stmt_errno(stmt->hnd);
+					mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(stmt->hnd));
+					free_stmt (rdev, stmt);
+					MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_CONNECTED);
+					if (is_server_lost(err))
+					{
+						const mio_ooch_t* prev_errmsg;
+						prev_errmsg = mio_backuperrmsg(mio);
+						break_connection (rdev, syshnd);
+						mio_seterrbfmt (mio, MIO_ESYSERR, "%js", prev_errmsg);
+					}
+					return -1;
+				}
+
+				/* prepared immediately. postpone actual handling to the ready() callback */
+				rdev->stmt_deferred = 1;
+				rdev->stmt_err = 0;
+				watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+			}
+			return 0;
+		}
+
+		case MIO_DEV_MAR_EXECUTE_STMT:
+		{
+			mio_dev_mar_execute_t* ei = (mio_dev_mar_execute_t*)arg;
+			unsigned long cursor_type, prefetch_rows;
+			int err, status;
+			mio_syshnd_t syshnd;
+
+			if (!rdev->connected)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "not connected. disallowed to execute a statement");
+				return -1;
+			}
+
+			if (rdev->res || rdev->row_fetch_stmt)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "operation in progress. disallowed to execute a statement");
+				return -1;
+			}
+
+			if (ei->stmt->dev != rdev || ei->nparams != ei->stmt->nparams)
+			{
+				mio_seterrbfmt (mio, MIO_EINVAL, "invalid statement or wrong number of parameters - %zu expected", ei->stmt->nparams);
+				return -1;
+			}
+
+			if (bind_stmt_params(rdev, ei->stmt, ei->params) <= -1) return -1;
+
+			/* with a read-only cursor, the server keeps the result set and
+			 * sends as many rows as can be delivered in a wakeup on demand */
+			cursor_type = ei->cursor? CURSOR_TYPE_READ_ONLY: CURSOR_TYPE_NO_CURSOR;
+			prefetch_rows = rdev->row_batch_max;
+			if (mysql_stmt_attr_set(ei->stmt->hnd, STMT_ATTR_CURSOR_TYPE, &cursor_type) ||
+			    mysql_stmt_attr_set(ei->stmt->hnd, STMT_ATTR_PREFETCH_ROWS, &prefetch_rows))
+			{
+				mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(ei->stmt->hnd));
+				return -1;
+			}
+
+			rdev->stmt = ei->stmt;
+			syshnd = mysql_get_socket(rdev->hnd);
+			status = mysql_stmt_execute_start(&err, ei->stmt->hnd);
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_EXECUTING);
+			if (status)
+			{
+				watch_mysql (rdev, status);
+			}
+			else
+			{
+				if (err)
+				{
+					err = mysql_stmt_errno(ei->stmt->hnd);
+					mio_seterrbfmt (mio, MIO_ESYSERR, "%hs", mysql_stmt_error(ei->stmt->hnd));
+					MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_STMT_PREPARED);
+					if (is_server_lost(err))
+					{
+						const mio_ooch_t* prev_errmsg;
+						prev_errmsg = mio_backuperrmsg(mio);
+						break_connection (rdev, syshnd);
+						mio_seterrbfmt (mio, MIO_ESYSERR, "%js", prev_errmsg);
+					}
+					return -1;
+				}
+
+				rdev->stmt_deferred = 1;
+				rdev->stmt_err = 0;
+				watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+			}
+			return 0;
+		}
+
+		case MIO_DEV_MAR_FETCH_STMT_ROWS:
+		case MIO_DEV_MAR_FETCH_STMT_ROWS_BATCHED:
+		{
+			if (!rdev->stmt || MIO_DEV_MAR_GET_PROGRESS(rdev) != MIO_DEV_MAR_STMT_EXECUTED)
+			{
+				mio_seterrbfmt (mio, MIO_EPERM, "no statement executed. disallowed to fetch statement rows");
+				return -1;
+			}
+
+			if (cmd == MIO_DEV_MAR_FETCH_STMT_ROWS_BATCHED)
+			{
+				if (!rdev->on_rows_fetched)
+				{
+					mio_seterrbfmt (mio, MIO_EINVAL, "on_rows_fetched callback not set. disallowed to fetch rows in batches");
+					return -1;
+				}
+
+				if (!rdev->row_batch)
+				{
+					rdev->row_batch = (void**)mio_allocmem(mio, MIO_SIZEOF(*rdev->row_batch) * rdev->row_batch_max);
+					if (MIO_UNLIKELY(!rdev->row_batch)) return -1;
+				}
+			}
+
+			if (bind_stmt_result(rdev, rdev->stmt) <= -1) return -1;
+
+			rdev->row_fetch_stmt = 1;
+			rdev->row_fetch_batched = (cmd == MIO_DEV_MAR_FETCH_STMT_ROWS_BATCHED);
+			rdev->row_fetch_waiting = 0;
+
+			/* postpone fetching to the ready() callback. the socket is idle. 
+			 * watching it for writing triggers the callback in the next wakeup */
+			MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHING);
+			watch_mysql (rdev, MYSQL_WAIT_READ | MYSQL_WAIT_WRITE);
+			return 0;
+		}
+
 		default:
 			mio_seterrnum (mio, MIO_EINVAL);
 			return -1;
@@ -337,6 +1373,8 @@ static mio_dev_mth_t dev_mar_methods =
 	MIO_NULL,
 	MIO_NULL,
 	MIO_NULL, /* sendfile */
+	MIO_NULL, /* splice */
+	MIO_NULL, /* writezc */
 	dev_mar_ioctl
 };
 
@@ -486,60 +1524,48 @@ static int dev_evcb_mar_ready (mio_dev_t* dev, int events)
 
 			break;
 
-		case MIO_DEV_MAR_ROW_FETCHING:
-		{
-			int status;
-			MYSQL_ROW row;
+		case MIO_DEV_MAR_RESULT_STORING:
+			if (store_result(rdev, events) <= -1) return -1;
+			break;
 
-			if (rdev->row_fetched_deferred)
+		case MIO_DEV_MAR_ROW_FETCHING:
+			if (rdev->row_fetch_paused && !(events & (MIO_DEV_EVENT_HUP | MIO_DEV_EVENT_ERR))) break;
+			if (rdev->row_fetch_stmt) 
 			{
-				row = (MYSQL_ROW)rdev->row;
-				rdev->row_fetched_deferred = 0;
-
-				if (!row)
-				{
-					MIO_ASSERT (mio, rdev->res != MIO_NULL);
-					mysql_free_result (rdev->res); /* this doesn't block after the last row */
-					rdev->res = MIO_NULL;
-
-					watch_mysql (rdev, rdev->row_wstatus);
-				}
+				if (fetch_stmt_rows(rdev, events) <= -1) return -1;
+			}
+			else if (rdev->row_fetch_batched) fetch_row_batch (rdev);
+			else if (fetch_rows(rdev, events) <= -1) return -1;
+			break;
 
-				MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
-				if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, row);
+		case MIO_DEV_MAR_STMT_PREPARING:
+		case MIO_DEV_MAR_STMT_EXECUTING:
+		{
+			int err, status;
+			mio_syshnd_t syshnd;
 
-				if (row) start_fetch_row (rdev);
+			syshnd = mysql_get_socket(rdev->hnd);
+			if (rdev->stmt_deferred)
+			{
+				err = rdev->stmt_err;
+				rdev->stmt_deferred = 0;
 			}
 			else
 			{
-				/* TODO: if rdev->res is MIO_NULL, error.. */
-				status = mysql_fetch_row_cont(&row, rdev->res, events_to_mysql_wstatus(events));
-
-				if (!status)
-				{
-					/* row is available */
-					if (!row) 
-					{
-						/* the last row has been received - cleanup before invoking the callback */
-						watch_mysql (rdev, status);
-
-						MIO_ASSERT (mio, rdev->res != MIO_NULL);
-						mysql_free_result (rdev->res); /* this doesn't block after the last row */
-						rdev->res = MIO_NULL;
-					}
-
-					MIO_DEV_MAR_SET_PROGRESS (rdev, MIO_DEV_MAR_ROW_FETCHED);
-					if (MIO_LIKELY(rdev->on_row_fetched)) rdev->on_row_fetched (rdev, row);
-
-					if (row) start_fetch_row (rdev); /* arrange to fetch the next row */
-				}
+				if (MIO_DEV_MAR_GET_PROGRESS(rdev) == MIO_DEV_MAR_STMT_PREPARING)
+					status = mysql_stmt_prepare_cont(&err, rdev->stmt->hnd, events_to_mysql_wstatus(events));
 				else
+					status = mysql_stmt_execute_cont(&err, rdev->stmt->hnd, events_to_mysql_wstatus(events));
+
+				if (status)
 				{
-					/* no row is available */
 					watch_mysql (rdev, status);
+					break;
 				}
 			}
 
+			if (MIO_DEV_MAR_GET_PROGRESS(rdev) == MIO_DEV_MAR_STMT_PREPARING) finish_prepare_stmt (rdev, err, syshnd);
+			else finish_execute_stmt (rdev, err, syshnd);
 			break;
 		}
 
@@ -585,6 +1611,70 @@ int mio_dev_mar_fetchrows (mio_dev_mar_t* dev)
 	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_FETCH_ROW, MIO_NULL);
 }
 
+int mio_dev_mar_fetchrowsbatched (mio_dev_mar_t* dev)
+{
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_FETCH_ROWS_BATCHED, MIO_NULL);
+}
+
+int mio_dev_mar_pausefetch (mio_dev_mar_t* dev)
+{
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_PAUSE_FETCH, MIO_NULL);
+}
+
+int mio_dev_mar_resumefetch (mio_dev_mar_t* dev)
+{
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_RESUME_FETCH, MIO_NULL);
+}
+
+int mio_dev_mar_preparestmt (mio_dev_mar_t* dev, const mio_bch_t* qstr, mio_oow_t qlen)
+{
+	mio_bcs_t bcs = { (mio_bch_t*)qstr, qlen};
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_PREPARE_STMT, &bcs);
+}
+
+int mio_dev_mar_executestmt (mio_dev_mar_t* dev, mio_dev_mar_stmt_t* stmt, const mio_dev_mar_param_t* params, mio_oow_t nparams)
+{
+	mio_dev_mar_execute_t ei;
+	ei.stmt = stmt;
+	ei.params = params;
+	ei.nparams = nparams;
+	ei.cursor = 0;
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_EXECUTE_STMT, &ei);
+}
+
+int mio_dev_mar_executestmtwithcursor (mio_dev_mar_t* dev, mio_dev_mar_stmt_t* stmt, const mio_dev_mar_param_t* params, mio_oow_t nparams)
+{
+	mio_dev_mar_execute_t ei;
+	ei.stmt = stmt;
+	ei.params = params;
+	ei.nparams = nparams;
+	ei.cursor = 1;
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_EXECUTE_STMT, &ei);
+}
+
+int mio_dev_mar_fetchstmtrows (mio_dev_mar_t* dev)
+{
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_FETCH_STMT_ROWS, MIO_NULL);
+}
+
+int mio_dev_mar_fetchstmtrowsbatched (mio_dev_mar_t* dev)
+{
+	return mio_dev_ioctl((mio_dev_t*)dev, MIO_DEV_MAR_FETCH_STMT_ROWS_BATCHED, MIO_NULL);
+}
+
+void mio_dev_mar_closestmt (mio_dev_mar_t* dev, mio_dev_mar_stmt_t* stmt)
+{
+	/* the statement must not be in progress */
+	MIO_ASSERT (dev->mio, stmt->dev == dev);
+	MIO_ASSERT (dev->mio, dev->stmt != stmt || (MIO_DEV_MAR_GET_PROGRESS(dev) != MIO_DEV_MAR_STMT_PREPARING && MIO_DEV_MAR_GET_PROGRESS(dev) != MIO_DEV_MAR_STMT_EXECUTING && !dev->row_fetch_stmt));
+	free_stmt (dev, stmt);
+}
+
+mio_oow_t mio_dev_mar_getstmtfieldcount (mio_dev_mar_stmt_t* stmt)
+{
+	return stmt->nfields;
+}
+
 mio_oow_t mio_dev_mar_escapebchars (mio_dev_mar_t* dev, const mio_bch_t* qstr, mio_oow_t qlen, mio_bch_t* buf)
 {
 	mio_dev_mar_t* rdev = (mio_dev_mar_t*)dev;
@@ -408,11 +408,21 @@ enum mio_svc_dnc_resolve_flag_t
 	MIO_SVC_DNC_RESOLVE_FLAG_BRIEF      = (1 << 8),
 	MIO_SVC_DNC_RESOLVE_FLAG_COOKIE     = (1 << 9),
 	MIO_SVC_DNC_RESOLVE_FLAG_DNSSEC     = (1 << 10),
+	MIO_SVC_DNC_RESOLVE_FLAG_NO_CACHE   = (1 << 11), /* don't answer from the cache. the fresh response still gets cached */
 
-	MIO_SVC_DNC_RESOLVE_FLAG_ALL = (MIO_SVC_DNC_RESOLVE_FLAG_PREFER_TCP | MIO_SVC_DNC_RESOLVE_FLAG_TCP_IF_TC | MIO_SVC_DNC_RESOLVE_FLAG_BRIEF | MIO_SVC_DNC_RESOLVE_FLAG_COOKIE | MIO_SVC_DNC_RESOLVE_FLAG_DNSSEC)
+	MIO_SVC_DNC_RESOLVE_FLAG_ALL = (MIO_SVC_DNC_RESOLVE_FLAG_PREFER_TCP | MIO_SVC_DNC_RESOLVE_FLAG_TCP_IF_TC | MIO_SVC_DNC_RESOLVE_FLAG_BRIEF | MIO_SVC_DNC_RESOLVE_FLAG_COOKIE | MIO_SVC_DNC_RESOLVE_FLAG_DNSSEC | MIO_SVC_DNC_RESOLVE_FLAG_NO_CACHE)
 };
 typedef enum mio_svc_dnc_resolve_flag_t  mio_svc_dnc_resolve_flag_t;
 
+/* the maximum number of responses cached by mio_svc_dnc_resolve() */
+#define MIO_SVC_DNC_CACHE_CAPA_DEFAULT (1024)
+/* upper limit of the time to cache a positive response in seconds */
+#define MIO_SVC_DNC_CACHE_MAX_TTL (86400)
+/* upper limit of the time to cache a negative response in seconds. RFC2308 */
+#define MIO_SVC_DNC_CACHE_MAX_NEG_TTL (10800)
+/* number of seconds to keep an idle tcp connection to a server */
+#define MIO_SVC_DNC_TCP_IDLE_TMOUT_DEFAULT (10)
+
 /* ---------------------------------------------------------------- */
 
 #define MIO_DNS_COOKIE_CLIENT_LEN (8)
@@ -440,6 +450,17 @@ struct mio_dns_cookie_t
 
 /* ---------------------------------------------------------------- */
 
+struct mio_dns_pkt_edns_t
+{
+	int exist;
+	mio_uint16_t uplen; /* udp payload len - will be placed in the qclass field of RR. */
+	mio_uint8_t  xrcode; /* upper 8 bits of the extended rcode */
+	mio_uint8_t  version; 
+	mio_uint8_t  dnssecok;
+	mio_dns_cookie_t cookie;
+};
+typedef struct mio_dns_pkt_edns_t mio_dns_pkt_edns_t;
+
 struct mio_dns_pkt_info_t
 {
 	/* the following 5 fields are internal use only */
@@ -452,14 +473,7 @@ struct mio_dns_pkt_info_t
 	/* you may access the following fields */
 	mio_dns_bhdr_t hdr;
 
-	struct
-	{
-		int exist;
-		mio_uint16_t uplen; /* udp payload len - will be placed in the qclass field of RR. */
-		mio_uint8_t  version; 
-		mio_uint8_t  dnssecok;
-		mio_dns_cookie_t cookie;
-	} edns;
+	mio_dns_pkt_edns_t edns;
 
 	mio_uint16_t qdcount; /* number of questions */
 	mio_uint16_t ancount; /* number of answers (answer part) */
@@ -477,6 +491,52 @@ struct mio_dns_pkt_info_t
 };
 typedef struct mio_dns_pkt_info_t mio_dns_pkt_info_t;
 
+/* cursor to walk through the records of a packet in place. the cursor 
+ * doesn't copy the packet. so the packet must stay while the cursor is
+ * used. a cursor may be copied to remember a position. */
+struct mio_dns_pkt_cur_t
+{
+	/* the following 4 fields are internal use only */
+	const mio_uint8_t* _start;
+	const mio_uint8_t* _end;
+	const mio_uint8_t* _ptr;
+	mio_uint16_t _left; /* number of records left in the current section */
+	int _sect; /* 0: question, 1: answer, 2: authority, 3: additional */
+
+	/* you may access the following fields */
+	mio_dns_bhdr_t hdr; /* rcode holds the lower 4 bits of the extended rcode only */
+	mio_uint16_t qdcount;
+	mio_uint16_t ancount;
+	mio_uint16_t nscount;
+	mio_uint16_t arcount;
+};
+typedef struct mio_dns_pkt_cur_t mio_dns_pkt_cur_t;
+
+/* question pointed to by a cursor */
+struct mio_dns_cqr_t
+{
+	mio_oow_t    qnameoff; /* offset to the name in the packet. the name may be compressed */
+	mio_uint16_t qtype;
+	mio_uint16_t qclass;
+};
+typedef struct mio_dns_cqr_t mio_dns_cqr_t;
+
+/* resource record pointed to by a cursor */
+struct mio_dns_crr_t
+{
+	mio_dns_rr_part_t  part;
+	mio_oow_t          rrnameoff; /* offset to the name in the packet. the name may be compressed */
+	mio_uint16_t       rrtype;
+	mio_uint16_t       rrclass;
+	mio_uint32_t       ttl;
+	mio_uint16_t       dlen;
+	const mio_uint8_t* dptr; /* data in the packet. the names in the data may be compressed */
+};
+typedef struct mio_dns_crr_t mio_dns_crr_t;
+
+/* the buffer size large enough to decode any resource record pointed to by a cursor */
+#define MIO_DNS_CRR_DECODE_BUF_LEN (1024)
+
 
 /* ---------------------------------------------------------------- */
 
@@ -497,6 +557,45 @@ MIO_EXPORT void mio_svc_dnc_stop (
 	mio_svc_dnc_t* dnc
 );
 
+/**
+ * The mio_svc_dnc_addserv() function adds an upstream server in addition
+ * to the server given to mio_svc_dnc_start(). The address family must
+ * match that of the first server. A question goes to the server with the
+ * lowest smoothed round-trip time among those not failing. A server failing
+ * to reply a few times in a row is put on hold for a while. A question not
+ * answered in time is sent again to the next best server.
+ */
+MIO_EXPORT int mio_svc_dnc_addserv (
+	mio_svc_dnc_t*     dnc,
+	const mio_skad_t*  serv_addr
+);
+
+/**
+ * The mio_svc_dnc_settcpidletmout() function sets how long to keep a tcp
+ * connection to a server with no requests outstanding. Requests over tcp
+ * to the same server share a single connection and are pipelined on it.
+ * A question outstanding on a connection closed by the server is sent
+ * again once over a new connection. MIO_NULL or zero keeps the connection
+ * until the server closes it. The default is 
+ * #MIO_SVC_DNC_TCP_IDLE_TMOUT_DEFAULT seconds.
+ */
+MIO_EXPORT void mio_svc_dnc_settcpidletmout (
+	mio_svc_dnc_t*     dnc,
+	const mio_ntime_t* tmout
+);
+
+/**
+ * The mio_svc_dnc_sethedgedelay() function makes the service send the same
+ * question over udp to the second best server if no reply arrives from the
+ * first server within \a delay. The first reply from either server is taken.
+ * The delay must be shorter than the reply timeout to take effect. MIO_NULL
+ * or zero disables hedging, which is the default.
+ */
+MIO_EXPORT void mio_svc_dnc_sethedgedelay (
+	mio_svc_dnc_t*     dnc,
+	const mio_ntime_t* delay
+);
+
 #if defined(MIO_HAVE_INLINE)
 static MIO_INLINE mio_t* mio_svc_dns_getmio(mio_svc_dns_t* svc) { return mio_svc_getmio((mio_svc_t*)svc); }
 static MIO_INLINE mio_t* mio_svc_dnc_getmio(mio_svc_dnc_t* svc) { return mio_svc_getmio((mio_svc_t*)svc); }
@@ -531,6 +630,17 @@ MIO_EXPORT mio_dns_msg_t* mio_svc_dnc_sendreq (
 );
 
 
+/**
+ * The mio_svc_dnc_resolve() function sends a question and invokes
+ * \a on_resolve upon a response. A response is served from the cache
+ * if a valid response for the same name, type and the cookie/dnssec 
+ * flags has been cached. TTLs in the records served are reduced by the
+ * time elapsed since caching. Negative responses(NXDOMAIN and NODATA)
+ * are cached for the time given in the SOA record as specified in 
+ * RFC2308. If a question for the same key is already in flight, the new
+ * request waits for the same response without sending another question.
+ * The callback is never invoked before this function returns.
+ */
 MIO_EXPORT mio_dns_msg_t* mio_svc_dnc_resolve (
 	mio_svc_dnc_t*           dnc,
 	const mio_bch_t*         qname,
@@ -540,6 +650,23 @@ MIO_EXPORT mio_dns_msg_t* mio_svc_dnc_resolve (
 	mio_oow_t                xtnsize
 );
 
+/**
+ * The mio_svc_dnc_setcachecapa() function sets the maximum number of
+ * responses to cache. 0 disables caching. Requests in flight are still
+ * coalesced when caching is disabled.
+ */
+MIO_EXPORT void mio_svc_dnc_setcachecapa (
+	mio_svc_dnc_t*           dnc,
+	mio_oow_t                capa
+);
+
+/**
+ * The mio_svc_dnc_purgecache() function drops all cached responses.
+ */
+MIO_EXPORT void mio_svc_dnc_purgecache (
+	mio_svc_dnc_t*           dnc
+);
+
 /*
  * -1: cookie in the request but no client cookie in the response. this may be ok or not ok depending on your policy 
  * 0: client cookie mismatch in the request in the response
@@ -552,6 +679,72 @@ MIO_EXPORT int mio_svc_dnc_checkclientcookie (
 	mio_dns_pkt_info_t* respi
 );
 
+/**
+ * The mio_svc_dnc_checkclientcookieinpkt() function is the same as
+ * mio_svc_dnc_checkclientcookie() except that it inspects the response
+ * packet in place without decoding it. It returns 0 for a malformed 
+ * response packet.
+ */
+MIO_EXPORT int mio_svc_dnc_checkclientcookieinpkt (
+	mio_svc_dnc_t*       dnc,
+	mio_dns_msg_t*       reqmsg,
+	const mio_dns_pkt_t* respkt,
+	mio_oow_t            respktlen
+);
+
+/**
+ * The mio_svc_dnc_getresolvextn() function returns the pointer to the
+ * extension area of the size requested in mio_svc_dnc_resolve().
+ */
+MIO_EXPORT void* mio_svc_dnc_getresolvextn (
+	mio_dns_msg_t*      reqmsg
+);
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * The mio_svc_dns_start() function starts a dns server service listening
+ * on \a bind_addr over both udp and tcp. A question is answered from the
+ * zone store populated with mio_svc_dns_addrr(). A question for a name
+ * outside the zones is sent to the forwarder set with
+ * mio_svc_dns_setforwarder() or refused if no forwarder is set.
+ */
+MIO_EXPORT mio_svc_dns_t* mio_svc_dns_start (
+	mio_t*             mio,
+	const mio_skad_t*  bind_addr
+);
+
+MIO_EXPORT void mio_svc_dns_stop (
+	mio_svc_dns_t* dns
+);
+
+/**
+ * The mio_svc_dns_addrr() function adds a resource record to the zone
+ * store. A name holding a SOA record becomes the apex of a zone and the
+ * service answers authoritatively for the names under it, including
+ * NXDOMAIN and NODATA with the SOA record in the authority section.
+ * Records for a name outside the zones are answered without the
+ * authoritative bit. The record data is encoded upon addition and each
+ * answer is composed by copying the encoded records. Only the IN class
+ * is supported. Adding a record with the same data updates the ttl and
+ * adding a SOA record replaces the existing one.
+ */
+MIO_EXPORT int mio_svc_dns_addrr (
+	mio_svc_dns_t*        dns,
+	const mio_dns_brr_t*  rr
+);
+
+/**
+ * The mio_svc_dns_setforwarder() function sets the client service used
+ * to resolve questions not answered from the zone store. The answers are
+ * cached by the client service. MIO_NULL disables forwarding. The client
+ * service must stay alive while it is set.
+ */
+MIO_EXPORT void mio_svc_dns_setforwarder (
+	mio_svc_dns_t*        dns,
+	mio_svc_dnc_t*        dnc
+);
+
 /* ---------------------------------------------------------------- */
 
 MIO_EXPORT mio_dns_pkt_info_t* mio_dns_make_pkt_info (
@@ -565,6 +758,86 @@ MIO_EXPORT void mio_dns_free_pkt_info (
 	mio_dns_pkt_info_t*   pi
 );
 
+/**
+ * The mio_dns_init_pkt_cur() function initializes a cursor to walk through
+ * the packet \a pkt of the length \a len without decoding it in advance.
+ * Unlike mio_dns_make_pkt_info(), it doesn't allocate memory. It returns 0
+ * on success and -1 if the packet is shorter than the header.
+ */
+MIO_EXPORT int mio_dns_init_pkt_cur (
+	mio_dns_pkt_cur_t*    cur,
+	const mio_dns_pkt_t*  pkt,
+	mio_oow_t             len
+);
+
+/**
+ * The mio_dns_next_qr_in_pkt_cur() function moves the cursor to the next
+ * question. It returns 1 if a question is stored in \a qr, 0 if there are
+ * no more questions and -1 if the packet is malformed.
+ */
+MIO_EXPORT int mio_dns_next_qr_in_pkt_cur (
+	mio_dns_pkt_cur_t*    cur,
+	mio_dns_cqr_t*        qr
+);
+
+/**
+ * The mio_dns_next_rr_in_pkt_cur() function moves the cursor to the next
+ * resource record in the answer, authority and additional sections in order,
+ * skipping the questions not visited. It returns 1 if a record is stored 
+ * in \a rr, 0 if there are no more records and -1 if the packet is malformed.
+ * The names are not decoded. Use mio_dns_decode_name_in_pkt_cur() or
+ * mio_dns_decode_rr_in_pkt_cur() when they are needed.
+ */
+MIO_EXPORT int mio_dns_next_rr_in_pkt_cur (
+	mio_dns_pkt_cur_t*    cur,
+	mio_dns_crr_t*        rr
+);
+
+/**
+ * The mio_dns_decode_name_in_pkt_cur() function decodes the name at the
+ * offset \a off of the packet into \a buf in the dotted form, following
+ * compression pointers. The root name is decoded to an empty string. 
+ * If \a buf is #MIO_NULL, the name is validated without being copied.
+ * If \a endoff is not #MIO_NULL, it is set to the offset right after the
+ * name at \a off. It returns the length of the decoded name on success and
+ * -1 if the name is malformed or the buffer is too small.
+ */
+MIO_EXPORT mio_ooi_t mio_dns_decode_name_in_pkt_cur (
+	const mio_dns_pkt_cur_t* cur,
+	mio_oow_t                off,
+	mio_bch_t*               buf,
+	mio_oow_t                bufsz,
+	mio_oow_t*               endoff
+);
+
+/**
+ * The mio_dns_decode_rr_in_pkt_cur() function decodes the resource record
+ * \a rr obtained with mio_dns_next_rr_in_pkt_cur() into \a brr in the same
+ * form as mio_dns_make_pkt_info() produces. The name and the data containing
+ * names are decoded into \a buf that must be aligned for a structure. The
+ * data of other types points to the packet. A buffer of 
+ * #MIO_DNS_CRR_DECODE_BUF_LEN bytes is always large enough. It returns 0 on
+ * success and -1 on failure.
+ */
+MIO_EXPORT int mio_dns_decode_rr_in_pkt_cur (
+	const mio_dns_pkt_cur_t* cur,
+	const mio_dns_crr_t*     rr,
+	mio_dns_brr_t*           brr,
+	void*                    buf,
+	mio_oow_t                bufsz
+);
+
+/**
+ * The mio_dns_get_edns_in_pkt_cur() function finds the OPT pseudo-RR in
+ * the additional section and stores its information in \a edns. edns->exist
+ * is set to 0 if there is none. The cursor is not moved. It returns 0 on
+ * success and -1 if the packet is malformed.
+ */
+MIO_EXPORT int mio_dns_get_edns_in_pkt_cur (
+	const mio_dns_pkt_cur_t* cur,
+	mio_dns_pkt_edns_t*      edns
+);
+
 /* ---------------------------------------------------------------- */
 
 #if defined(MIO_HAVE_INLINE)
@@ -232,7 +232,16 @@ enum mio_htb_style_kind_t
 	/** copy the key into the pair but store the value pointer */
 	MIO_HTB_STYLE_INLINE_KEY_COPIER,
 	/** copy the value into the pair but store the key pointer */
-	MIO_HTB_STYLE_INLINE_VALUE_COPIER
+	MIO_HTB_STYLE_INLINE_VALUE_COPIER,
+
+	/** #MIO_HTB_STYLE_DEFAULT with the keyed hasher */
+	MIO_HTB_STYLE_KEYED,
+	/** #MIO_HTB_STYLE_INLINE_COPIERS with the keyed hasher */
+	MIO_HTB_STYLE_INLINE_COPIERS_KEYED,
+	/** #MIO_HTB_STYLE_INLINE_KEY_COPIER with the keyed hasher */
+	MIO_HTB_STYLE_INLINE_KEY_COPIER_KEYED,
+	/** #MIO_HTB_STYLE_INLINE_VALUE_COPIER with the keyed hasher */
+	MIO_HTB_STYLE_INLINE_VALUE_COPIER_KEYED
 };
 
 typedef enum mio_htb_style_kind_t  mio_htb_style_kind_t;
@@ -248,6 +257,7 @@ struct mio_htb_t
 
 	mio_uint8_t     scale[2]; /**< length scale */
 	mio_uint8_t     factor;   /**< load factor in percentage */
+	mio_uint8_t     keyed;    /**< the default hasher switched to the keyed hash */
 
 	mio_oow_t       size;
 	mio_oow_t       capa;
@@ -282,6 +292,7 @@ typedef struct mio_htb_itr_t mio_htb_itr_t;
 #define MIO_HTB_KEEPER_DEFAULT (MIO_NULL)
 #define MIO_HTB_SIZER_DEFAULT  (MIO_NULL)
 #define MIO_HTB_HASHER_DEFAULT (mio_htb_dflhash)
+#define MIO_HTB_HASHER_KEYED   (mio_htb_keyedhash)
 
 /**
  * The MIO_HTB_SIZE() macro returns the number of pairs in a hash table.
@@ -656,7 +667,10 @@ MIO_EXPORT void mio_htb_freepair (
 );
 
 /**
- * The mio_htb_dflhash() function is a default hash function.
+ * The mio_htb_dflhash() function is a default hash function. It begins
+ * with a fast unkeyed hash. When an insertion finds a chain grown too
+ * long, the table switches to mio_htb_keyedhash() and rehashes all pairs
+ * so that crafted keys can't keep colliding.
  */
 MIO_EXPORT mio_oow_t mio_htb_dflhash (
 	const mio_htb_t*  htb,
@@ -664,6 +678,17 @@ MIO_EXPORT mio_oow_t mio_htb_dflhash (
 	mio_oow_t        klen
 );
 
+/**
+ * The mio_htb_keyedhash() function computes SipHash-2-4 of a key with
+ * the random key of the #mio_t object associated with the table. Use it
+ * for a table that always holds keys from untrusted sources.
+ */
+MIO_EXPORT mio_oow_t mio_htb_keyedhash (
+	const mio_htb_t*  htb,
+	const void*       kptr,
+	mio_oow_t        klen
+);
+
 /**
  * The mio_htb_dflcomp() function is default comparator.
  */
@@ -0,0 +1,513 @@
+/*
+ * $Id$
+ *
+    Copyright (c) 2016-2020 Chung, Hyung-Hwan. All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions
+    are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+    IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+    OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+    INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+    THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MIO_HTO_H_
+#define _MIO_HTO_H_
+
+#include <mio.h>
+
+/**@file
+ * This file provides an open-addressing hash table encapsulated in the
+ * #mio_hto_t type. Unlike #mio_htb_t that allocates a pair per key and
+ * chains pairs under a bucket, it keeps pairs in a flat slot array and
+ * a parallel array of one-byte control codes. A control code holds 7 bits
+ * of the key hash for an occupied slot, which lets a lookup test a group
+ * of 16 slots at once and compare the key only on a probable hit.
+ *
+ * The key and value copiers behave the same as those of #mio_htb_t except
+ * that #MIO_HTO_COPIER_INLINE places small data in the slot itself instead
+ * of allocating memory. Keys are hashed with SipHash-2-4 keyed with the
+ * random key of the associated #mio_t object by default.
+ *
+ * Pairs move when the table grows. A pair pointer returned by a function
+ * is valid until the next insertion into the same table.
+ *
+ * @code
+ * #include <mio-hto.h>
+ *
+ * static mio_hto_walk_t walk (mio_hto_t* hto, mio_hto_pair_t* pair, void* ctx)
+ * {
+ *   printf ("key = %d, value = %d\n",
+ *     *(int*)MIO_HTO_KPTR(pair), *(int*)MIO_HTO_VPTR(pair));
+ *   return MIO_HTO_WALK_FORWARD;
+ * }
+ *
+ * int main ()
+ * {
+ *   mio_t* mio;
+ *   mio_hto_t* s1;
+ *   int i;
+ *
+ *   mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 512, MIO_NULL); // error handling skipped
+ *   s1 = mio_hto_open(mio, 0, 30, 1, 1); // error handling skipped
+ *   mio_hto_setstyle (s1, mio_get_hto_style(MIO_HTO_STYLE_INLINE_COPIERS));
+ *
+ *   for (i = 0; i < 20; i++)
+ *   {
+ *     int x = i * 20;
+ *     mio_hto_insert (s1, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x)); // error handling skipped
+ *   }
+ *
+ *   mio_hto_walk (s1, walk, MIO_NULL);
+ *
+ *   mio_hto_close (s1);
+ *   mio_close (mio);
+ *   return 0;
+ * }
+ * @endcode
+ */
+
+typedef struct mio_hto_t mio_hto_t;
+typedef struct mio_hto_pair_t mio_hto_pair_t;
+
+/**
+ * The mio_hto_walk_t type defines values that the callback function can
+ * return to control mio_hto_walk().
+ */
+enum mio_hto_walk_t
+{
+	MIO_HTO_WALK_STOP    = 0,
+	MIO_HTO_WALK_FORWARD = 1
+};
+typedef enum mio_hto_walk_t mio_hto_walk_t;
+
+/**
+ * The mio_hto_id_t type defines IDs to indicate a key or a value in various
+ * functions.
+ */
+enum mio_hto_id_t
+{
+	MIO_HTO_KEY = 0,
+	MIO_HTO_VAL = 1
+};
+typedef enum mio_hto_id_t mio_hto_id_t;
+
+/**
+ * The mio_hto_copier_t type defines a pair contruction callback.
+ * Two special copiers #MIO_HTO_COPIER_SIMPLE and #MIO_HTO_COPIER_INLINE
+ * are provided.
+ */
+typedef void* (*mio_hto_copier_t) (
+	mio_hto_t* hto  /* hash table */,
+	void*      dptr /* pointer to a key or a value */,
+	mio_oow_t  dlen /* length of a key or a value */
+);
+
+/**
+ * The mio_hto_freeer_t defines a key/value destruction callback.
+ * The freeer is called when a pair containing the element is destroyed.
+ */
+typedef void (*mio_hto_freeer_t) (
+	mio_hto_t* hto,  /**< hash table */
+	void*      dptr, /**< pointer to a key or a value */
+	mio_oow_t  dlen  /**< length of a key or a value */
+);
+
+/**
+ * The mio_hto_comper_t type defines a key comparator that is called when
+ * the table needs to compare keys. It should return 0 if the keys are the
+ * same and a non-zero integer otherwise.
+ */
+typedef int (*mio_hto_comper_t) (
+	const mio_hto_t* hto,    /**< hash table */
+	const void*      kptr1,  /**< key pointer */
+	mio_oow_t        klen1,  /**< key length */
+	const void*      kptr2,  /**< key pointer */
+	mio_oow_t        klen2   /**< key length */
+);
+
+/**
+ * The mio_hto_keeper_t type defines a value keeper that is called when
+ * a value is retained in the context that it should be destroyed because
+ * it is identical to a new value.
+ */
+typedef void (*mio_hto_keeper_t) (
+	mio_hto_t* hto,    /**< hash table */
+	void*      vptr,   /**< value pointer */
+	mio_oow_t  vlen    /**< value length */
+);
+
+/**
+ * The mio_hto_hasher_t type defines a key hash function. The table uses
+ * the lowest 7 bits of the hash value in the control code of a slot and
+ * the remaining bits to choose where probing begins.
+ */
+typedef mio_oow_t (*mio_hto_hasher_t) (
+	const mio_hto_t*  hto,   /**< hash table */
+	const void*       kptr,  /**< key pointer */
+	mio_oow_t         klen   /**< key length in bytes */
+);
+
+/**
+ * The mio_hto_walker_t defines a pair visitor. It must not insert
+ * or delete a pair.
+ */
+typedef mio_hto_walk_t (*mio_hto_walker_t) (
+	mio_hto_t*      hto,   /**< hash table */
+	mio_hto_pair_t* pair,  /**< pointer to a key/value pair */
+	void*           ctx    /**< pointer to user-defined data */
+);
+
+/**
+ * The MIO_HTO_IBUF_SIZE macro defines the size of the space within a slot
+ * where #MIO_HTO_COPIER_INLINE places the key and the value if they fit.
+ */
+#define MIO_HTO_IBUF_SIZE 32
+
+/**
+ * The mio_hto_pair_t type defines a hash table pair stored in a slot.
+ */
+struct mio_hto_pair_t
+{
+	mio_ptl_t key;
+	mio_ptl_t val;
+
+	/* inline data space for the inline copier */
+	mio_uint8_t ibuf[MIO_HTO_IBUF_SIZE];
+};
+
+typedef struct mio_hto_style_t mio_hto_style_t;
+
+struct mio_hto_style_t
+{
+	mio_hto_copier_t copier[2];
+	mio_hto_freeer_t freeer[2];
+	mio_hto_comper_t comper;   /**< key comparator */
+	mio_hto_keeper_t keeper;   /**< value keeper */
+	mio_hto_hasher_t hasher;   /**< key hasher */
+};
+
+/**
+ * The mio_hto_style_kind_t type defines the type of predefined
+ * callback set for pair manipulation.
+ */
+enum mio_hto_style_kind_t
+{
+	/** store the key and the value pointer */
+	MIO_HTO_STYLE_DEFAULT,
+	/** copy both key and value into the pair */
+	MIO_HTO_STYLE_INLINE_COPIERS,
+	/** copy the key into the pair but store the value pointer */
+	MIO_HTO_STYLE_INLINE_KEY_COPIER,
+	/** copy the value into the pair but store the key pointer */
+	MIO_HTO_STYLE_INLINE_VALUE_COPIER
+};
+typedef enum mio_hto_style_kind_t  mio_hto_style_kind_t;
+
+/**
+ * The mio_hto_t type defines an open-addressing hash table.
+ */
+struct mio_hto_t
+{
+	mio_t* mio;
+
+	const mio_hto_style_t* style;
+
+	mio_uint8_t     scale[2]; /**< length scale */
+	mio_uint8_t     seed[16]; /**< key for the default hasher */
+
+	mio_oow_t       size;     /**< number of pairs */
+	mio_oow_t       capa;     /**< number of slots. multiple of 16 */
+	mio_oow_t       tombs;    /**< number of slots marked deleted */
+	mio_oow_t       threshold;
+
+	mio_uint8_t*    ctrl;     /**< control code per slot */
+	mio_hto_pair_t* slot;
+};
+
+struct mio_hto_itr_t
+{
+	mio_oow_t       slotno;
+};
+typedef struct mio_hto_itr_t mio_hto_itr_t;
+
+/**
+ * The MIO_HTO_COPIER_SIMPLE macros defines a copier that remembers the
+ * pointer and length of data in a pair.
+ **/
+#define MIO_HTO_COPIER_SIMPLE ((mio_hto_copier_t)1)
+
+/**
+ * The MIO_HTO_COPIER_INLINE macros defines a copier that copies data into
+ * a pair. The data is placed inside the slot if it fits in
+ * #MIO_HTO_IBUF_SIZE bytes together with the other inlined item.
+ **/
+#define MIO_HTO_COPIER_INLINE ((mio_hto_copier_t)2)
+
+#define MIO_HTO_COPIER_DEFAULT (MIO_HTO_COPIER_SIMPLE)
+#define MIO_HTO_FREEER_DEFAULT (MIO_NULL)
+#define MIO_HTO_COMPER_DEFAULT (mio_hto_dflcomp)
+#define MIO_HTO_KEEPER_DEFAULT (MIO_NULL)
+#define MIO_HTO_HASHER_DEFAULT (mio_hto_dflhash)
+
+#define MIO_HTO_SIZE(m) (*(const mio_oow_t*)&(m)->size)
+#define MIO_HTO_CAPA(m) (*(const mio_oow_t*)&(m)->capa)
+
+#define MIO_HTO_KSCALE(m) (*(const int*)&(m)->scale[MIO_HTO_KEY])
+#define MIO_HTO_VSCALE(m) (*(const int*)&(m)->scale[MIO_HTO_VAL])
+
+#define MIO_HTO_KPTL(p) (&(p)->key)
+#define MIO_HTO_VPTL(p) (&(p)->val)
+
+#define MIO_HTO_KPTR(p) ((p)->key.ptr)
+#define MIO_HTO_KLEN(p) ((p)->key.len)
+#define MIO_HTO_VPTR(p) ((p)->val.ptr)
+#define MIO_HTO_VLEN(p) ((p)->val.len)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * The mio_get_hto_style() functions returns a predefined callback set for
+ * pair manipulation.
+ */
+MIO_EXPORT const mio_hto_style_t* mio_get_hto_style (
+	mio_hto_style_kind_t kind
+);
+
+/**
+ * The mio_hto_open() function creates an open-addressing hash table.
+ * The initial capacity @a capa is the number of pairs the table can hold
+ * before it grows for the first time. The @a kscale and @a vscale
+ * parameters specify the unit of the key and value size.
+ * @return #mio_hto_t pointer on success, #MIO_NULL on failure.
+ */
+MIO_EXPORT mio_hto_t* mio_hto_open (
+	mio_t*      mio,
+	mio_oow_t   xtnsize, /**< extension size in bytes */
+	mio_oow_t   capa,    /**< initial capacity */
+	int         kscale,  /**< key scale - 1 to 255 */
+	int         vscale   /**< value scale - 1 to 255 */
+);
+
+/**
+ * The mio_hto_close() function destroys a hash table.
+ */
+MIO_EXPORT void mio_hto_close (
+	mio_hto_t* hto /**< hash table */
+);
+
+/**
+ * The mio_hto_init() function initializes a hash table
+ */
+MIO_EXPORT int mio_hto_init (
+	mio_hto_t*  hto,     /**< hash table */
+	mio_t*      mio,
+	mio_oow_t   capa,    /**< initial capacity */
+	int         kscale,  /**< key scale */
+	int         vscale   /**< value scale */
+);
+
+/**
+ * The mio_hto_fini() funtion finalizes a hash table
+ */
+MIO_EXPORT void mio_hto_fini (
+	mio_hto_t* hto
+);
+
+#if defined(MIO_HAVE_INLINE)
+static MIO_INLINE void* mio_hto_getxtn (mio_hto_t* hto) { return (void*)(hto + 1); }
+#else
+#define mio_hto_getxtn(hto) ((void*)((mio_hto_t*)(hto) + 1))
+#endif
+
+/**
+ * The mio_hto_getstyle() function gets manipulation callback function set.
+ */
+MIO_EXPORT const mio_hto_style_t* mio_hto_getstyle (
+	const mio_hto_t* hto /**< hash table */
+);
+
+/**
+ * The mio_hto_setstyle() function sets internal manipulation callback
+ * functions for data construction, destruction, hashing, etc. The callback
+ * structure pointed to by \a style must outlive the hash table. Change the
+ * style while the table is empty.
+ */
+MIO_EXPORT void mio_hto_setstyle (
+	mio_hto_t*              hto,  /**< hash table */
+	const mio_hto_style_t*  style /**< callback function set */
+);
+
+/**
+ * The mio_hto_getsize() function gets the number of pairs in hash table.
+ */
+MIO_EXPORT mio_oow_t mio_hto_getsize (
+	const mio_hto_t* hto
+);
+
+/**
+ * The mio_hto_getcapa() function gets the number of slots allocated.
+ */
+MIO_EXPORT mio_oow_t mio_hto_getcapa (
+	const mio_hto_t* hto /**< hash table */
+);
+
+/**
+ * The mio_hto_search() function searches a hash table to find a pair with a
+ * matching key.
+ * @return pointer to the pair with a maching key,
+ *         or #MIO_NULL if no match is found.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_search (
+	const mio_hto_t* hto,   /**< hash table */
+	const void*      kptr,  /**< key pointer */
+	mio_oow_t        klen   /**< key length */
+);
+
+/**
+ * The mio_hto_upsert() function searches a hash table for the pair with a
+ * matching key. If one is found, it updates the pair. Otherwise, it inserts
+ * a new pair with the key and value given.
+ * @return pointer to the updated or inserted pair on success,
+ *         #MIO_NULL on failure.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_upsert (
+	mio_hto_t* hto,   /**< hash table */
+	void*      kptr,  /**< key pointer */
+	mio_oow_t  klen,  /**< key length */
+	void*      vptr,  /**< value pointer */
+	mio_oow_t  vlen   /**< value length */
+);
+
+/**
+ * The mio_hto_ensert() function inserts a new pair with the key and the value
+ * given. If there exists a pair with the key given, the function returns
+ * the pair containing the key.
+ * @return pointer to a pair on success, #MIO_NULL on failure.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_ensert (
+	mio_hto_t* hto,   /**< hash table */
+	void*      kptr,  /**< key pointer */
+	mio_oow_t  klen,  /**< key length */
+	void*      vptr,  /**< value pointer */
+	mio_oow_t  vlen   /**< value length */
+);
+
+/**
+ * The mio_hto_insert() function inserts a new pair with the key and the value
+ * given. If there exists a pair with the key given, the function returns
+ * #MIO_NULL without channging the value.
+ * @return pointer to the pair created on success, #MIO_NULL on failure.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_insert (
+	mio_hto_t* hto,   /**< hash table */
+	void*      kptr,  /**< key pointer */
+	mio_oow_t  klen,  /**< key length */
+	void*      vptr,  /**< value pointer */
+	mio_oow_t  vlen   /**< value length */
+);
+
+/**
+ * The mio_hto_update() function updates the value of an existing pair
+ * with a matching key.
+ * @return pointer to the pair on success, #MIO_NULL on no matching pair
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_update (
+	mio_hto_t* hto,   /**< hash table */
+	void*      kptr,  /**< key pointer */
+	mio_oow_t  klen,  /**< key length */
+	void*      vptr,  /**< value pointer */
+	mio_oow_t  vlen   /**< value length */
+);
+
+/**
+ * The mio_hto_delete() function deletes a pair with a matching key
+ * @return 0 on success, -1 on failure
+ */
+MIO_EXPORT int mio_hto_delete (
+	mio_hto_t*  hto,  /**< hash table */
+	const void* kptr, /**< key pointer */
+	mio_oow_t   klen  /**< key length */
+);
+
+/**
+ * The mio_hto_clear() function empties a hash table. It keeps the slots
+ * allocated.
+ */
+MIO_EXPORT void mio_hto_clear (
+	mio_hto_t* hto /**< hash table */
+);
+
+/**
+ * The mio_hto_walk() function traverses a hash table.
+ */
+MIO_EXPORT void mio_hto_walk (
+	mio_hto_t*       hto,    /**< hash table */
+	mio_hto_walker_t walker, /**< callback function for each pair */
+	void*            ctx     /**< pointer to user-specific data */
+);
+
+MIO_EXPORT void mio_init_hto_itr (
+	mio_hto_itr_t* itr
+);
+
+/**
+ * The mio_hto_getfirstpair() function returns the pointer to the first pair
+ * in a hash table.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_getfirstpair (
+	mio_hto_t*     hto,   /**< hash table */
+	mio_hto_itr_t* itr    /**< iterator*/
+);
+
+/**
+ * The mio_hto_getnextpair() function returns the pointer to the pair
+ * next to the one last returned for the iterator @a itr.
+ */
+MIO_EXPORT mio_hto_pair_t* mio_hto_getnextpair (
+	mio_hto_t*      hto,    /**< hash table */
+	mio_hto_itr_t*  itr     /**< iterator*/
+);
+
+/**
+ * The mio_hto_dflhash() function is a default hash function. It computes
+ * SipHash-2-4 of the key with the seed of the table taken from the
+ * random key of the associated #mio_t object.
+ */
+MIO_EXPORT mio_oow_t mio_hto_dflhash (
+	const mio_hto_t*  hto,
+	const void*       kptr,
+	mio_oow_t         klen
+);
+
+/**
+ * The mio_hto_dflcomp() function is default comparator.
+ */
+MIO_EXPORT int mio_hto_dflcomp (
+	const mio_hto_t* hto,
+	const void*      kptr1,
+	mio_oow_t        klen1,
+	const void*      kptr2,
+	mio_oow_t        klen2
+);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
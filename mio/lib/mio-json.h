@@ -84,6 +84,7 @@ struct mio_json_state_node_t
 	mio_oow_t level;
 	mio_oow_t index;
 	int in_comment;
+	mio_oow_t qmask; /* paths that still match below this container in the query mode */
 	union
 	{
 		struct
@@ -135,6 +136,30 @@ enum mio_json_option_t
 
 typedef enum mio_json_option_t mio_json_option_t;
 
+enum mio_json_path_seg_type_t
+{
+	MIO_JSON_PATH_SEG_KEY,   /* .name or ["name"] */
+	MIO_JSON_PATH_SEG_INDEX, /* [n] */
+	MIO_JSON_PATH_SEG_ANY    /* .* or [*] */
+};
+typedef enum mio_json_path_seg_type_t mio_json_path_seg_type_t;
+
+typedef struct mio_json_path_seg_t mio_json_path_seg_t;
+struct mio_json_path_seg_t
+{
+	mio_json_path_seg_type_t type;
+	mio_oocs_t key; /* points into the str field of mio_json_path_t */
+	mio_oow_t index;
+};
+
+typedef struct mio_json_path_t mio_json_path_t;
+struct mio_json_path_t
+{
+	mio_ooch_t* str;
+	mio_oow_t nsegs;
+	mio_json_path_seg_t seg[1]; /* actual size is determined at runtime */
+};
+
 struct mio_json_t
 {
 	mio_t* mio;
@@ -144,6 +169,7 @@ struct mio_json_t
 
 	mio_json_state_node_t state_top;
 	mio_json_state_node_t* state_stack;
+	mio_json_state_node_t* state_free; /* popped nodes kept for reuse */
 
 	mio_oocs_t tok;
 	mio_oow_t tok_capa;
@@ -152,6 +178,77 @@ struct mio_json_t
 
 	mio_oow_t c_line;
 	mio_oow_t c_col;
+
+	struct
+	{
+		mio_json_path_t** ptr;
+		mio_oow_t len;
+		mio_oow_t capa;
+
+		mio_oow_t next_qmask; /* paths matching the container being opened */
+		int hit; /* reporting a value on a matching path */
+		mio_oow_t hit_level;
+		mio_oow_t hit_path;
+
+		struct
+		{
+			int active;
+			int scalar; /* skipping a number or a word */
+			int in_str;
+			int escaped;
+			int in_comment;
+			mio_oow_t depth;
+		} skip;
+	} query;
+};
+
+/* ========================================================================= */
+
+enum mio_json_node_type_t
+{
+	MIO_JSON_NODE_ARRAY,
+	MIO_JSON_NODE_OBJECT,
+	MIO_JSON_NODE_STRING,
+	MIO_JSON_NODE_NUMBER,
+	MIO_JSON_NODE_NIL,
+	MIO_JSON_NODE_TRUE,
+	MIO_JSON_NODE_FALSE
+};
+typedef enum mio_json_node_type_t mio_json_node_type_t;
+
+typedef struct mio_json_node_t mio_json_node_t;
+struct mio_json_node_t
+{
+	mio_json_node_type_t type;
+	mio_json_node_t* parent;
+	union
+	{
+		struct
+		{
+			/* the number of items in an array or the number of pairs in an object */
+			mio_oow_t count;
+			/* an array item i is at item[i]. an object key i is at item[i * 2]
+			 * and the value is at item[i * 2 + 1] */
+			mio_json_node_t** item;
+		} c;
+
+		/* the text of a string or a number. it's not null-terminated. 
+		 * a string without escape sequences points into the parsed input */
+		mio_bcs_t str;
+	} u;
+};
+
+/**
+ * The mio_json_doc_t type defines a json document parsed into a single
+ * memory block. The nodes are laid out in the document order.
+ */
+typedef struct mio_json_doc_t mio_json_doc_t;
+struct mio_json_doc_t
+{
+	mio_t* mio;
+	mio_json_node_t* root;
+	mio_oow_t nnodes; /* number of nodes used */
+	mio_json_node_t* node; /* nodes in the document order. node[0] is the root */
 };
 
 /* ========================================================================= */
@@ -165,6 +262,13 @@ typedef int (*mio_jsonwr_writecb_t) (
 	void*                 ctx
 );
 
+typedef int (*mio_jsonwr_writevcb_t) (
+	mio_jsonwr_t*         jsonwr,
+	mio_iovec_t*          iov,
+	mio_iolen_t           iovcnt,
+	void*                 ctx
+);
+
 typedef struct mio_jsonwr_state_node_t mio_jsonwr_state_node_t;
 struct mio_jsonwr_state_node_t
 {
@@ -181,17 +285,26 @@ enum mio_jsonwr_flag_t
 };
 typedef enum mio_jsonwr_flag_t mio_jsonwr_flag_t;
 
+#define MIO_JSONWR_IOV_MAX 64
+
 struct mio_jsonwr_t
 {
 	mio_t* mio;
 	mio_jsonwr_writecb_t writecb;
+	mio_jsonwr_writevcb_t writevcb;
 	mio_jsonwr_state_node_t state_top;
 	mio_jsonwr_state_node_t* state_stack;
+	mio_jsonwr_state_node_t* state_free; /* popped nodes kept for reuse */
 	int flags;
 
 	void* wctx;
 	mio_bch_t wbuf[8192];
 	mio_oow_t wbuf_len;
+
+	/* segments of wbuf and the caller's data for writevcb */
+	mio_iovec_t iov[MIO_JSONWR_IOV_MAX];
+	mio_iolen_t iovcnt;
+	int iov_ext; /* some segments refer to the caller's data */
 };
 
 /* ========================================================================= */
@@ -257,6 +370,43 @@ MIO_EXPORT void mio_json_resetfeedloc (
 	mio_json_t*   json
 );
 
+/**
+ * The mio_json_addpath() function registers a path to a value of interest
+ * and puts the parser to the query mode. A path begins with $ that denotes
+ * the root value and is followed by segments of .name, ["name"], [n], .*
+ * or [*]. e.g. $.user.id, $.items[0].name, $.items[*].id
+ *
+ * In the query mode, the callback set with mio_json_setinstcb() is invoked
+ * only for the values on the registered paths including all the values 
+ * nested in them. Any other values are skipped over without building tokens.
+ * Call mio_json_getpathmatch() inside the callback to find which path the
+ * reported value belongs to.
+ *
+ * The function returns the index of the registered path on success and -1
+ * on failure. Up to as many paths as the bits in mio_oow_t can be registered.
+ */
+MIO_EXPORT int mio_json_addpath (
+	mio_json_t*       json,
+	const mio_bch_t*  path
+);
+
+/**
+ * The mio_json_clearpaths() function deletes all the registered paths and
+ * puts the parser back to the normal mode.
+ */
+MIO_EXPORT void mio_json_clearpaths (
+	mio_json_t*       json
+);
+
+/**
+ * The mio_json_getpathmatch() function returns the index of the path that
+ * the value being reported to the callback belongs to. It returns -1 if the
+ * parser is not in the query mode.
+ */
+MIO_EXPORT int mio_json_getpathmatch (
+	mio_json_t*       json
+);
+
 /**
  * The mio_json_feed() function processes the raw data.
  *
@@ -281,6 +431,69 @@ MIO_EXPORT int mio_json_feed (
 
 /* ========================================================================= */
 
+/**
+ * The mio_json_parsedoc() function parses a complete json text into a 
+ * document allocated in a single memory block. A string without escape 
+ * sequences refers to the input text directly. Therefore, the input must 
+ * remain valid until the document is freed with mio_json_freedoc().
+ * It accepts the standard json text only and ignores the options set
+ * for the streaming parser.
+ *
+ * The function returns a document on success and #MIO_NULL on failure.
+ */
+MIO_EXPORT mio_json_doc_t* mio_json_parsedoc (
+	mio_t*            mio,
+	const mio_bch_t*  ptr,
+	mio_oow_t         len
+);
+
+/**
+ * The mio_json_freedoc() function frees the document and all its nodes.
+ */
+MIO_EXPORT void mio_json_freedoc (
+	mio_json_doc_t*   doc
+);
+
+#if defined(MIO_HAVE_INLINE)
+static MIO_INLINE mio_json_node_t* mio_json_getdocroot (mio_json_doc_t* doc) { return doc->root; }
+#else
+#	define mio_json_getdocroot(doc) (((mio_json_doc_t*)(doc))->root)
+#endif
+
+/**
+ * The mio_json_getitem() function returns the item at the given index in 
+ * an array or the value of the pair at the given index in an object.
+ * It returns #MIO_NULL if the index is out of range or the node is not
+ * a container.
+ */
+MIO_EXPORT mio_json_node_t* mio_json_getitem (
+	const mio_json_node_t* node,
+	mio_oow_t              index
+);
+
+/**
+ * The mio_json_getkey() function returns the key of the pair at the given 
+ * index in an object. It returns #MIO_NULL if the index is out of range or
+ * the node is not an object.
+ */
+MIO_EXPORT mio_json_node_t* mio_json_getkey (
+	const mio_json_node_t* node,
+	mio_oow_t              index
+);
+
+/**
+ * The mio_json_findvalue() function returns the value of the first pair 
+ * whose key matches the given key in an object. It returns #MIO_NULL if no
+ * such pair is found or the node is not an object.
+ */
+MIO_EXPORT mio_json_node_t* mio_json_findvalue (
+	const mio_json_node_t* node,
+	const mio_bch_t*       key,
+	mio_oow_t              keylen
+);
+
+/* ========================================================================= */
+
 MIO_EXPORT mio_jsonwr_t* mio_jsonwr_open (
 	mio_t*             mio,
 	mio_oow_t          xtnsize,
@@ -319,6 +532,21 @@ MIO_EXPORT void mio_jsonwr_setwritecb (
 	void*                ctx
 );
 
+/**
+ * The mio_jsonwr_setwritevcb() function sets the callback to output the 
+ * serialized text in segments. It takes precedence over the callback set
+ * with mio_jsonwr_setwritecb(). A large string and a large number are not
+ * copied to the internal buffer but passed to the callback as a segment
+ * referring to the caller's data before the write function returns.
+ * The callback may pass the segments to mio_dev_sck_writev() directly.
+ * Pass #MIO_NULL to go back to the callback set with mio_jsonwr_setwritecb().
+ */
+MIO_EXPORT void mio_jsonwr_setwritevcb (
+	mio_jsonwr_t*         jsonwr,
+	mio_jsonwr_writevcb_t writevcb,
+	void*                 ctx
+);
+
 MIO_EXPORT int mio_jsonwr_write (
 	mio_jsonwr_t*   jsonwr,
 	mio_json_inst_t inst,
@@ -30,6 +30,7 @@
 #include <mio.h>
 
 typedef struct mio_dev_mar_t mio_dev_mar_t;
+typedef struct mio_dev_mar_stmt_t mio_dev_mar_stmt_t;
 
 enum mio_dev_mar_progress_t
 {
@@ -38,14 +39,22 @@ enum mio_dev_mar_progress_t
 	MIO_DEV_MAR_CONNECTED,
 	MIO_DEV_MAR_QUERY_STARTING,
 	MIO_DEV_MAR_QUERY_STARTED,
+	MIO_DEV_MAR_RESULT_STORING,
 	MIO_DEV_MAR_ROW_FETCHING,
-	MIO_DEV_MAR_ROW_FETCHED
+	MIO_DEV_MAR_ROW_FETCHED,
+	MIO_DEV_MAR_STMT_PREPARING,
+	MIO_DEV_MAR_STMT_PREPARED,
+	MIO_DEV_MAR_STMT_EXECUTING,
+	MIO_DEV_MAR_STMT_EXECUTED
 };
 typedef enum mio_dev_mar_progress_t mio_dev_mar_progress_t;
 
 #define MIO_DEV_MAR_SET_PROGRESS(dev,value) ((dev)->progress = (value))
 #define MIO_DEV_MAR_GET_PROGRESS(dev) ((dev)->progress)
 
+/* the default number of rows delivered in a single wakeup */
+#define MIO_DEV_MAR_ROW_BATCH_MAX_DEFAULT 128
+
 
 typedef int (*mio_dev_mar_on_read_t) (
 	mio_dev_mar_t*    dev,
@@ -78,6 +87,59 @@ typedef void (*mio_dev_mar_on_row_fetched_t) (
 	void*             row_data
 );
 
+/* rows points to an array of MYSQL_ROW values valid until the callback returns.
+ * count 0 with rows set to MIO_NULL indicates the end of the result set. */
+typedef void (*mio_dev_mar_on_rows_fetched_t) (
+	mio_dev_mar_t*    dev,
+	void**            rows,
+	mio_oow_t         count
+);
+
+/* stmt is MIO_NULL if preparation has failed */
+typedef void (*mio_dev_mar_on_stmt_prepared_t) (
+	mio_dev_mar_t*      dev,
+	mio_dev_mar_stmt_t* stmt,
+	int                 mar_ret,
+	const mio_bch_t*    mar_errmsg
+);
+
+typedef void (*mio_dev_mar_on_stmt_executed_t) (
+	mio_dev_mar_t*      dev,
+	mio_dev_mar_stmt_t* stmt,
+	int                 mar_ret,
+	const mio_bch_t*    mar_errmsg
+);
+
+enum mio_dev_mar_param_type_t
+{
+	MIO_DEV_MAR_PARAM_NULL,
+	MIO_DEV_MAR_PARAM_INT,
+	MIO_DEV_MAR_PARAM_UINT,
+	MIO_DEV_MAR_PARAM_DOUBLE,
+	MIO_DEV_MAR_PARAM_BCHARS,
+	MIO_DEV_MAR_PARAM_BLOB
+};
+typedef enum mio_dev_mar_param_type_t mio_dev_mar_param_type_t;
+
+/* a parameter value bound to a placeholder of a prepared statement.
+ * the value is sent in the binary protocol without escaping */
+struct mio_dev_mar_param_t
+{
+	mio_dev_mar_param_type_t type;
+	union
+	{
+		mio_int64_t i;
+		mio_uint64_t ui;
+		double d;
+		struct
+		{
+			const void* ptr;
+			mio_oow_t len;
+		} b; /* for MIO_DEV_MAR_PARAM_BCHARS and MIO_DEV_MAR_PARAM_BLOB */
+	} u;
+};
+typedef struct mio_dev_mar_param_t mio_dev_mar_param_t;
+
 struct mio_dev_mar_t
 {
 	MIO_DEV_HEADER;
@@ -91,18 +153,38 @@ struct mio_dev_mar_t
 	unsigned int query_started_deferred: 1;
 	/*unsigned int query_started: 1;*/
 	unsigned int row_fetched_deferred: 1;
+	unsigned int result_stored_deferred: 1;
+	unsigned int row_fetch_waiting: 1; /* waiting for I/O in the middle of fetching/storing */
+	unsigned int row_fetch_batched: 1;
+	unsigned int row_fetch_paused: 1;
+	unsigned int row_fetch_stopped: 1; /* stopped fetching for pausing between rows */
+	unsigned int row_fetch_stmt: 1; /* fetching the result of a prepared statement */
+	unsigned int stmt_deferred: 1;
 	unsigned int broken: 1;
 	mio_syshnd_t broken_syshnd;
 
 	int row_wstatus;
 	void* row;
 
+	int stmt_err;
+	mio_dev_mar_stmt_t* stmt; /* statement in progress */
+	mio_dev_mar_stmt_t* stmt_list; /* all statements prepared over this device */
+
+	mio_oow_t row_batch_max;
+	void** row_batch;
+	char* row_batch_buf; /* copies of the statement rows in a batch */
+	mio_oow_t row_batch_buf_len;
+	mio_oow_t row_batch_buf_capa;
+
 	mio_dev_mar_on_read_t on_read;
 	mio_dev_mar_on_write_t on_write;
 	mio_dev_mar_on_connect_t on_connect;
 	mio_dev_mar_on_disconnect_t on_disconnect;
 	mio_dev_mar_on_query_started_t on_query_started;
 	mio_dev_mar_on_row_fetched_t on_row_fetched;
+	mio_dev_mar_on_rows_fetched_t on_rows_fetched;
+	mio_dev_mar_on_stmt_prepared_t on_stmt_prepared;
+	mio_dev_mar_on_stmt_executed_t on_stmt_executed;
 };
 
 enum mio_dev_mar_make_flag_t
@@ -131,6 +213,10 @@ struct mio_dev_mar_make_t
 	mio_dev_mar_on_disconnect_t on_disconnect; /* optional */
 	mio_dev_mar_on_query_started_t on_query_started;
 	mio_dev_mar_on_row_fetched_t on_row_fetched;
+	mio_dev_mar_on_rows_fetched_t on_rows_fetched; /* mandatory for mio_dev_mar_fetchrowsbatched() */
+	mio_oow_t row_batch_max; /* maximum rows per wakeup. 0 for MIO_DEV_MAR_ROW_BATCH_MAX_DEFAULT */
+	mio_dev_mar_on_stmt_prepared_t on_stmt_prepared;
+	mio_dev_mar_on_stmt_executed_t on_stmt_executed;
 };
 
 typedef struct mio_dev_mar_connect_t mio_dev_mar_connect_t;
@@ -147,21 +233,43 @@ enum mio_dev_mar_ioctl_cmd_t
 {
 	MIO_DEV_MAR_CONNECT,
 	MIO_DEV_MAR_QUERY_WITH_BCS,
-	MIO_DEV_MAR_FETCH_ROW
+	MIO_DEV_MAR_FETCH_ROW,
+	MIO_DEV_MAR_FETCH_ROWS_BATCHED,
+	MIO_DEV_MAR_PAUSE_FETCH,
+	MIO_DEV_MAR_RESUME_FETCH,
+	MIO_DEV_MAR_PREPARE_STMT,
+	MIO_DEV_MAR_EXECUTE_STMT,
+	MIO_DEV_MAR_FETCH_STMT_ROWS,
+	MIO_DEV_MAR_FETCH_STMT_ROWS_BATCHED
 };
 typedef enum mio_dev_mar_ioctl_cmd_t mio_dev_mar_ioctl_cmd_t;
 
+/* argument to MIO_DEV_MAR_EXECUTE_STMT */
+typedef struct mio_dev_mar_execute_t mio_dev_mar_execute_t;
+struct mio_dev_mar_execute_t
+{
+	mio_dev_mar_stmt_t* stmt;
+	const mio_dev_mar_param_t* params;
+	mio_oow_t nparams;
+	int cursor; /* open a read-only server-side cursor for the result set */
+};
+
 
 /* -------------------------------------------------------------- */
 
 typedef struct mio_svc_marc_t mio_svc_marc_t;
 typedef mio_dev_mar_connect_t mio_svc_marc_connect_t;
 typedef mio_dev_mar_tmout_t mio_svc_marc_tmout_t;
+typedef mio_dev_mar_param_t mio_svc_marc_param_t;
+
+/* the default number of prepared statements cached per session */
+#define MIO_SVC_MARC_STMT_CACHE_CAPA_DEFAULT 32
 
 enum mio_svc_marc_qtype_t
 {
 	MIO_SVC_MARC_QTYPE_SELECT, /* SELECT, SHOW, ... */
-	MIO_SVC_MARC_QTYPE_ACTION /* UPDATE, INSERT, DELETE, ALTER ... */
+	MIO_SVC_MARC_QTYPE_ACTION, /* UPDATE, INSERT, DELETE, ALTER ... */
+	MIO_SVC_MARC_QTYPE_SELECT_BATCHED /* same as SELECT but rows are delivered in batches */
 };
 typedef enum mio_svc_marc_qtype_t mio_svc_marc_qtype_t;
 
@@ -169,7 +277,8 @@ enum mio_svc_marc_rcode_t
 {
 	MIO_SVC_MARC_RCODE_ROW, /* has row *- data is MYSQL_ROW */
 	MIO_SVC_MARC_RCODE_DONE, /* completed or no more row  - data is NULL */
-	MIO_SVC_MARC_RCODE_ERROR /* query error - data is mio_sv_marc_dev_error_t* */
+	MIO_SVC_MARC_RCODE_ERROR, /* query error - data is mio_sv_marc_dev_error_t* */
+	MIO_SVC_MARC_RCODE_ROWS /* has rows - data is mio_svc_marc_rows_t* */
 };
 typedef enum mio_svc_marc_rcode_t mio_svc_marc_rcode_t;
 
@@ -180,6 +289,13 @@ struct mio_svc_marc_dev_error_t
 };
 typedef struct mio_svc_marc_dev_error_t mio_svc_marc_dev_error_t;
 
+struct mio_svc_marc_rows_t
+{
+	void** ptr; /* array of MYSQL_ROW */
+	mio_oow_t count;
+};
+typedef struct mio_svc_marc_rows_t mio_svc_marc_rows_t;
+
 typedef void (*mio_svc_marc_on_result_t) (
 	mio_svc_marc_t*      marc,
 	mio_oow_t            sid,
@@ -225,10 +341,112 @@ MIO_EXPORT int mio_dev_mar_querywithbchars (
 	mio_oow_t            qlen
 );
 
+/**
+ * The mio_dev_mar_fetchrows() function starts fetching rows of the result
+ * set without buffering it on the client side. The on_row_fetched callback
+ * is invoked for each row. Rows already received are delivered in the same
+ * wakeup up to the row_batch_max limit. To stream a result set through a
+ * server-side cursor, execute the query as a prepared statement with 
+ * mio_dev_mar_executestmtwithcursor() and fetch the rows with
+ * mio_dev_mar_fetchstmtrows().
+ */
 MIO_EXPORT int mio_dev_mar_fetchrows (
 	mio_dev_mar_t*       mar
 );
 
+/**
+ * The mio_dev_mar_fetchrowsbatched() function reads the whole result set
+ * without blocking and delivers the rows to the on_rows_fetched callback
+ * in batches of at most row_batch_max rows per wakeup.
+ */
+MIO_EXPORT int mio_dev_mar_fetchrowsbatched (
+	mio_dev_mar_t*       mar
+);
+
+/**
+ * The mio_dev_mar_preparestmt() function starts preparing a statement.
+ * The on_stmt_prepared callback is invoked upon completion. The statement
+ * stays valid until it is closed with mio_dev_mar_closestmt() or the
+ * device is killed.
+ */
+MIO_EXPORT int mio_dev_mar_preparestmt (
+	mio_dev_mar_t*       mar,
+	const mio_bch_t*     qstr,
+	mio_oow_t            qlen
+);
+
+/**
+ * The mio_dev_mar_executestmt() function starts executing a prepared
+ * statement with the given parameters. The data pointed to by the 
+ * parameters must stay valid until the on_stmt_executed callback is
+ * invoked.
+ */
+MIO_EXPORT int mio_dev_mar_executestmt (
+	mio_dev_mar_t*             mar,
+	mio_dev_mar_stmt_t*        stmt,
+	const mio_dev_mar_param_t* params,
+	mio_oow_t                  nparams
+);
+
+/**
+ * The mio_dev_mar_executestmtwithcursor() function is the same as
+ * mio_dev_mar_executestmt() except that the result set is kept on the
+ * server side behind a read-only cursor. The server sends row_batch_max
+ * rows at a time only when the rows fetched before have been delivered.
+ * Pausing the fetch with mio_dev_mar_pausefetch() stops the server from
+ * producing more rows for a large result set.
+ */
+MIO_EXPORT int mio_dev_mar_executestmtwithcursor (
+	mio_dev_mar_t*             mar,
+	mio_dev_mar_stmt_t*        stmt,
+	const mio_dev_mar_param_t* params,
+	mio_oow_t                  nparams
+);
+
+/**
+ * The mio_dev_mar_fetchstmtrows() function fetches the result set of
+ * the statement executed. The rows are read as the server sends them
+ * unless the statement has been executed with a cursor. Each row is passed
+ * to the on_row_fetched callback as an array of null-terminated strings
+ * like MYSQL_ROW. The row is valid until the callback returns.
+ */
+MIO_EXPORT int mio_dev_mar_fetchstmtrows (
+	mio_dev_mar_t*       mar
+);
+
+/**
+ * The mio_dev_mar_fetchstmtrowsbatched() function is the same as
+ * mio_dev_mar_fetchstmtrows() except that the rows are passed to the
+ * on_rows_fetched callback in batches of at most row_batch_max rows.
+ */
+MIO_EXPORT int mio_dev_mar_fetchstmtrowsbatched (
+	mio_dev_mar_t*       mar
+);
+
+MIO_EXPORT void mio_dev_mar_closestmt (
+	mio_dev_mar_t*       mar,
+	mio_dev_mar_stmt_t*  stmt
+);
+
+MIO_EXPORT mio_oow_t mio_dev_mar_getstmtfieldcount (
+	mio_dev_mar_stmt_t*  stmt
+);
+
+/**
+ * The mio_dev_mar_pausefetch() function stops reading and delivering rows
+ * of the current result set until mio_dev_mar_resumefetch() is called.
+ * While paused, the server gets blocked by the socket buffer getting full
+ * when rows are fetched with mio_dev_mar_fetchrows(). It doesn't request
+ * more rows from a server-side cursor.
+ */
+MIO_EXPORT int mio_dev_mar_pausefetch (
+	mio_dev_mar_t*       mar
+);
+
+MIO_EXPORT int mio_dev_mar_resumefetch (
+	mio_dev_mar_t*       mar
+);
+
 #if defined(MIO_HAVE_INLINE)
 static MIO_INLINE void mio_dev_mar_kill (mio_dev_mar_t* mar) { mio_dev_kill ((mio_dev_t*)mar); }
 static MIO_INLINE void mio_dev_mar_halt (mio_dev_mar_t* mar) { mio_dev_halt ((mio_dev_t*)mar); }
@@ -274,6 +492,48 @@ MIO_EXPORT int mio_svc_marc_querywithbchars (
 	void*                      qctx
 );
 
+/**
+ * The mio_svc_marc_execstmtwithbchars() function executes a statement
+ * with parameters bound in the binary protocol. The statement is prepared
+ * once per session and reused from the session statement cache afterwards.
+ * The parameters are copied. The callback is invoked the same way as
+ * mio_svc_marc_querywithbchars().
+ */
+MIO_EXPORT int mio_svc_marc_execstmtwithbchars (
+	mio_svc_marc_t*             marc,
+	mio_oow_t                   sid,
+	mio_svc_marc_qtype_t        qtype,
+	const mio_bch_t*            qptr,
+	mio_oow_t                   qlen,
+	const mio_svc_marc_param_t* params,
+	mio_oow_t                   nparams,
+	mio_svc_marc_on_result_t    on_result,
+	void*                       qctx
+);
+
+/**
+ * The mio_svc_marc_setstmtcachecapa() function changes the maximum number
+ * of prepared statements kept per session. The least recently used 
+ * statement is closed when the limit is reached. It applies to all the
+ * sessions including those connected already. A session holding more
+ * statements than the new limit closes the excess ones the next time it
+ * caches a statement.
+ */
+MIO_EXPORT void mio_svc_marc_setstmtcachecapa (
+	mio_svc_marc_t*            marc,
+	mio_oow_t                  capa
+);
+
+MIO_EXPORT int mio_svc_marc_pausefetch (
+	mio_svc_marc_t*            marc,
+	mio_oow_t                  sid
+);
+
+MIO_EXPORT int mio_svc_marc_resumefetch (
+	mio_svc_marc_t*            marc,
+	mio_oow_t                  sid
+);
+
 MIO_EXPORT mio_oow_t mio_svc_marc_escapebchars (
 	mio_svc_marc_t*     marc,
 	const mio_bch_t*    qstr,
@@ -196,6 +196,19 @@ MIO_EXPORT int mio_dev_pro_timedwrite (
 	void*              wrctx
 );
 
+/**
+ * The mio_dev_pro_forward() function arranges to write the output of the
+ * child process from the slave device \a sid to the \a dst device without
+ * copying it to user space. See mio_dev_forward() for details.
+ */
+MIO_EXPORT int mio_dev_pro_forward (
+	mio_dev_pro_t*     pro,
+	mio_dev_pro_sid_t  sid, /**< either #MIO_DEV_PRO_OUT or #MIO_DEV_PRO_ERR */
+	mio_dev_t*         dst,
+	mio_iolen_t        len,
+	void*              wrctx
+);
+
 MIO_EXPORT int mio_dev_pro_close (
 	mio_dev_pro_t*     pro,
 	mio_dev_pro_sid_t  sid
@@ -218,6 +218,47 @@ void mio_sys_getrealtime (
 	mio_ntime_t* now
 );
 
+void mio_sys_getcoarsetime (
+	mio_t*       mio,
+	mio_ntime_t* now
+);
+
+/* fill the buffer with random bytes from the system if available.
+ * it falls back to the bytes derived from the current time */
+void mio_sys_getrandom (
+	mio_t*       mio,
+	void*        buf,
+	mio_oow_t    len
+);
+
+/* create a non-blocking pipe with the close-on-exec flag set on both ends */
+int mio_sys_openpipe (
+	mio_t*        mio,
+	mio_syshnd_t* pfd
+);
+
+void mio_sys_closepipe (
+	mio_t*        mio,
+	mio_syshnd_t* pfd
+);
+
+/* move data from the handle 'in' to the handle 'out' without copying it
+ * to user space. either handle must be a pipe. it returns -1 on failure,
+ * 0 if no data can be moved without blocking, 1 otherwise with the length
+ * of data moved stored in *len. the length of 0 means EOF on 'in'. */
+int mio_sys_splice (
+	mio_t*        mio,
+	mio_syshnd_t  in,
+	mio_syshnd_t  out,
+	mio_iolen_t*  len
+);
+
+/* refresh the time cached for the current loop iteration.
+ * mio_sys_waitmux() calls this as soon as the wait is over */
+void mio_refreshtime (
+	mio_t*       mio
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -216,6 +216,9 @@ enum mio_dev_sck_state_t
 	MIO_DEV_SCK_ACCEPTED       = (1 << 5),
 
 	/* the following items can be bitwise-ORed with an exclusive item above */
+	MIO_DEV_SCK_ZEROCOPY       = (1 << 11), /* zero-copy transmission enabled */
+	MIO_DEV_SCK_ZEROCOPY_OFF   = (1 << 12), /* zero-copy transmission unavailable or not beneficial */
+	MIO_DEV_SCK_KTLS_SEND      = (1 << 13), /* the kernel encrypts outgoing tls records */
 	MIO_DEV_SCK_LENIENT        = (1 << 14),
 	MIO_DEV_SCK_INTERCEPTED    = (1 << 15),
 
@@ -290,7 +293,11 @@ typedef enum mio_dev_sck_type_t mio_dev_sck_type_t;
 enum mio_dev_sck_make_option_t
 {
 	/* for now, accept failure doesn't affect the listing socket if this is set */
-	MIO_DEV_SCK_MAKE_LENIENT = (1 << 0)
+	MIO_DEV_SCK_MAKE_LENIENT = (1 << 0),
+
+	/* merge the data received in a row on a stream socket before calling on_read.
+	 * the sockets accepted on a listener inherit it */
+	MIO_DEV_SCK_MAKE_COALESCE_READ = (1 << 1)
 };
 typedef enum mio_dev_sck_make_option_t mio_dev_sck_make_option_t;
 
@@ -309,6 +316,59 @@ struct mio_dev_sck_make_t
 	mio_dev_sck_on_raw_accept_t on_raw_accept; /* optional */
 };
 
+enum mio_dev_sck_tune_profile_t
+{
+	/* apply the fields of mio_dev_sck_tune_t given only */
+	MIO_DEV_SCK_TUNE_PROFILE_NONE = 0,
+
+	/* request-response traffic. TCP_NODELAY, TCP_QUICKACK, TCP_NOTSENT_LOWAT of
+	 * #MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_LATENCY and TCP fast open on a listener.
+	 * fast open on a connecting socket must be requested explicitly with
+	 * #MIO_DEV_SCK_TUNE_FASTOPEN as it holds the handshake till the first write */
+	MIO_DEV_SCK_TUNE_PROFILE_LATENCY,
+
+	/* #MIO_DEV_SCK_TUNE_PROFILE_LATENCY with SO_BUSY_POLL of 
+	 * #MIO_DEV_SCK_TUNE_BUSY_POLL_DEFAULT microseconds */
+	MIO_DEV_SCK_TUNE_PROFILE_BUSY_POLL,
+
+	/* bulk transfer. TCP_NOTSENT_LOWAT of #MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_BULK
+	 * to bound the data queued in the kernel without starving the link */
+	MIO_DEV_SCK_TUNE_PROFILE_BULK
+};
+typedef enum mio_dev_sck_tune_profile_t mio_dev_sck_tune_profile_t;
+
+enum mio_dev_sck_tune_option_t
+{
+	MIO_DEV_SCK_TUNE_NODELAY  = (1 << 0), /* TCP_NODELAY */
+	MIO_DEV_SCK_TUNE_QUICKACK = (1 << 1), /* TCP_QUICKACK. set on every accepted socket as the kernel doesn't carry it over */
+	MIO_DEV_SCK_TUNE_FASTOPEN = (1 << 2), /* TCP_FASTOPEN on a listener. TCP_FASTOPEN_CONNECT on a connecting socket */
+
+	MIO_DEV_SCK_TUNE_IGNERR   = (1 << 15) /* ignore failure to set an option unsupported by the system */
+};
+typedef enum mio_dev_sck_tune_option_t mio_dev_sck_tune_option_t;
+
+#define MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_LATENCY (16384)
+#define MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_BULK (131072)
+#define MIO_DEV_SCK_TUNE_BUSY_POLL_DEFAULT (50)
+#define MIO_DEV_SCK_TUNE_FASTOPEN_QLEN_DEFAULT (256)
+
+/* tcp tuning applied to a socket being bound or connected. the options
+ * applied to a listener are inherited by the sockets accepted on it.
+ * a field set to 0 takes the value of the profile if any. otherwise,
+ * the system default is kept. the options are ignored for a non-tcp socket */
+typedef struct mio_dev_sck_tune_t mio_dev_sck_tune_t;
+struct mio_dev_sck_tune_t
+{
+	mio_dev_sck_tune_profile_t profile;
+	int options; /* 0 or bitwise-OR'ed of mio_dev_sck_tune_option_t enumerators. added to those of the profile */
+	int rcvbuf; /* SO_RCVBUF in bytes */
+	int sndbuf; /* SO_SNDBUF in bytes */
+	int busy_poll; /* SO_BUSY_POLL in microseconds */
+	int notsent_lowat; /* TCP_NOTSENT_LOWAT in bytes */
+	int defer_accept; /* TCP_DEFER_ACCEPT in seconds. effective on a listener */
+	int fastopen_qlen; /* fast open requests pending on a listener. 0 for #MIO_DEV_SCK_TUNE_FASTOPEN_QLEN_DEFAULT with MIO_DEV_SCK_TUNE_FASTOPEN */
+};
+
 enum mio_dev_sck_bind_option_t
 {
 	MIO_DEV_SCK_BIND_BROADCAST   = (1 << 0),
@@ -316,6 +376,11 @@ enum mio_dev_sck_bind_option_t
 	MIO_DEV_SCK_BIND_REUSEPORT   = (1 << 2),
 	MIO_DEV_SCK_BIND_TRANSPARENT = (1 << 3),
 
+	/* effective with MIO_DEV_SCK_BIND_SSL */
+	MIO_DEV_SCK_BIND_SSL_NO_TICKET        = (1 << 4), /* don't issue stateless session tickets */
+	MIO_DEV_SCK_BIND_SSL_NO_SESSION_CACHE = (1 << 5), /* don't cache sessions in the server */
+	MIO_DEV_SCK_BIND_SSL_NO_KTLS          = (1 << 6), /* don't offload record encryption to the kernel */
+
 /* TODO: more options --- SO_RCVBUF, SO_SNDBUF, SO_RCVTIMEO, SO_SNDTIMEO, SO_KEEPALIVE */
 /*   BINDTODEVICE??? */
 
@@ -333,10 +398,34 @@ struct mio_dev_sck_bind_t
 
 	const mio_bch_t* ssl_certfile;
 	const mio_bch_t* ssl_keyfile;
+	mio_oow_t ssl_session_cache_size; /* maximum sessions cached for resumption. 0 for #MIO_DEV_SCK_SSL_SESSION_CACHE_SIZE_DEFAULT */
+	mio_ntime_t ssl_ticket_key_lifetime; /* interval to rotate the ticket key. 0 for #MIO_DEV_SCK_SSL_TICKET_KEY_LIFETIME_DEFAULT seconds */
+	const mio_bch_t* ssl_alpn; /* optional. comma-separated protocols for alpn in the order of preference. e.g. "h2,http/1.1" */
+	mio_dev_sck_tune_t tune; /* tcp tuning for the socket and the sockets accepted on it */
+};
+
+#define MIO_DEV_SCK_SSL_SESSION_CACHE_SIZE_DEFAULT (1024)
+#define MIO_DEV_SCK_SSL_TICKET_KEY_LIFETIME_DEFAULT (3600)
+
+/* length of a ticket key. 16 bytes for the key name, 32 bytes for HMAC-SHA256
+ * and 32 bytes for AES-256-CBC in order */
+#define MIO_DEV_SCK_SSL_TICKET_KEY_LEN (80)
+
+typedef struct mio_dev_sck_ssl_stat_t mio_dev_sck_ssl_stat_t;
+struct mio_dev_sck_ssl_stat_t
+{
+	mio_oow_t hits; /* handshakes that resumed a session */
+	mio_oow_t misses; /* full handshakes */
 };
 
+/* client-side cache of ssl sessions per remote address */
+typedef struct mio_dev_sck_sslcache_t mio_dev_sck_sslcache_t;
+
 enum mio_dev_sck_connect_option_t
 {
+	/* effective with MIO_DEV_SCK_CONNECT_SSL */
+	MIO_DEV_SCK_CONNECT_SSL_NO_KTLS = (1 << 0), /* don't offload record encryption to the kernel */
+
 	MIO_DEV_SCK_CONNECT_SSL         = (1 << 15)
 };
 typedef enum mio_dev_sck_connect_option_t mio_dev_sck_connect_option_t;
@@ -347,21 +436,40 @@ struct mio_dev_sck_connect_t
 	int options;
 	mio_skad_t remoteaddr;
 	mio_ntime_t connect_tmout;
+	mio_dev_sck_sslcache_t* ssl_cache; /* optional. used with MIO_DEV_SCK_CONNECT_SSL to resume a session */
+	const mio_bch_t* ssl_alpn; /* optional. comma-separated protocols to offer for alpn */
+	mio_dev_sck_tune_t tune; /* tcp tuning. with MIO_DEV_SCK_TUNE_FASTOPEN, the connection is established with the first data written */
 };
 
-#if 0
 enum mio_dev_sck_listen_option_t
 {
+	/* wake up only one of the multiplexers watching the same listening 
+	 * socket shared by multiple mio instances. effective with epoll only */
+	MIO_DEV_SCK_LISTEN_EXCLUSIVE = (1 << 0)
 };
 typedef enum mio_dev_sck_listen_option_t mio_dev_sck_listen_option_t;
-#endif
+
+/* the default number of connections accepted per readiness event */
+#define MIO_DEV_SCK_ACCEPT_BUDGET_DEFAULT (64)
+#define MIO_DEV_SCK_SSL_HANDSHAKE_WORKERS_MAX (64)
 
 typedef struct mio_dev_sck_listen_t mio_dev_sck_listen_t;
 struct mio_dev_sck_listen_t
 {
-	int options; /* no options as of now. set it to 0 */
+	int options; /** 0 or bitwise-OR'ed of mio_dev_sck_listen_option_t enumerators */
 	int backlogs;
 	mio_ntime_t accept_tmout;
+	mio_oow_t accept_budget; /* maximum connections to accept per readiness event. 0 for #MIO_DEV_SCK_ACCEPT_BUDGET_DEFAULT */
+	mio_oow_t ssl_handshake_workers; /* threads performing tls handshakes of accepted sockets. 0 to perform them in the event loop */
+};
+
+typedef struct mio_dev_sck_accept_stat_t mio_dev_sck_accept_stat_t;
+struct mio_dev_sck_accept_stat_t
+{
+	mio_oow_t wakeups; /* number of readiness events handled */
+	mio_oow_t accepted; /* number of connections accepted */
+	mio_oow_t exhausted; /* number of wakeups that used up the budget */
+	mio_oow_t max_per_wakeup; /* largest number of connections accepted in a wakeup */
 };
 
 struct mio_dev_sck_t
@@ -414,6 +522,16 @@ struct mio_dev_sck_t
 	void* ssl;
 
 	mio_syshnd_t side_chan; /* side-channel for MIO_DEV_SCK_QX */
+	mio_dev_sck_sslcache_t* ssl_cache; /* session cache for a connecting socket */
+	void* ssl_hsp; /* tls handshake worker pool */
+	void* ssl_hsjob; /* handshake step in progress in the worker pool */
+
+	/* for a listening socket */
+	mio_oow_t accept_budget;
+	mio_dev_sck_accept_stat_t accept_stat;
+
+	mio_uint32_t zc_seq; /* sequence number of the next zero-copy send */
+	mio_dev_sck_tune_t tune; /* tcp tuning applied. inherited by the sockets accepted */
 };
 
 enum mio_dev_sck_shutdown_how_t
@@ -456,11 +574,13 @@ static MIO_INLINE mio_t* mio_dev_sck_getmio (mio_dev_sck_t* sck) { return mio_de
 static MIO_INLINE void* mio_dev_sck_getxtn (mio_dev_sck_t* sck) { return (void*)(sck + 1); }
 static MIO_INLINE mio_dev_sck_type_t mio_dev_sck_gettype (mio_dev_sck_t* sck) { return sck->type; }
 static MIO_INLINE mio_syshnd_t mio_dev_sck_getsyshnd (mio_dev_sck_t* sck) { return sck->hnd; }
+static MIO_INLINE const mio_dev_sck_accept_stat_t* mio_dev_sck_getacceptstat (mio_dev_sck_t* sck) { return &sck->accept_stat; }
 #else
 #	define mio_dev_sck_getmio(sck) mio_dev_getmio(sck)
 #	define mio_dev_sck_getxtn(sck) ((void*)(((mio_dev_sck_t*)sck) + 1))
 #	define mio_dev_sck_gettype(sck) (((mio_dev_sck_t*)sck)->type)
 #	define mio_dev_sck_getsyshnd(sck) (((mio_dev_sck_t*)sck)->hnd)
+#	define mio_dev_sck_getacceptstat(sck) ((const mio_dev_sck_accept_stat_t*)&((mio_dev_sck_t*)sck)->accept_stat)
 #endif
 
 MIO_EXPORT int mio_dev_sck_bind (
@@ -495,6 +615,21 @@ MIO_EXPORT int mio_dev_sck_writev (
 );
 
 
+/**
+ * The mio_dev_sck_writezc() function writes data to a stream socket without
+ * copying it to the kernel if the data is large enough and the system supports
+ * it. The data must stay intact until the on_write callback is called, which
+ * happens after the kernel has finished sending the data. The data is written
+ * with mio_dev_sck_write() otherwise. Zero-copy transmission is turned off on
+ * the socket once the kernel reports that it had to copy the data anyway.
+ */
+MIO_EXPORT int mio_dev_sck_writezc (
+	mio_dev_sck_t*        dev,
+	const void*           data,
+	mio_iolen_t           len,
+	void*                 wrctx
+);
+
 MIO_EXPORT int mio_dev_sck_timedwrite (
 	mio_dev_sck_t*        dev,
 	const void*           data,
@@ -547,6 +682,11 @@ static MIO_INLINE int mio_dev_sck_timedsendfile (mio_dev_sck_t* sck, mio_syshnd_
 	return mio_dev_timedsendfile((mio_dev_t*)sck, in_fd, foff, len, tmout, wrctx);
 }
 
+static MIO_INLINE int mio_dev_sck_forward (mio_dev_sck_t* sck, mio_dev_t* src, mio_iolen_t len, void* wrctx)
+{
+	return mio_dev_forward((mio_dev_t*)sck, src, len, wrctx);
+}
+
 #else
 
 #define mio_dev_sck_kill(sck) mio_dev_kill((mio_dev_t*)sck)
@@ -557,6 +697,7 @@ static MIO_INLINE int mio_dev_sck_timedsendfile (mio_dev_sck_t* sck, mio_syshnd_
 
 #define mio_dev_sck_sendfile(sck,in_fd,foff,len,wrctx) mio_dev_sendfile((mio_dev_t*)sck, in_fd, foff, len, wrctx)
 #define mio_dev_sck_timedsendfile(sck,in_fd,foff,len,tmout,wrctx) mio_dev_timedsendfile((mio_dev_t*)sck, in_fd, foff, len, tmout, wrctx)
+#define mio_dev_sck_forward(sck,src,len,wrctx) mio_dev_forward((mio_dev_t*)sck, src, len, wrctx)
 #endif
 
 
@@ -592,16 +733,112 @@ MIO_EXPORT int mio_dev_sck_shutdown (
 	int            how  /* bitwise-ORed of mio_dev_sck_shutdown_how_t enumerators */
 );
 
+/**
+ * The mio_dev_sck_sendfileok() function returns 1 if mio_dev_sck_sendfile()
+ * can be used on a socket and 0 otherwise. A tls socket qualifies only if
+ * kernel tls has been activated for sending after the handshake.
+ */
 MIO_EXPORT int mio_dev_sck_sendfileok (
 	mio_dev_sck_t* dev
 );
 
+/**
+ * The mio_dev_sck_forwardok() function returns 1 if data from another
+ * device can be forwarded to a socket with mio_dev_sck_forward() and 0
+ * otherwise. A tls socket qualifies only if kernel tls has been activated
+ * for sending. Reading from a tls socket can't be forwarded at all.
+ */
+MIO_EXPORT int mio_dev_sck_forwardok (
+	mio_dev_sck_t* dev
+);
+
 MIO_EXPORT int mio_dev_sck_writetosidechan (
 	mio_dev_sck_t* htts,
 	const void*    dptr,
 	mio_oow_t      dlen
 );
 
+/**
+ * The mio_dev_sck_setsslticketkey() function sets the key to encrypt the
+ * session tickets issued by a listening socket bound with 
+ * MIO_DEV_SCK_BIND_SSL. The key must be #MIO_DEV_SCK_SSL_TICKET_KEY_LEN
+ * bytes long. It becomes the current key and the previous two keys are 
+ * kept to decrypt the tickets issued with them. Setting a key disables
+ * the automatic rotation of the randomly generated key so that the 
+ * processes sharing the key can resume sessions from each other. 
+ */
+MIO_EXPORT int mio_dev_sck_setsslticketkey (
+	mio_dev_sck_t*     dev,
+	const mio_uint8_t* key,
+	mio_oow_t          len
+);
+
+/**
+ * The mio_dev_sck_getsslstat() function gets the number of handshakes
+ * resumed and not resumed on the sockets accepted by a listening socket
+ * bound with MIO_DEV_SCK_BIND_SSL.
+ */
+MIO_EXPORT int mio_dev_sck_getsslstat (
+	mio_dev_sck_t*          dev,
+	mio_dev_sck_ssl_stat_t* stat
+);
+
+/**
+ * The mio_dev_sck_makesslcache() function creates a client-side cache
+ * holding up to \a capa ssl sessions, one for each remote address. 
+ * A socket connected with the cache set in mio_dev_sck_connect_t 
+ * offers the session cached for the remote address and stores a new
+ * session received. The cache must outlive the sockets using it.
+ */
+MIO_EXPORT mio_dev_sck_sslcache_t* mio_dev_sck_makesslcache (
+	mio_t*                  mio,
+	mio_oow_t               capa
+);
+
+MIO_EXPORT void mio_dev_sck_freesslcache (
+	mio_dev_sck_sslcache_t* cache
+);
+
+MIO_EXPORT void mio_dev_sck_getsslcachestat (
+	mio_dev_sck_sslcache_t* cache,
+	mio_dev_sck_ssl_stat_t* stat
+);
+
+/**
+ * The mio_dev_sck_addsslhost() function adds a certificate for a host name
+ * to a listening socket bound with MIO_DEV_SCK_BIND_SSL. A client indicating
+ * the host name with SNI gets this certificate instead of the one given in
+ * binding. A name beginning with "*." matches any single label in place of
+ * the asterisk. The certificate of an existing host is replaced without 
+ * affecting the connections established or in handshake with the old one.
+ */
+MIO_EXPORT int mio_dev_sck_addsslhost (
+	mio_dev_sck_t*   dev,
+	const mio_bch_t* host,
+	const mio_bch_t* certfile,
+	const mio_bch_t* keyfile
+);
+
+/**
+ * The mio_dev_sck_delsslhost() function deletes a host name added with
+ * mio_dev_sck_addsslhost().
+ */
+MIO_EXPORT int mio_dev_sck_delsslhost (
+	mio_dev_sck_t*   dev,
+	const mio_bch_t* host
+);
+
+/**
+ * The mio_dev_sck_getsslalpn() function copies the protocol negotiated with
+ * alpn to the buffer given and null-terminates it. It returns the length of
+ * the protocol name or 0 if none has been negotiated.
+ */
+MIO_EXPORT mio_oow_t mio_dev_sck_getsslalpn (
+	mio_dev_sck_t*   dev,
+	mio_bch_t*       buf,
+	mio_oow_t        bufsz
+);
+
 
 MIO_EXPORT mio_uint16_t mio_checksum_ip (
 	const void* hdr,
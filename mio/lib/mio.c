@@ -44,6 +44,18 @@ struct wq_sendfile_data_t
 };
 typedef struct wq_sendfile_data_t wq_sendfile_data_t;
 
+struct wq_forward_data_t
+{
+	mio_dev_t* src; /* MIO_NULL once reading from the source device is over */
+	mio_syshnd_t pfd[2];
+	mio_iolen_t pending; /* length of data held in the pipe */
+	mio_iolen_t moved; /* length of data written to the destination device */
+	mio_errnum_t errnum; /* set if reading from the source device has failed */
+};
+typedef struct wq_forward_data_t wq_forward_data_t;
+
+#define FORWARD_CHUNK_SIZE (65536)
+
 /* ========================================================================= */
 
 static void* mmgr_alloc (mio_mmgr_t* mmgr, mio_oow_t size)
@@ -144,6 +156,7 @@ int mio_init (mio_t* mio, mio_mmgr_t* mmgr, mio_cmgr_t* cmgr, mio_bitmask_t feat
 	MIO_SVCL_INIT (&mio->actsvc);
 
 	mio_sys_gettime (mio, &mio->init_time);
+	mio_sys_getrandom (mio, mio->hashkey, MIO_SIZEOF(mio->hashkey));
 	return 0;
 
 oops:
@@ -164,17 +177,6 @@ void mio_fini (mio_t* mio)
 
 	mio->_fini_in_progress = 1;
 
-	/* clean up free cwq list */
-	for (i = 0; i < MIO_COUNTOF(mio->cwqfl); i++)
-	{
-		mio_cwq_t* cwq;
-		while ((cwq = mio->cwqfl[i]))
-		{
-			mio->cwqfl[i] = cwq->q_next;
-			mio_freemem (mio, cwq);
-		}
-	}
-
 	/* kill services before killing devices */
 	while (!MIO_SVCL_IS_EMPTY(&mio->actsvc))
 	{
@@ -238,6 +240,18 @@ void mio_fini (mio_t* mio)
 		kill_and_free_device (dev, 2);
 	}
 
+	/* clean up free cwq list. the devices killed above may have
+	 * returned their completed write requests to the list */
+	for (i = 0; i < MIO_COUNTOF(mio->cwqfl); i++)
+	{
+		mio_cwq_t* cwq;
+		while ((cwq = mio->cwqfl[i]))
+		{
+			mio->cwqfl[i] = cwq->q_next;
+			mio_freemem (mio, cwq);
+		}
+	}
+
 	/* purge scheduled timer jobs and kill the timer */
 	mio_cleartmrjobs (mio);
 	mio_freemem (mio, mio->tmr.jobs);
@@ -441,6 +455,53 @@ void mio_epilogue (mio_t* mio)
 	/* TODO: */
 }
 
+static int watch_forward_source (mio_dev_t* src)
+{
+	/* resume input watching on the source device of a forwarding request.
+	 * the device is not watched at all if it hung up while the pipe was full */
+	if (!(src->dev_cap & MIO_DEV_CAP_ACTIVE)) return 0;
+	if (!(src->dev_cap & MIO_DEV_CAP_WATCH_STARTED) && mio_dev_watch(src, MIO_DEV_WATCH_START, 0) <= -1) return -1;
+	return mio_dev_watch(src, MIO_DEV_WATCH_RENEW, MIO_DEV_EVENT_IN);
+}
+
+static void detach_forward_source (mio_wq_t* q, mio_errnum_t errnum)
+{
+	wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+
+	MIO_ASSERT (q->dev->mio, fwd->src != MIO_NULL && fwd->src->fwdq == q);
+	fwd->src->fwdq = MIO_NULL;
+	fwd->src = MIO_NULL;
+	fwd->errnum = errnum;
+
+	/* let the destination device write the data left in the pipe and end the request */
+	if ((q->dev->dev_cap & MIO_DEV_CAP_ACTIVE) && mio_dev_watch(q->dev, MIO_DEV_WATCH_RENEW, MIO_DEV_EVENT_IN) <= -1)
+	{
+		MIO_DEBUG1 (q->dev->mio, "DEV(%p) - halting a device for watcher renewal failure\n", q->dev);
+		mio_dev_halt (q->dev);
+	}
+}
+
+static void release_forward (mio_t* mio, mio_wq_t* q)
+{
+	wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+
+	if (fwd->src)
+	{
+		/* the request is dropped before reading is over. the source device
+		 * delivers further input to its on_read callback from now on */
+		mio_dev_t* src = fwd->src;
+		src->fwdq = MIO_NULL;
+		fwd->src = MIO_NULL;
+		if (watch_forward_source(src) <= -1)
+		{
+			MIO_DEBUG1 (mio, "DEV(%p) - halting a device for watcher renewal failure\n", src);
+			mio_dev_halt (src);
+		}
+	}
+
+	mio_sys_closepipe (mio, fwd->pfd);
+}
+
 static MIO_INLINE void unlink_wq (mio_t* mio, mio_wq_t* q)
 {
 	if (q->tmridx != MIO_TMRIDX_INVALID)
@@ -449,6 +510,53 @@ static MIO_INLINE void unlink_wq (mio_t* mio, mio_wq_t* q)
 		MIO_ASSERT (mio, q->tmridx == MIO_TMRIDX_INVALID);
 	}
 	MIO_WQ_UNLINK (q);
+	if (q->forward) release_forward (mio, q);
+	if (q->hlen > 0)
+	{
+		q->dev->wq_bytes -= q->hlen;
+		q->hlen = 0;
+	}
+}
+
+static void check_wq_pressure (mio_t* mio, mio_dev_t* dev)
+{
+	if (dev->wmark.high > 0 && !dev->wq_pressured && dev->wq_bytes >= dev->wmark.high)
+	{
+		dev->wq_pressured = 1;
+		if (dev->wmark.on_pressure && dev->wmark.on_pressure(dev, dev->wmark.ctx) <= -1)
+		{
+			MIO_DEBUG2 (mio, "DEV(%p) - halting a device for on_pressure error - %js\n", dev, mio_geterrmsg(mio));
+			mio_dev_halt (dev);
+		}
+	}
+}
+
+static int check_wq_drain (mio_t* mio, mio_dev_t* dev)
+{
+	if (dev->wq_pressured && dev->wq_bytes <= dev->wmark.low)
+	{
+		dev->wq_pressured = 0;
+		if (dev->wmark.on_drain && dev->wmark.on_drain(dev, dev->wmark.ctx) <= -1)
+		{
+			MIO_DEBUG2 (mio, "DEV(%p) - halting a device for on_drain error - %js\n", dev, mio_geterrmsg(mio));
+			mio_dev_halt (dev);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int fire_zcq_handler (mio_t* mio, mio_dev_t* dev, mio_wq_t* q)
+{
+	int y;
+
+	/* the request has been unlinked from the write queue before
+	 * it's chained to the zero-copy completion queue. */
+	MIO_WQ_UNLINK (q);
+	if (q->olen <= -1 && q->forward) mio_seterrnum (mio, ((wq_forward_data_t*)q->ptr)->errnum);
+	y = dev->dev_evcb->on_write(dev, q->olen, q->ctx, &q->dstaddr);
+	mio_freemem (mio, q);
+	return y;
 }
 
 static void fire_cwq_handlers (mio_t* mio)
@@ -544,6 +652,179 @@ static void fire_cwq_handlers_for_dev (mio_t* mio, mio_dev_t* dev, int for_kill)
 
 }
 
+static MIO_INLINE void renew_read_timeout (mio_t* mio, mio_dev_t* dev)
+{
+	/* delete the read timeout job on the device as the
+	 * read operation will be reported. */
+	mio_tmrjob_t tmrjob;
+
+	MIO_MEMSET (&tmrjob, 0, MIO_SIZEOF(tmrjob));
+	tmrjob.ctx = dev;
+	mio_gettime (mio, &tmrjob.when);
+	MIO_ADD_NTIME (&tmrjob.when, &tmrjob.when, &dev->rtmout);
+	tmrjob.handler = on_read_timeout;
+	tmrjob.idxptr = &dev->rtmridx;
+
+	mio_updtmrjob (mio, dev->rtmridx, &tmrjob);
+
+	/*mio_deltmrjob (mio, dev->rtmridx);
+	dev->rtmridx = MIO_TMRIDX_INVALID;*/
+}
+
+static int drain_forward_pipe (mio_t* mio, mio_wq_t* q)
+{
+	/* write the data held in the forwarding pipe to the destination device.
+	 * it returns -1 on failure, 1 if the request is over, 0 otherwise */
+	mio_dev_t* dev = q->dev;
+	wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+	mio_iolen_t ulen;
+	int x;
+
+	while (fwd->pending > 0)
+	{
+		ulen = fwd->pending;
+		x = dev->dev_mth->splice(dev, fwd->pfd[0], &ulen, 1);
+		if (x <= -1) return -1;
+		if (x == 0 || ulen <= 0) return 0;
+
+		fwd->pending -= ulen;
+		fwd->moved += ulen;
+	}
+
+	return fwd->src? 0: 1;
+}
+
+static int fill_forward_pipe (mio_t* mio, mio_dev_t* dev)
+{
+	/* move input on the source device to the forwarding pipe and write
+	 * it out if the request is at the head of the destination's queue.
+	 * it returns -1 if the source device has been halted, 0 otherwise */
+	mio_wq_t* q = dev->fwdq;
+	wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+	mio_iolen_t ulen;
+	int x;
+
+	while (1)
+	{
+		ulen = FORWARD_CHUNK_SIZE;
+		if (q->len >= 0 && ulen > q->len) ulen = q->len;
+
+		x = dev->dev_mth->splice(dev, fwd->pfd[1], &ulen, 0);
+		if (x <= -1)
+		{
+			MIO_DEBUG2 (mio, "DEV(%p) - halting a device for forwarding failure - %js\n", dev, mio_geterrmsg(mio));
+			detach_forward_source (q, mio_geterrnum(mio));
+			mio_dev_halt (dev);
+			return -1;
+		}
+
+		if (dev->rtmridx != MIO_TMRIDX_INVALID) renew_read_timeout (mio, dev);
+
+		/* nothing to read or the pipe is full */
+		if (x == 0) break;
+
+		if (ulen <= 0)
+		{
+			/* EOF received. the forwarding request gets over when the 
+			 * destination device writes all data left in the pipe. 
+			 * the on_read callback is called to report EOF as usual */
+			detach_forward_source (q, MIO_ENOERR);
+			dev->dev_cap |= MIO_DEV_CAP_IN_CLOSED;
+			dev->dev_cap |= MIO_DEV_CAP_RENEW_REQUIRED;
+
+			if (dev->dev_evcb->on_read(dev, mio->bigbuf, 0, MIO_NULL) <= -1 ||
+			    (dev->dev_cap & MIO_DEV_CAP_OUT_CLOSED))
+			{
+				MIO_DEBUG2 (mio, "DEV(%p) - halting a stream device for on_read failure while output is closed - %js\n", dev, mio_geterrmsg(mio));
+				mio_dev_halt (dev);
+				return -1;
+			}
+			return 0;
+		}
+
+		fwd->pending += ulen;
+		if (q->len >= 0)
+		{
+			q->len -= ulen;
+			if (q->len <= 0)
+			{
+				/* as much as requested has been read */
+				detach_forward_source (q, MIO_ENOERR);
+				dev->dev_cap |= MIO_DEV_CAP_RENEW_REQUIRED;
+				break;
+			}
+		}
+	}
+
+	if (MIO_WQ_HEAD(&q->dev->wq) == q && (q->dev->dev_cap & MIO_DEV_CAP_ACTIVE) && drain_forward_pipe(mio, q) <= -1)
+	{
+		MIO_DEBUG2 (mio, "DEV(%p) - halting a device for forwarding failure - %js\n", q->dev, mio_geterrmsg(mio));
+		mio_dev_halt (q->dev);
+	}
+	else if (fwd->pending > 0 && fwd->src)
+	{
+		/* stop reading until the destination device drains the pipe */
+		dev->dev_cap |= MIO_DEV_CAP_RENEW_REQUIRED;
+		if ((q->dev->dev_cap & MIO_DEV_CAP_ACTIVE) && mio_dev_watch(q->dev, MIO_DEV_WATCH_RENEW, MIO_DEV_EVENT_IN) <= -1)
+		{
+			MIO_DEBUG1 (mio, "DEV(%p) - halting a device for watcher renewal failure\n", q->dev);
+			mio_dev_halt (q->dev);
+		}
+	}
+
+	return 0;
+}
+
+static int suspend_forward_source (mio_t* mio, mio_dev_t* dev, int events)
+{
+	/* if the peer has hung up while the forwarding pipe is full, stop watching
+	 * the device until the pipe gets drained not to lose the data left in the
+	 * device. the hangup is handled after reading it all */
+	if (dev->fwdq && (events & MIO_DEV_EVENT_HUP) && !(events & MIO_DEV_EVENT_ERR) &&
+	    ((wq_forward_data_t*)dev->fwdq->ptr)->pending > 0)
+	{
+		if (mio_dev_watch(dev, MIO_DEV_WATCH_STOP, 0) <= -1)
+		{
+			MIO_DEBUG1 (mio, "DEV(%p) - halting a device for watcher stop failure\n", dev);
+			mio_dev_halt (dev);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+static int read_coalesced (mio_t* mio, mio_dev_t* dev, mio_iolen_t* len, mio_devaddr_t* srcaddr, int* tail)
+{
+	/* keep reading into the buffer until no more data is available or
+	 * the buffer is full. EOF(1) or an error(-1) met after some data is
+	 * stored in *tail for the caller to handle it after the data */
+	mio_iolen_t off = 0, rem;
+	int x;
+
+	*tail = 0;
+	do
+	{
+		rem = MIO_COUNTOF(mio->bigbuf) - off;
+		x = dev->dev_mth->read(dev, &mio->bigbuf[off], &rem, srcaddr);
+		if (x <= 0 || rem <= 0)
+		{
+			if (off <= 0)
+			{
+				*len = rem;
+				return x;
+			}
+			*tail = x;
+			break;
+		}
+		off += rem;
+	}
+	while (off < MIO_COUNTOF(mio->bigbuf));
+
+	*len = off;
+	return 1;
+}
+
 static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int rdhup)
 {
 	MIO_ASSERT (mio, mio == dev->mio);
@@ -552,6 +833,15 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 
 	MIO_ASSERT (mio, mio == dev->mio);
 
+	if (dev->fwdq && (events & MIO_DEV_EVENT_HUP) && !(events & MIO_DEV_EVENT_ERR))
+	{
+		/* the hangup may have been reported while input watching was off
+		 * for forwarding. read the data left before handling the hangup.
+		 * this must precede the ready callback which may reject the hangup */
+		if (suspend_forward_source(mio, dev, events)) return;
+		if (!(dev->dev_cap & MIO_DEV_CAP_IN_DISABLED)) events |= MIO_DEV_EVENT_IN;
+	}
+
 	if (dev->dev_evcb->ready)
 	{
 		int x, xevents;
@@ -592,6 +882,65 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 
 			q = MIO_WQ_HEAD(&dev->wq);
 
+			if (q->forward)
+			{
+				wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+				mio_iolen_t olen;
+				int y;
+
+				x = drain_forward_pipe(mio, q);
+				if (x <= -1)
+				{
+					MIO_DEBUG2 (mio, "DEV(%p) - halting a device for forwarding failure - %js\n", dev, mio_geterrmsg(mio));
+					mio_dev_halt (dev);
+					dev = MIO_NULL;
+					break;
+				}
+				else if (x == 0)
+				{
+					/* resume reading from the source device once the pipe is empty.
+					 * output watching is not needed until more data gets in the pipe */
+					if (fwd->pending <= 0 && watch_forward_source(fwd->src) <= -1)
+					{
+						MIO_DEBUG1 (mio, "DEV(%p) - halting a device for watcher renewal failure\n", fwd->src);
+						mio_dev_halt (fwd->src);
+					}
+					dev->dev_cap |= MIO_DEV_CAP_RENEW_REQUIRED;
+					break;
+				}
+
+				/* finished a forwarding request */
+				olen = fwd->moved;
+				if (fwd->errnum != MIO_ENOERR)
+				{
+					mio_seterrnum (mio, fwd->errnum);
+					olen = -1;
+				}
+
+				unlink_wq (mio, q);
+				if (!MIO_WQ_IS_EMPTY(&dev->zcq))
+				{
+					/* report after the zero-copy requests preceding it */
+					q->olen = olen;
+					MIO_WQ_ENQ (&dev->zcq, q);
+					y = 0;
+				}
+				else
+				{
+					y = dev->dev_evcb->on_write(dev, olen, q->ctx, &q->dstaddr);
+					mio_freemem (mio, q);
+				}
+
+				if (y <= -1)
+				{
+					MIO_DEBUG2 (mio, "DEV(%p) - halting a device for on_write error - %js\n", dev, mio_geterrmsg(mio));
+					mio_dev_halt (dev);
+					dev = MIO_NULL;
+					break;
+				}
+				continue;
+			}
+
 			uptr = q->ptr;
 			urem = q->len;
 
@@ -601,6 +950,13 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 			{
 				x = dev->dev_mth->sendfile(dev, ((wq_sendfile_data_t*)uptr)->in_fd, ((wq_sendfile_data_t*)uptr)->foff, &ulen);
 			}
+			else if (q->zerocopy)
+			{
+				x = dev->dev_mth->writezc(dev, uptr, &ulen, &q->zcseq);
+				/* 2 indicates the data has been copied. no completion follows */
+				if (x == 1) q->zcsent = 1;
+				else if (x == 2) x = 1;
+			}
 			else
 			{
 				x = dev->dev_mth->write(dev, uptr, &ulen, &q->dstaddr);
@@ -614,8 +970,9 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 			}
 			else if (x == 0)
 			{
-				/* keep the left-over */
-				if (!q->sendfile) MIO_MEMMOVE (q->ptr, uptr, urem);
+				/* keep the left-over. the data of a zero-copy request is not owned */
+				if (q->zerocopy) q->ptr = (mio_uint8_t*)uptr;
+				else if (!q->sendfile) MIO_MEMMOVE (q->ptr, uptr, urem);
 				q->len = urem;
 				break;
 			}
@@ -631,6 +988,15 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 				}
 				urem -= ulen;
 
+				if (q->hlen > 0)
+				{
+					/* the bytes written no longer weigh on the write queue.
+					 * the rest is subtracted when the request is unlinked */
+					mio_iolen_t wlen = (ulen < q->hlen)? ulen: q->hlen;
+					q->hlen -= wlen;
+					dev->wq_bytes -= wlen;
+				}
+
 				if (urem <= 0)
 				{
 					/* finished writing a single write request */
@@ -646,8 +1012,19 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 					}
 
 					unlink_wq (mio, q);
-					y = dev->dev_evcb->on_write(dev, q->olen, q->ctx, &q->dstaddr);
-					mio_freemem (mio, q);
+					if (q->zcsent || !MIO_WQ_IS_EMPTY(&dev->zcq))
+					{
+						/* the callback is called when the kernel finishes sending
+						 * the data of this request or the zero-copy requests
+						 * preceding it. see mio_dev_completezc() */
+						MIO_WQ_ENQ (&dev->zcq, q);
+						y = 0;
+					}
+					else
+					{
+						y = dev->dev_evcb->on_write(dev, q->olen, q->ctx, &q->dstaddr);
+						mio_freemem (mio, q);
+					}
 
 					if (y <= -1)
 					{
@@ -674,6 +1051,8 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 			}
 		}
 
+		if (dev && check_wq_drain(mio, dev) <= -1) dev = MIO_NULL;
+
 		if (dev && MIO_WQ_IS_EMPTY(&dev->wq))
 		{
 			/* no pending request to write */
@@ -690,19 +1069,42 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 		}
 	}
 
-	if (dev && (events & MIO_DEV_EVENT_IN))
+	if (dev && (events & MIO_DEV_EVENT_IN) && dev->fwdq)
+	{
+		/* the input is forwarded to another device */
+		if (fill_forward_pipe(mio, dev) <= -1) dev = MIO_NULL;
+	}
+	else if (dev && (events & MIO_DEV_EVENT_IN))
 	{
 		mio_devaddr_t srcaddr;
 		mio_iolen_t len;
-		int x;
+		int x, tail = 0;
+		mio_errnum_t tail_errnum = MIO_ENOERR;
 
 		/* the devices are all non-blocking. read as much as possible
 		 * if on_read callback returns 1 or greater. read only once
 		 * if the on_read calllback returns 0. */
 		while (1)
 		{
-			len = MIO_COUNTOF(mio->bigbuf);
-			x = dev->dev_mth->read(dev, mio->bigbuf, &len, &srcaddr);
+			if (tail)
+			{
+				/* EOF or an error met after the coalesced data delivered */
+				x = tail;
+				len = 0;
+				tail = 0;
+				if (x <= -1) mio_seterrnum (mio, tail_errnum);
+			}
+			else if ((dev->dev_cap & (MIO_DEV_CAP_STREAM | MIO_DEV_CAP_IN_COALESCE)) == (MIO_DEV_CAP_STREAM | MIO_DEV_CAP_IN_COALESCE))
+			{
+				len = MIO_COUNTOF(mio->bigbuf);
+				x = read_coalesced(mio, dev, &len, &srcaddr, &tail);
+				if (tail <= -1) tail_errnum = mio_geterrnum(mio);
+			}
+			else
+			{
+				len = MIO_COUNTOF(mio->bigbuf);
+				x = dev->dev_mth->read(dev, mio->bigbuf, &len, &srcaddr);
+			}
 			if (x <= -1)
 			{
 				MIO_DEBUG2 (mio, "DEV(%p) - halting a device for read failure - %js\n", dev, mio_geterrmsg(mio));
@@ -711,24 +1113,7 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 				break;
 			}
 
-			if (dev->rtmridx != MIO_TMRIDX_INVALID)
-			{
-				/* delete the read timeout job on the device as the
-				 * read operation will be reported below. */
-				mio_tmrjob_t tmrjob;
-
-				MIO_MEMSET (&tmrjob, 0, MIO_SIZEOF(tmrjob));
-				tmrjob.ctx = dev;
-				mio_gettime (mio, &tmrjob.when);
-				MIO_ADD_NTIME (&tmrjob.when, &tmrjob.when, &dev->rtmout);
-				tmrjob.handler = on_read_timeout;
-				tmrjob.idxptr = &dev->rtmridx;
-
-				mio_updtmrjob (mio, dev->rtmridx, &tmrjob);
-
-				/*mio_deltmrjob (mio, dev->rtmridx);
-				dev->rtmridx = MIO_TMRIDX_INVALID;*/
-			}
+			if (dev->rtmridx != MIO_TMRIDX_INVALID) renew_read_timeout (mio, dev);
 
 			if (x == 0)
 			{
@@ -780,10 +1165,9 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 				else
 				{
 					int y;
-		/* TODO: for a stream device, merge received data if bigbuf isn't full and fire the on_read callback
-		 *        when x == 0 or <= -1. you can  */
 
-					/* data available */
+					/* data available. the data received in a row has been merged
+					 * for a stream device with MIO_DEV_CAP_IN_COALESCE */
 					y = dev->dev_evcb->on_read(dev, mio->bigbuf, len, &srcaddr);
 					if (y <= -1)
 					{
@@ -792,10 +1176,13 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 						dev = MIO_NULL;
 						break;
 					}
-					else if (y == 0)
+					else if (y == 0 && (!tail || (dev->dev_cap & MIO_DEV_CAP_IN_DISABLED)))
 					{
 						/* don't be greedy. read only once 
-						 * for this loop iteration */
+						 * for this loop iteration. the tail is left
+						 * unread while reading is disabled. the watcher
+						 * is level-triggered and reports it again
+						 * when reading is enabled */
 						break;
 					}
 				}
@@ -803,6 +1190,8 @@ static MIO_INLINE void handle_event (mio_t* mio, mio_dev_t* dev, int events, int
 		}
 	}
 
+	if (dev && suspend_forward_source(mio, dev, events)) return;
+
 	if (dev)
 	{
 		if (events & (MIO_DEV_EVENT_ERR | MIO_DEV_EVENT_HUP))
@@ -887,6 +1276,10 @@ static MIO_INLINE int __exec (mio_t* mio)
 {
 	int ret = 0;
 
+	/* take the time once for the cwq handlers and timer jobs below.
+	 * mio_sys_waitmux() refreshes it again after waking up */
+	mio_refreshtime (mio);
+
 	/* clear unneeded cfmbs - i hate to do this. TODO: should i do this less frequently? if less frequent, would it accumulate too many blocks? */
 	if (!MIO_CFMBL_IS_EMPTY(&mio->cfmb)) clear_unneeded_cfmbs (mio);
 
@@ -926,6 +1319,9 @@ static MIO_INLINE int __exec (mio_t* mio)
 	}
 
 	kill_all_halted_devices (mio);
+
+	/* the cached time goes stale once the control leaves the loop */
+	mio->tick.valid = 0;
 	return ret;
 }
 
@@ -991,6 +1387,9 @@ mio_dev_t* mio_dev_make (mio_t* mio, mio_oow_t dev_size, mio_dev_mth_t* dev_mth,
 	dev->rtmridx = MIO_TMRIDX_INVALID;
 	MIO_WQ_INIT (&dev->wq);
 	dev->cw_count = 0;
+	MIO_WQ_INIT (&dev->zcq);
+	dev->wq_bytes = 0;
+	dev->wq_pressured = 0;
 
 	/* call the callback function first */
 	if (dev->dev_mth->make(dev, make_ctx) <= -1) goto oops;
@@ -1144,6 +1543,13 @@ void mio_dev_kill (mio_dev_t* dev)
 	/* clear completed write event queues */
 	if (dev->cw_count > 0) fire_cwq_handlers_for_dev (mio, dev, 1);
 
+	/* the requests waiting for zero-copy completion are reported as completed
+	 * as the device is going away */
+	while (!MIO_WQ_IS_EMPTY(&dev->zcq)) fire_zcq_handler (mio, dev, MIO_WQ_HEAD(&dev->zcq));
+
+	/* the device is gone before the forwarding request reading from it is over */
+	if (dev->fwdq) detach_forward_source (dev->fwdq, MIO_EDEVHUP);
+
 	/* clear pending write requests - won't fire on_write for pending write requests */
 	while (!MIO_WQ_IS_EMPTY(&dev->wq))
 	{
@@ -1222,6 +1628,13 @@ int mio_dev_ioctl (mio_dev_t* dev, int cmd, void* arg)
 	return dev->dev_mth->ioctl(dev, cmd, arg);
 }
 
+static MIO_INLINE int is_forward_idle (mio_wq_t* q)
+{
+	/* no data to write until more input arrives on the source device */
+	wq_forward_data_t* fwd = (wq_forward_data_t*)q->ptr;
+	return fwd->pending <= 0 && fwd->src;
+}
+
 int mio_dev_watch (mio_dev_t* dev, mio_dev_watch_cmd_t cmd, int events)
 {
 	mio_t* mio = dev->mio;
@@ -1265,6 +1678,7 @@ int mio_dev_watch (mio_dev_t* dev, mio_dev_watch_cmd_t cmd, int events)
 			 * if you want input watching disabled while renewing, call this function like this. 
 			 *  mio_dev_wtach (dev, MIO_DEV_WATCH_RENEW, 0); */
 			if (MIO_WQ_IS_EMPTY(&dev->wq)) events &= ~MIO_DEV_EVENT_OUT;
+			else if (MIO_WQ_HEAD(&dev->wq)->forward && is_forward_idle(MIO_WQ_HEAD(&dev->wq))) events &= ~MIO_DEV_EVENT_OUT;
 			else events |= MIO_DEV_EVENT_OUT;
 
 			/* fall through */
@@ -1286,6 +1700,10 @@ int mio_dev_watch (mio_dev_t* dev, mio_dev_watch_cmd_t cmd, int events)
 	}
 
 
+	/* the input of a device being forwarded is not watched while 
+	 * the forwarding pipe holds data */
+	if (dev->fwdq && ((wq_forward_data_t*)dev->fwdq->ptr)->pending > 0) events &= ~MIO_DEV_EVENT_IN;
+
 	/* this function honors MIO_DEV_EVENT_IN and MIO_DEV_EVENT_OUT only
 	 * as valid input event bits. it intends to provide simple abstraction
 	 * by reducing the variety of event bits that the caller has to handle. */
@@ -1303,9 +1721,12 @@ int mio_dev_watch (mio_dev_t* dev, mio_dev_watch_cmd_t cmd, int events)
 		if (dev->dev_cap & MIO_DEV_CAP_OUT) dev_cap |= MIO_DEV_CAP_OUT_WATCHED;
 	}
 
-	if (mux_cmd == MIO_SYS_MUX_CMD_UPDATE && (dev_cap & DEV_CAP_ALL_WATCHED) == (dev->dev_cap & DEV_CAP_ALL_WATCHED))
+	if (mux_cmd == MIO_SYS_MUX_CMD_UPDATE && (dev_cap & DEV_CAP_ALL_WATCHED) == (dev->dev_cap & DEV_CAP_ALL_WATCHED) &&
+	    !((dev->dev_cap & MIO_DEV_CAP_WATCH_SUSPENDED) && !MIO_WQ_IS_EMPTY(&dev->zcq)))
 	{
-		/* no change in the device capacity. skip calling epoll_ctl */
+		/* no change in the device capacity. skip calling epoll_ctl.
+		 * a suspended device with zero-copy requests pending completion
+		 * must be registered back to get the completion notifications */
 	}
 	else
 	{
@@ -1418,7 +1839,7 @@ static void on_write_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t*
 	x = dev->dev_evcb->on_write(dev, -1, q->ctx, &q->dstaddr); 
 
 	MIO_ASSERT (mio, q->tmridx == MIO_TMRIDX_INVALID);
-	MIO_WQ_UNLINK(q);
+	unlink_wq (mio, q);
 	mio_freemem (mio, q);
 
 	if (x <= -1) 
@@ -1426,6 +1847,7 @@ static void on_write_timeout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t*
 		MIO_DEBUG2 (mio, "DEV(%p) - halting a device for on_write error upon timeout - %js\n", dev, mio_geterrmsg(mio));
 		mio_dev_halt (dev);
 	}
+	else check_wq_drain (mio, dev);
 }
 
 static MIO_INLINE int __enqueue_completed_write (mio_dev_t* dev, mio_iolen_t len, void* wrctx, const mio_devaddr_t* dstaddr)
@@ -1434,6 +1856,30 @@ static MIO_INLINE int __enqueue_completed_write (mio_dev_t* dev, mio_iolen_t len
 	mio_cwq_t* cwq;
 	mio_oow_t cwq_extra_aligned, cwqfl_index;
 
+	if (!MIO_WQ_IS_EMPTY(&dev->zcq))
+	{
+		/* the on_write callback must not precede those of the zero-copy
+		 * requests waiting for completion. chain it after them */
+		mio_wq_t* q;
+
+		q = (mio_wq_t*)mio_callocmem(mio, MIO_SIZEOF(*q) + (dstaddr? dstaddr->len: 0));
+		if (MIO_UNLIKELY(!q)) return -1;
+
+		q->olen = len;
+		q->ctx = wrctx;
+		q->dev = dev;
+		q->tmridx = MIO_TMRIDX_INVALID;
+		if (dstaddr)
+		{
+			q->dstaddr.ptr = (mio_uint8_t*)(q + 1);
+			q->dstaddr.len = dstaddr->len;
+			MIO_MEMCPY (q->dstaddr.ptr, dstaddr->ptr, dstaddr->len);
+		}
+
+		MIO_WQ_ENQ (&dev->zcq, q);
+		return 0;
+	}
+
 	cwq_extra_aligned = (dstaddr? dstaddr->len: 0);
 	cwq_extra_aligned = MIO_ALIGN_POW2(cwq_extra_aligned, MIO_CWQFL_ALIGN);
 	cwqfl_index = cwq_extra_aligned / MIO_CWQFL_SIZE;
@@ -1489,6 +1935,10 @@ static MIO_INLINE int __enqueue_pending_write (mio_dev_t* dev, mio_iolen_t olen,
 	if (MIO_UNLIKELY(!q)) return -1;
 
 	q->sendfile = 0;
+	q->forward = 0;
+	q->zerocopy = 0;
+	q->zcsent = 0;
+	q->hlen = 0;
 	q->tmridx = MIO_TMRIDX_INVALID;
 	q->dev = dev;
 	q->ctx = wrctx;
@@ -1533,6 +1983,8 @@ static MIO_INLINE int __enqueue_pending_write (mio_dev_t* dev, mio_iolen_t olen,
 	}
 
 	MIO_WQ_ENQ (&dev->wq, q);
+	q->hlen = urem;
+	dev->wq_bytes += urem;
 	if (!(dev->dev_cap & MIO_DEV_CAP_OUT_WATCHED))
 	{
 		/* if output is not being watched, arrange to do so */
@@ -1544,6 +1996,7 @@ static MIO_INLINE int __enqueue_pending_write (mio_dev_t* dev, mio_iolen_t olen,
 		}
 	}
 
+	check_wq_pressure (mio, dev);
 	return 0; /* request pused to a write queue. */
 }
 
@@ -1564,6 +2017,10 @@ static MIO_INLINE int __enqueue_pending_sendfile (mio_dev_t* dev, mio_iolen_t ol
 	if (MIO_UNLIKELY(!q)) return -1;
 
 	q->sendfile = 1;
+	q->forward = 0;
+	q->zerocopy = 0;
+	q->zcsent = 0;
+	q->hlen = 0;
 	q->tmridx = MIO_TMRIDX_INVALID;
 	q->dev = dev;
 	q->ctx = wrctx;
@@ -1939,9 +2396,267 @@ int mio_dev_timedsendfile (mio_dev_t* dev, mio_syshnd_t in_fd, mio_foff_t foff,
 	return __dev_sendfile(dev,in_fd, foff, len, tmout, wrctx);
 }
 
+int mio_dev_forward (mio_dev_t* dev, mio_dev_t* src, mio_iolen_t len, void* wrctx)
+{
+	mio_t* mio = dev->mio;
+	mio_wq_t* q;
+	wq_forward_data_t* fwd;
+
+	if (MIO_UNLIKELY(dev->dev_cap & MIO_DEV_CAP_OUT_CLOSED))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "unable to forward to closed device");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(src->dev_cap & MIO_DEV_CAP_IN_CLOSED))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "unable to forward from closed device");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(!dev->dev_mth->splice || !src->dev_mth->splice || 
+	                 !(dev->dev_cap & MIO_DEV_CAP_STREAM) || !(src->dev_cap & MIO_DEV_CAP_STREAM)))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "unable to forward over unsupported device");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(dev->dev_cap & MIO_DEV_CAP_OUT_UNQUEUEABLE))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "device incapable of queuing");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(dev == src || src->mio != mio || len == 0))
+	{
+		mio_seterrnum (mio, MIO_EINVAL);
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(src->fwdq))
+	{
+		mio_seterrbfmt (mio, MIO_EPERM, "device input already being forwarded");
+		return -1;
+	}
+
+	q = (mio_wq_t*)mio_allocmem(mio, MIO_SIZEOF(*q) + MIO_SIZEOF(wq_forward_data_t));
+	if (MIO_UNLIKELY(!q)) return -1;
+
+	q->sendfile = 0;
+	q->forward = 1;
+	q->zerocopy = 0;
+	q->zcsent = 0;
+	q->hlen = 0;
+	q->tmridx = MIO_TMRIDX_INVALID;
+	q->dev = dev;
+	q->ctx = wrctx;
+	q->dstaddr.ptr = MIO_NULL;
+	q->dstaddr.len = 0;
+	q->ptr = (mio_uint8_t*)(q + 1);
+	q->len = (len < 0)? -1: len; /* remaining length to read. -1 to read until EOF */
+	q->olen = 0;
+
+	fwd = (wq_forward_data_t*)q->ptr;
+	fwd->src = src;
+	fwd->pending = 0;
+	fwd->moved = 0;
+	fwd->errnum = MIO_ENOERR;
+	if (mio_sys_openpipe(mio, fwd->pfd) <= -1)
+	{
+		mio_freemem (mio, q);
+		return -1;
+	}
+
+	/* the request is not written until the data in the pipe is available.
+	 * so output watching is not renewed here */
+	MIO_WQ_ENQ (&dev->wq, q);
+	src->fwdq = q;
+	return 0;
+}
+
+int mio_dev_writezc (mio_dev_t* dev, const void* data, mio_iolen_t len, void* wrctx)
+{
+	mio_t* mio = dev->mio;
+	mio_wq_t* q;
+	mio_iolen_t ulen;
+	int x;
+
+	if (MIO_UNLIKELY(dev->dev_cap & MIO_DEV_CAP_OUT_CLOSED))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "unable to write to closed device");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(!dev->dev_mth->writezc || !(dev->dev_cap & MIO_DEV_CAP_STREAM)))
+	{
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "unable to write without copying over unsupported device");
+		return -1;
+	}
+
+	if (MIO_UNLIKELY(len <= 0))
+	{
+		/* use mio_dev_write() to close the writing end */
+		mio_seterrbfmt (mio, MIO_EINVAL, "zero-length zero-copy writing request");
+		return -1;
+	}
+
+	/* the request is allocated regardless of immediate writing
+	 * as the completion is reported later */
+	q = (mio_wq_t*)mio_callocmem(mio, MIO_SIZEOF(*q));
+	if (MIO_UNLIKELY(!q)) return -1;
+
+	q->zerocopy = 1;
+	q->hlen = 0;
+	q->olen = len;
+	q->ptr = (mio_uint8_t*)data;
+	q->len = len;
+	q->ctx = wrctx;
+	q->dev = dev;
+	q->tmridx = MIO_TMRIDX_INVALID;
+
+	if (MIO_WQ_IS_EMPTY(&dev->wq))
+	{
+		do
+		{
+			ulen = q->len;
+			x = dev->dev_mth->writezc(dev, q->ptr, &ulen, &q->zcseq);
+			if (x <= -1)
+			{
+				mio_freemem (mio, q);
+				return -1;
+			}
+			else if (x == 0) break;
+			else if (x == 1) q->zcsent = 1;
+
+			q->ptr += ulen;
+			q->len -= ulen;
+		}
+		while (q->len > 0);
+
+		if (q->len <= 0)
+		{
+			if (!q->zcsent && MIO_WQ_IS_EMPTY(&dev->zcq))
+			{
+				/* all copied. nothing to wait for */
+				mio_freemem (mio, q);
+				return __enqueue_completed_write(dev, len, wrctx, MIO_NULL);
+			}
+
+			/* written immediately. wait for the kernel to finish sending */
+			MIO_WQ_ENQ (&dev->zcq, q);
+			if (dev->dev_cap & MIO_DEV_CAP_WATCH_SUSPENDED)
+			{
+				/* the completion notification is reported as an error event.
+				 * a device not being watched must be registered back */
+				if (mio_dev_watch(dev, MIO_DEV_WATCH_RENEW, 0) <= -1)
+				{
+					/* the data has been sent. the callback is called
+					 * for the request when the device is killed */
+					mio_dev_halt (dev);
+				}
+			}
+			return 0;
+		}
+	}
+
+	if (MIO_UNLIKELY(dev->dev_cap & MIO_DEV_CAP_OUT_UNQUEUEABLE))
+	{
+		/* writing queuing is not requested. so return failure */
+		mio_seterrbfmt (mio, MIO_ENOCAPA, "device incapable of queuing");
+		mio_freemem (mio, q);
+		return -1;
+	}
+
+	MIO_WQ_ENQ (&dev->wq, q);
+	if (!(dev->dev_cap & MIO_DEV_CAP_OUT_WATCHED))
+	{
+		/* if output is not being watched, arrange to do so */
+		if (mio_dev_watch(dev, MIO_DEV_WATCH_RENEW, MIO_DEV_EVENT_IN) <= -1)
+		{
+			unlink_wq (mio, q);
+			mio_freemem (mio, q);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int mio_dev_completezc (mio_dev_t* dev, mio_uint32_t seq)
+{
+	mio_t* mio = dev->mio;
+
+	/* the kernel finishes zero-copy sending operations on a stream in order.
+	 * the sequence number wraps around. compare it with the difference */
+	while (!MIO_WQ_IS_EMPTY(&dev->zcq))
+	{
+		mio_wq_t* q;
+
+		q = MIO_WQ_HEAD(&dev->zcq);
+		if (q->zcsent && (mio_int32_t)(seq - q->zcseq) < 0) break;
+
+		if (fire_zcq_handler(mio, dev, q) <= -1) return -1;
+	}
+
+	return 0;
+}
+
+void mio_dev_setwmark (mio_dev_t* dev, const mio_dev_wmark_t* wmark)
+{
+	if (wmark && wmark->high > 0)
+	{
+		dev->wmark = *wmark;
+		/* the low watermark must be lower than the high watermark */
+		if (dev->wmark.low >= dev->wmark.high) dev->wmark.low = dev->wmark.high - 1;
+	}
+	else
+	{
+		MIO_MEMSET (&dev->wmark, 0, MIO_SIZEOF(dev->wmark));
+	}
+	dev->wq_pressured = 0;
+}
+
+int mio_dev_wmark_pausereader (mio_dev_t* dev, void* ctx)
+{
+	return mio_dev_read((mio_dev_t*)ctx, 0);
+}
+
+int mio_dev_wmark_resumereader (mio_dev_t* dev, void* ctx)
+{
+	return mio_dev_read((mio_dev_t*)ctx, 1);
+}
+
 /* -------------------------------------------------------------------------- */
 
+void mio_refreshtime (mio_t* mio)
+{
+	if (mio->option.trait & MIO_TRAIT_COARSE_CLOCK)
+	{
+		mio_sys_getcoarsetime (mio, &mio->tick.now);
+		MIO_SUB_NTIME (&mio->tick.now, &mio->tick.now, &mio->init_time);
+		/* the coarse clock may lag behind init_time taken with the precise clock */
+		if (!MIO_IS_POS_NTIME(&mio->tick.now)) MIO_CLEAR_NTIME (&mio->tick.now);
+	}
+	else
+	{
+		mio_sys_gettime (mio, &mio->tick.now);
+		MIO_SUB_NTIME (&mio->tick.now, &mio->tick.now, &mio->init_time);
+	}
+	mio->tick.valid = 1;
+}
+
 void mio_gettime (mio_t* mio, mio_ntime_t* now)
+{
+	if (MIO_LIKELY(mio->tick.valid))
+	{
+		*now = mio->tick.now;
+		return;
+	}
+
+	mio_gettime_precise (mio, now);
+}
+
+void mio_gettime_precise (mio_t* mio, mio_ntime_t* now)
 {
 	mio_sys_gettime (mio, now);
 	/* in mio_init(), mio->init_time has been set to the initialization time. 
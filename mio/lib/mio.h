@@ -130,6 +130,14 @@ enum mio_feature_t
 };
 typedef enum mio_feature_t mio_feature_t;
 
+enum mio_trait_t
+{
+	/* refresh the loop-tick time with a coarse clock(e.g. CLOCK_MONOTONIC_COARSE)
+	 * if available. it is cheaper to read but lags by up to a scheduler tick */
+	MIO_TRAIT_COARSE_CLOCK = ((mio_bitmask_t)1 << 0)
+};
+typedef enum mio_trait_t mio_trait_t;
+
 enum mio_option_t
 {
 	MIO_TRAIT,
@@ -235,6 +243,23 @@ struct mio_dev_mth_t
 	int           (*writev)       (mio_dev_t* dev, const mio_iovec_t* iov, mio_iolen_t* iovcnt, const mio_devaddr_t* dstaddr);
 	int           (*sendfile)     (mio_dev_t* dev, mio_syshnd_t in_fd, mio_foff_t foff, mio_iolen_t* len);
 
+	/* optional. move data between the device and the pipe handle given
+	 * without copying it to user space. data flows from the device to
+	 * the pipe if 'out' is 0 and from the pipe to the device otherwise.
+	 * return -1 on failure, 0 if no data can be moved, 1 otherwise.
+	 * when returning 1, *len must be set to the length of data moved.
+	 * if *len is set to 0 while 'out' is 0, it's treated as EOF. */
+	int           (*splice)       (mio_dev_t* dev, mio_syshnd_t pfd, mio_iolen_t* len, int out);
+
+	/* optional. write data without copying it to the kernel. the data must
+	 * stay intact until the device reports completion of the sending
+	 * operation with mio_dev_completezc(). return -1 on failure, 0 if no
+	 * data can be written, 1 if written without copying, 2 if written by
+	 * copying. when returning 1 or 2, *len must be set to the length of
+	 * data written. *seq must be set to the sequence number of the sending
+	 * operation when returning 1 only. */
+	int           (*writezc)      (mio_dev_t* dev, const void* data, mio_iolen_t* len, mio_uint32_t* seq);
+
 	/* ------------------------------------------------------------------ */
 	int           (*ioctl)        (mio_dev_t* dev, int cmd, void* arg);
 
@@ -338,6 +363,10 @@ struct mio_wq_t
 	mio_wq_t*       q_prev;
 
 	int             sendfile;
+	int             forward;
+	int             zerocopy;
+	int             zcsent; /* some data sent without copying. completion pending */
+	mio_uint32_t    zcseq; /* sequence number of the last zero-copy send */
 	mio_iolen_t     olen; /* original data length */
 	mio_uint8_t*    ptr;  /* pointer to data */
 	mio_iolen_t     len;  /* remaining data length */
@@ -346,6 +375,7 @@ struct mio_wq_t
 
 	mio_tmridx_t    tmridx;
 	mio_devaddr_t   dstaddr;
+	mio_iolen_t     hlen; /* length of the data copied and held by the request and not written yet */
 };
 
 #define MIO_WQ_INIT(wq) ((wq)->q_next = (wq)->q_prev = (wq))
@@ -363,6 +393,25 @@ struct mio_wq_t
 #define MIO_WQ_ENQ(wq,x) MIO_WQ_LINK(MIO_WQ_TAIL(wq), (mio_q_t*)x, wq)
 #define MIO_WQ_DEQ(wq) MIO_WQ_UNLINK(MIO_WQ_HEAD(wq))
 
+typedef int (*mio_dev_on_wmark_t) (
+	mio_dev_t*      dev,
+	void*           ctx
+);
+
+/* write queue watermarks to bound the data queued on a device. on_pressure
+ * is called when the data held in the write queue reaches the high 
+ * watermark. on_drain is called when it falls to the low watermark after
+ * on_pressure. the device is halted if a callback returns -1. */
+typedef struct mio_dev_wmark_t mio_dev_wmark_t;
+struct mio_dev_wmark_t
+{
+	mio_oow_t          high; /* 0 to disable */
+	mio_oow_t          low;
+	mio_dev_on_wmark_t on_pressure;
+	mio_dev_on_wmark_t on_drain;
+	void*              ctx;
+};
+
 #define MIO_DEV_HEADER \
 	mio_t*          mio; \
 	mio_oow_t       dev_size; \
@@ -373,6 +422,11 @@ struct mio_wq_t
 	mio_tmridx_t    rtmridx; \
 	mio_wq_t        wq; \
 	mio_oow_t       cw_count; \
+	mio_wq_t*       fwdq; \
+	mio_wq_t        zcq; \
+	mio_oow_t       wq_bytes; \
+	int             wq_pressured; \
+	mio_dev_wmark_t wmark; \
 	mio_dev_t*      dev_prev; \
 	mio_dev_t*      dev_next 
 
@@ -415,7 +469,8 @@ enum mio_dev_cap_t
 	MIO_DEV_CAP_STREAM          = (1 << 4),
 	MIO_DEV_CAP_IN_DISABLED     = (1 << 5),
 	MIO_DEV_CAP_OUT_UNQUEUEABLE = (1 << 6),
-	MIO_DEV_CAP_ALL_MASK        = (MIO_DEV_CAP_VIRTUAL | MIO_DEV_CAP_IN | MIO_DEV_CAP_OUT | MIO_DEV_CAP_PRI | MIO_DEV_CAP_STREAM | MIO_DEV_CAP_IN_DISABLED | MIO_DEV_CAP_OUT_UNQUEUEABLE),
+	MIO_DEV_CAP_IN_COALESCE     = (1 << 7),  /* read a stream device till no data is available and call on_read once. meaningful only if #MIO_DEV_CAP_STREAM is set */
+	MIO_DEV_CAP_ALL_MASK        = (MIO_DEV_CAP_VIRTUAL | MIO_DEV_CAP_IN | MIO_DEV_CAP_OUT | MIO_DEV_CAP_PRI | MIO_DEV_CAP_STREAM | MIO_DEV_CAP_IN_DISABLED | MIO_DEV_CAP_OUT_UNQUEUEABLE | MIO_DEV_CAP_IN_COALESCE),
 
 	/* -------------------------------------------------------------------
 	 * the followings bits are for internal use only. 
@@ -431,7 +486,8 @@ enum mio_dev_cap_t
 	MIO_DEV_CAP_ZOMBIE          = (1 << 17),
 	MIO_DEV_CAP_RENEW_REQUIRED  = (1 << 18),
 	MIO_DEV_CAP_WATCH_STARTED   = (1 << 19),
-	MIO_DEV_CAP_WATCH_SUSPENDED = (1 << 20)
+	MIO_DEV_CAP_WATCH_SUSPENDED = (1 << 20),
+	MIO_DEV_CAP_WATCH_EXCLUSIVE = (1 << 21)  /**< wake up one of the multiplexers sharing the handle. epoll only */
 };
 typedef enum mio_dev_cap_t mio_dev_cap_t;
 
@@ -578,6 +634,7 @@ enum mio_log_mask_t
 	MIO_LOG_ALL_LEVELS = (MIO_LOG_DEBUG  | MIO_LOG_INFO | MIO_LOG_WARN | MIO_LOG_ERROR | MIO_LOG_FATAL),
 	MIO_LOG_ALL_TYPES  = (MIO_LOG_UNTYPED | MIO_LOG_CORE | MIO_LOG_DEV | MIO_LOG_TIMER),
 
+	MIO_LOG_ASYNC      = ((mio_bitmask_t)1 << 12), /* let a dedicated thread write log messages for the builtin writer. messages are dropped if it lags too much */
 	MIO_LOG_GUARDED    = ((mio_bitmask_t)1 << 13), /* make logging thread-safe */
 	MIO_LOG_STDOUT     = ((mio_bitmask_t)1 << 14), /* write log messages to stdout without timestamp. MIO_LOG_STDOUT wins over MIO_LOG_STDERR. */
 	MIO_LOG_STDERR     = ((mio_bitmask_t)1 << 15)  /* write log messages to stderr without timestamp. */
@@ -714,6 +771,14 @@ struct mio_t
 	mio_uint8_t bigbuf[65535]; /* TODO: make this dynamic depending on devices added. device may indicate a buffer size required??? */
 
 	mio_ntime_t init_time;
+	struct
+	{
+		int valid;
+		mio_ntime_t now; /* relative to init_time */
+	} tick; /* time cached once per loop iteration */
+
+	mio_uint8_t hashkey[16]; /* random key for hashing data from untrusted sources */
+
 	struct
 	{
 		mio_oow_t     capa;
@@ -989,6 +1054,85 @@ MIO_EXPORT int mio_dev_timedsendfile (
 	const mio_ntime_t*    tmout,
 	void*                 wrctx
 );
+
+/**
+ * The mio_dev_forward() function posts a request to write data read from
+ * the \a src device to the \a dev device. The data is moved through a
+ * kernel pipe without being copied to user space and the on_read callback
+ * of \a src is not called for the data forwarded. The request ends when
+ * \a len bytes are forwarded or when \a src reaches EOF if \a len is
+ * negative. EOF is still reported to the on_read callback of \a src.
+ * The on_write callback of \a dev is called with the total number of bytes
+ * forwarded when the request ends, or with -1 if reading from \a src fails
+ * or \a src is killed before the request ends. Input on \a src is not
+ * watched while forwarded data is waiting to be written to \a dev.
+ * Both devices must be stream devices capable of splicing.
+ */
+MIO_EXPORT int mio_dev_forward (
+	mio_dev_t*            dev,
+	mio_dev_t*            src,
+	mio_iolen_t           len,
+	void*                 wrctx
+);
+
+/**
+ * The mio_dev_writezc() function posts a request to write data on a stream
+ * device without copying it to the kernel. The data must stay intact until
+ * the on_write callback is called, which is deferred until the device reports
+ * that the kernel has finished sending it. The on_write callbacks of the writing
+ * requests posted afterwards are also deferred to keep the completion order.
+ * The data left unsent is not copied to the write queue either.
+ */
+MIO_EXPORT int mio_dev_writezc (
+	mio_dev_t*            dev,
+	const void*           data,
+	mio_iolen_t           len,
+	void*                 wrctx
+);
+
+/**
+ * The mio_dev_completezc() function is called by a device implementation
+ * to indicate that the kernel has finished all zero-copy sending operations
+ * up to the sequence number \a seq. It calls the on_write callbacks of the
+ * writing requests completed. It returns -1 if a callback fails and 0 otherwise.
+ */
+MIO_EXPORT int mio_dev_completezc (
+	mio_dev_t*            dev,
+	mio_uint32_t          seq
+);
+
+/**
+ * The mio_dev_setwmark() function sets the watermarks of the data held in
+ * the write queue of a device. It clears the watermarks if \a wmark is
+ * #MIO_NULL or the high watermark is 0. The pressure state is reset without
+ * calling on_drain. The data of sendfile, forwarding and zero-copy requests
+ * is not counted as it is not copied.
+ */
+MIO_EXPORT void mio_dev_setwmark (
+	mio_dev_t*             dev,
+	const mio_dev_wmark_t* wmark
+);
+
+/**
+ * The mio_dev_wmark_pausereader() function disables input watching on the
+ * device given as \a ctx. It can be used as the on_pressure callback for a
+ * device whose data written comes from another device.
+ */
+MIO_EXPORT int mio_dev_wmark_pausereader (
+	mio_dev_t*            dev,
+	void*                 ctx
+);
+
+/**
+ * The mio_dev_wmark_resumereader() function enables input watching on the
+ * device given as \a ctx. It is the counterpart of mio_dev_wmark_pausereader()
+ * for the on_drain callback.
+ */
+MIO_EXPORT int mio_dev_wmark_resumereader (
+	mio_dev_t*            dev,
+	void*                 ctx
+);
+
 /* =========================================================================
  * SERVICE 
  * ========================================================================= */
@@ -1065,12 +1209,25 @@ MIO_EXPORT int mio_schedtmrjobafter (
 
 /**
  * The mio_gettime() function returns the elapsed time since mio initialization.
+ * While the event loop is running, it returns the time cached when the loop
+ * last woke up instead of reading the system clock. Outside the loop, it is
+ * the same as mio_gettime_precise().
  */
 MIO_EXPORT void mio_gettime (
 	mio_t*            mio,
 	mio_ntime_t*      now
 );
 
+/**
+ * The mio_gettime_precise() function reads the system clock and returns the
+ * elapsed time since mio initialization. Use it when the time must not lag
+ * behind the cached loop time, e.g. to measure time spent in a callback.
+ */
+MIO_EXPORT void mio_gettime_precise (
+	mio_t*            mio,
+	mio_ntime_t*      now
+);
+
 /* =========================================================================
  * SYSTEM MEMORY MANAGEMENT FUCNTIONS VIA MMGR
  * ========================================================================= */
@@ -337,6 +337,19 @@ static mio_syshnd_t dev_pipe_getsyshnd_slave (mio_dev_t* dev)
 	return (mio_syshnd_t)pipe->pfd;
 }
 
+static int dev_pipe_splice_slave (mio_dev_t* dev, mio_syshnd_t pfd, mio_iolen_t* len, int out)
+{
+	mio_dev_pipe_slave_t* pipe = (mio_dev_pipe_slave_t*)dev;
+
+	if (MIO_UNLIKELY(pipe->pfd == MIO_SYSHND_INVALID))
+	{
+		mio_seterrnum (pipe->mio, MIO_EBADHND);
+		return -1;
+	}
+
+	return out? mio_sys_splice(pipe->mio, pfd, pipe->pfd, len): mio_sys_splice(pipe->mio, pipe->pfd, pfd, len);
+}
+
 static int dev_pipe_ioctl (mio_dev_t* dev, int cmd, void* arg)
 {
 	mio_t* mio = dev->mio;
@@ -377,9 +390,12 @@ static mio_dev_mth_t dev_pipe_methods =
 	MIO_NULL,
 	dev_pipe_getsyshnd,
 
-	MIO_NULL,
-	MIO_NULL,
-	MIO_NULL,
+	MIO_NULL, /* read */
+	MIO_NULL, /* write */
+	MIO_NULL, /* writev */
+	MIO_NULL, /* sendfile */
+	MIO_NULL, /* splice */
+	MIO_NULL, /* writezc */
 	dev_pipe_ioctl
 };
 
@@ -393,6 +409,9 @@ static mio_dev_mth_t dev_pipe_methods_slave =
 	dev_pipe_read_slave,
 	dev_pipe_write_slave,
 	dev_pipe_writev_slave,
+	MIO_NULL, /* sendfile */
+	dev_pipe_splice_slave,
+	MIO_NULL, /* writezc */
 	dev_pipe_ioctl
 };
 
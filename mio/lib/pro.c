@@ -682,6 +682,14 @@ static mio_syshnd_t dev_pro_getsyshnd_slave (mio_dev_t* dev)
 	return (mio_syshnd_t)pro->pfd;
 }
 
+static int dev_pro_splice_slave (mio_dev_t* dev, mio_syshnd_t pfd, mio_iolen_t* len, int out)
+{
+	mio_dev_pro_slave_t* pro = (mio_dev_pro_slave_t*)dev;
+
+	MIO_ASSERT (pro->mio, pro->pfd != MIO_SYSHND_INVALID);
+	return out? mio_sys_splice(pro->mio, pfd, pro->pfd, len): mio_sys_splice(pro->mio, pro->pfd, pfd, len);
+}
+
 static int dev_pro_ioctl (mio_dev_t* dev, int cmd, void* arg)
 {
 	mio_t* mio = dev->mio;
@@ -743,6 +751,8 @@ static mio_dev_mth_t dev_pro_methods =
 	MIO_NULL, /* write */
 	MIO_NULL, /* writev */
 	MIO_NULL, /* sendfile */
+	MIO_NULL, /* splice */
+	MIO_NULL, /* writezc */
 	dev_pro_ioctl
 };
 
@@ -757,6 +767,8 @@ static mio_dev_mth_t dev_pro_methods_slave =
 	dev_pro_write_slave,
 	dev_pro_writev_slave,
 	MIO_NULL, /* sendfile */
+	dev_pro_splice_slave,
+	MIO_NULL, /* writezc */
 	dev_pro_ioctl
 };
 
@@ -936,6 +948,23 @@ int mio_dev_pro_timedread (mio_dev_pro_t* dev, mio_dev_pro_sid_t sid, int enable
 	}
 }
 
+int mio_dev_pro_forward (mio_dev_pro_t* dev, mio_dev_pro_sid_t sid, mio_dev_t* dst, mio_iolen_t len, void* wrctx)
+{
+	mio_t* mio = dev->mio;
+
+	MIO_ASSERT (mio, sid == MIO_DEV_PRO_OUT || sid == MIO_DEV_PRO_ERR);
+
+	if (dev->slave[sid])
+	{
+		return mio_dev_forward(dst, (mio_dev_t*)dev->slave[sid], len, wrctx);
+	}
+	else
+	{
+		mio_seterrnum (mio, MIO_ENOCAPA);
+		return -1;
+	}
+}
+
 int mio_dev_pro_write (mio_dev_pro_t* dev, const void* data, mio_iolen_t dlen, void* wrctx)
 {
 	if (dev->slave[MIO_DEV_PRO_IN])
@@ -26,6 +26,8 @@
 
 
 #include <mio-sck.h>
+#include <mio-htb.h>
+#include <mio-chr.h>
 #include "mio-prv.h"
 
 #include <sys/socket.h>
@@ -35,6 +37,7 @@
 #include <string.h> /* strerror */
 
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/if_ether.h>
@@ -73,6 +76,16 @@
 #	if !defined(SO_REUSEPORT)
 #		define SO_REUSEPORT 15
 #	endif
+#	if defined(HAVE_LINUX_ERRQUEUE_H)
+#		include <linux/errqueue.h> /* struct sock_extended_err */
+#	endif
+#endif
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#	define USE_ZEROCOPY
+	/* pinning pages and reaping the completion notification cost
+	 * more than copying small data */
+#	define ZEROCOPY_MIN_LEN (16384)
 #endif
 
 #if defined(HAVE_OPENSSL_SSL_H) && defined(HAVE_SSL)
@@ -83,7 +96,25 @@
 #	if defined(HAVE_OPENSSL_ENGINE_H)
 #		include <openssl/engine.h>
 #	endif
+#	include <openssl/rand.h>
+#	include <openssl/evp.h>
+#	if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#		include <openssl/core_names.h>
+#	else
+#		include <openssl/hmac.h>
+#	endif
 #	define USE_SSL
+#	if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+#		define USE_SSL_RESUMPTION
+#		define USE_SSL_SNI /* depends on the server state for resumption */
+#	endif
+#	if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#		define USE_SSL_KTLS
+#	endif
+#	if defined(HAVE_PTHREAD) && (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+#		include <pthread.h>
+#		define USE_SSL_OFFLOAD
+#	endif
 #endif
 
 /* ========================================================================= */
@@ -285,6 +316,100 @@ static struct sck_type_map_t sck_type_map[] =
 
 /* ======================================================================== */
 
+#define TUNE_BOUND 0
+#define TUNE_CONNECTING 1
+#define TUNE_ACCEPTED 2
+
+static void resolve_tune (const mio_dev_sck_tune_t* tune, mio_dev_sck_tune_t* out, int target)
+{
+	/* fill the fields not set with the values of the profile */
+	*out = *tune;
+	switch (tune->profile)
+	{
+		case MIO_DEV_SCK_TUNE_PROFILE_BUSY_POLL:
+			if (out->busy_poll <= 0) out->busy_poll = MIO_DEV_SCK_TUNE_BUSY_POLL_DEFAULT;
+			/* fall through */
+		case MIO_DEV_SCK_TUNE_PROFILE_LATENCY:
+			out->options |= MIO_DEV_SCK_TUNE_NODELAY | MIO_DEV_SCK_TUNE_QUICKACK;
+			/* a peer that speaks first would wait forever on a socket
+			 * connecting with fast open. enable it for a listener only */
+			if (target == TUNE_BOUND) out->options |= MIO_DEV_SCK_TUNE_FASTOPEN;
+			if (out->notsent_lowat <= 0) out->notsent_lowat = MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_LATENCY;
+			break;
+
+		case MIO_DEV_SCK_TUNE_PROFILE_BULK:
+			if (out->notsent_lowat <= 0) out->notsent_lowat = MIO_DEV_SCK_TUNE_NOTSENT_LOWAT_BULK;
+			break;
+
+		default:
+			break;
+	}
+
+	if ((out->options & MIO_DEV_SCK_TUNE_FASTOPEN) && out->fastopen_qlen <= 0) out->fastopen_qlen = MIO_DEV_SCK_TUNE_FASTOPEN_QLEN_DEFAULT;
+}
+
+static int set_tune_option (mio_dev_sck_t* rdev, const mio_dev_sck_tune_t* tune, int level, int optname, int v, const mio_bch_t* optstr)
+{
+	if (setsockopt(rdev->hnd, level, optname, &v, MIO_SIZEOF(v)) == -1 && !(tune->options & MIO_DEV_SCK_TUNE_IGNERR))
+	{
+		mio_seterrbfmtwithsyserr (rdev->mio, 0, errno, "unable to set %hs", optstr);
+		return -1;
+	}
+	return 0;
+}
+
+static int apply_tune (mio_dev_sck_t* rdev, const mio_dev_sck_tune_t* tune, int target)
+{
+	/* an option not available on the system is ignored */
+	if (rdev->type != MIO_DEV_SCK_TCP4 && rdev->type != MIO_DEV_SCK_TCP6) return 0;
+
+	if (target == TUNE_ACCEPTED)
+	{
+		/* an accepted socket inherits the other options from the listener */
+	#if defined(TCP_QUICKACK)
+		if ((tune->options & MIO_DEV_SCK_TUNE_QUICKACK) && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK") <= -1) return -1;
+	#endif
+		return 0;
+	}
+
+	/* the buffer sizes must be set before connecting or listening 
+	 * to take effect on the window scale negotiated */
+	if (tune->rcvbuf > 0 && set_tune_option(rdev, tune, SOL_SOCKET, SO_RCVBUF, tune->rcvbuf, "SO_RCVBUF") <= -1) return -1;
+	if (tune->sndbuf > 0 && set_tune_option(rdev, tune, SOL_SOCKET, SO_SNDBUF, tune->sndbuf, "SO_SNDBUF") <= -1) return -1;
+#if defined(SO_BUSY_POLL)
+	if (tune->busy_poll > 0 && set_tune_option(rdev, tune, SOL_SOCKET, SO_BUSY_POLL, tune->busy_poll, "SO_BUSY_POLL") <= -1) return -1;
+#endif
+	if ((tune->options & MIO_DEV_SCK_TUNE_NODELAY) && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY") <= -1) return -1;
+#if defined(TCP_QUICKACK)
+	if ((tune->options & MIO_DEV_SCK_TUNE_QUICKACK) && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK") <= -1) return -1;
+#endif
+#if defined(TCP_NOTSENT_LOWAT)
+	if (tune->notsent_lowat > 0 && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_NOTSENT_LOWAT, tune->notsent_lowat, "TCP_NOTSENT_LOWAT") <= -1) return -1;
+#endif
+
+	if (target == TUNE_BOUND)
+	{
+	#if defined(TCP_DEFER_ACCEPT)
+		if (tune->defer_accept > 0 && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_DEFER_ACCEPT, tune->defer_accept, "TCP_DEFER_ACCEPT") <= -1) return -1;
+	#endif
+	#if defined(TCP_FASTOPEN)
+		if ((tune->options & MIO_DEV_SCK_TUNE_FASTOPEN) && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_FASTOPEN, tune->fastopen_qlen, "TCP_FASTOPEN") <= -1) return -1;
+	#endif
+	}
+	else
+	{
+		/* connect() returns without sending SYN. SYN is sent with the
+		 * first data written carrying the data if a cookie is available */
+	#if defined(TCP_FASTOPEN_CONNECT)
+		if ((tune->options & MIO_DEV_SCK_TUNE_FASTOPEN) && set_tune_option(rdev, tune, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT") <= -1) return -1;
+	#endif
+	}
+
+	return 0;
+}
+
+/* ======================================================================== */
+
 static void connect_timedout (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
 {
 	mio_dev_sck_t* rdev = (mio_dev_sck_t*)job->ctx;
@@ -419,6 +544,7 @@ static int dev_sck_make (mio_dev_t* dev, void* ctx)
 	rdev->type = arg->type;
 
 	if (arg->options & MIO_DEV_SCK_MAKE_LENIENT) rdev->state |= MIO_DEV_SCK_LENIENT;
+	if (arg->options & MIO_DEV_SCK_MAKE_COALESCE_READ) rdev->dev_cap |= MIO_DEV_CAP_IN_COALESCE;
 
 	return 0;
 
@@ -470,6 +596,10 @@ static void dev_sck_fail_before_make_client (void* ctx)
 	close (*clisckhnd);
 }
 
+#if defined(USE_SSL_OFFLOAD)
+static void release_ssl_hsp (mio_dev_sck_t* dev);
+#endif
+
 static int dev_sck_kill (mio_dev_t* dev, int force)
 {
 	mio_t* mio = dev->mio;
@@ -499,6 +629,9 @@ static int dev_sck_kill (mio_dev_t* dev, int force)
 		if (rdev->on_disconnect) rdev->on_disconnect (rdev);
 	}
 
+#if defined(USE_SSL_OFFLOAD)
+	if (rdev->ssl_hsp) release_ssl_hsp (rdev);
+#endif
 #if defined(USE_SSL)
 	if (rdev->ssl)
 	{
@@ -867,34 +1000,47 @@ static int dev_sck_sendfile_stateful (mio_dev_t* dev, mio_syshnd_t in_fd, mio_fo
 	mio_t* mio = dev->mio;
 	mio_dev_sck_t* rdev = (mio_dev_sck_t*)dev;
 
-#if 0 && defined(USE_SSL)
-/* TODO: ssl needs to read from the file... and send... */
+#if defined(USE_SSL)
 	if (rdev->ssl)
 	{
-		int x;
+	#if defined(USE_SSL_KTLS)
+		ossl_ssize_t x;
 
 		if (*len <= 0)
 		{
 			/* it's a writing finish indicator. close the writing end of
 			 * the socket, probably leaving it in the half-closed state */
-			if ((x = SSL_shutdown((SSL*)rdev->ssl)) == -1)
+			int y;
+			if ((y = SSL_shutdown((SSL*)rdev->ssl)) == -1)
 			{
-				set_ssl_error (mio, SSL_get_error((SSL*)rdev->ssl, x));
+				set_ssl_error (mio, SSL_get_error((SSL*)rdev->ssl, y));
 				return -1;
 			}
 			return 1;
 		}
 
-		x = SSL_write((SSL*)rdev->ssl, data, *len);
-		if (x <= -1)
+		if (!(rdev->state & MIO_DEV_SCK_KTLS_SEND))
 		{
-			int err = SSL_get_error ((SSL*)rdev->ssl, x);
+			/* the file contents can't bypass userspace record encryption */
+			mio_seterrbfmt (mio, MIO_ENOIMPL, "sendfile not supported without kernel tls");
+			return -1;
+		}
+
+		/* the kernel reads the file and encrypts the records */
+		x = SSL_sendfile((SSL*)rdev->ssl, in_fd, foff, *len, 0);
+		if (x <= 0)
+		{
+			int err = SSL_get_error((SSL*)rdev->ssl, (int)x);
 			if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return 0;
 			set_ssl_error (mio, err);
 			return -1;
 		}
 
 		*len = x;
+	#else
+		mio_seterrbfmt (mio, MIO_ENOIMPL, "sendfile not supported without kernel tls");
+		return -1;
+	#endif
 	}
 	else
 	{
@@ -927,27 +1073,1029 @@ static int dev_sck_sendfile_stateful (mio_dev_t* dev, mio_syshnd_t in_fd, mio_fo
 			mio_seterrwithsyserr (mio, 0, errno);
 			return -1;
 		}
-		*len = x;
-#else
-		mio_seterrnum (mio, MIO_ENOIMPL);
-		return -1;
-#endif
+		*len = x;
+#else
+		mio_seterrnum (mio, MIO_ENOIMPL);
+		return -1;
+#endif
+
+#if defined(USE_SSL)
+	}
+#endif
+	return 1;
+}
+
+/* ------------------------------------------------------------------------------ */
+
+static int dev_sck_splice_stateful (mio_dev_t* dev, mio_syshnd_t pfd, mio_iolen_t* len, int out)
+{
+	mio_t* mio = dev->mio;
+	mio_dev_sck_t* rdev = (mio_dev_sck_t*)dev;
+
+#if defined(USE_SSL)
+	if (rdev->ssl && !(out && (rdev->state & MIO_DEV_SCK_KTLS_SEND)))
+	{
+		/* the data can't bypass the ssl library unless the kernel encrypts it */
+		mio_seterrbfmt (mio, MIO_ENOIMPL, "splice not supported over ssl");
+		return -1;
+	}
+#endif
+
+	return out? mio_sys_splice(mio, pfd, rdev->hnd, len): mio_sys_splice(mio, rdev->hnd, pfd, len);
+}
+
+static int dev_sck_writezc_stateful (mio_dev_t* dev, const void* data, mio_iolen_t* len, mio_uint32_t* seq)
+{
+	mio_t* mio = dev->mio;
+	mio_dev_sck_t* rdev = (mio_dev_sck_t*)dev;
+
+#if defined(USE_ZEROCOPY)
+	ssize_t x;
+	int flags = MSG_ZEROCOPY;
+
+	/* mio_dev_sck_writezc() doesn't choose this path for a tls socket */
+	MIO_ASSERT (mio, rdev->state & MIO_DEV_SCK_ZEROCOPY);
+
+	#if defined(MSG_NOSIGNAL)
+	flags |= MSG_NOSIGNAL;
+	#endif
+	x = send(rdev->hnd, data, *len, flags);
+	if (x == -1 && errno == ENOBUFS)
+	{
+		/* the kernel is short of memory to track another zero-copy sending
+		 * operation. copy the data instead of waiting for the completion
+		 * notifications as there may be none pending to wake up the device */
+		x = send(rdev->hnd, data, *len, flags & ~MSG_ZEROCOPY);
+		if (x >= 0)
+		{
+			*len = x;
+			return 2;
+		}
+	}
+	if (x == -1)
+	{
+		if (errno == EINPROGRESS || errno == EWOULDBLOCK || errno == EAGAIN) return 0;  /* no data can be written */
+		if (errno == EINTR) return 0;
+		mio_seterrwithsyserr (mio, 0, errno);
+		return -1;
+	}
+
+	/* the kernel counts successful sending operations with MSG_ZEROCOPY
+	 * and reports completion with the count */
+	*len = x;
+	*seq = rdev->zc_seq++;
+	return 1;
+#else
+	mio_seterrbfmt (mio, MIO_ENOIMPL, "zero-copy write not supported");
+	return -1;
+#endif
+}
+
+#if defined(USE_ZEROCOPY)
+static int reap_zerocopy_completions (mio_dev_sck_t* rdev)
+{
+	/* return -1 on failure, 0 if no completion notification is found, 1 otherwise */
+	mio_t* mio = rdev->mio;
+	int reaped = 0;
+
+	while (1)
+	{
+		struct msghdr msg;
+		struct cmsghdr* cmsg;
+		union
+		{
+			mio_uint8_t buf[CMSG_SPACE(MIO_SIZEOF(struct sock_extended_err) + MIO_SIZEOF(struct sockaddr_in6))];
+			struct cmsghdr align;
+		} ctl;
+
+		MIO_MEMSET (&msg, 0, MIO_SIZEOF(msg));
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = MIO_SIZEOF(ctl.buf);
+
+		/* reading the error queue never blocks */
+		if (recvmsg(rdev->hnd, &msg, MSG_ERRQUEUE) == -1)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EWOULDBLOCK || errno == EAGAIN) break;
+			mio_seterrwithsyserr (mio, 0, errno);
+			return -1;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			struct sock_extended_err* ee;
+
+			if (!(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) &&
+			    !(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) continue;
+
+			ee = (struct sock_extended_err*)CMSG_DATA(cmsg);
+			if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+			/* the kernel copied the data anyway. e.g. over the loopback device.
+			 * stop pinning the pages for the later requests */
+			if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) rdev->state |= MIO_DEV_SCK_ZEROCOPY_OFF;
+
+			/* ee_info to ee_data is the range of sending operations completed */
+			if (mio_dev_completezc((mio_dev_t*)rdev, ee->ee_data) <= -1) return -1;
+			reaped = 1;
+		}
+	}
+
+	return reaped;
+}
+#endif
+
+/* ------------------------------------------------------------------------------ */
+
+#if defined(USE_SSL)
+
+static SSL_CTX* make_ssl_server_ctx (mio_t* mio, const mio_bch_t* certfile, const mio_bch_t* keyfile, int options)
+{
+	SSL_CTX* ssl_ctx;
+
+	ssl_ctx = SSL_CTX_new(SSLv23_server_method());
+	if (!ssl_ctx)
+	{
+		set_ssl_error (mio, ERR_get_error());
+		return MIO_NULL;
+	}
+
+	if (SSL_CTX_use_certificate_file(ssl_ctx, certfile, SSL_FILETYPE_PEM) == 0 ||
+	    SSL_CTX_use_PrivateKey_file(ssl_ctx, keyfile, SSL_FILETYPE_PEM) == 0 ||
+	    SSL_CTX_check_private_key(ssl_ctx) == 0  /*||
+	    SSL_CTX_use_certificate_chain_file(ssl_ctx, bnd->chainfile) == 0*/)
+	{
+		set_ssl_error (mio, ERR_get_error());
+		SSL_CTX_free (ssl_ctx);
+		return MIO_NULL;
+	}
+
+	SSL_CTX_set_read_ahead (ssl_ctx, 0);
+	SSL_CTX_set_mode (ssl_ctx, SSL_CTX_get_mode(ssl_ctx) | 
+	                           /*SSL_MODE_ENABLE_PARTIAL_WRITE |*/
+	                           SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+	SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_SSLv2); /* no outdated SSLv2 by default */
+#if defined(USE_SSL_KTLS)
+	if (!(options & MIO_DEV_SCK_BIND_SSL_NO_KTLS)) SSL_CTX_set_options (ssl_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+	return ssl_ctx;
+}
+
+#if defined(USE_SSL_RESUMPTION)
+/* ticket key in the layout of the key given to mio_dev_sck_setsslticketkey() */
+typedef struct sck_ssl_tkey_t sck_ssl_tkey_t;
+struct sck_ssl_tkey_t
+{
+	mio_uint8_t name[16];
+	mio_uint8_t hmac[32];
+	mio_uint8_t aes[32];
+};
+
+/* the current key and two previous keys to decrypt the tickets issued with them */
+#define SSL_TKEY_COUNT (3)
+
+/* server-side state attached to the ssl context of a listening socket. it is
+ * shared by the accepted sockets and released along with the context that 
+ * may outlive the listening socket. */
+typedef struct sck_ssl_svr_t sck_ssl_svr_t;
+struct sck_ssl_svr_t
+{
+	mio_t* mio;
+	int options; /* bitwise-ORed of mio_dev_sck_bind_option_t enumerators */
+	CRYPTO_RWLOCK* lock; /* guards the keys and the hosts used by the handshake worker threads */
+	mio_htb_t* hosts; /* SSL_CTX pointers keyed by host name for SNI */
+	mio_uint8_t* alpn; /* protocols in the wire format */
+	mio_oow_t alpn_len;
+	sck_ssl_tkey_t tkey[SSL_TKEY_COUNT]; /* tkey[0] is current */
+	mio_oow_t tkey_count;
+	mio_ntime_t tkey_lifetime;
+	mio_ntime_t tkey_expiry; /* zero if not rotated automatically */
+	mio_dev_sck_ssl_stat_t stat;
+};
+
+typedef struct sck_sslcache_ent_t sck_sslcache_ent_t;
+struct sck_sslcache_ent_t
+{
+	mio_htb_pair_t* pair;
+	SSL_SESSION* sess;
+	sck_sslcache_ent_t* prev;
+	sck_sslcache_ent_t* next;
+};
+
+struct mio_dev_sck_sslcache_t
+{
+	mio_t* mio;
+	mio_oow_t capa;
+	mio_htb_t htb; /* sck_sslcache_ent_t pointers keyed by remote address */
+	sck_sslcache_ent_t* head; /* most recently used */
+	sck_sslcache_ent_t* tail; /* least recently used */
+	mio_dev_sck_ssl_stat_t stat;
+};
+
+static int ssl_svr_exidx = -1;
+static CRYPTO_ONCE ssl_svr_exidx_once = CRYPTO_ONCE_STATIC_INIT;
+
+static void free_ssl_svr (void* parent, void* ptr, CRYPTO_EX_DATA* ad, int idx, long int argl, void* argp)
+{
+	if (ptr) 
+	{
+		sck_ssl_svr_t* svr = (sck_ssl_svr_t*)ptr;
+		if (svr->hosts) mio_htb_close (svr->hosts);
+		if (svr->alpn) OPENSSL_free (svr->alpn);
+		if (svr->lock) CRYPTO_THREAD_lock_free (svr->lock);
+		OPENSSL_cleanse (ptr, MIO_SIZEOF(sck_ssl_svr_t));
+		OPENSSL_free (ptr);
+	}
+}
+
+static void init_ssl_svr_exidx (void)
+{
+	ssl_svr_exidx = SSL_CTX_get_ex_new_index(0, MIO_NULL, MIO_NULL, MIO_NULL, free_ssl_svr);
+}
+
+static MIO_INLINE sck_ssl_svr_t* get_ssl_svr (SSL_CTX* ssl_ctx)
+{
+	sck_ssl_svr_t* svr;
+	if (ssl_svr_exidx < 0) return MIO_NULL;
+	svr = (sck_ssl_svr_t*)SSL_CTX_get_ex_data(ssl_ctx, ssl_svr_exidx);
+	/* the context for a host added refers to the state of the listening socket */
+	return svr? svr: (sck_ssl_svr_t*)SSL_CTX_get_app_data(ssl_ctx);
+}
+
+static int push_ssl_tkey (sck_ssl_svr_t* svr, const mio_uint8_t* key)
+{
+	/* make the given key or a new random key current, keeping the previous ones */
+	MIO_MEMMOVE (&svr->tkey[1], &svr->tkey[0], MIO_SIZEOF(svr->tkey[0]) * (SSL_TKEY_COUNT - 1));
+	if (key) MIO_MEMCPY (&svr->tkey[0], key, MIO_SIZEOF(svr->tkey[0]));
+	else if (RAND_bytes((unsigned char*)&svr->tkey[0], MIO_SIZEOF(svr->tkey[0])) <= 0) return -1;
+	if (svr->tkey_count < SSL_TKEY_COUNT) svr->tkey_count++;
+	return 0;
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+static int handle_ssl_ticket_key (sck_ssl_svr_t* svr, SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc)
+#else
+static int handle_ssl_ticket_key (sck_ssl_svr_t* svr, SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, HMAC_CTX* hctx, int enc)
+#endif
+{
+	sck_ssl_tkey_t* tkey;
+	mio_oow_t i;
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+	OSSL_PARAM params[3];
+#endif
+
+	if (svr->tkey_count <= 0) return -1;
+
+	if (enc)
+	{
+		if (MIO_IS_POS_NTIME(&svr->tkey_expiry))
+		{
+			mio_ntime_t now;
+			/* don't use mio_gettime() that reads the time cached by
+			 * the event loop. this may run in a handshake worker thread */
+			mio_gettime_precise (svr->mio, &now);
+			if (MIO_CMP_NTIME(&now, &svr->tkey_expiry) >= 0)
+			{
+				/* rotate the key. the tickets issued with the old key
+				 * remain valid until two more rotations */
+				if (push_ssl_tkey(svr, MIO_NULL) <= -1) return -1;
+				MIO_ADD_NTIME (&svr->tkey_expiry, &now, &svr->tkey_lifetime);
+			}
+		}
+
+		tkey = &svr->tkey[0];
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0) return -1;
+		MIO_MEMCPY (key_name, tkey->name, MIO_SIZEOF(tkey->name));
+		if (EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), MIO_NULL, tkey->aes, iv) <= 0) return -1;
+		i = 0;
+	}
+	else
+	{
+		for (i = 0; i < svr->tkey_count; i++)
+		{
+			if (MIO_MEMCMP(key_name, svr->tkey[i].name, MIO_SIZEOF(svr->tkey[i].name)) == 0) break;
+		}
+		if (i >= svr->tkey_count) return 0; /* unknown key. fall back to a full handshake */
+
+		tkey = &svr->tkey[i];
+		if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), MIO_NULL, tkey->aes, iv) <= 0) return -1;
+	}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, tkey->hmac, MIO_SIZEOF(tkey->hmac));
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "sha256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+	if (EVP_MAC_CTX_set_params(hctx, params) <= 0) return -1;
+#else
+	if (HMAC_Init_ex(hctx, tkey->hmac, MIO_SIZEOF(tkey->hmac), EVP_sha256(), MIO_NULL) <= 0) return -1;
+#endif
+
+	/* return 2 to have a new ticket issued if the ticket was decrypted with
+	 * an old key. a tls 1.3 client uses a ticket only once. unless renewed,
+	 * the server sends no new ticket on resumption and the next connection
+	 * falls back to a full handshake */
+	return (i == 0 && SSL_version(ssl) < TLS1_3_VERSION)? 1: 2;
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+static int ssl_ticket_key_cb (SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc)
+#else
+static int ssl_ticket_key_cb (SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, HMAC_CTX* hctx, int enc)
+#endif
+{
+	sck_ssl_svr_t* svr;
+	int n;
+
+	svr = get_ssl_svr(SSL_get_SSL_CTX(ssl));
+	if (!svr || !CRYPTO_THREAD_write_lock(svr->lock)) return -1;
+	n = handle_ssl_ticket_key(svr, ssl, key_name, iv, cctx, hctx, enc);
+	CRYPTO_THREAD_unlock (svr->lock);
+	return n;
+}
+
+#if defined(USE_SSL_SNI)
+static mio_oow_t encode_ssl_alpn (const mio_bch_t* str, mio_uint8_t* buf)
+{
+	/* convert "h2,http/1.1" to "\x02h2\x08http/1.1". the buffer must be
+	 * as large as the string including the terminating null */
+	mio_oow_t len = 0, lpos = 0;
+
+	while (1)
+	{
+		if (*str == ',' || *str == '\0')
+		{
+			mio_oow_t plen = len - lpos;
+			if (plen <= 0 || plen > 255) return 0; /* empty or too long */
+			buf[lpos] = (mio_uint8_t)plen;
+			if (*str == '\0') break;
+			lpos = ++len;
+		}
+		else
+		{
+			buf[++len] = *str;
+		}
+		str++;
+	}
+
+	return len + 1;
+}
+
+static int ssl_alpn_select_cb (SSL* ssl, const unsigned char** out, unsigned char* outlen, const unsigned char* in, unsigned int inlen, void* arg)
+{
+	sck_ssl_svr_t* svr = (sck_ssl_svr_t*)arg;
+	/* pick the first protocol of the server preference offered by the client */
+	if (SSL_select_next_proto((unsigned char**)out, outlen, svr->alpn, svr->alpn_len, in, inlen) != OPENSSL_NPN_NEGOTIATED) return SSL_TLSEXT_ERR_NOACK;
+	return SSL_TLSEXT_ERR_OK;
+}
+
+static mio_oow_t make_ssl_host_key (const mio_bch_t* host, mio_bch_t* buf, mio_oow_t bufsz)
+{
+	/* host names are case-insensitive */
+	mio_oow_t len;
+	for (len = 0; host[len] != '\0'; len++)
+	{
+		if (len >= bufsz) return 0;
+		buf[len] = mio_to_bch_lower(host[len]);
+	}
+	return len;
+}
+
+static int ssl_servername_cb (SSL* ssl, int* al, void* arg)
+{
+	sck_ssl_svr_t* svr = (sck_ssl_svr_t*)arg;
+	const char* name;
+	mio_bch_t key[256];
+	mio_oow_t len, i;
+	mio_htb_pair_t* pair = MIO_NULL;
+
+	name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+	if (!name || !(len = make_ssl_host_key(name, key, MIO_COUNTOF(key)))) return SSL_TLSEXT_ERR_NOACK;
+
+	if (!CRYPTO_THREAD_read_lock(svr->lock)) return SSL_TLSEXT_ERR_NOACK;
+	if (svr->hosts)
+	{
+		pair = mio_htb_search(svr->hosts, key, len);
+		if (!pair)
+		{
+			/* replace the first label with an asterisk for a wildcard name */
+			for (i = 0; i < len && key[i] != '.'; i++) /* nothing */;
+			if (i > 0 && i < len)
+			{
+				key[i - 1] = '*';
+				pair = mio_htb_search(svr->hosts, &key[i - 1], len - i + 1);
+			}
+		}
+
+		/* the ssl object holds a reference to the context switched to.
+		 * the context stays alive even if the host is deleted or replaced */
+		if (pair) SSL_set_SSL_CTX (ssl, (SSL_CTX*)MIO_HTB_VPTR(pair));
+	}
+	CRYPTO_THREAD_unlock (svr->lock);
+
+	return pair? SSL_TLSEXT_ERR_OK: SSL_TLSEXT_ERR_NOACK; /* the default certificate if not found */
+}
+
+static void free_ssl_host_ctx (mio_htb_t* htb, void* vptr, mio_oow_t vlen)
+{
+	SSL_CTX_free ((SSL_CTX*)vptr);
+}
+
+static mio_htb_style_t ssl_host_htb_style =
+{
+	{
+		MIO_HTB_COPIER_INLINE,
+		MIO_HTB_COPIER_DEFAULT
+	},
+	{
+		MIO_HTB_FREEER_DEFAULT,
+		free_ssl_host_ctx
+	},
+	MIO_HTB_COMPER_DEFAULT,
+	MIO_HTB_KEEPER_DEFAULT,
+	MIO_HTB_SIZER_DEFAULT,
+	MIO_HTB_HASHER_DEFAULT
+};
+#endif
+
+static unsigned char ssl_sid_ctx[] = MIO_PACKAGE_NAME;
+
+static int init_ssl_svr (mio_t* mio, SSL_CTX* ssl_ctx, const mio_dev_sck_bind_t* bnd)
+{
+	sck_ssl_svr_t* svr;
+
+	if (!CRYPTO_THREAD_run_once(&ssl_svr_exidx_once, init_ssl_svr_exidx) || ssl_svr_exidx < 0) 
+	{
+		set_ssl_error (mio, ERR_get_error());
+		return -1;
+	}
+
+	svr = (sck_ssl_svr_t*)OPENSSL_zalloc(MIO_SIZEOF(*svr));
+	if (!svr)
+	{
+		mio_seterrnum (mio, MIO_ESYSMEM);
+		return -1;
+	}
+	svr->mio = mio;
+	svr->lock = CRYPTO_THREAD_lock_new();
+	if (!svr->lock || SSL_CTX_set_ex_data(ssl_ctx, ssl_svr_exidx, svr) == 0)
+	{
+		set_ssl_error (mio, ERR_get_error());
+		if (svr->lock) CRYPTO_THREAD_lock_free (svr->lock);
+		OPENSSL_free (svr);
+		return -1;
+	}
+	/* svr is freed along with ssl_ctx from now on */
+	svr->options = bnd->options;
+
+	SSL_CTX_set_session_id_context (ssl_ctx, ssl_sid_ctx, MIO_SIZEOF(ssl_sid_ctx) - 1);
+	if (bnd->options & MIO_DEV_SCK_BIND_SSL_NO_SESSION_CACHE)
+	{
+		SSL_CTX_set_session_cache_mode (ssl_ctx, SSL_SESS_CACHE_OFF);
+	}
+	else
+	{
+		/* the internal cache of the context is shared by the accepted sockets */
+		SSL_CTX_set_session_cache_mode (ssl_ctx, SSL_SESS_CACHE_SERVER);
+		SSL_CTX_sess_set_cache_size (ssl_ctx, (bnd->ssl_session_cache_size > 0? bnd->ssl_session_cache_size: MIO_DEV_SCK_SSL_SESSION_CACHE_SIZE_DEFAULT));
+	}
+
+	if (bnd->options & MIO_DEV_SCK_BIND_SSL_NO_TICKET)
+	{
+		SSL_CTX_set_options (ssl_ctx, SSL_OP_NO_TICKET);
+	}
+	else
+	{
+		if (push_ssl_tkey(svr, MIO_NULL) <= -1)
+		{
+			set_ssl_error (mio, ERR_get_error());
+			return -1;
+		}
+
+		if (MIO_IS_POS_NTIME(&bnd->ssl_ticket_key_lifetime)) svr->tkey_lifetime = bnd->ssl_ticket_key_lifetime;
+		else MIO_INIT_NTIME (&svr->tkey_lifetime, MIO_DEV_SCK_SSL_TICKET_KEY_LIFETIME_DEFAULT, 0);
+		mio_gettime_precise (mio, &svr->tkey_expiry);
+		MIO_ADD_NTIME (&svr->tkey_expiry, &svr->tkey_expiry, &svr->tkey_lifetime);
+
+	#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+		SSL_CTX_set_tlsext_ticket_key_evp_cb (ssl_ctx, ssl_ticket_key_cb);
+	#else
+		SSL_CTX_set_tlsext_ticket_key_cb (ssl_ctx, ssl_ticket_key_cb);
+	#endif
+	}
+
+#if defined(USE_SSL_SNI)
+	if (bnd->ssl_alpn)
+	{
+		svr->alpn = (mio_uint8_t*)OPENSSL_malloc(strlen(bnd->ssl_alpn) + 1);
+		if (!svr->alpn)
+		{
+			mio_seterrnum (mio, MIO_ESYSMEM);
+			return -1;
+		}
+		svr->alpn_len = encode_ssl_alpn(bnd->ssl_alpn, svr->alpn);
+		if (svr->alpn_len <= 0)
+		{
+			mio_seterrbfmt (mio, MIO_EINVAL, "invalid alpn protocols %hs", bnd->ssl_alpn);
+			return -1;
+		}
+		SSL_CTX_set_alpn_select_cb (ssl_ctx, ssl_alpn_select_cb, svr);
+	}
+
+	SSL_CTX_set_tlsext_servername_callback (ssl_ctx, ssl_servername_cb);
+	SSL_CTX_set_tlsext_servername_arg (ssl_ctx, svr);
+#endif
+
+	return 0;
+}
+
+static mio_oow_t make_sslcache_key (mio_t* mio, const mio_skad_t* skad, mio_bch_t* buf, mio_oow_t len)
+{
+	return mio_skadtobcstr(mio, skad, buf, len, MIO_SKAD_TO_BCSTR_ADDR | MIO_SKAD_TO_BCSTR_PORT);
+}
+
+static void free_sslcache_ent (mio_dev_sck_sslcache_t* cache, sck_sslcache_ent_t* ent)
+{
+	if (ent->prev) ent->prev->next = ent->next;
+	else cache->head = ent->next;
+	if (ent->next) ent->next->prev = ent->prev;
+	else cache->tail = ent->prev;
+
+	SSL_SESSION_free (ent->sess);
+	mio_htb_delete (&cache->htb, MIO_HTB_KPTR(ent->pair), MIO_HTB_KLEN(ent->pair));
+	mio_freemem (cache->mio, ent);
+}
+
+static int on_new_client_ssl_session (SSL* ssl, SSL_SESSION* sess)
+{
+	/* called when the server has sent a new session or ticket */
+	mio_dev_sck_t* dev = (mio_dev_sck_t*)SSL_get_app_data(ssl);
+	mio_dev_sck_sslcache_t* cache;
+	sck_sslcache_ent_t* ent;
+	mio_htb_pair_t* pair;
+	mio_bch_t key[128];
+	mio_oow_t klen;
+
+	if (!dev || !dev->ssl_cache || !SSL_SESSION_is_resumable(sess)) return 0;
+	cache = dev->ssl_cache;
+
+	klen = make_sslcache_key(dev->mio, &dev->remoteaddr, key, MIO_COUNTOF(key));
+	if (klen <= 0) return 0;
+
+	pair = mio_htb_search(&cache->htb, key, klen);
+	if (pair)
+	{
+		/* replace the old session */
+		ent = (sck_sslcache_ent_t*)MIO_HTB_VPTR(pair);
+		SSL_SESSION_free (ent->sess);
+
+		if (ent != cache->head)
+		{
+			ent->prev->next = ent->next;
+			if (ent->next) ent->next->prev = ent->prev;
+			else cache->tail = ent->prev;
+			ent->prev = MIO_NULL;
+			ent->next = cache->head;
+			cache->head->prev = ent;
+			cache->head = ent;
+		}
+	}
+	else
+	{
+		while (cache->tail && MIO_HTB_SIZE(&cache->htb) >= cache->capa) free_sslcache_ent (cache, cache->tail);
+
+		ent = (sck_sslcache_ent_t*)mio_callocmem(dev->mio, MIO_SIZEOF(*ent));
+		if (MIO_UNLIKELY(!ent)) return 0;
+		ent->pair = mio_htb_insert(&cache->htb, key, klen, ent, 0);
+		if (MIO_UNLIKELY(!ent->pair))
+		{
+			mio_freemem (dev->mio, ent);
+			return 0;
+		}
+
+		ent->next = cache->head;
+		if (cache->head) cache->head->prev = ent;
+		else cache->tail = ent;
+		cache->head = ent;
+	}
+
+	ent->sess = sess;
+	return 1; /* keep the reference to the session */
+}
+
+static void offer_cached_ssl_session (mio_dev_sck_t* dev, SSL* ssl)
+{
+	mio_htb_pair_t* pair;
+	mio_bch_t key[128];
+	mio_oow_t klen;
+
+	klen = make_sslcache_key(dev->mio, &dev->remoteaddr, key, MIO_COUNTOF(key));
+	if (klen <= 0) return;
+
+	pair = mio_htb_search(&dev->ssl_cache->htb, key, klen);
+	if (pair) SSL_set_session (ssl, ((sck_sslcache_ent_t*)MIO_HTB_VPTR(pair))->sess);
+}
+
+static void count_ssl_resumption (mio_dev_sck_t* dev)
+{
+	mio_dev_sck_ssl_stat_t* stat;
+
+	if (dev->ssl_cache) 
+	{
+		stat = &dev->ssl_cache->stat;
+	}
+	else
+	{
+		sck_ssl_svr_t* svr = get_ssl_svr(SSL_get_SSL_CTX((SSL*)dev->ssl));
+		if (!svr) return;
+		stat = &svr->stat;
+	}
+
+	if (SSL_session_reused((SSL*)dev->ssl)) stat->hits++;
+	else stat->misses++;
+}
+#endif
+
+#if defined(USE_SSL_OFFLOAD)
+/* a handshake step of an accepted socket performed in a worker thread. the
+ * device gets no events while its job is in progress. if the device is 
+ * killed meanwhile, the job takes over the ssl object and the socket handle
+ * and they are released when the job is completed. */
+typedef struct sck_ssl_hsjob_t sck_ssl_hsjob_t;
+struct sck_ssl_hsjob_t
+{
+	mio_dev_sck_t* dev;
+	SSL* ssl;
+	mio_syshnd_t hnd;
+	int (*ssl_func) (SSL*);
+
+	/* result of ssl_func() */
+	int ret;
+	int err;
+	unsigned long errcode;
+
+	sck_ssl_hsjob_t* qnext; /* in the pending queue or in the done list */
+	sck_ssl_hsjob_t* prev; /* in the list of all jobs not completed */
+	sck_ssl_hsjob_t* next;
+};
+
+/* worker threads shared by a listening socket and the sockets accepted on it */
+typedef struct sck_ssl_hsp_t sck_ssl_hsp_t;
+struct sck_ssl_hsp_t
+{
+	mio_t* mio;
+	mio_oow_t refs; /* the listening socket and the accepted sockets in handshake */
+	mio_dev_sck_t* qx; /* carries completion notices to the event loop. MIO_NULL if gone */
+	mio_syshnd_t side_chan; /* write end of qx */
+	sck_ssl_hsjob_t* jobs; /* accessed in the event loop only */
+
+	/* the following fields are guarded by mtx */
+	pthread_mutex_t mtx;
+	pthread_cond_t cnd;
+	int stop;
+	sck_ssl_hsjob_t* pending_head;
+	sck_ssl_hsjob_t* pending_tail;
+	sck_ssl_hsjob_t* done;
+
+	mio_oow_t nthrs;
+	pthread_t thr[1]; /* more follow */
+};
+
+static void* ssl_hsp_worker_main (void* ctx)
+{
+	sck_ssl_hsp_t* hsp = (sck_ssl_hsp_t*)ctx;
+	sck_ssl_hsjob_t* job;
+
+	pthread_mutex_lock (&hsp->mtx);
+	while (!hsp->stop)
+	{
+		if (!hsp->pending_head)
+		{
+			pthread_cond_wait (&hsp->cnd, &hsp->mtx);
+			continue;
+		}
+
+		job = hsp->pending_head;
+		hsp->pending_head = job->qnext;
+		if (!hsp->pending_head) hsp->pending_tail = MIO_NULL;
+		pthread_mutex_unlock (&hsp->mtx);
+
+		ERR_clear_error ();
+		job->ret = job->ssl_func(job->ssl);
+		job->err = (job->ret <= 0)? SSL_get_error(job->ssl, job->ret): SSL_ERROR_NONE;
+		job->errcode = ERR_get_error();
+		ERR_clear_error ();
+
+		pthread_mutex_lock (&hsp->mtx);
+		/* a single notice covers all jobs done until the event loop picks
+		 * them up. a failed write means that a notice is pending already */
+		if (!hsp->done) write (hsp->side_chan, "D", 1);
+		job->qnext = hsp->done;
+		hsp->done = job;
+	}
+	pthread_mutex_unlock (&hsp->mtx);
+
+	return MIO_NULL;
+}
+
+static MIO_INLINE void unlink_ssl_hsjob (sck_ssl_hsp_t* hsp, sck_ssl_hsjob_t* job)
+{
+	if (job->prev) job->prev->next = job->next;
+	else hsp->jobs = job->next;
+	if (job->next) job->next->prev = job->prev;
+}
+
+static void stop_ssl_hsp_workers (sck_ssl_hsp_t* hsp)
+{
+	mio_oow_t i;
+
+	if (hsp->nthrs <= 0) return;
+
+	pthread_mutex_lock (&hsp->mtx);
+	hsp->stop = 1;
+	pthread_cond_broadcast (&hsp->cnd);
+	pthread_mutex_unlock (&hsp->mtx);
+	for (i = 0; i < hsp->nthrs; i++) pthread_join (hsp->thr[i], MIO_NULL);
+	hsp->nthrs = 0;
+
+	/* reclaim the jobs whose results the event loop hasn't picked up */
+	while (hsp->jobs)
+	{
+		sck_ssl_hsjob_t* job = hsp->jobs;
+
+		unlink_ssl_hsjob (hsp, job);
+		if (job->dev)
+		{
+			/* let the device go on with the handshake in the event loop */
+			job->dev->ssl_hsjob = MIO_NULL;
+			mio_dev_watch ((mio_dev_t*)job->dev, MIO_DEV_WATCH_RENEW, MIO_DEV_EVENT_IN);
+		}
+		else
+		{
+			SSL_free (job->ssl);
+			close (job->hnd);
+		}
+		mio_freemem (hsp->mio, job);
+	}
+
+	hsp->pending_head = MIO_NULL;
+	hsp->pending_tail = MIO_NULL;
+	hsp->done = MIO_NULL;
+}
+
+static void unref_ssl_hsp (sck_ssl_hsp_t* hsp)
+{
+	MIO_ASSERT (hsp->mio, hsp->refs > 0);
+	if (--hsp->refs > 0) return;
+
+	stop_ssl_hsp_workers (hsp);
+	if (hsp->qx)
+	{
+		hsp->qx->ssl_hsp = MIO_NULL;
+		mio_dev_sck_halt (hsp->qx);
+	}
+
+	pthread_cond_destroy (&hsp->cnd);
+	pthread_mutex_destroy (&hsp->mtx);
+	mio_freemem (hsp->mio, hsp);
+}
+
+static int make_ssl_hsp (mio_dev_sck_t* dev, mio_oow_t nthrs)
+{
+	mio_t* mio = dev->mio;
+	sck_ssl_hsp_t* hsp;
+	mio_dev_sck_make_t mi;
+	mio_oow_t i;
+	int n;
+
+	MIO_ASSERT (mio, nthrs > 0);
+
+	hsp = (sck_ssl_hsp_t*)mio_callocmem(mio, MIO_SIZEOF(*hsp) + MIO_SIZEOF(hsp->thr[0]) * (nthrs - 1));
+	if (MIO_UNLIKELY(!hsp)) return -1;
+
+	hsp->mio = mio;
+	hsp->refs = 1;
+	pthread_mutex_init (&hsp->mtx, MIO_NULL);
+	pthread_cond_init (&hsp->cnd, MIO_NULL);
+
+	MIO_MEMSET (&mi, 0, MIO_SIZEOF(mi));
+	mi.type = MIO_DEV_SCK_QX;
+	hsp->qx = mio_dev_sck_make(mio, 0, &mi);
+	if (MIO_UNLIKELY(!hsp->qx)) goto oops;
+	hsp->qx->ssl_hsp = hsp;
+	hsp->side_chan = hsp->qx->side_chan;
+
+	for (i = 0; i < nthrs; i++)
+	{
+		n = pthread_create(&hsp->thr[i], MIO_NULL, ssl_hsp_worker_main, hsp);
+		if (n != 0)
+		{
+			mio_seterrbfmtwithsyserr (mio, 0, n, "unable to create a tls handshake worker");
+			goto oops;
+		}
+		hsp->nthrs++;
+	}
+
+	dev->ssl_hsp = hsp;
+	return 0;
+
+oops:
+	unref_ssl_hsp (hsp);
+	return -1;
+}
+
+static void release_ssl_hsp (mio_dev_sck_t* dev)
+{
+	sck_ssl_hsp_t* hsp = (sck_ssl_hsp_t*)dev->ssl_hsp;
+
+	dev->ssl_hsp = MIO_NULL;
+
+	if (dev->type == MIO_DEV_SCK_QX)
+	{
+		/* the notification channel is being killed before the pool.
+		 * the remaining handshakes are performed in the event loop */
+		stop_ssl_hsp_workers (hsp);
+		hsp->qx = MIO_NULL;
+		return;
+	}
+
+	if (dev->ssl_hsjob)
+	{
+		/* let the job in progress take over the ssl object and the handle */
+		((sck_ssl_hsjob_t*)dev->ssl_hsjob)->dev = MIO_NULL;
+		dev->ssl_hsjob = MIO_NULL;
+		dev->ssl = MIO_NULL;
+		dev->hnd = MIO_SYSHND_INVALID;
+	}
+
+	unref_ssl_hsp (hsp);
+}
+
+static int submit_ssl_hsjob (mio_dev_sck_t* dev, int (*ssl_func)(SSL*))
+{
+	mio_t* mio = dev->mio;
+	sck_ssl_hsp_t* hsp = (sck_ssl_hsp_t*)dev->ssl_hsp;
+	sck_ssl_hsjob_t* job;
+
+	job = (sck_ssl_hsjob_t*)mio_callocmem(mio, MIO_SIZEOF(*job));
+	if (MIO_UNLIKELY(!job)) return -1;
+
+	/* no events for the device until the job is completed */
+	if (mio_dev_watch((mio_dev_t*)dev, MIO_DEV_WATCH_UPDATE, 0) <= -1)
+	{
+		mio_freemem (mio, job);
+		return -1;
+	}
+
+	job->dev = dev;
+	job->ssl = (SSL*)dev->ssl;
+	job->hnd = dev->hnd;
+	job->ssl_func = ssl_func;
+
+	job->next = hsp->jobs;
+	if (hsp->jobs) hsp->jobs->prev = job;
+	hsp->jobs = job;
+	dev->ssl_hsjob = job;
+
+	pthread_mutex_lock (&hsp->mtx);
+	if (hsp->pending_tail) hsp->pending_tail->qnext = job;
+	else hsp->pending_head = job;
+	hsp->pending_tail = job;
+	pthread_cond_signal (&hsp->cnd);
+	pthread_mutex_unlock (&hsp->mtx);
+
+	return 0;
+}
+#endif
+
+static int conclude_ssl (mio_dev_sck_t* dev, int ret, int err, unsigned long errcode)
+{
+	mio_t* mio = dev->mio;
+	int watcher_cmd, watcher_events;
+
+	watcher_cmd = MIO_DEV_WATCH_RENEW;
+	watcher_events = MIO_DEV_EVENT_IN;
+
+	if (ret <= 0)
+	{
+		if (err == SSL_ERROR_WANT_READ)
+		{
+			/* handshaking isn't complete */
+			ret = 0;
+		}
+		else if (err == SSL_ERROR_WANT_WRITE)
+		{
+			/* handshaking isn't complete */
+			watcher_cmd = MIO_DEV_WATCH_UPDATE;
+			watcher_events = MIO_DEV_EVENT_IN | MIO_DEV_EVENT_OUT;
+			ret = 0;
+		}
+		else
+		{
+			set_ssl_error (mio, (errcode? (int)errcode: err));
+			ret = -1;
+		}
+	}
+	else
+	{
+		ret = 1; /* accepted */
+	#if defined(USE_SSL_RESUMPTION)
+		count_ssl_resumption (dev);
+	#endif
+	#if defined(USE_SSL_KTLS)
+		/* openssl hands the keys over to the kernel after the handshake
+		 * if the kernel and the negotiated cipher support it */
+		if (BIO_get_ktls_send(SSL_get_wbio((SSL*)dev->ssl))) dev->state |= MIO_DEV_SCK_KTLS_SEND;
+	#endif
+	}
+
+	if (mio_dev_watch((mio_dev_t*)dev, watcher_cmd, watcher_events) <= -1)
+	{
+		mio_stop (mio, MIO_STOPREQ_WATCHER_ERROR);
+		ret = -1;
+	}
+
+	return ret;
+}
+
+static void finish_ssl_accept (mio_dev_sck_t* rdev)
+{
+	if (rdev->tmrjob_index != MIO_TMRIDX_INVALID)
+	{
+		mio_deltmrjob (rdev->mio, rdev->tmrjob_index);
+		rdev->tmrjob_index = MIO_TMRIDX_INVALID;
+	}
+
+#if defined(USE_SSL_OFFLOAD)
+	if (rdev->ssl_hsp) 
+	{
+		/* no more handshake steps for the worker pool */
+		sck_ssl_hsp_t* hsp = (sck_ssl_hsp_t*)rdev->ssl_hsp;
+		rdev->ssl_hsp = MIO_NULL;
+		unref_ssl_hsp (hsp);
+	}
+#endif
+
+	MIO_DEV_SCK_SET_PROGRESS (rdev, MIO_DEV_SCK_ACCEPTED);
+	if (rdev->on_connect) rdev->on_connect (rdev);
+}
+
+#if defined(USE_SSL_OFFLOAD)
+static void complete_ssl_hsjobs (sck_ssl_hsp_t* hsp)
+{
+	sck_ssl_hsjob_t* job, * done;
+
+	pthread_mutex_lock (&hsp->mtx);
+	done = hsp->done;
+	hsp->done = MIO_NULL;
+	pthread_mutex_unlock (&hsp->mtx);
+
+	/* detach the jobs from the pool first. the callbacks invoked below 
+	 * may kill devices including the notification channel */
+	for (job = done; job; job = job->qnext) unlink_ssl_hsjob (hsp, job);
+
+	hsp->refs++; /* keep the pool alive till the end of this function */
+	while (done)
+	{
+		mio_dev_sck_t* dev;
+		int x;
+
+		job = done;
+		done = job->qnext;
+
+		dev = job->dev;
+		if (!dev)
+		{
+			/* the device has been killed while the job was in progress */
+			SSL_free (job->ssl);
+			close (job->hnd);
+			mio_freemem (hsp->mio, job);
+			continue;
+		}
 
-	
-#if 0 && defined(USE_SSL)
+		dev->ssl_hsjob = MIO_NULL;
+		x = conclude_ssl(dev, job->ret, job->err, job->errcode);
+		mio_freemem (hsp->mio, job);
+
+		if (x <= -1)
+		{
+			MIO_DEBUG2 (hsp->mio, "SCK(%p) - ssl-accept failure. halting - %js\n", dev, mio_geterrmsg(hsp->mio));
+			mio_dev_sck_halt (dev);
+		}
+		else if (x >= 1)
+		{
+			finish_ssl_accept (dev);
+		}
 	}
-#endif
-	return 1;
+	unref_ssl_hsp (hsp);
 }
-
-/* ------------------------------------------------------------------------------ */
-
-#if defined(USE_SSL)
+#endif
 
 static int do_ssl (mio_dev_sck_t* dev, int (*ssl_func)(SSL*))
 {
 	mio_t* mio = dev->mio;
-	int ret, watcher_cmd, watcher_events;
+	int ret, err;
 
 	MIO_ASSERT (mio, dev->ssl_ctx);
 
@@ -969,47 +2117,23 @@ static int do_ssl (mio_dev_sck_t* dev, int (*ssl_func)(SSL*))
 		}
 
 		SSL_set_read_ahead (ssl, 0);
+	#if defined(USE_SSL_RESUMPTION)
+		SSL_set_app_data (ssl, dev);
+		if (dev->ssl_cache) offer_cached_ssl_session (dev, ssl);
+	#endif
 
 		dev->ssl = ssl;
 	}
 
-	watcher_cmd = MIO_DEV_WATCH_RENEW;
-	watcher_events = MIO_DEV_EVENT_IN;
+#if defined(USE_SSL_OFFLOAD)
+	/* leave the expensive step to the worker pool if available. 
+	 * it's performed in the event loop upon submission failure */
+	if (dev->ssl_hsp && ((sck_ssl_hsp_t*)dev->ssl_hsp)->qx && submit_ssl_hsjob(dev, ssl_func) >= 0) return 0;
+#endif
 
 	ret = ssl_func((SSL*)dev->ssl);
-	if (ret <= 0)
-	{
-		int err = SSL_get_error(dev->ssl, ret);
-		if (err == SSL_ERROR_WANT_READ)
-		{
-			/* handshaking isn't complete */
-			ret = 0;
-		}
-		else if (err == SSL_ERROR_WANT_WRITE)
-		{
-			/* handshaking isn't complete */
-			watcher_cmd = MIO_DEV_WATCH_UPDATE;
-			watcher_events = MIO_DEV_EVENT_IN | MIO_DEV_EVENT_OUT;
-			ret = 0;
-		}
-		else
-		{
-			set_ssl_error (mio, err);
-			ret = -1;
-		}
-	}
-	else
-	{
-		ret = 1; /* accepted */
-	}
-
-	if (mio_dev_watch((mio_dev_t*)dev, watcher_cmd, watcher_events) <= -1)
-	{
-		mio_stop (mio, MIO_STOPREQ_WATCHER_ERROR);
-		ret = -1;
-	}
-
-	return ret;
+	err = (ret <= 0)? SSL_get_error((SSL*)dev->ssl, ret): SSL_ERROR_NONE;
+	return conclude_ssl(dev, ret, err, (ret <= 0)? ERR_get_error(): 0);
 }
 
 static MIO_INLINE int connect_ssl (mio_dev_sck_t* dev)
@@ -1033,6 +2157,7 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 		case MIO_DEV_SCK_BIND:
 		{
 			mio_dev_sck_bind_t* bnd = (mio_dev_sck_bind_t*)arg;
+			mio_dev_sck_tune_t tune;
 			int x;
 		#if defined(USE_SSL)
 			SSL_CTX* ssl_ctx = MIO_NULL;
@@ -1122,6 +2247,11 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 			#endif
 			}
 
+			/* apply all tuning options before binding. the options
+			 * set on a listener are inherited by the sockets accepted */
+			resolve_tune (&bnd->tune, &tune, TUNE_BOUND);
+			if (apply_tune(rdev, &tune, TUNE_BOUND) <= -1) return -1;
+
 			if (rdev->ssl_ctx)
 			{
 			#if defined(USE_SSL)
@@ -1147,29 +2277,16 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 					return -1;
 				}
 
-				ssl_ctx = SSL_CTX_new(SSLv23_server_method());
-				if (!ssl_ctx)
-				{
-					set_ssl_error (mio, ERR_get_error());
-					return -1;
-				}
+				ssl_ctx = make_ssl_server_ctx(mio, bnd->ssl_certfile, bnd->ssl_keyfile, bnd->options);
+				if (!ssl_ctx) return -1;
 
-				if (SSL_CTX_use_certificate_file(ssl_ctx, bnd->ssl_certfile, SSL_FILETYPE_PEM) == 0 ||
-				    SSL_CTX_use_PrivateKey_file(ssl_ctx, bnd->ssl_keyfile, SSL_FILETYPE_PEM) == 0 ||
-				    SSL_CTX_check_private_key(ssl_ctx) == 0  /*||
-				    SSL_CTX_use_certificate_chain_file(ssl_ctx, bnd->chainfile) == 0*/)
+			#if defined(USE_SSL_RESUMPTION)
+				if (init_ssl_svr(mio, ssl_ctx, bnd) <= -1)
 				{
-					set_ssl_error (mio, ERR_get_error());
 					SSL_CTX_free (ssl_ctx);
 					return -1;
 				}
-
-				SSL_CTX_set_read_ahead (ssl_ctx, 0);
-				SSL_CTX_set_mode (ssl_ctx, SSL_CTX_get_mode(ssl_ctx) | 
-				                           /*SSL_MODE_ENABLE_PARTIAL_WRITE |*/
-				                           SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
-
-				SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_SSLv2); /* no outdated SSLv2 by default */
+			#endif
 			#else
 				mio_seterrnum (mio, MIO_ENOIMPL);
 				return -1;
@@ -1187,6 +2304,7 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 			}
 
 			rdev->localaddr = bnd->localaddr;
+			rdev->tune = tune;
 
 		#if defined(USE_SSL)
 			rdev->ssl_ctx = ssl_ctx;
@@ -1226,6 +2344,9 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 				return -1;
 			}
 
+			resolve_tune (&conn->tune, &rdev->tune, TUNE_CONNECTING);
+			if (apply_tune(rdev, &rdev->tune, TUNE_CONNECTING) <= -1) return -1;
+
 		#if defined(USE_SSL)
 			if (rdev->ssl_ctx)
 			{
@@ -1252,7 +2373,44 @@ static int dev_sck_ioctl (mio_dev_t* dev, int cmd, void* arg)
 				SSL_CTX_set_mode (ssl_ctx, SSL_CTX_get_mode(ssl_ctx) | 
 				                           /* SSL_MODE_ENABLE_PARTIAL_WRITE | */
 				                           SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+			#if defined(USE_SSL_KTLS)
+				if (!(conn->options & MIO_DEV_SCK_CONNECT_SSL_NO_KTLS)) SSL_CTX_set_options (ssl_ctx, SSL_OP_ENABLE_KTLS);
+			#endif
+			#if defined(USE_SSL_SNI)
+				if (conn->ssl_alpn)
+				{
+					mio_uint8_t* alpn;
+					mio_oow_t alpn_len;
+
+					alpn = (mio_uint8_t*)mio_allocmem(mio, strlen(conn->ssl_alpn) + 1);
+					if (MIO_UNLIKELY(!alpn))
+					{
+						SSL_CTX_free (ssl_ctx);
+						return -1;
+					}
+
+					alpn_len = encode_ssl_alpn(conn->ssl_alpn, alpn);
+					if (alpn_len <= 0 || SSL_CTX_set_alpn_protos(ssl_ctx, alpn, alpn_len) != 0) /* 0 on success unlike others */
+					{
+						mio_seterrbfmt (mio, MIO_EINVAL, "invalid alpn protocols %hs", conn->ssl_alpn);
+						mio_freemem (mio, alpn);
+						SSL_CTX_free (ssl_ctx);
+						return -1;
+					}
+					mio_freemem (mio, alpn);
+				}
+			#endif
+
+			#if defined(USE_SSL_RESUMPTION)
+				if (conn->ssl_cache)
+				{
+					/* the sessions received are kept in the cache given */
+					SSL_CTX_set_session_cache_mode (ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+					SSL_CTX_sess_set_new_cb (ssl_ctx, on_new_client_ssl_session);
+				}
+			#endif
 			}
+			rdev->ssl_cache = (conn->options & MIO_DEV_SCK_CONNECT_SSL)? conn->ssl_cache: MIO_NULL;
 		#endif
 			/* the socket is already non-blocking */
 /*{
@@ -1366,7 +2524,34 @@ fcntl (rdev->hnd, F_SETFL, flags | O_NONBLOCK);
 				return -1;
 			}
 
+			if (lstn->options & MIO_DEV_SCK_LISTEN_EXCLUSIVE)
+			{
+				/* re-register the handle as the exclusive flag can be 
+				 * specified upon insertion only */
+				rdev->dev_cap |= MIO_DEV_CAP_WATCH_EXCLUSIVE;
+				if (mio_dev_watch((mio_dev_t*)rdev, MIO_DEV_WATCH_STOP, 0) <= -1 ||
+				    mio_dev_watch((mio_dev_t*)rdev, MIO_DEV_WATCH_START, 0) <= -1)
+				{
+					/* watcher update failure. it's critical */
+					mio_stop (mio, MIO_STOPREQ_WATCHER_ERROR);
+					return -1;
+				}
+			}
+
+		#if defined(USE_SSL_OFFLOAD)
+			if (lstn->ssl_handshake_workers > 0 && rdev->ssl_ctx)
+			{
+				if (lstn->ssl_handshake_workers > MIO_DEV_SCK_SSL_HANDSHAKE_WORKERS_MAX)
+				{
+					mio_seterrbfmt (mio, MIO_EINVAL, "too many tls handshake workers %zu", lstn->ssl_handshake_workers);
+					return -1;
+				}
+				if (make_ssl_hsp(rdev, lstn->ssl_handshake_workers) <= -1) return -1;
+			}
+		#endif
+
 			rdev->tmout = lstn->accept_tmout;
+			rdev->accept_budget = (lstn->accept_budget > 0)? lstn->accept_budget: MIO_DEV_SCK_ACCEPT_BUDGET_DEFAULT;
 
 			MIO_DEV_SCK_SET_PROGRESS (rdev, MIO_DEV_SCK_LISTENING);
 			return 0;
@@ -1387,6 +2572,8 @@ static mio_dev_mth_t dev_mth_sck_stateless =
 	dev_sck_write_stateless,
 	dev_sck_writev_stateless,
 	MIO_NULL,          /* sendfile */
+	MIO_NULL,          /* splice */
+	MIO_NULL,          /* writezc */
 	dev_sck_ioctl,     /* ioctl */
 };
 
@@ -1402,6 +2589,8 @@ static mio_dev_mth_t dev_mth_sck_stateful =
 	dev_sck_write_stateful,
 	dev_sck_writev_stateful,
 	dev_sck_sendfile_stateful,
+	dev_sck_splice_stateful,
+	dev_sck_writezc_stateful,
 	dev_sck_ioctl,     /* ioctl */
 };
 
@@ -1416,6 +2605,8 @@ static mio_dev_mth_t dev_mth_clisck =
 	dev_sck_write_stateful,
 	dev_sck_writev_stateful,
 	dev_sck_sendfile_stateful,
+	dev_sck_splice_stateful,
+	dev_sck_writezc_stateful,
 	dev_sck_ioctl
 };
 
@@ -1430,6 +2621,8 @@ static mio_dev_mth_t dev_mth_sck_bpf =
 	dev_sck_write_bpf,
 	dev_sck_writev_bpf,
 	MIO_NULL,          /* sendfile */
+	MIO_NULL,          /* splice */
+	MIO_NULL,          /* writezc */
 	dev_sck_ioctl,     /* ioctl */
 };
 
@@ -1558,7 +2751,7 @@ static int make_accepted_client_connection (mio_dev_sck_t* rdev, mio_syshnd_t cl
 	clidev->type = clisck_type;
 	MIO_ASSERT (mio, clidev->hnd == clisck);
 
-	clidev->dev_cap |= MIO_DEV_CAP_IN | MIO_DEV_CAP_OUT | MIO_DEV_CAP_STREAM;
+	clidev->dev_cap |= MIO_DEV_CAP_IN | MIO_DEV_CAP_OUT | MIO_DEV_CAP_STREAM | (rdev->dev_cap & MIO_DEV_CAP_IN_COALESCE);
 	clidev->remoteaddr = *remoteaddr;
 
 	addrlen = MIO_SIZEOF(clidev->localaddr);
@@ -1609,6 +2802,13 @@ static int make_accepted_client_connection (mio_dev_sck_t* rdev, mio_syshnd_t cl
 	clidev->on_write = rdev->on_write;
 	clidev->on_read = rdev->on_read;
 
+	clidev->tune = rdev->tune;
+	if (apply_tune(clidev, &clidev->tune, TUNE_ACCEPTED) <= -1)
+	{
+		/* not critical. the connection works without the option */
+		MIO_DEBUG3 (mio, "SCK(%p) - unable to tune accepted device %p - %js\n", rdev, clidev, mio_geterrmsg(mio));
+	}
+
 	/* inherit the contents of the extension area */
 	MIO_ASSERT (mio, rdev->dev_size == clidev->dev_size);
 	MIO_MEMCPY (mio_dev_sck_getxtn(clidev), mio_dev_sck_getxtn(rdev), rdev->dev_size - MIO_SIZEOF(mio_dev_sck_t));
@@ -1624,6 +2824,15 @@ static int make_accepted_client_connection (mio_dev_sck_t* rdev, mio_syshnd_t cl
 		/* let the client device know the SSL context to use */
 		clidev->ssl_ctx = rdev->ssl_ctx;
 
+	#if defined(USE_SSL_OFFLOAD)
+		if (rdev->ssl_hsp)
+		{
+			/* the handshake is performed in the worker pool of the listening socket */
+			clidev->ssl_hsp = rdev->ssl_hsp;
+			((sck_ssl_hsp_t*)clidev->ssl_hsp)->refs++;
+		}
+	#endif
+
 		if (MIO_IS_POS_NTIME(&rdev->tmout) &&
 		    schedule_timer_job_after(clidev, &rdev->tmout, ssl_accept_timedout) <= -1)
 		{
@@ -1685,7 +2894,31 @@ static int accept_incoming_connection (mio_dev_sck_t* rdev)
 #if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC) && defined(HAVE_ACCEPT4)
 accept_done:
 #endif
-	return make_accepted_client_connection(rdev, clisck, &remoteaddr, rdev->type);
+	/* 1 if a connection has been accepted */
+	return (make_accepted_client_connection(rdev, clisck, &remoteaddr, rdev->type) <= -1)? -1: 1;
+}
+
+static int accept_incoming_connections (mio_dev_sck_t* rdev)
+{
+	/* drain the backlog up to the budget in a single wakeup instead 
+	 * of returning to the multiplexer for every connection */
+	mio_oow_t count = 0;
+	int x;
+
+	do
+	{
+		x = accept_incoming_connection(rdev);
+		if (x <= 0) break; /* error or no more pending connections */
+		count++;
+	}
+	while (count < rdev->accept_budget && !(rdev->dev_cap & MIO_DEV_CAP_HALTED)); /* halted in a callback? */
+
+	rdev->accept_stat.wakeups++;
+	rdev->accept_stat.accepted += count;
+	if (count >= rdev->accept_budget) rdev->accept_stat.exhausted++;
+	if (count > rdev->accept_stat.max_per_wakeup) rdev->accept_stat.max_per_wakeup = count;
+
+	return (x <= -1)? -1: 0;
 }
 
 static int dev_evcb_sck_ready_stateful (mio_dev_t* dev, int events)
@@ -1697,6 +2930,13 @@ static int dev_evcb_sck_ready_stateful (mio_dev_t* dev, int events)
 	{
 		int errcode;
 		mio_scklen_t len;
+	#if defined(USE_ZEROCOPY)
+		int reaped = 0;
+
+		/* completion notifications of zero-copy sending operations
+		 * are queued to the error queue raising the error event */
+		if ((rdev->state & MIO_DEV_SCK_ZEROCOPY) && (reaped = reap_zerocopy_completions(rdev)) <= -1) return -1;
+	#endif
 
 		len = MIO_SIZEOF(errcode);
 		if (getsockopt(rdev->hnd, SOL_SOCKET, SO_ERROR, (char*)&errcode, &len) == -1)
@@ -1709,6 +2949,11 @@ static int dev_evcb_sck_ready_stateful (mio_dev_t* dev, int events)
 		}
 		else
 		{
+		#if defined(USE_ZEROCOPY)
+			/* no actual error. skip this round. the events still
+			 * pending are reported again as the watcher is level-triggered */
+			if (errcode == 0 && reaped) return 0;
+		#endif
 			mio_seterrwithsyserr (mio, 0, errcode);
 		}
 		return -1;
@@ -1798,13 +3043,13 @@ static int dev_evcb_sck_ready_stateful (mio_dev_t* dev, int events)
 			{
 				if (rdev->state & MIO_DEV_SCK_LENIENT)
 				{
-					accept_incoming_connection(rdev);
+					accept_incoming_connections(rdev);
 					return 0; /* return ok to the core regardless of accept()'s result */
 				}
 				else
 				{
 					/* [NOTE] if the accept operation fails, the core also kills this listening device. */
-					return accept_incoming_connection(rdev);
+					return accept_incoming_connections(rdev);
 				}
 			}
 			else
@@ -1830,19 +3075,13 @@ static int dev_evcb_sck_ready_stateful (mio_dev_t* dev, int events)
 			{
 				int x;
 
+				if (rdev->ssl_hsjob) return 0; /* in progress in a worker thread */
+
 				x = accept_ssl(rdev);
 				if (x <= -1) return -1;
 				if (x == 0) return 0; /* not SSL-accepted yet */
 
-				if (rdev->tmrjob_index != MIO_TMRIDX_INVALID)
-				{
-					mio_deltmrjob (rdev->mio, rdev->tmrjob_index);
-					rdev->tmrjob_index = MIO_TMRIDX_INVALID;
-				}
-
-				MIO_DEV_SCK_SET_PROGRESS (rdev, MIO_DEV_SCK_ACCEPTED);
-				if (rdev->on_connect) rdev->on_connect (rdev);
-
+				finish_ssl_accept (rdev);
 				return 0;
 			}
 			else
@@ -1991,6 +3230,15 @@ static int dev_evcb_sck_on_read_qx (mio_dev_t* dev, const void* data, mio_iolen_
 	{
 		mio_dev_sck_qxmsg_t* qxmsg;
 
+	#if defined(USE_SSL_OFFLOAD)
+		if (rdev->ssl_hsp)
+		{
+			/* notice from the tls handshake workers */
+			complete_ssl_hsjobs ((sck_ssl_hsp_t*)rdev->ssl_hsp);
+			return 0;
+		}
+	#endif
+
 		if (dlen != MIO_SIZEOF(*qxmsg))
 		{
 			mio_seterrbfmt (mio, MIO_EINVAL, "wrong qx packet size");
@@ -2140,6 +3388,31 @@ int mio_dev_sck_writev (mio_dev_sck_t* dev, mio_iovec_t* iov, mio_iolen_t iovcnt
 	return mio_dev_writev((mio_dev_t*)dev, iov, iovcnt, wrctx, skad_to_devaddr(dev, dstaddr, &devaddr));
 }
 
+int mio_dev_sck_writezc (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, void* wrctx)
+{
+#if defined(USE_ZEROCOPY)
+	if (dlen >= ZEROCOPY_MIN_LEN && !(dev->state & MIO_DEV_SCK_ZEROCOPY_OFF) && (dev->dev_cap & MIO_DEV_CAP_STREAM) && !dev->ssl)
+	{
+		if (!(dev->state & MIO_DEV_SCK_ZEROCOPY))
+		{
+			int v = 1;
+			if (setsockopt(dev->hnd, SOL_SOCKET, SO_ZEROCOPY, &v, MIO_SIZEOF(v)) == -1)
+			{
+				/* not supported by the kernel or the protocol. don't try again */
+				dev->state |= MIO_DEV_SCK_ZEROCOPY_OFF;
+				goto copy;
+			}
+			dev->state |= MIO_DEV_SCK_ZEROCOPY;
+		}
+
+		return mio_dev_writezc((mio_dev_t*)dev, data, dlen, wrctx);
+	}
+
+copy:
+#endif
+	return mio_dev_sck_write(dev, data, dlen, wrctx, MIO_NULL);
+}
+
 int mio_dev_sck_timedwrite (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_ntime_t* tmout, void* wrctx, const mio_skad_t* dstaddr)
 {
 	mio_devaddr_t devaddr;
@@ -2218,12 +3491,17 @@ int mio_dev_sck_shutdown (mio_dev_sck_t* dev, int how)
 int mio_dev_sck_sendfileok (mio_dev_sck_t* dev)
 {
 #if defined(USE_SSL)
-	return !(dev->ssl);
+	return !(dev->ssl) || (dev->state & MIO_DEV_SCK_KTLS_SEND);
 #else
 	return 1;
 #endif
 }
 
+int mio_dev_sck_forwardok (mio_dev_sck_t* dev)
+{
+	return mio_dev_sck_sendfileok(dev);
+}
+
 int mio_dev_sck_writetosidechan (mio_dev_sck_t* dev, const void* dptr, mio_oow_t dlen)
 {
 	if (write(dev->side_chan, dptr, dlen) <= -1) return -1; /* this doesn't set the error information. if you may check errno, though */
@@ -2232,6 +3510,214 @@ int mio_dev_sck_writetosidechan (mio_dev_sck_t* dev, const void* dptr, mio_oow_t
 
 /* ========================================================================= */
 
+int mio_dev_sck_setsslticketkey (mio_dev_sck_t* dev, const mio_uint8_t* key, mio_oow_t len)
+{
+#if defined(USE_SSL_RESUMPTION)
+	mio_t* mio = dev->mio;
+	sck_ssl_svr_t* svr;
+
+	if (len != MIO_DEV_SCK_SSL_TICKET_KEY_LEN)
+	{
+		mio_seterrbfmt (mio, MIO_EINVAL, "invalid ticket key length %zu", len);
+		return -1;
+	}
+
+	svr = dev->ssl_ctx? get_ssl_svr((SSL_CTX*)dev->ssl_ctx): MIO_NULL;
+	if (!svr || (dev->state & (MIO_DEV_SCK_ACCEPTED | MIO_DEV_SCK_ACCEPTING_SSL)))
+	{
+		mio_seterrbfmt (mio, MIO_EPERM, "not a socket bound with ssl");
+		return -1;
+	}
+
+	CRYPTO_THREAD_write_lock (svr->lock);
+	push_ssl_tkey (svr, key);
+	MIO_INIT_NTIME (&svr->tkey_expiry, 0, 0); /* no more automatic rotation */
+	CRYPTO_THREAD_unlock (svr->lock);
+	return 0;
+#else
+	mio_seterrnum (dev->mio, MIO_ENOIMPL);
+	return -1;
+#endif
+}
+
+int mio_dev_sck_getsslstat (mio_dev_sck_t* dev, mio_dev_sck_ssl_stat_t* stat)
+{
+#if defined(USE_SSL_RESUMPTION)
+	sck_ssl_svr_t* svr;
+
+	svr = dev->ssl_ctx? get_ssl_svr((SSL_CTX*)dev->ssl_ctx): MIO_NULL;
+	if (!svr)
+	{
+		mio_seterrbfmt (dev->mio, MIO_EPERM, "not a socket bound with ssl");
+		return -1;
+	}
+
+	*stat = svr->stat;
+	return 0;
+#else
+	mio_seterrnum (dev->mio, MIO_ENOIMPL);
+	return -1;
+#endif
+}
+
+mio_dev_sck_sslcache_t* mio_dev_sck_makesslcache (mio_t* mio, mio_oow_t capa)
+{
+#if defined(USE_SSL_RESUMPTION)
+	mio_dev_sck_sslcache_t* cache;
+
+	cache = (mio_dev_sck_sslcache_t*)mio_callocmem(mio, MIO_SIZEOF(*cache));
+	if (MIO_UNLIKELY(!cache)) return MIO_NULL;
+
+	if (mio_htb_init(&cache->htb, mio, 64, 70, 1, 1) <= -1)
+	{
+		mio_freemem (mio, cache);
+		return MIO_NULL;
+	}
+	mio_htb_setstyle (&cache->htb, mio_get_htb_style(MIO_HTB_STYLE_INLINE_KEY_COPIER));
+
+	cache->mio = mio;
+	cache->capa = (capa > 0)? capa: MIO_DEV_SCK_SSL_SESSION_CACHE_SIZE_DEFAULT;
+	return cache;
+#else
+	mio_seterrnum (mio, MIO_ENOIMPL);
+	return MIO_NULL;
+#endif
+}
+
+void mio_dev_sck_freesslcache (mio_dev_sck_sslcache_t* cache)
+{
+#if defined(USE_SSL_RESUMPTION)
+	while (cache->head) free_sslcache_ent (cache, cache->head);
+	mio_htb_fini (&cache->htb);
+	mio_freemem (cache->mio, cache);
+#endif
+}
+
+void mio_dev_sck_getsslcachestat (mio_dev_sck_sslcache_t* cache, mio_dev_sck_ssl_stat_t* stat)
+{
+#if defined(USE_SSL_RESUMPTION)
+	*stat = cache->stat;
+#else
+	MIO_MEMSET (stat, 0, MIO_SIZEOF(*stat));
+#endif
+}
+
+int mio_dev_sck_addsslhost (mio_dev_sck_t* dev, const mio_bch_t* host, const mio_bch_t* certfile, const mio_bch_t* keyfile)
+{
+#if defined(USE_SSL_SNI)
+	mio_t* mio = dev->mio;
+	sck_ssl_svr_t* svr;
+	SSL_CTX* ssl_ctx;
+	mio_bch_t key[256];
+	mio_oow_t len;
+	mio_htb_pair_t* pair;
+
+	svr = dev->ssl_ctx? get_ssl_svr((SSL_CTX*)dev->ssl_ctx): MIO_NULL;
+	if (!svr || (dev->state & (MIO_DEV_SCK_ACCEPTED | MIO_DEV_SCK_ACCEPTING_SSL)))
+	{
+		mio_seterrbfmt (mio, MIO_EPERM, "not a socket bound with ssl");
+		return -1;
+	}
+
+	len = make_ssl_host_key(host, key, MIO_COUNTOF(key));
+	if (len <= 0)
+	{
+		mio_seterrbfmt (mio, MIO_EINVAL, "invalid host name");
+		return -1;
+	}
+
+	ssl_ctx = make_ssl_server_ctx(mio, certfile, keyfile, svr->options);
+	if (!ssl_ctx) return -1;
+
+	/* the session cache and the tickets of the listening socket's context 
+	 * remain in use after switching to this context */
+	SSL_CTX_set_app_data (ssl_ctx, svr);
+	SSL_CTX_set_session_id_context (ssl_ctx, ssl_sid_ctx, MIO_SIZEOF(ssl_sid_ctx) - 1);
+	if (svr->alpn) SSL_CTX_set_alpn_select_cb (ssl_ctx, ssl_alpn_select_cb, svr);
+
+	CRYPTO_THREAD_write_lock (svr->lock);
+	if (!svr->hosts)
+	{
+		svr->hosts = mio_htb_open(mio, 0, 64, 70, 1, 1);
+		if (svr->hosts) mio_htb_setstyle (svr->hosts, &ssl_host_htb_style);
+	}
+	/* the old context replaced is released as it's not used any more */
+	pair = svr->hosts? mio_htb_upsert(svr->hosts, key, len, ssl_ctx, 0): MIO_NULL;
+	CRYPTO_THREAD_unlock (svr->lock);
+
+	if (!pair)
+	{
+		SSL_CTX_free (ssl_ctx);
+		return -1;
+	}
+
+	return 0;
+#else
+	mio_seterrnum (dev->mio, MIO_ENOIMPL);
+	return -1;
+#endif
+}
+
+int mio_dev_sck_delsslhost (mio_dev_sck_t* dev, const mio_bch_t* host)
+{
+#if defined(USE_SSL_SNI)
+	mio_t* mio = dev->mio;
+	sck_ssl_svr_t* svr;
+	mio_bch_t key[256];
+	mio_oow_t len;
+	int n;
+
+	svr = dev->ssl_ctx? get_ssl_svr((SSL_CTX*)dev->ssl_ctx): MIO_NULL;
+	if (!svr || (dev->state & (MIO_DEV_SCK_ACCEPTED | MIO_DEV_SCK_ACCEPTING_SSL)))
+	{
+		mio_seterrbfmt (mio, MIO_EPERM, "not a socket bound with ssl");
+		return -1;
+	}
+
+	len = make_ssl_host_key(host, key, MIO_COUNTOF(key));
+
+	CRYPTO_THREAD_write_lock (svr->lock);
+	n = (len > 0 && svr->hosts)? mio_htb_delete(svr->hosts, key, len): -1;
+	CRYPTO_THREAD_unlock (svr->lock);
+
+	if (n <= -1)
+	{
+		mio_seterrbfmt (mio, MIO_ENOENT, "unknown host %hs", host);
+		return -1;
+	}
+
+	return 0;
+#else
+	mio_seterrnum (dev->mio, MIO_ENOIMPL);
+	return -1;
+#endif
+}
+
+mio_oow_t mio_dev_sck_getsslalpn (mio_dev_sck_t* dev, mio_bch_t* buf, mio_oow_t bufsz)
+{
+	mio_oow_t len = 0;
+
+#if defined(USE_SSL_SNI)
+	if (dev->ssl)
+	{
+		const unsigned char* ptr;
+		unsigned int plen;
+
+		SSL_get0_alpn_selected ((SSL*)dev->ssl, &ptr, &plen);
+		if (ptr && plen < bufsz)
+		{
+			MIO_MEMCPY (buf, ptr, plen);
+			len = plen;
+		}
+	}
+#endif
+
+	if (bufsz > 0) buf[len] = '\0';
+	return len;
+}
+
+/* ========================================================================= */
+
 mio_uint16_t mio_checksum_ip (const void* hdr, mio_oow_t len)
 {
 	mio_uint32_t sum = 0;
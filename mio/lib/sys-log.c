@@ -66,9 +66,13 @@
 
 #else
 #	include <sys/types.h>
+#	include <sys/uio.h>
 #	include <unistd.h>
 #	include <fcntl.h>
 #	include <errno.h>
+#	if defined(HAVE_SYS_POLL_H)
+#		include <sys/poll.h>
+#	endif
 
 #	if defined(HAVE_TIME_H)
 #		include <time.h>
@@ -88,12 +92,553 @@ enum logfd_flag_t
 	LOGFD_OPENED_HERE = (1 << 1)
 };
 
+#if defined(_WIN32) || defined(__OS2__) || defined(__DOS__)
+	/* no async log */
+#elif defined(__ATOMIC_ACQUIRE)
+#	define ENABLE_ASYNC_LOG
+#	define LOG_LOAD_ACQUIRE(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#	define LOG_STORE_RELEASE(x,v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#	define LOG_MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif defined(MIO_HAVE_SYNC_SYNCHRONIZE)
+#	define ENABLE_ASYNC_LOG
+#	define LOG_LOAD_ACQUIRE(x) ((x) + (__sync_synchronize(), 0))
+#	define LOG_STORE_RELEASE(x,v) (__sync_synchronize(), (x) = (v))
+#	define LOG_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+static mio_oow_t format_ts (time_t now, mio_bch_t* ts, mio_oow_t capa)
+{
+	mio_oow_t tslen;
+	struct tm tm, *tmp;
+
+#if defined(_WIN32)
+	tmp = localtime(&now);
+	tslen = strftime(ts, capa, "%Y-%m-%d %H:%M:%S %z ", tmp);
+	if (tslen == 0) 
+	{
+		tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+	}
+#elif defined(__OS2__)
+	#if defined(__WATCOMC__)
+	tmp = _localtime(&now, &tm);
+	#else
+	tmp = localtime(&now);
+	#endif
+
+	#if defined(__BORLANDC__)
+	/* the borland compiler doesn't handle %z properly - it showed 00 all the time */
+	tslen = strftime(ts, capa, "%Y-%m-%d %H:%M:%S %Z ", tmp);
+	#else
+	tslen = strftime(ts, capa, "%Y-%m-%d %H:%M:%S %z ", tmp);
+	#endif
+	if (tslen == 0) 
+	{
+		tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+	}
+
+#elif defined(__DOS__)
+	tmp = localtime(&now);
+	/* since i know that %z/%Z is not available in strftime, i switch to sprintf immediately */
+	tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+#else
+	#if defined(HAVE_LOCALTIME_R)
+	tmp = localtime_r(&now, &tm);
+	#else
+	tmp = localtime(&now);
+	#endif
+
+	#if defined(HAVE_STRFTIME_SMALL_Z)
+	tslen = strftime(ts, capa, "%Y-%m-%d %H:%M:%S %z ", tmp);
+	#else
+	tslen = strftime(ts, capa, "%Y-%m-%d %H:%M:%S %Z ", tmp); 
+	#endif
+	if (tslen == 0) 
+	{
+		tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+	}
+#endif
+
+	return tslen;
+}
+
+#if defined(ENABLE_ASYNC_LOG)
+
+/* a record in the ring buffer. the message follows the header as passed
+ * to mio_sys_writelog() and the writer thread formats it. the record is
+ * padded to LOG_REC_ALIGN. a record with a negative fd fills the space
+ * at the end of the buffer not large enough for the next record */
+struct log_rec_t
+{
+	mio_uint32_t len; /* length of the message in bytes */
+	mio_int32_t fd;
+	mio_bitmask_t mask;
+	int fd_flag;
+	time_t now;
+};
+typedef struct log_rec_t log_rec_t;
+
+#define LOG_RING_CAPA (1 << 20)
+#define LOG_REC_ALIGN (32) /* power of 2 not smaller than the record header */
+#define LOG_REC_SIZE(len) MIO_ALIGN_POW2(MIO_SIZEOF(log_rec_t) + (len), LOG_REC_ALIGN)
+#define LOG_IOV_MAX (64)
+#define LOG_STG_CAPA (8192)
+
+/* output gathered by the writer thread for a single writev() call */
+struct log_out_t
+{
+	int fd;
+	int iovcnt;
+	struct iovec iov[LOG_IOV_MAX];
+
+	/* text produced by the writer thread. e.g. timestamps, converted messages */
+	mio_oow_t stglen;
+	mio_bch_t stg[LOG_STG_CAPA];
+
+	struct
+	{
+		time_t sec;
+		mio_bch_t buf[32];
+		mio_oow_t len;
+	} ts; /* timestamp formatted for the second given in sec */
+};
+typedef struct log_out_t log_out_t;
+
+static pthread_mutex_t log_list_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t log_atfork_once = PTHREAD_ONCE_INIT;
+static mio_sys_log_t* log_list = MIO_NULL; /* logs with the writer thread running */
+
+static int writev_all (int fd, struct iovec* iov, int iovcnt)
+{
+	while (iovcnt > 0)
+	{
+		ssize_t wr;
+
+		wr = writev(fd, iov, iovcnt);
+		if (wr <= -1)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+			#if defined(HAVE_SYS_POLL_H)
+				/* wait for the descriptor to become writable instead of spinning */
+				struct pollfd pfd;
+				pfd.fd = fd;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+				poll (&pfd, 1, -1);
+			#else
+				usleep (1000);
+			#endif
+				continue;
+			}
+			return -1;
+		}
+
+		while (iovcnt > 0 && (size_t)wr >= iov->iov_len)
+		{
+			wr -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			iov->iov_base = (mio_uint8_t*)iov->iov_base + wr;
+			iov->iov_len -= wr;
+		}
+	}
+
+	return 0;
+}
+
+static void flush_log_out (log_out_t* out)
+{
+	if (out->iovcnt > 0) writev_all (out->fd, out->iov, out->iovcnt);
+	out->iovcnt = 0;
+	out->stglen = 0;
+}
+
+static void add_log_out (log_out_t* out, const void* ptr, mio_oow_t len)
+{
+	/* the data must stay intact until flushed */
+	if (len <= 0) return;
+	if (out->iovcnt >= MIO_COUNTOF(out->iov)) flush_log_out (out);
+	out->iov[out->iovcnt].iov_base = (void*)ptr;
+	out->iov[out->iovcnt].iov_len = len;
+	out->iovcnt++;
+}
+
+static mio_bch_t* reserve_log_out (log_out_t* out, mio_oow_t len)
+{
+	/* return the space to produce at least len bytes in. it can be
+	 * followed by commit_log_out() without flushing in between */
+	if (out->stglen + len > MIO_COUNTOF(out->stg) || out->iovcnt >= MIO_COUNTOF(out->iov)) flush_log_out (out);
+	return &out->stg[out->stglen];
+}
+
+static void commit_log_out (log_out_t* out, mio_oow_t len)
+{
+	if (len <= 0) return;
+	out->iov[out->iovcnt].iov_base = &out->stg[out->stglen];
+	out->iov[out->iovcnt].iov_len = len;
+	out->iovcnt++;
+	out->stglen += len;
+}
+
+static void format_log_rec (mio_sys_log_t* log, log_out_t* out, const log_rec_t* rec)
+{
+	if (!(rec->mask & (MIO_LOG_STDOUT | MIO_LOG_STDERR)))
+	{
+		mio_bch_t* ptr;
+
+		if (rec->now != out->ts.sec || out->ts.len <= 0)
+		{
+			out->ts.len = format_ts(rec->now, out->ts.buf, MIO_SIZEOF(out->ts.buf));
+			out->ts.sec = rec->now;
+		}
+
+		ptr = reserve_log_out(out, out->ts.len);
+		MIO_MEMCPY (ptr, out->ts.buf, out->ts.len);
+		commit_log_out (out, out->ts.len);
+	}
+
+	if (rec->fd_flag & LOGFD_TTY)
+	{
+		if (rec->mask & MIO_LOG_FATAL) add_log_out (out, "\x1B[1;31m", 7);
+		else if (rec->mask & MIO_LOG_ERROR) add_log_out (out, "\x1B[1;32m", 7);
+		else if (rec->mask & MIO_LOG_WARN) add_log_out (out, "\x1B[1;33m", 7);
+	}
+
+#if defined(MIO_OOCH_IS_UCH)
+	{
+		const mio_uch_t* msg;
+		mio_oow_t len;
+
+		msg = (const mio_uch_t*)(rec + 1);
+		len = rec->len / MIO_SIZEOF(*msg);
+		while (len > 0)
+		{
+			mio_bch_t* bcs;
+			mio_oow_t ucslen, bcslen;
+			int n;
+
+			bcs = reserve_log_out(out, MIO_BCSIZE_MAX);
+			ucslen = len;
+			bcslen = MIO_COUNTOF(out->stg) - out->stglen;
+			n = mio_conv_uchars_to_bchars_with_cmgr(msg, &ucslen, bcs, &bcslen, log->async.cmgr);
+			commit_log_out (out, bcslen);
+
+			/* stop at an invalid character like the synchronous writer */
+			if (n != -2) break;
+			msg += ucslen;
+			len -= ucslen;
+		}
+	}
+#else
+	add_log_out (out, rec + 1, rec->len);
+#endif
+
+	if (rec->fd_flag & LOGFD_TTY)
+	{
+		if (rec->mask & (MIO_LOG_FATAL | MIO_LOG_ERROR | MIO_LOG_WARN)) add_log_out (out, "\x1B[0m", 4);
+	}
+}
+
+static void* log_writer_main (void* ctx)
+{
+	mio_sys_log_t* log = (mio_sys_log_t*)ctx;
+	log_out_t out;
+	int napped = 0;
+
+	out.fd = -1;
+	out.iovcnt = 0;
+	out.stglen = 0;
+	out.ts.len = 0;
+
+	while (1)
+	{
+		mio_oow_t head, pos, dropped;
+
+		head = LOG_LOAD_ACQUIRE(log->async.head);
+		pos = log->async.tail;
+
+		if (pos == head)
+		{
+			struct timespec ts;
+
+			if (LOG_LOAD_ACQUIRE(log->async.stop)) break;
+
+			if (!napped)
+			{
+				/* take a short nap for more records to come before sleeping.
+				 * the logging side doesn't wake up the writer taking a nap.
+				 * this lets busy logging go on without a wake-up call per
+				 * record and lets more records get written in a batch */
+				napped = 1;
+				usleep (1000);
+				continue;
+			}
+
+			/* sleep until woken up by a new record. the timed wait 
+			 * guarantees progress even if a wake-up gets missed */
+			clock_gettime (CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 100000000;
+			if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+
+			pthread_mutex_lock (&log->async.mtx);
+			LOG_STORE_RELEASE (log->async.sleeping, 1);
+			LOG_MEMORY_BARRIER ();
+			if (LOG_LOAD_ACQUIRE(log->async.head) == pos && !LOG_LOAD_ACQUIRE(log->async.stop)) pthread_cond_timedwait (&log->async.cnd, &log->async.mtx, &ts);
+			LOG_STORE_RELEASE (log->async.sleeping, 0);
+			pthread_mutex_unlock (&log->async.mtx);
+			continue;
+		}
+		napped = 0;
+
+		/* format a batch of records. consecutive records for the same
+		 * file descriptor are written with a single writev() call */
+		dropped = LOG_LOAD_ACQUIRE(log->async.dropped);
+		while (pos != head && out.iovcnt < MIO_COUNTOF(out.iov) / 2)
+		{
+			log_rec_t* rec = (log_rec_t*)&log->async.ptr[pos & (log->async.capa - 1)];
+			if (rec->fd >= 0)
+			{
+				if (rec->fd != out.fd)
+				{
+					flush_log_out (&out);
+					out.fd = rec->fd;
+				}
+
+				if (dropped != log->async.dropped_reported)
+				{
+					mio_bch_t* ptr;
+					ptr = reserve_log_out(&out, 64);
+					commit_log_out (&out, sprintf(ptr, "[%lu log messages dropped]\n", (unsigned long)(dropped - log->async.dropped_reported)));
+					log->async.dropped_reported = dropped;
+				}
+
+				format_log_rec (log, &out, rec);
+			}
+			pos += LOG_REC_SIZE(rec->len);
+		}
+		flush_log_out (&out);
+
+		LOG_STORE_RELEASE (log->async.tail, pos);
+		LOG_MEMORY_BARRIER (); /* pairs with the barrier after setting waiting in wait_log_writer() */
+
+		if (LOG_LOAD_ACQUIRE(log->async.waiting))
+		{
+			pthread_mutex_lock (&log->async.mtx);
+			pthread_cond_broadcast (&log->async.dcnd);
+			pthread_mutex_unlock (&log->async.mtx);
+		}
+	}
+
+	return MIO_NULL;
+}
+
+static void on_fork_prepare (void)
+{
+	pthread_mutex_lock (&log_list_mtx);
+}
+
+static void on_fork_parent (void)
+{
+	pthread_mutex_unlock (&log_list_mtx);
+}
+
+static void on_fork_child (void)
+{
+	/* the writer threads don't exist in a child process. let the child
+	 * start its own writer upon the next message. the parent writes the
+	 * records pending. */
+	mio_sys_log_t* log;
+
+	for (log = log_list; log; log = log->async.next)
+	{
+		log->async.started = 0;
+		log->async.head = 0;
+		log->async.tail = 0;
+		log->async.dropped = 0;
+		log->async.dropped_reported = 0;
+		log->async.sleeping = 0;
+		log->async.waiting = 0;
+		log->async.stop = 0;
+
+		/* the writer thread may have held the mutex when forked */
+		pthread_mutex_init (&log->async.mtx, MIO_NULL);
+		pthread_cond_init (&log->async.cnd, MIO_NULL);
+		pthread_cond_init (&log->async.dcnd, MIO_NULL);
+	}
+
+	log_list = MIO_NULL;
+	pthread_mutex_unlock (&log_list_mtx);
+}
+
+static void register_log_atfork (void)
+{
+	pthread_atfork (on_fork_prepare, on_fork_parent, on_fork_child);
+}
+
+static int start_log_writer (mio_t* mio)
+{
+	mio_sys_log_t* log = &mio->sysdep->log;
+
+	MIO_STATIC_ASSERT (MIO_SIZEOF(log_rec_t) <= LOG_REC_ALIGN);
+
+	if (!log->async.ptr)
+	{
+		/* the ring is kept in a forked child restarting the writer */
+		log->async.ptr = (mio_uint8_t*)mio_allocmem(mio, LOG_RING_CAPA);
+		if (!log->async.ptr) return -1;
+		log->async.capa = LOG_RING_CAPA;
+		log->async.head = 0;
+		log->async.tail = 0;
+		log->async.dropped = 0;
+		log->async.dropped_reported = 0;
+		log->async.sleeping = 0;
+		log->async.waiting = 0;
+		log->async.stop = 0;
+		log->async.cmgr = mio_getcmgr(mio);
+
+		pthread_mutex_init (&log->async.mtx, MIO_NULL);
+		pthread_cond_init (&log->async.cnd, MIO_NULL);
+		pthread_cond_init (&log->async.dcnd, MIO_NULL);
+	}
+
+	pthread_once (&log_atfork_once, register_log_atfork);
+
+	pthread_mutex_lock (&log_list_mtx);
+	if (pthread_create(&log->async.thr, MIO_NULL, log_writer_main, log) != 0)
+	{
+		pthread_mutex_unlock (&log_list_mtx);
+		return -1;
+	}
+	log->async.next = log_list;
+	log_list = log;
+	log->async.started = 1;
+	pthread_mutex_unlock (&log_list_mtx);
+
+	return 0;
+}
+
+static void stop_log_writer (mio_t* mio)
+{
+	mio_sys_log_t* log = &mio->sysdep->log;
+
+	if (log->async.started)
+	{
+		mio_sys_log_t** pp;
+
+		/* the writer thread exits after having written all records */
+		pthread_mutex_lock (&log->async.mtx);
+		LOG_STORE_RELEASE (log->async.stop, 1);
+		pthread_cond_signal (&log->async.cnd);
+		pthread_mutex_unlock (&log->async.mtx);
+		pthread_join (log->async.thr, MIO_NULL);
+
+		pthread_mutex_lock (&log_list_mtx);
+		for (pp = &log_list; *pp; pp = &(*pp)->async.next)
+		{
+			if (*pp == log)
+			{
+				*pp = log->async.next;
+				break;
+			}
+		}
+		pthread_mutex_unlock (&log_list_mtx);
+		log->async.started = 0;
+	}
+
+	if (log->async.ptr)
+	{
+		pthread_cond_destroy (&log->async.dcnd);
+		pthread_cond_destroy (&log->async.cnd);
+		pthread_mutex_destroy (&log->async.mtx);
+		mio_freemem (mio, log->async.ptr);
+		log->async.ptr = MIO_NULL;
+	}
+}
+
+static void wait_log_writer (mio_sys_log_t* log)
+{
+	/* wait until the writer thread has written all records. the logging
+	 * side is the only producer. no records are added while waiting */
+	if (LOG_LOAD_ACQUIRE(log->async.tail) == log->async.head) return;
+
+	pthread_mutex_lock (&log->async.mtx);
+	LOG_STORE_RELEASE (log->async.waiting, 1);
+	LOG_MEMORY_BARRIER (); /* pairs with the barrier after advancing tail in the writer */
+	while (LOG_LOAD_ACQUIRE(log->async.tail) != log->async.head)
+	{
+		pthread_cond_signal (&log->async.cnd); /* wake up the writer if sleeping */
+		pthread_cond_wait (&log->async.dcnd, &log->async.mtx);
+	}
+	LOG_STORE_RELEASE (log->async.waiting, 0);
+	pthread_mutex_unlock (&log->async.mtx);
+}
+
+static void enqueue_log (mio_sys_log_t* log, int fd, mio_bitmask_t mask, int fd_flag, const mio_ooch_t* msg, mio_oow_t len)
+{
+	mio_oow_t head, tail, off, room, size;
+	log_rec_t* rec;
+
+	len *= MIO_SIZEOF(*msg);
+
+	head = log->async.head;
+	tail = LOG_LOAD_ACQUIRE(log->async.tail);
+
+	size = LOG_REC_SIZE(len);
+	off = head & (log->async.capa - 1);
+	room = log->async.capa - off; /* room till the end of the buffer */
+	if (room >= size) room = 0; /* no padding needed */
+
+	if (log->async.capa - (head - tail) < room + size)
+	{
+		/* lack of room. drop it rather than blocking */
+		LOG_STORE_RELEASE (log->async.dropped, log->async.dropped + 1);
+		return;
+	}
+
+	if (room > 0)
+	{
+		rec = (log_rec_t*)&log->async.ptr[off];
+		rec->len = room - MIO_SIZEOF(*rec);
+		rec->fd = -1;
+		head += room;
+		off = 0;
+	}
+
+	rec = (log_rec_t*)&log->async.ptr[off];
+	rec->len = len;
+	rec->fd = fd;
+	rec->mask = mask;
+	rec->fd_flag = fd_flag;
+	rec->now = time(MIO_NULL);
+	MIO_MEMCPY (rec + 1, msg, len);
+
+	LOG_STORE_RELEASE (log->async.head, head + size);
+	LOG_MEMORY_BARRIER (); /* pairs with the barrier after setting sleeping in the writer */
+
+	if (LOG_LOAD_ACQUIRE(log->async.sleeping))
+	{
+		pthread_mutex_lock (&log->async.mtx);
+		pthread_cond_signal (&log->async.cnd);
+		pthread_mutex_unlock (&log->async.mtx);
+	}
+}
+#endif
+
 static int write_all (mio_t* mio, int fd, mio_bitmask_t mask, const mio_bch_t* ptr, mio_oow_t len)
 {
 	if (mio->option.log_writer) return mio->option.log_writer(mio, mask, ptr, len);
 
 	if (MIO_UNLIKELY(fd <= -1)) return 0; /* MIO_FEATURE_LOG_WRITER is off but mio->option.log_write is not set */
 
+#if defined(ENABLE_ASYNC_LOG)
+	/* keep the order with the records pending */
+	if (mio->sysdep->log.async.started) wait_log_writer (&mio->sysdep->log);
+#endif
+
 	while (len > 0)
 	{
 		mio_ooi_t wr;
@@ -196,6 +741,15 @@ void mio_sys_writelog (mio_t* mio, mio_bitmask_t mask, const mio_ooch_t* msg, mi
 
 	if (mio->_features & MIO_FEATURE_LOG_WRITER)
 	{
+	#if defined(ENABLE_ASYNC_LOG)
+		if ((mio->option.log_mask & MIO_LOG_ASYNC) && !log->async.started && !mio->option.log_writer)
+		{
+			/* start the writer thread upon the first message. keep
+			 * writing synchronously if it can't be started */
+			start_log_writer (mio);
+		}
+	#endif
+
 		if (mask & MIO_LOG_STDERR)
 		{
 			logfd = 2;
@@ -209,6 +763,15 @@ void mio_sys_writelog (mio_t* mio, mio_bitmask_t mask, const mio_ooch_t* msg, mi
 				if (logfd <= -1) return;
 			}
 		}
+
+	#if defined(ENABLE_ASYNC_LOG)
+		if (log->async.started && (mio->option.log_mask & MIO_LOG_ASYNC) && !(mask & MIO_LOG_FATAL) && !mio->option.log_writer)
+		{
+			/* let the writer thread format and write the message */
+			enqueue_log (log, logfd, mask, ((logfd == log->fd)? log->fd_flag: 0), msg, len);
+			return;
+		}
+	#endif
 	}
 
 /* TODO: beautify the log message.
@@ -216,58 +779,22 @@ void mio_sys_writelog (mio_t* mio, mio_bitmask_t mask, const mio_ooch_t* msg, mi
 	if (!(mask & (MIO_LOG_STDOUT | MIO_LOG_STDERR)))
 	{
 		time_t now;
-		char ts[32];
-		size_t tslen;
-		struct tm tm, *tmp;
+		mio_oow_t tslen;
 
 		now = time(MIO_NULL);
-	#if defined(_WIN32)
-		tmp = localtime(&now);
-		tslen = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S %z ", tmp);
-		if (tslen == 0) 
+		if (now == log->ts.sec && log->ts.len > 0) 
 		{
-			tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+			/* formatted for the same second already */
+			tslen = log->ts.len;
 		}
-	#elif defined(__OS2__)
-		#if defined(__WATCOMC__)
-		tmp = _localtime(&now, &tm);
-		#else
-		tmp = localtime(&now);
-		#endif
-
-		#if defined(__BORLANDC__)
-		/* the borland compiler doesn't handle %z properly - it showed 00 all the time */
-		tslen = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S %Z ", tmp);
-		#else
-		tslen = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S %z ", tmp);
-		#endif
-		if (tslen == 0) 
+		else
 		{
-			tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
+			tslen = format_ts(now, log->ts.buf, MIO_SIZEOF(log->ts.buf));
+			log->ts.sec = now;
+			log->ts.len = tslen;
 		}
 
-	#elif defined(__DOS__)
-		tmp = localtime(&now);
-		/* since i know that %z/%Z is not available in strftime, i switch to sprintf immediately */
-		tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
-	#else
-		#if defined(HAVE_LOCALTIME_R)
-		tmp = localtime_r(&now, &tm);
-		#else
-		tmp = localtime(&now);
-		#endif
-
-		#if defined(HAVE_STRFTIME_SMALL_Z)
-		tslen = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S %z ", tmp);
-		#else
-		tslen = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S %Z ", tmp); 
-		#endif
-		if (tslen == 0) 
-		{
-			tslen = sprintf(ts, "%04d-%02d-%02d %02d:%02d:%02d ", tmp->tm_year + 1900, tmp->tm_mon + 1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec);
-		}
-	#endif
-		write_log (mio, logfd, mask, ts, tslen);
+		write_log (mio, logfd, mask, log->ts.buf, tslen);
 	}
 
 	if (logfd == log->fd && (log->fd_flag & LOGFD_TTY))
@@ -345,6 +872,10 @@ void mio_sys_finilog (mio_t* mio)
 {
 	mio_sys_log_t* log = &mio->sysdep->log;
 
+#if defined(ENABLE_ASYNC_LOG)
+	stop_log_writer (mio);
+#endif
+
 	pthread_mutex_destroy (&log->mtx);
 
 	if (mio->_features & MIO_FEATURE_LOG_WRITER)
@@ -388,6 +919,12 @@ void mio_sys_resetlog (mio_t* mio)
 		log->fd = fd;
 		log->fd_flag = fd_flag;
 
+	#if defined(ENABLE_ASYNC_LOG)
+		/* the records pending may still refer to the old descriptor.
+		 * let the writer thread drain them before closing it */
+		if (kill_fd >= 0 && log->async.started) wait_log_writer (log);
+	#endif
+
 		if (kill_fd >= 0) close (kill_fd);
 	}
 }
@@ -335,6 +335,15 @@ int mio_sys_ctrlmux (mio_t* mio, mio_sys_mux_cmd_t cmd, mio_dev_t* dev, int dev_
 	}
 	if (dev_cap & MIO_DEV_CAP_OUT_WATCHED) events |= EPOLLOUT;
 
+#if defined(EPOLLEXCLUSIVE)
+	if (dev_cap & MIO_DEV_CAP_WATCH_EXCLUSIVE)
+	{
+		/* EPOLLEXCLUSIVE can't be combined with EPOLLRDHUP and EPOLLPRI */
+		events &= (EPOLLIN | EPOLLOUT);
+		if (events) events |= EPOLLEXCLUSIVE;
+	}
+#endif
+
 	ev.events = events | EPOLLHUP | EPOLLERR /*| EPOLLET*/; /* TODO: ready to support edge-trigger? */
 	ev.data.ptr = dev;
 
@@ -351,7 +360,10 @@ int mio_sys_ctrlmux (mio_t* mio, mio_sys_mux_cmd_t cmd, mio_dev_t* dev, int dev_
 			break;
 
 		case MIO_SYS_MUX_CMD_UPDATE:
-			if (MIO_UNLIKELY(!events))
+			/* the completion notification of a zero-copy sending operation
+			 * is reported as an error event. don't suspend the device while
+			 * it's waiting for one. */
+			if (MIO_UNLIKELY(!events) && MIO_WQ_IS_EMPTY(&dev->zcq))
 			{
 				if (dev->dev_cap & MIO_DEV_CAP_WATCH_SUSPENDED)
 				{
@@ -371,6 +383,14 @@ int mio_sys_ctrlmux (mio_t* mio, mio_sys_mux_cmd_t cmd, mio_dev_t* dev, int dev_
 					x = epoll_ctl(mux->hnd, EPOLL_CTL_ADD, hnd, &ev);
 					if (x >= 0) dev->dev_cap &= ~MIO_DEV_CAP_WATCH_SUSPENDED;
 				}
+			#if defined(EPOLLEXCLUSIVE)
+				else if (events & EPOLLEXCLUSIVE)
+				{
+					/* EPOLLEXCLUSIVE is allowed with EPOLL_CTL_ADD only */
+					x = epoll_ctl(mux->hnd, EPOLL_CTL_DEL, hnd, &ev);
+					if (x >= 0) x = epoll_ctl(mux->hnd, EPOLL_CTL_ADD, hnd, &ev);
+				}
+			#endif
 				else
 				{
 					x = epoll_ctl(mux->hnd, EPOLL_CTL_MOD, hnd, &ev);
@@ -420,6 +440,8 @@ int mio_sys_waitmux (mio_t* mio, const mio_ntime_t* tmout, mio_sys_mux_evtcb_t e
 		return -1;
 	}
 
+	mio_refreshtime (mio);
+
 	for (i = 0; i < mux->pd.size; i++)
 	{
 		if (mux->pd.pfd[i].fd >= 0 && mux->pd.pfd[i].revents)
@@ -454,6 +476,8 @@ int mio_sys_waitmux (mio_t* mio, const mio_ntime_t* tmout, mio_sys_mux_evtcb_t e
 		return -1;
 	}
 
+	mio_refreshtime (mio);
+
 	/* TODO: merge events??? for the same descriptor */
 	
 	for (i = 0; i < nentries; i++)
@@ -42,6 +42,8 @@
 #endif
 
 #include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
 
 /* -------------------------------------------------------------------------- */
 
@@ -94,7 +96,39 @@ struct mio_sys_log_t
 		mio_oow_t len;
 	} out;
 
+	struct
+	{
+		time_t sec;
+		mio_bch_t buf[32];
+		mio_oow_t len;
+	} ts; /* timestamp formatted for the second given in sec */
+
 	pthread_mutex_t mtx;
+
+	/* records written by the dedicated writer thread if MIO_LOG_ASYNC is set.
+	 * the ring is written by the logging side serialized by the caller and
+	 * read by the writer thread without a lock. */
+	struct
+	{
+		int started;
+		pthread_t thr;
+		mio_cmgr_t* cmgr; /* used by the writer thread to convert messages */
+		struct mio_sys_log_t* next; /* in the list of logs with the writer thread running */
+
+		mio_uint8_t* ptr;
+		mio_oow_t capa; /* power of 2 */
+		volatile mio_oow_t head; /* advanced by the logging side */
+		volatile mio_oow_t tail; /* advanced by the writer thread */
+		volatile mio_oow_t dropped; /* number of records dropped for lack of room */
+		mio_oow_t dropped_reported;
+
+		int sleeping;
+		int waiting;
+		int stop;
+		pthread_mutex_t mtx; /* used to put the idle writer or a waiter to sleep only */
+		pthread_cond_t cnd; /* wakes up the writer */
+		pthread_cond_t dcnd; /* signaled by the writer after writing records if waiting is set */
+	} async;
 };
 typedef struct mio_sys_log_t mio_sys_log_t;
 
@@ -24,6 +24,9 @@
     THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#if !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE /* splice() */
+#endif
 #include "sys-prv.h"
 
 int mio_sys_init (mio_t* mio)
@@ -117,3 +120,123 @@ printf ("make sysnhd cloexec error (%d) - errno %d\n", hnd, errno);
 	return -1;
 #endif
 }
+
+#if defined(HAVE_UNISTD_H)
+#	include <unistd.h>
+#endif
+void mio_sys_getrandom (mio_t* mio, void* buf, mio_oow_t len)
+{
+	mio_uint8_t* ptr = (mio_uint8_t*)buf;
+	mio_oow_t got = 0;
+	mio_ntime_t now;
+	mio_uint8_t key[16];
+	mio_oow_t i;
+
+#if defined(O_RDONLY) && defined(HAVE_UNISTD_H)
+	int fd;
+
+	#if defined(O_CLOEXEC)
+	fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	#else
+	fd = open("/dev/urandom", O_RDONLY);
+	#endif
+	if (fd >= 0)
+	{
+		while (got < len)
+		{
+			ssize_t n = read(fd, ptr + got, len - got);
+			if (n <= 0)
+			{
+				if (n <= -1 && errno == EINTR) continue;
+				break;
+			}
+			got += n;
+		}
+		close (fd);
+	}
+#endif
+
+	if (got >= len) return;
+
+	/* no random source. derive the remaining bytes from the clocks
+	 * and the addresses which are at least different per process run */
+	mio_sys_getrealtime (mio, &now);
+	MIO_MEMSET (key, 0, MIO_SIZEOF(key));
+	MIO_MEMCPY (&key[0], &now.sec, (MIO_SIZEOF(now.sec) < 8? MIO_SIZEOF(now.sec): 8));
+	MIO_MEMCPY (&key[8], &now.nsec, (MIO_SIZEOF(now.nsec) < 4? MIO_SIZEOF(now.nsec): 4));
+	i = (mio_oow_t)mio ^ (mio_oow_t)&now;
+	MIO_MEMCPY (&key[12], &i, (MIO_SIZEOF(i) < 4? MIO_SIZEOF(i): 4));
+
+	for (i = got; i < len; i += 8)
+	{
+		mio_uint8_t out[8];
+		mio_sys_gettime (mio, &now);
+		mio_sip_hash_24 (key, &now, MIO_SIZEOF(now), out);
+		MIO_MEMCPY (ptr + i, out, (len - i < 8? len - i: 8));
+		key[i % 16] ^= out[0];
+	}
+}
+
+int mio_sys_openpipe (mio_t* mio, mio_syshnd_t* pfd)
+{
+#if defined(HAVE_PIPE2) && defined(O_CLOEXEC) && defined(O_NONBLOCK)
+	if (pipe2(pfd, O_CLOEXEC | O_NONBLOCK) <= -1)
+	{
+		mio_seterrwithsyserr (mio, 0, errno);
+		return -1;
+	}
+#else
+	if (pipe(pfd) <= -1)
+	{
+		mio_seterrwithsyserr (mio, 0, errno);
+		return -1;
+	}
+
+	if (mio_makesyshndasync(mio, pfd[0]) <= -1 || mio_makesyshndcloexec(mio, pfd[0]) <= -1 ||
+	    mio_makesyshndasync(mio, pfd[1]) <= -1 || mio_makesyshndcloexec(mio, pfd[1]) <= -1)
+	{
+		mio_sys_closepipe (mio, pfd);
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
+void mio_sys_closepipe (mio_t* mio, mio_syshnd_t* pfd)
+{
+	if (pfd[0] != MIO_SYSHND_INVALID)
+	{
+		close (pfd[0]);
+		pfd[0] = MIO_SYSHND_INVALID;
+	}
+	if (pfd[1] != MIO_SYSHND_INVALID)
+	{
+		close (pfd[1]);
+		pfd[1] = MIO_SYSHND_INVALID;
+	}
+}
+
+int mio_sys_splice (mio_t* mio, mio_syshnd_t in, mio_syshnd_t out, mio_iolen_t* len)
+{
+#if defined(HAVE_SPLICE) && defined(SPLICE_F_NONBLOCK)
+	ssize_t x;
+
+	/* both handles are non-blocking. SPLICE_F_NONBLOCK makes the pipe
+	 * side non-blocking even if the pipe is shared with someone else */
+	x = splice(in, MIO_NULL, out, MIO_NULL, *len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (x <= -1)
+	{
+		if (errno == EINPROGRESS || errno == EWOULDBLOCK || errno == EAGAIN) return 0;
+		if (errno == EINTR) return 0;
+		mio_seterrwithsyserr (mio, 0, errno);
+		return -1;
+	}
+
+	*len = x;
+	return 1;
+#else
+	mio_seterrbfmt (mio, MIO_ENOIMPL, "splice not supported");
+	return -1;
+#endif
+}
@@ -510,6 +510,14 @@ static mio_syshnd_t dev_thr_getsyshnd_slave (mio_dev_t* dev)
 	return (mio_syshnd_t)thr->pfd;
 }
 
+static int dev_thr_splice_slave (mio_dev_t* dev, mio_syshnd_t pfd, mio_iolen_t* len, int out)
+{
+	mio_dev_thr_slave_t* thr = (mio_dev_thr_slave_t*)dev;
+
+	MIO_ASSERT (thr->mio, thr->pfd != MIO_SYSHND_INVALID);
+	return out? mio_sys_splice(thr->mio, pfd, thr->pfd, len): mio_sys_splice(thr->mio, thr->pfd, pfd, len);
+}
+
 static int dev_thr_ioctl (mio_dev_t* dev, int cmd, void* arg)
 {
 	mio_t* mio = dev->mio;
@@ -569,9 +577,12 @@ static mio_dev_mth_t dev_thr_methods =
 	MIO_NULL,
 	dev_thr_getsyshnd,
 
-	MIO_NULL,
-	MIO_NULL,
-	MIO_NULL,
+	MIO_NULL, /* read */
+	MIO_NULL, /* write */
+	MIO_NULL, /* writev */
+	MIO_NULL, /* sendfile */
+	MIO_NULL, /* splice */
+	MIO_NULL, /* writezc */
 	dev_thr_ioctl
 };
 
@@ -585,6 +596,9 @@ static mio_dev_mth_t dev_thr_methods_slave =
 	dev_thr_read_slave,
 	dev_thr_write_slave,
 	dev_thr_writev_slave,
+	MIO_NULL, /* sendfile */
+	dev_thr_splice_slave,
+	MIO_NULL, /* writezc */
 	dev_thr_ioctl
 };
 
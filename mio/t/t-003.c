@@ -0,0 +1,171 @@
+/* test the response cache and the question coalescing of the dns client service */
+
+#include <mio.h>
+#include <mio-dns.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "t.h"
+
+static int nresults = 0;
+static int results[4];
+static int in_resolve = 0;
+static int early_callback = 0;
+
+/* answer every A question with 10.0.0.N where N is the number of questions
+ * received so far. the caller can tell how many questions have reached the
+ * server by looking at the address returned */
+static void run_server (int fd)
+{
+	mio_uint8_t buf[512];
+	struct sockaddr_in from;
+	socklen_t fromlen;
+	ssize_t n;
+	mio_oow_t pos;
+	int count = 0;
+
+	while (1)
+	{
+		fromlen = sizeof(from);
+		n = recvfrom(fd, buf, sizeof(buf) - 16, 0, (struct sockaddr*)&from, &fromlen);
+		if (n < 12) continue;
+
+		/* skip the question name and the type and class fields */
+		pos = 12;
+		while (pos < (mio_oow_t)n && buf[pos] != 0) pos += buf[pos] + 1;
+		pos += 5;
+		if (pos > (mio_oow_t)n) continue;
+
+		count++;
+		buf[2] = 0x81; /* qr, rd */
+		buf[3] = 0x80; /* ra */
+		buf[6] = 0; buf[7] = 1; /* ancount */
+		buf[8] = 0; buf[9] = 0; /* nscount */
+		buf[10] = 0; buf[11] = 0; /* arcount - drop the opt record from the question */
+
+		buf[pos++] = 0xC0; buf[pos++] = 12; /* name pointer to the question */
+		buf[pos++] = 0; buf[pos++] = MIO_DNS_RRT_A;
+		buf[pos++] = 0; buf[pos++] = MIO_DNS_RRC_IN;
+		buf[pos++] = 0; buf[pos++] = 0; buf[pos++] = 0x01; buf[pos++] = 0x2C; /* ttl 300 */
+		buf[pos++] = 0; buf[pos++] = 4;
+		buf[pos++] = 10; buf[pos++] = 0; buf[pos++] = 0; buf[pos++] = count;
+
+		sendto(fd, buf, pos, 0, (struct sockaddr*)&from, fromlen);
+	}
+}
+
+static void on_resolve (mio_svc_dnc_t* dnc, mio_dns_msg_t* reqmsg, mio_errnum_t status, const void* data, mio_oow_t dlen)
+{
+	const mio_dns_brr_t* brr = (const mio_dns_brr_t*)data;
+
+	if (in_resolve) early_callback = 1;
+
+	if (status != MIO_ENOERR || !brr || brr->rrtype != MIO_DNS_RRT_A || brr->dlen != 4)
+	{
+		results[nresults++] = -1;
+	}
+	else
+	{
+		results[nresults++] = ((const mio_uint8_t*)brr->dptr)[3];
+	}
+
+	if (nresults == 2)
+	{
+		/* both coalesced requests are done. this one must come from the cache */
+		in_resolve = 1;
+		if (!mio_svc_dnc_resolve(dnc, "a.example.org", MIO_DNS_RRT_A, MIO_SVC_DNC_RESOLVE_FLAG_BRIEF, on_resolve, 0)) results[nresults++] = -2;
+		in_resolve = 0;
+	}
+	else if (nresults == 3)
+	{
+		/* bypass the cache */
+		if (!mio_svc_dnc_resolve(dnc, "a.example.org", MIO_DNS_RRT_A, MIO_SVC_DNC_RESOLVE_FLAG_BRIEF | MIO_SVC_DNC_RESOLVE_FLAG_NO_CACHE, on_resolve, 0)) results[nresults++] = -2;
+	}
+
+	if (nresults >= 4) mio_stop (mio_svc_dnc_getmio(dnc), MIO_STOPREQ_TERMINATION);
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	int fd = -1;
+	pid_t pid = -1;
+
+	{
+		struct sockaddr_in sin;
+		socklen_t sinlen;
+		mio_svc_dnc_t* dnc;
+		mio_skad_t servaddr;
+		mio_ntime_t send_tmout, reply_tmout;
+		mio_bch_t addrbuf[64];
+		int n;
+
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+		T_ASSERT1 (fd >= 0, "udp socket");
+
+		memset (&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		sinlen = sizeof(sin);
+		T_ASSERT1 (bind(fd, (struct sockaddr*)&sin, sizeof(sin)) == 0 && getsockname(fd, (struct sockaddr*)&sin, &sinlen) == 0, "bind the fake server");
+
+		pid = fork();
+		T_ASSERT1 (pid >= 0, "fork");
+		if (pid == 0)
+		{
+			run_server (fd);
+			_exit (0);
+		}
+		close (fd);
+		fd = -1;
+
+		alarm (10);
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+		snprintf (addrbuf, MIO_COUNTOF(addrbuf), "127.0.0.1:%d", (int)ntohs(sin.sin_port));
+		T_ASSERT1 (mio_bcstrtoskad(mio, addrbuf, &servaddr) >= 0, "server address");
+
+		MIO_INIT_NTIME (&send_tmout, 1, 0);
+		MIO_INIT_NTIME (&reply_tmout, 1, 0);
+		dnc = mio_svc_dnc_start(mio, &servaddr, MIO_NULL, &send_tmout, &reply_tmout, 2);
+		T_ASSERT1 (dnc != MIO_NULL, "dns client start");
+
+		/* the second question must wait for the answer to the first */
+		T_ASSERT1 (mio_svc_dnc_resolve(dnc, "a.example.org", MIO_DNS_RRT_A, MIO_SVC_DNC_RESOLVE_FLAG_BRIEF, on_resolve, 0) != MIO_NULL, "resolve #1");
+		T_ASSERT1 (mio_svc_dnc_resolve(dnc, "A.Example.Org", MIO_DNS_RRT_A, MIO_SVC_DNC_RESOLVE_FLAG_BRIEF, on_resolve, 0) != MIO_NULL, "resolve #2");
+
+		mio_loop (mio);
+
+		for (n = 0; n < nresults; n++) printf ("result %d = %d\n", n, results[n]);
+
+		T_ASSERT1 (nresults == 4, "number of responses");
+		T_ASSERT1 (results[0] == 1 && results[1] == 1, "coalesced questions");
+		T_ASSERT1 (results[2] == 1, "answer from the cache");
+		T_ASSERT1 (!early_callback, "callback before resolve returns");
+		T_ASSERT1 (results[3] == 2, "cache bypass");
+	}
+
+	mio_close (mio);
+	kill (pid, SIGKILL);
+	waitpid (pid, MIO_NULL, 0);
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	if (fd >= 0) close (fd);
+	if (pid > 0)
+	{
+		kill (pid, SIGKILL);
+		waitpid (pid, MIO_NULL, 0);
+	}
+	return -1;
+}
@@ -0,0 +1,286 @@
+/* test the json parser */
+
+#include <mio.h>
+#include <mio-json.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include "t.h"
+
+static char trace[4096];
+static mio_oow_t trace_len = 0;
+
+static void add_trace (const char* str)
+{
+	mio_oow_t len = strlen(str);
+	if (trace_len + len < MIO_COUNTOF(trace))
+	{
+		memcpy (&trace[trace_len], str, len);
+		trace_len += len;
+		trace[trace_len] = '\0';
+	}
+}
+
+static void add_trace_oocs (const mio_oocs_t* str)
+{
+	mio_oow_t i;
+	char tmp[16];
+
+	for (i = 0; i < str->len; i++)
+	{
+		if (str->ptr[i] >= 0x20 && str->ptr[i] < 0x7F)
+		{
+			tmp[0] = str->ptr[i];
+			tmp[1] = '\0';
+		}
+		else
+		{
+			/* show a control or non-ascii character in hexadecimal */
+			snprintf (tmp, MIO_COUNTOF(tmp), "<%x>", (unsigned int)str->ptr[i]);
+		}
+		add_trace (tmp);
+	}
+}
+
+static int on_json_inst (mio_json_t* json, mio_json_inst_t inst, mio_oow_t level, mio_oow_t index, mio_json_state_t container_state, const mio_oocs_t* str, void* ctx)
+{
+	int pm;
+	char tmp[16];
+
+	if (trace_len > 0) add_trace (" ");
+
+	pm = mio_json_getpathmatch(json);
+	if (pm >= 0)
+	{
+		snprintf (tmp, MIO_COUNTOF(tmp), "%d:", pm);
+		add_trace (tmp);
+	}
+
+	switch (inst)
+	{
+		case MIO_JSON_INST_START_ARRAY:
+			add_trace ("[");
+			break;
+		case MIO_JSON_INST_END_ARRAY:
+			add_trace ("]");
+			break;
+		case MIO_JSON_INST_START_OBJECT:
+			add_trace ("{");
+			break;
+		case MIO_JSON_INST_END_OBJECT:
+			add_trace ("}");
+			break;
+		case MIO_JSON_INST_KEY:
+			add_trace ("k:");
+			add_trace_oocs (str);
+			break;
+		case MIO_JSON_INST_STRING:
+			add_trace ("s:");
+			add_trace_oocs (str);
+			break;
+		case MIO_JSON_INST_NUMBER:
+			add_trace ("n:");
+			add_trace_oocs (str);
+			break;
+		case MIO_JSON_INST_NIL:
+			add_trace ("nil");
+			break;
+		case MIO_JSON_INST_TRUE:
+			add_trace ("true");
+			break;
+		case MIO_JSON_INST_FALSE:
+			add_trace ("false");
+			break;
+	}
+
+	return 0;
+}
+
+/* feed the text in chunks of the given size. a chunk size of 0 feeds
+ * the whole text at once. the bytes of an incomplete sequence left over
+ * by a feed are fed again with the next chunk */
+static int feed_json (mio_json_t* json, const char* text, mio_oow_t chunk)
+{
+	char buf[1024];
+	mio_oow_t len, pos, n, blen, rem;
+
+	trace_len = 0;
+	trace[0] = '\0';
+	mio_json_resetstates (json);
+
+	len = strlen(text);
+	if (chunk <= 0) chunk = len;
+	blen = 0;
+	for (pos = 0; pos < len; pos += n)
+	{
+		n = (len - pos < chunk)? (len - pos): chunk;
+		if (blen + n > MIO_COUNTOF(buf)) return -1;
+		memcpy (&buf[blen], &text[pos], n);
+		blen += n;
+
+		if (mio_json_feed(json, buf, blen, &rem, 0) <= -1) return -1;
+		memmove (buf, &buf[blen - rem], rem);
+		blen = rem;
+	}
+
+	return (blen == 0 && mio_json_getstate(json) == MIO_JSON_STATE_START)? 0: -1;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	mio_json_t* json = MIO_NULL;
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	json = mio_json_open(mio, 0);
+	T_ASSERT1 (json != MIO_NULL, "json open");
+	mio_json_setinstcb (json, on_json_inst, MIO_NULL);
+
+	{
+		/* string runs are consumed in bulk. the result must not depend on
+		 * how the text is split into chunks */
+		static const char* text = "{ \"key\" : \"a long run of plain characters, then \\\"escapes\\\" \\t\\n\\u00e9\\u4e2d and \xc3\xa9 raw\", \"arr\": [ 1,  -2.5e3 , true,false , null, \"\" ] }";
+		static const char* expected = "{ k:key s:a long run of plain characters, then \"escapes\" <9><a><e9><4e2d> and <e9> raw k:arr [ n:1 n:-2.5e3 true false nil s: ] }";
+		static mio_oow_t chunks[] = { 0, 1, 2, 3, 7, 16 };
+		mio_oow_t i;
+
+		for (i = 0; i < MIO_COUNTOF(chunks); i++)
+		{
+			T_ASSERT1 (feed_json(json, text, chunks[i]) == 0, "feed json text");
+			if (strcmp(trace, expected) != 0) printf ("chunk %d - %s\n", (int)chunks[i], trace);
+			T_ASSERT1 (strcmp(trace, expected) == 0, "json string runs");
+		}
+	}
+
+	{
+		/* blanks between tokens are skipped in bulk */
+		static const char* text = "   \t\r\n[\n\n  \"x\"  ,\r\n\t\"y\"\n\n  ]   \n";
+
+		T_ASSERT1 (feed_json(json, text, 0) == 0, "feed json text");
+		T_ASSERT1 (strcmp(trace, "[ s:x s:y ]") == 0, "json blanks");
+		T_ASSERT1 (feed_json(json, text, 1) == 0, "feed json text");
+		T_ASSERT1 (strcmp(trace, "[ s:x s:y ]") == 0, "json blanks");
+	}
+
+	{
+		/* an unterminated string must not be completed */
+		mio_oow_t rem;
+		mio_json_resetstates (json);
+		T_ASSERT1 (mio_json_feed(json, "[\"abc", 5, &rem, 0) == 0 && mio_json_getstate(json) != MIO_JSON_STATE_START, "incomplete string");
+		mio_json_resetstates (json);
+	}
+
+	{
+		/* only the values on the registered paths are reported. the skipped
+		 * values contain brackets and quotes inside strings */
+		static const char* text = "{ \"skip\": { \"a\": [1, \"]}\\\"[{\", {\"b\": null}] }, \"user\": { \"name\": \"x]\", \"id\": 123, \"tags\": [\"p\", \"q\"] }, \"items\": [ { \"id\": 1, \"name\": \"one\" }, { \"name\": \"two\", \"id\": \"2\" }, { \"id\": { \"n\": [true] } } ], \"tail\": \"}\" }";
+		static const char* expected = "0:n:123 2:n:1 1:s:one 2:s:2 2:{ 2:k:n 2:[ 2:true 2:] 2:}";
+		static mio_oow_t chunks[] = { 0, 1, 5 };
+		mio_oow_t i;
+
+		T_ASSERT1 (mio_json_getpathmatch(json) <= -1, "path match in the normal mode");
+		T_ASSERT1 (mio_json_addpath(json, "$.user.id") == 0, "add path");
+		T_ASSERT1 (mio_json_addpath(json, "$.items[0].name") == 1, "add path");
+		T_ASSERT1 (mio_json_addpath(json, "$.items[*].id") == 2, "add path");
+
+		for (i = 0; i < MIO_COUNTOF(chunks); i++)
+		{
+			T_ASSERT1 (feed_json(json, text, chunks[i]) == 0, "feed json text");
+			if (strcmp(trace, expected) != 0) printf ("chunk %d - %s\n", (int)chunks[i], trace);
+			T_ASSERT1 (strcmp(trace, expected) == 0, "json path query");
+		}
+
+		/* back to the normal mode */
+		mio_json_clearpaths (json);
+		T_ASSERT1 (feed_json(json, "{\"a\": [1]}", 0) == 0, "feed json text");
+		T_ASSERT1 (strcmp(trace, "{ k:a [ n:1 ] }") == 0, "json after clearing paths");
+	}
+
+	{
+		/* an invalid path is rejected */
+		T_ASSERT1 (mio_json_addpath(json, "user.id") <= -1, "path without $");
+		T_ASSERT1 (mio_json_addpath(json, "$.items[") <= -1, "unterminated index");
+		mio_json_clearpaths (json);
+	}
+
+	{
+		/* a document is parsed into nodes accessed by index or key */
+		static const char* text = "{ \"a\": { \"b\": [ 1, \"x\\u00e9\\ud83d\\ude00\\n\\\"\", { \"c\": true } ] },\n  \"plain\": \"abc\", \"e\": [], \"n\": null }";
+		mio_json_doc_t* doc;
+		mio_json_node_t* root, * a, * b, * n;
+
+		doc = mio_json_parsedoc(mio, text, strlen(text));
+		T_ASSERT1 (doc != MIO_NULL, "parse document");
+		root = mio_json_getdocroot(doc);
+		T_ASSERT1 (root->type == MIO_JSON_NODE_OBJECT && root->u.c.count == 4 && !root->parent, "document root");
+
+		n = mio_json_getkey(root, 1);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_STRING && n->u.str.len == 5 && memcmp(n->u.str.ptr, "plain", 5) == 0, "key by index");
+		n = mio_json_getitem(root, 1);
+		T_ASSERT1 (n && n->u.str.len == 3 && memcmp(n->u.str.ptr, "abc", 3) == 0, "value by index");
+		/* a string without escape sequences refers to the input */
+		T_ASSERT1 (n->u.str.ptr > text && n->u.str.ptr < text + strlen(text), "string in the input");
+		T_ASSERT1 (!mio_json_getkey(root, 4) && !mio_json_getitem(root, 4), "index out of range");
+
+		a = mio_json_findvalue(root, "a", 1);
+		T_ASSERT1 (a && a->type == MIO_JSON_NODE_OBJECT && a->parent == root, "value by key");
+		b = mio_json_findvalue(a, "b", 1);
+		T_ASSERT1 (b && b->type == MIO_JSON_NODE_ARRAY && b->u.c.count == 3 && b->parent == a, "nested value by key");
+		T_ASSERT1 (!mio_json_getkey(b, 0) && !mio_json_findvalue(b, "b", 1) && !mio_json_getitem(b, 3), "array accessors");
+
+		n = mio_json_getitem(b, 0);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_NUMBER && n->u.str.len == 1 && n->u.str.ptr[0] == '1', "number item");
+
+		/* \u00e9 in 2 bytes, the surrogate pair for U+1F600 in 4 bytes */
+		n = mio_json_getitem(b, 1);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_STRING, "string item");
+		T_ASSERT1 (n->u.str.len == 9 && memcmp(n->u.str.ptr, "x\xc3\xa9\xf0\x9f\x98\x80\n\"", 9) == 0, "string escapes");
+
+		n = mio_json_findvalue(mio_json_getitem(b, 2), "c", 1);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_TRUE && n->parent == mio_json_getitem(b, 2) && n->parent->parent == b, "deeply nested value");
+
+		n = mio_json_findvalue(root, "e", 1);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_ARRAY && n->u.c.count == 0 && !mio_json_getitem(n, 0), "empty array");
+		n = mio_json_findvalue(root, "n", 1);
+		T_ASSERT1 (n && n->type == MIO_JSON_NODE_NIL, "null value");
+		T_ASSERT1 (!mio_json_findvalue(root, "nn", 2) && !mio_json_findvalue(root, "", 0), "no such key");
+
+		mio_json_freedoc (doc);
+	}
+
+	{
+		/* the error message tells where the text goes wrong */
+		static struct
+		{
+			const char* text;
+			const char* msg;
+		} bad[] =
+		{
+			{ "{\n  \"a\": [1, 2,\n   x ]\n}", "invalid word value at 3:4" },
+			{ "[1, \"ab\\q\"]", "invalid escape sequence at 1:8" },
+			{ "[1, \"\\u12x4\"]", "invalid escape sequence at 1:6" },
+			{ "{\"a\": 1\n \"b\": 2}", "comma or } expected in object at 2:2" },
+			{ "[1, 2] 3", "trailing data at 1:8" },
+			{ "[\"abc", "unterminated string at 1:6" },
+			{ "[-]", "invalid numeric value at 1:3" }
+		};
+		mio_oow_t i;
+
+		for (i = 0; i < MIO_COUNTOF(bad); i++)
+		{
+			T_ASSERT1 (mio_json_parsedoc(mio, bad[i].text, strlen(bad[i].text)) == MIO_NULL, "malformed document");
+			T_ASSERT2 (mio_geterrnum(mio) == MIO_EINVAL && mio_comp_oocstr_bcstr(mio_geterrmsg(mio), bad[i].msg, 0) == 0, "error location", bad[i].msg);
+		}
+	}
+
+	mio_json_close (json);
+	mio_close (mio);
+	return 0;
+
+oops:
+	if (json) mio_json_close (json);
+	if (mio) mio_close (mio);
+	return -1;
+}
@@ -0,0 +1,207 @@
+/* test the open-addressing hash table */
+
+#include <mio.h>
+#include <mio-hto.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include "t.h"
+
+#define NKEYS 5000
+
+static mio_oow_t bad_hash (const mio_hto_t* hto, const void* kptr, mio_oow_t klen)
+{
+	/* put all the keys in the same group with the same control code */
+	return 0;
+}
+
+static mio_hto_walk_t sum_values (mio_hto_t* hto, mio_hto_pair_t* pair, void* ctx)
+{
+	*(long*)ctx += *(int*)MIO_HTO_VPTR(pair);
+	return MIO_HTO_WALK_FORWARD;
+}
+
+static int check_int_table (mio_hto_t* hto, int nkeys)
+{
+	int i, x;
+	mio_hto_pair_t* pair;
+	mio_hto_itr_t itr;
+	mio_oow_t count;
+	long sum, expected_sum;
+
+	/* insert */
+	for (i = 0; i < nkeys; i++)
+	{
+		x = i * 3;
+		if (!mio_hto_insert(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x))) return -1;
+	}
+	if (mio_hto_getsize(hto) != nkeys) return -2;
+
+	/* a duplicate key is rejected by insert and returned by ensert */
+	x = -1;
+	if (mio_hto_insert(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x)) == MIO_NULL) return -3;
+	i = 7;
+	if (mio_hto_insert(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x)) != MIO_NULL) return -3;
+	pair = mio_hto_ensert(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x));
+	if (!pair || *(int*)MIO_HTO_VPTR(pair) != 21) return -3;
+	i = nkeys;
+	if (mio_hto_delete(hto, &i, MIO_SIZEOF(i)) <= -1) return -3;
+
+	/* search */
+	for (i = 0; i < nkeys; i++)
+	{
+		pair = mio_hto_search(hto, &i, MIO_SIZEOF(i));
+		if (!pair || *(int*)MIO_HTO_KPTR(pair) != i || *(int*)MIO_HTO_VPTR(pair) != i * 3) return -4;
+	}
+	i = nkeys;
+	if (mio_hto_search(hto, &i, MIO_SIZEOF(i))) return -4;
+
+	/* delete the odd keys. the slots left behind must not break the
+	 * probe sequences of the even keys */
+	for (i = 1; i < nkeys; i += 2)
+	{
+		if (mio_hto_delete(hto, &i, MIO_SIZEOF(i)) <= -1) return -5;
+	}
+	i = 1;
+	if (mio_hto_delete(hto, &i, MIO_SIZEOF(i)) >= 0) return -5;
+	if (mio_hto_getsize(hto) != (nkeys + 1) / 2) return -5;
+	for (i = 0; i < nkeys; i++)
+	{
+		pair = mio_hto_search(hto, &i, MIO_SIZEOF(i));
+		if ((i & 1) ? (pair != MIO_NULL): (!pair || *(int*)MIO_HTO_VPTR(pair) != i * 3)) return -6;
+	}
+
+	/* update the even keys and put back the odd keys with upsert */
+	for (i = 0; i < nkeys; i++)
+	{
+		x = i;
+		if (!mio_hto_upsert(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x))) return -7;
+	}
+	if (mio_hto_getsize(hto) != nkeys) return -7;
+	i = nkeys;
+	x = 0;
+	if (mio_hto_update(hto, &i, MIO_SIZEOF(i), &x, MIO_SIZEOF(x))) return -7;
+
+	/* the iterator and the walker visit every pair once */
+	count = 0;
+	sum = 0;
+	mio_init_hto_itr (&itr);
+	for (pair = mio_hto_getfirstpair(hto, &itr); pair; pair = mio_hto_getnextpair(hto, &itr))
+	{
+		count++;
+		sum += *(int*)MIO_HTO_VPTR(pair);
+	}
+	expected_sum = (long)nkeys * (nkeys - 1) / 2;
+	if (count != nkeys || sum != expected_sum) return -8;
+
+	sum = 0;
+	mio_hto_walk (hto, sum_values, &sum);
+	if (sum != expected_sum) return -8;
+
+	mio_hto_clear (hto);
+	if (mio_hto_getsize(hto) != 0) return -9;
+	i = 0;
+	if (mio_hto_search(hto, &i, MIO_SIZEOF(i))) return -9;
+
+	return 0;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	mio_hto_t* hto = MIO_NULL;
+	int n;
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	{
+		/* integer keys and values copied into the slots. the table grows
+		 * several times from the small initial capacity */
+		hto = mio_hto_open(mio, 0, 4, 1, 1);
+		T_ASSERT1 (hto != MIO_NULL, "hto open");
+		mio_hto_setstyle (hto, mio_get_hto_style(MIO_HTO_STYLE_INLINE_COPIERS));
+
+		n = check_int_table(hto, NKEYS);
+		if (n <= -1) printf ("check_int_table - %d\n", n);
+		T_ASSERT1 (n == 0, "inline integer pairs");
+		T_ASSERT1 (mio_hto_getcapa(hto) >= NKEYS && mio_hto_getcapa(hto) % 16 == 0, "capacity");
+
+		/* the table is usable again after clearing */
+		n = check_int_table(hto, NKEYS / 2);
+		T_ASSERT1 (n == 0, "inline integer pairs after clearing");
+
+		mio_hto_close (hto);
+		hto = MIO_NULL;
+	}
+
+	{
+		/* every key has the same hash value */
+		static mio_hto_style_t style;
+
+		style = *mio_get_hto_style(MIO_HTO_STYLE_INLINE_COPIERS);
+		style.hasher = bad_hash;
+
+		hto = mio_hto_open(mio, 0, 0, 1, 1);
+		T_ASSERT1 (hto != MIO_NULL, "hto open");
+		mio_hto_setstyle (hto, &style);
+
+		n = check_int_table(hto, 300);
+		if (n <= -1) printf ("check_int_table - %d\n", n);
+		T_ASSERT1 (n == 0, "colliding integer pairs");
+
+		mio_hto_close (hto);
+		hto = MIO_NULL;
+	}
+
+	{
+		/* string keys longer and shorter than the inline buffer */
+		static const char* keys[] =
+		{
+			"a", "bb", "ccc", "short key",
+			"a key that is too long to fit in the inline buffer of a slot",
+			"another key that is too long to fit in the inline buffer of a slot"
+		};
+		char buf[128];
+		mio_hto_pair_t* pair;
+		int i, j;
+
+		hto = mio_hto_open(mio, 0, 0, 1, 1);
+		T_ASSERT1 (hto != MIO_NULL, "hto open");
+		mio_hto_setstyle (hto, mio_get_hto_style(MIO_HTO_STYLE_INLINE_COPIERS));
+
+		for (j = 0; j < 100; j++)
+		{
+			for (i = 0; i < MIO_COUNTOF(keys); i++)
+			{
+				snprintf (buf, MIO_COUNTOF(buf), "%s-%d", keys[i], j);
+				T_ASSERT1 (mio_hto_insert(hto, buf, strlen(buf), &j, MIO_SIZEOF(j)) != MIO_NULL, "insert string key");
+			}
+		}
+		T_ASSERT1 (mio_hto_getsize(hto) == MIO_COUNTOF(keys) * 100, "string key count");
+
+		/* the copied keys survive the growth of the table and the
+		 * change of the caller's buffer */
+		memset (buf, 0, MIO_SIZEOF(buf));
+		for (j = 0; j < 100; j++)
+		{
+			for (i = 0; i < MIO_COUNTOF(keys); i++)
+			{
+				snprintf (buf, MIO_COUNTOF(buf), "%s-%d", keys[i], j);
+				pair = mio_hto_search(hto, buf, strlen(buf));
+				T_ASSERT1 (pair && MIO_HTO_KLEN(pair) == strlen(buf) && memcmp(MIO_HTO_KPTR(pair), buf, strlen(buf)) == 0 && *(int*)MIO_HTO_VPTR(pair) == j, "search string key");
+			}
+		}
+
+		mio_hto_close (hto);
+		hto = MIO_NULL;
+	}
+
+	mio_close (mio);
+	return 0;
+
+oops:
+	if (hto) mio_hto_close (hto);
+	if (mio) mio_close (mio);
+	return -1;
+}
@@ -0,0 +1,152 @@
+/* test the switch of the default hasher of mio_htb_t to the keyed hash */
+
+#include <mio.h>
+#include <mio-htb.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include "t.h"
+
+#define CAPA 64
+#define NKEYS 40
+
+static mio_oow_t keep_capa (mio_htb_t* htb, mio_oow_t hint)
+{
+	/* never grow the bucket */
+	return htb->capa;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	mio_t* mio2 = MIO_NULL;
+	mio_htb_t* htb = MIO_NULL;
+	mio_htb_t* htb2 = MIO_NULL;
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	{
+		/* keys falling in the same bucket under the unkeyed hash make a
+		 * long chain. the table switches to the keyed hash */
+		static char keys[NKEYS][16];
+		mio_htb_pair_t* pair;
+		mio_oow_t nkeys, n, i, max_chain, chain;
+		mio_htb_pair_t* p;
+		static mio_htb_style_t style;
+
+		/* the sizer keeps the capacity fixed */
+		style = *mio_get_htb_style(MIO_HTB_STYLE_INLINE_COPIERS);
+		style.sizer = keep_capa;
+
+		htb = mio_htb_open(mio, 0, CAPA, 70, 1, 1);
+		T_ASSERT1 (htb != MIO_NULL, "htb open");
+		mio_htb_setstyle (htb, &style);
+		T_ASSERT1 (!htb->keyed, "unkeyed at the beginning");
+
+		for (nkeys = 0, n = 0; nkeys < NKEYS; n++)
+		{
+			snprintf (keys[nkeys], MIO_COUNTOF(keys[nkeys]), "key-%lu", (unsigned long)n);
+			if (mio_htb_dflhash(htb, keys[nkeys], strlen(keys[nkeys])) % CAPA == 0) nkeys++;
+		}
+
+		for (i = 0; i < NKEYS; i++)
+		{
+			T_ASSERT1 (mio_htb_insert(htb, keys[i], strlen(keys[i]), &i, MIO_SIZEOF(i)) != MIO_NULL, "insert colliding key");
+		}
+
+		T_ASSERT1 (htb->keyed, "switch to the keyed hash");
+		T_ASSERT1 (MIO_HTB_SIZE(htb) == NKEYS && MIO_HTB_CAPA(htb) == CAPA, "size and capacity after switch");
+		T_ASSERT1 (mio_htb_dflhash(htb, keys[0], strlen(keys[0])) == mio_htb_keyedhash(htb, keys[0], strlen(keys[0])), "default hasher delegating to the keyed hash");
+
+		/* the pairs are spread over the buckets after rehashing */
+		max_chain = 0;
+		for (i = 0; i < CAPA; i++)
+		{
+			for (chain = 0, p = htb->bucket[i]; p; p = p->next) chain++;
+			if (chain > max_chain) max_chain = chain;
+		}
+		T_ASSERT1 (max_chain < NKEYS, "chains after rehashing");
+
+		/* every key is still found after rehashing */
+		for (i = 0; i < NKEYS; i++)
+		{
+			pair = mio_htb_search(htb, keys[i], strlen(keys[i]));
+			T_ASSERT1 (pair && *(mio_oow_t*)MIO_HTB_VPTR(pair) == i, "search after switch");
+		}
+
+		/* and after deletion of some */
+		for (i = 0; i < NKEYS; i += 2)
+		{
+			T_ASSERT1 (mio_htb_delete(htb, keys[i], strlen(keys[i])) == 0, "delete after switch");
+		}
+		for (i = 0; i < NKEYS; i++)
+		{
+			pair = mio_htb_search(htb, keys[i], strlen(keys[i]));
+			T_ASSERT1 ((i & 1)? (pair && *(mio_oow_t*)MIO_HTB_VPTR(pair) == i): (pair == MIO_NULL), "search after deletion");
+		}
+
+		mio_htb_close (htb);
+		htb = MIO_NULL;
+	}
+
+	{
+		/* ordinary keys in a growing table don't trigger the switch */
+		char key[32];
+		mio_oow_t i;
+
+		htb = mio_htb_open(mio, 0, 16, 70, 1, 1);
+		T_ASSERT1 (htb != MIO_NULL, "htb open");
+		mio_htb_setstyle (htb, mio_get_htb_style(MIO_HTB_STYLE_INLINE_COPIERS));
+
+		for (i = 0; i < 20000; i++)
+		{
+			snprintf (key, MIO_COUNTOF(key), "X-Header-%lu", (unsigned long)i);
+			T_ASSERT1 (mio_htb_insert(htb, key, strlen(key), &i, MIO_SIZEOF(i)) != MIO_NULL, "insert ordinary key");
+		}
+		T_ASSERT1 (!htb->keyed, "no switch for ordinary keys");
+
+		mio_htb_close (htb);
+		htb = MIO_NULL;
+	}
+
+	{
+		/* the keyed styles hash with the random key of each mio_t object */
+		static const char* key = "Content-Length";
+		mio_htb_pair_t* pair;
+		mio_oow_t v = 99;
+
+		mio2 = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio2 != MIO_NULL, "mio open");
+
+		htb = mio_htb_open(mio, 0, 16, 70, 1, 1);
+		htb2 = mio_htb_open(mio2, 0, 16, 70, 1, 1);
+		T_ASSERT1 (htb != MIO_NULL && htb2 != MIO_NULL, "htb open");
+		mio_htb_setstyle (htb, mio_get_htb_style(MIO_HTB_STYLE_INLINE_COPIERS_KEYED));
+		mio_htb_setstyle (htb2, mio_get_htb_style(MIO_HTB_STYLE_INLINE_COPIERS_KEYED));
+
+		T_ASSERT1 (mio_htb_keyedhash(htb, key, strlen(key)) == mio_htb_keyedhash(htb, key, strlen(key)), "stable keyed hash");
+		T_ASSERT1 (mio_htb_keyedhash(htb, key, strlen(key)) != mio_htb_keyedhash(htb2, key, strlen(key)), "keyed hash per mio object");
+
+		T_ASSERT1 (mio_htb_insert(htb, (void*)key, strlen(key), &v, MIO_SIZEOF(v)) != MIO_NULL, "insert with the keyed style");
+		pair = mio_htb_search(htb, key, strlen(key));
+		T_ASSERT1 (pair && *(mio_oow_t*)MIO_HTB_VPTR(pair) == 99, "search with the keyed style");
+
+		mio_htb_close (htb2);
+		htb2 = MIO_NULL;
+		mio_htb_close (htb);
+		htb = MIO_NULL;
+		mio_close (mio2);
+		mio2 = MIO_NULL;
+	}
+
+	mio_close (mio);
+	return 0;
+
+oops:
+	if (htb2) mio_htb_close (htb2);
+	if (htb) mio_htb_close (htb);
+	if (mio2) mio_close (mio2);
+	if (mio) mio_close (mio);
+	return -1;
+}
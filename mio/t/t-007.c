@@ -0,0 +1,294 @@
+/* test the dns packet cursor */
+
+#include <mio.h>
+#include <mio-dns.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "t.h"
+
+/* walk through all the records of a packet. it returns the number of
+ * records visited or -1 if the packet is found malformed */
+static int walk_pkt (const mio_uint8_t* pkt, mio_oow_t len)
+{
+	mio_dns_pkt_cur_t cur;
+	mio_dns_pkt_edns_t edns;
+	mio_dns_cqr_t qr;
+	mio_dns_crr_t rr;
+	mio_dns_brr_t brr;
+	union
+	{
+		mio_dns_brrd_soa_t soa; /* for alignment */
+		mio_uint8_t b[MIO_DNS_CRR_DECODE_BUF_LEN];
+	} rrbuf;
+	mio_bch_t name[256];
+	int n, count = 0;
+
+	if (mio_dns_init_pkt_cur(&cur, (const mio_dns_pkt_t*)pkt, len) <= -1) return -1;
+	if (mio_dns_get_edns_in_pkt_cur(&cur, &edns) <= -1) return -1;
+
+	while ((n = mio_dns_next_qr_in_pkt_cur(&cur, &qr)) > 0)
+	{
+		if (mio_dns_decode_name_in_pkt_cur(&cur, qr.qnameoff, name, MIO_COUNTOF(name), MIO_NULL) <= -1) return -1;
+		count++;
+	}
+	if (n <= -1) return -1;
+
+	while ((n = mio_dns_next_rr_in_pkt_cur(&cur, &rr)) > 0)
+	{
+		if (mio_dns_decode_rr_in_pkt_cur(&cur, &rr, &brr, &rrbuf, MIO_SIZEOF(rrbuf)) <= -1) return -1;
+		count++;
+	}
+	if (n <= -1) return -1;
+
+	return count;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	mio_dns_msg_t* msg = MIO_NULL;
+	mio_dns_pkt_info_t* pi = MIO_NULL;
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	{
+		/* walk through a packet built with mio_dns_make_msg() */
+		mio_dns_bhdr_t bhdr;
+		mio_dns_bqr_t qr;
+		mio_dns_brr_t rr[5];
+		mio_dns_bedns_t edns;
+		mio_dns_beopt_t beopt;
+		mio_dns_brrd_mx_t mx;
+		mio_dns_brrd_soa_t soa;
+		mio_uint8_t a[4] = { 1, 2, 3, 4 };
+		mio_uint8_t a2[4] = { 5, 6, 7, 8 };
+		mio_uint8_t cookie[24];
+		static mio_dns_rr_part_t parts[] = { MIO_DNS_RR_PART_ANSWER, MIO_DNS_RR_PART_ANSWER, MIO_DNS_RR_PART_ANSWER, MIO_DNS_RR_PART_AUTHORITY, MIO_DNS_RR_PART_ADDITIONAL };
+
+		mio_dns_pkt_cur_t cur, saved;
+		mio_dns_pkt_edns_t pedns;
+		mio_dns_cqr_t cqr;
+		mio_dns_crr_t crr;
+		mio_dns_brr_t brr;
+		union
+		{
+			mio_dns_brrd_soa_t soa; /* for alignment */
+			mio_uint8_t b[MIO_DNS_CRR_DECODE_BUF_LEN];
+		} rrbuf;
+		mio_bch_t name[256];
+		mio_oow_t i, endoff;
+		int n;
+
+		memset (&bhdr, 0, MIO_SIZEOF(bhdr));
+		bhdr.id = 0x1234;
+		bhdr.qr = 1;
+		bhdr.rd = 1;
+		bhdr.ra = 1;
+		bhdr.rcode = MIO_DNS_RCODE_NOERROR;
+
+		qr.qname = "www.example.org";
+		qr.qtype = MIO_DNS_RRT_A;
+		qr.qclass = MIO_DNS_RRC_IN;
+
+		memset (rr, 0, MIO_SIZEOF(rr));
+		rr[0].part = MIO_DNS_RR_PART_ANSWER;
+		rr[0].rrname = "www.example.org";
+		rr[0].rrtype = MIO_DNS_RRT_CNAME;
+		rr[0].rrclass = MIO_DNS_RRC_IN;
+		rr[0].ttl = 3600;
+		rr[0].dptr = "web.example.org";
+		rr[0].dlen = strlen(rr[0].dptr);
+
+		rr[1].part = MIO_DNS_RR_PART_ANSWER;
+		rr[1].rrname = "web.example.org";
+		rr[1].rrtype = MIO_DNS_RRT_A;
+		rr[1].rrclass = MIO_DNS_RRC_IN;
+		rr[1].ttl = 100;
+		rr[1].dptr = a;
+		rr[1].dlen = MIO_SIZEOF(a);
+
+		mx.preference = 10;
+		mx.exchange = "mail.example.org";
+		rr[2].part = MIO_DNS_RR_PART_ANSWER;
+		rr[2].rrname = "example.org";
+		rr[2].rrtype = MIO_DNS_RRT_MX;
+		rr[2].rrclass = MIO_DNS_RRC_IN;
+		rr[2].ttl = 200;
+		rr[2].dptr = &mx;
+		rr[2].dlen = MIO_SIZEOF(mx);
+
+		soa.mname = "ns.example.org";
+		soa.rname = "admin.example.org";
+		soa.serial = 2024010101;
+		soa.refresh = 7200;
+		soa.retry = 900;
+		soa.expire = 1209600;
+		soa.minimum = 300;
+		rr[3].part = MIO_DNS_RR_PART_AUTHORITY;
+		rr[3].rrname = "example.org";
+		rr[3].rrtype = MIO_DNS_RRT_SOA;
+		rr[3].rrclass = MIO_DNS_RRC_IN;
+		rr[3].ttl = 400;
+		rr[3].dptr = &soa;
+		rr[3].dlen = MIO_SIZEOF(soa);
+
+		rr[4].part = MIO_DNS_RR_PART_ADDITIONAL;
+		rr[4].rrname = "mail.example.org";
+		rr[4].rrtype = MIO_DNS_RRT_A;
+		rr[4].rrclass = MIO_DNS_RRC_IN;
+		rr[4].ttl = 500;
+		rr[4].dptr = a2;
+		rr[4].dlen = MIO_SIZEOF(a2);
+
+		for (i = 0; i < MIO_COUNTOF(cookie); i++) cookie[i] = (mio_uint8_t)(i + 1);
+		beopt.code = MIO_DNS_EOPT_COOKIE;
+		beopt.dlen = MIO_SIZEOF(cookie);
+		beopt.dptr = cookie;
+
+		memset (&edns, 0, MIO_SIZEOF(edns));
+		edns.uplen = 4096;
+		edns.dnssecok = 1;
+		edns.beonum = 1;
+		edns.beoptr = &beopt;
+
+		msg = mio_dns_make_msg(mio, &bhdr, &qr, 1, rr, MIO_COUNTOF(rr), &edns, 0);
+		T_ASSERT1 (msg != MIO_NULL, "make dns message");
+
+		T_ASSERT1 (mio_dns_init_pkt_cur(&cur, mio_dns_msg_to_pkt(msg), msg->pktlen) == 0, "init cursor");
+		T_ASSERT1 (cur.hdr.id == 0x1234 && cur.hdr.qr == 1 && cur.hdr.rd == 1 && cur.hdr.ra == 1 && cur.hdr.rcode == MIO_DNS_RCODE_NOERROR, "header");
+		T_ASSERT1 (cur.qdcount == 1 && cur.ancount == 3 && cur.nscount == 1 && cur.arcount == 2, "record counts");
+
+		T_ASSERT1 (mio_dns_get_edns_in_pkt_cur(&cur, &pedns) == 0, "get edns");
+		T_ASSERT1 (pedns.exist && pedns.uplen == 4096 && pedns.dnssecok == 1 && pedns.version == 0, "edns fields");
+		T_ASSERT1 (pedns.cookie.client_len == MIO_DNS_COOKIE_CLIENT_LEN && pedns.cookie.server_len == MIO_SIZEOF(cookie) - MIO_DNS_COOKIE_CLIENT_LEN, "cookie lengths");
+		T_ASSERT1 (memcmp(&pedns.cookie.data, cookie, MIO_SIZEOF(cookie)) == 0, "cookie data");
+
+		T_ASSERT1 (mio_dns_next_qr_in_pkt_cur(&cur, &cqr) == 1, "question");
+		T_ASSERT1 (cqr.qtype == MIO_DNS_RRT_A && cqr.qclass == MIO_DNS_RRC_IN, "question type and class");
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, cqr.qnameoff, name, MIO_COUNTOF(name), &endoff) == 15 && strcmp(name, "www.example.org") == 0, "question name");
+		T_ASSERT1 (endoff == cqr.qnameoff + 17, "end of question name");
+		T_ASSERT1 (mio_dns_next_qr_in_pkt_cur(&cur, &cqr) == 0, "no more questions");
+
+		/* the opt record is reported as an additional record too */
+		for (i = 0; (n = mio_dns_next_rr_in_pkt_cur(&cur, &crr)) > 0; i++)
+		{
+			if (i == 1) saved = cur;
+			if (i >= MIO_COUNTOF(rr))
+			{
+				T_ASSERT1 (crr.part == MIO_DNS_RR_PART_ADDITIONAL && crr.rrtype == MIO_DNS_RRT_OPT, "opt record");
+				continue;
+			}
+
+			T_ASSERT1 (crr.part == parts[i] && crr.rrtype == rr[i].rrtype && crr.rrclass == rr[i].rrclass && crr.ttl == rr[i].ttl, "record fields");
+			T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, crr.rrnameoff, name, MIO_COUNTOF(name), MIO_NULL) >= 0 && strcmp(name, rr[i].rrname) == 0, "record name");
+
+			T_ASSERT1 (mio_dns_decode_rr_in_pkt_cur(&cur, &crr, &brr, &rrbuf, MIO_SIZEOF(rrbuf)) == 0, "decode record");
+			T_ASSERT1 (brr.part == parts[i] && brr.rrtype == rr[i].rrtype && brr.ttl == rr[i].ttl && strcmp(brr.rrname, rr[i].rrname) == 0, "decoded record fields");
+			switch (brr.rrtype)
+			{
+				case MIO_DNS_RRT_A:
+					T_ASSERT1 (brr.dlen == 4 && memcmp(brr.dptr, rr[i].dptr, 4) == 0, "decoded A data");
+					break;
+
+				case MIO_DNS_RRT_CNAME:
+					T_ASSERT1 (strcmp((const char*)brr.dptr, (const char*)rr[i].dptr) == 0, "decoded CNAME data");
+					break;
+
+				case MIO_DNS_RRT_MX:
+				{
+					const mio_dns_brrd_mx_t* dmx = (const mio_dns_brrd_mx_t*)brr.dptr;
+					T_ASSERT1 (dmx->preference == 10 && strcmp(dmx->exchange, "mail.example.org") == 0, "decoded MX data");
+					break;
+				}
+
+				case MIO_DNS_RRT_SOA:
+				{
+					const mio_dns_brrd_soa_t* dsoa = (const mio_dns_brrd_soa_t*)brr.dptr;
+					T_ASSERT1 (strcmp(dsoa->mname, soa.mname) == 0 && strcmp(dsoa->rname, soa.rname) == 0, "decoded SOA names");
+					T_ASSERT1 (dsoa->serial == soa.serial && dsoa->refresh == soa.refresh && dsoa->retry == soa.retry && dsoa->expire == soa.expire && dsoa->minimum == soa.minimum, "decoded SOA numbers");
+					break;
+				}
+			}
+		}
+		T_ASSERT1 (n == 0 && i == MIO_COUNTOF(rr) + 1, "number of records");
+
+		/* a copied cursor resumes from the position copied */
+		T_ASSERT1 (mio_dns_next_rr_in_pkt_cur(&saved, &crr) == 1 && crr.rrtype == MIO_DNS_RRT_MX, "copied cursor");
+
+		/* the cursor agrees with mio_dns_make_pkt_info() */
+		pi = mio_dns_make_pkt_info(mio, mio_dns_msg_to_pkt(msg), msg->pktlen);
+		T_ASSERT1 (pi != MIO_NULL, "make packet info");
+		T_ASSERT1 (pi->ancount == cur.ancount && pi->nscount == cur.nscount && pi->edns.uplen == pedns.uplen && pi->edns.cookie.server_len == pedns.cookie.server_len, "packet info");
+		mio_dns_free_pkt_info (mio, pi);
+		pi = MIO_NULL;
+
+		/* every truncated packet is rejected or walked partially
+		 * without reading beyond its end */
+		for (i = 0; i < msg->pktlen; i++)
+		{
+			mio_uint8_t* tmp = (mio_uint8_t*)malloc(i + 1);
+			T_ASSERT1 (tmp != MIO_NULL, "memory allocation");
+			memcpy (tmp, mio_dns_msg_to_pkt(msg), i);
+			n = walk_pkt(tmp, i);
+			free (tmp);
+			T_ASSERT1 (n <= -1, "truncated packet");
+		}
+		T_ASSERT1 (walk_pkt((const mio_uint8_t*)mio_dns_msg_to_pkt(msg), msg->pktlen) == 1 + MIO_COUNTOF(rr) + 1, "whole packet");
+
+		mio_dns_free_msg (mio, msg);
+		msg = MIO_NULL;
+	}
+
+	{
+		/* compressed names */
+		static mio_uint8_t pkt[] =
+		{
+			0x00, 0x01, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+			/* 12: question www.example.org A IN */
+			3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'o', 'r', 'g', 0, 0x00, 0x01, 0x00, 0x01,
+			/* 33: answer - name pointing to 12. CNAME to web + pointer to 16 */
+			0xC0, 12, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x06,
+			3, 'w', 'e', 'b', 0xC0, 16
+		};
+		mio_dns_pkt_cur_t cur;
+		mio_dns_crr_t crr;
+		mio_dns_brr_t brr;
+		union
+		{
+			mio_dns_brrd_soa_t soa; /* for alignment */
+			mio_uint8_t b[MIO_DNS_CRR_DECODE_BUF_LEN];
+		} rrbuf;
+		mio_bch_t name[256];
+		mio_oow_t endoff;
+
+		T_ASSERT1 (mio_dns_init_pkt_cur(&cur, (const mio_dns_pkt_t*)pkt, MIO_SIZEOF(pkt)) == 0, "init cursor");
+		T_ASSERT1 (mio_dns_next_rr_in_pkt_cur(&cur, &crr) == 1, "skip the question and get the answer");
+		T_ASSERT1 (crr.rrnameoff == 33 && crr.rrtype == MIO_DNS_RRT_CNAME && crr.ttl == 60 && crr.dlen == 6, "answer fields");
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, crr.rrnameoff, name, MIO_COUNTOF(name), &endoff) == 15 && strcmp(name, "www.example.org") == 0 && endoff == 35, "compressed name");
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, 45, name, MIO_COUNTOF(name), MIO_NULL) == 15 && strcmp(name, "web.example.org") == 0, "partly compressed name");
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, 45, name, 8, MIO_NULL) <= -1, "small buffer");
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, 45, MIO_NULL, 0, MIO_NULL) == 15, "validation without buffer");
+		T_ASSERT1 (mio_dns_decode_rr_in_pkt_cur(&cur, &crr, &brr, &rrbuf, MIO_SIZEOF(rrbuf)) == 0 && strcmp((const char*)brr.dptr, "web.example.org") == 0, "decoded CNAME data");
+		T_ASSERT1 (mio_dns_next_rr_in_pkt_cur(&cur, &crr) == 0, "no more records");
+
+		/* a pointer loop */
+		pkt[45] = 0xC0;
+		pkt[46] = 49;
+		pkt[49] = 0xC0;
+		pkt[50] = 45;
+		T_ASSERT1 (mio_dns_decode_name_in_pkt_cur(&cur, 45, name, MIO_COUNTOF(name), MIO_NULL) <= -1, "pointer loop");
+		T_ASSERT1 (walk_pkt(pkt, MIO_SIZEOF(pkt)) <= -1, "packet with a pointer loop");
+	}
+
+	mio_close (mio);
+	return 0;
+
+oops:
+	if (pi) mio_dns_free_pkt_info (mio, pi);
+	if (msg) mio_dns_free_msg (mio, msg);
+	if (mio) mio_close (mio);
+	return -1;
+}
@@ -0,0 +1,228 @@
+/* test forwarding data between stream sockets with mio_dev_forward() */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include "t.h"
+#include "t-sck.h"
+
+#define FWD_LEN (4 * 1024 * 1024 + 123)
+#define TAIL_LEN (1000)
+
+#define ROLE_SRC 1
+#define ROLE_DST 2
+
+typedef struct sck_xtn_t sck_xtn_t;
+struct sck_xtn_t
+{
+	int role;
+};
+
+static mio_dev_sck_t* src = MIO_NULL;
+static mio_dev_sck_t* dst = MIO_NULL;
+static mio_iolen_t forwarded = 0;
+static int forward_done = 0;
+static mio_oow_t tail_read = 0;
+static int tail_ok = 1;
+static int src_eof = 0;
+static int failed = 0;
+
+/* send the data to be forwarded followed by the tail data to be read */
+static int run_writer (t_peer_t* peer, int port)
+{
+	mio_uint8_t buf[8192];
+	mio_oow_t pos, i, n;
+	ssize_t x;
+	int fd;
+
+	fd = t_connect_to(port);
+	if (fd <= -1) return 1;
+
+	for (pos = 0; pos < FWD_LEN + TAIL_LEN; pos += n)
+	{
+		n = FWD_LEN + TAIL_LEN - pos;
+		if (n > sizeof(buf)) n = sizeof(buf);
+		for (i = 0; i < n; i++) buf[i] = t_pattern(pos + i);
+		x = write(fd, buf, n);
+		if (x <= 0) return 1;
+		n = x;
+	}
+
+	shutdown (fd, SHUT_WR);
+	while (read(fd, buf, sizeof(buf)) > 0) /* wait for the peer to close */;
+	close (fd);
+	return 0;
+}
+
+/* receive the data forwarded and check it */
+static int run_reader (t_peer_t* peer, int port)
+{
+	mio_uint8_t buf[8192];
+	mio_oow_t pos, i;
+	ssize_t x;
+	int fd;
+
+	fd = t_connect_to(port);
+	if (fd <= -1) return 1;
+
+	pos = 0;
+	while ((x = read(fd, buf, sizeof(buf))) > 0)
+	{
+		for (i = 0; i < (mio_oow_t)x; i++)
+		{
+			if (buf[i] != t_pattern(pos + i)) return 2;
+		}
+		pos += x;
+	}
+
+	close (fd);
+	return (x == 0 && pos == FWD_LEN)? 0: 3;
+}
+
+static int on_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_iolen_t i;
+
+	if (xtn->role != ROLE_SRC)
+	{
+		failed = 1;
+		return 0;
+	}
+
+	if (dlen <= 0)
+	{
+		src_eof = 1;
+		mio_dev_sck_halt (dev);
+		return 0;
+	}
+
+	/* the data after the forwarded part must come to on_read. it may come
+	 * before the on_write callback of the destination as the source is 
+	 * released once the last byte to forward has been moved to the pipe */
+	for (i = 0; i < dlen; i++)
+	{
+		if (((const mio_uint8_t*)data)[i] != t_pattern(FWD_LEN + tail_read + i)) tail_ok = 0;
+	}
+	tail_read += dlen;
+	return 0;
+}
+
+static int on_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	if (dev != dst || wrctx != (void*)&forwarded)
+	{
+		failed = 1;
+		return 0;
+	}
+
+	forwarded = wrlen;
+	forward_done = 1;
+	/* close the destination so that the reader sees EOF */
+	mio_dev_sck_halt (dev);
+	return 0;
+}
+
+static void on_connect (mio_dev_sck_t* dev)
+{
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	if (!(dev->state & MIO_DEV_SCK_ACCEPTED)) return;
+
+	if (xtn->role == ROLE_SRC)
+	{
+		/* don't read until the forwarding request is posted */
+		src = dev;
+		mio_dev_sck_read (dev, 0);
+	}
+	else
+	{
+		dst = dev;
+	}
+
+	if (src && dst)
+	{
+		T_ASSERT1 (mio_dev_sck_forward(dst, (mio_dev_t*)src, FWD_LEN, &forwarded) == 0, "forward");
+		T_ASSERT1 (mio_dev_sck_forward(dst, (mio_dev_t*)src, FWD_LEN, &forwarded) <= -1, "second forward from the same source");
+		mio_dev_sck_read (src, 1);
+	}
+	return;
+
+oops:
+	failed = 1;
+	mio_stop (mio_dev_sck_getmio(dev), MIO_STOPREQ_TERMINATION);
+}
+
+static void on_disconnect (mio_dev_sck_t* dev)
+{
+	if (dev == src) src = MIO_NULL;
+	else if (dev == dst) dst = MIO_NULL;
+	if (src_eof && forward_done && !src && !dst) mio_stop (mio_dev_sck_getmio(dev), MIO_STOPREQ_TERMINATION);
+}
+
+static mio_dev_sck_t* make_listener (mio_t* mio, int role, int* port)
+{
+	mio_dev_sck_make_t mkinfo;
+	mio_dev_sck_t* sck;
+
+	memset (&mkinfo, 0, MIO_SIZEOF(mkinfo));
+	mkinfo.type = MIO_DEV_SCK_TCP4;
+	mkinfo.on_write = on_write;
+	mkinfo.on_read = on_read;
+	mkinfo.on_connect = on_connect;
+	mkinfo.on_disconnect = on_disconnect;
+	sck = t_make_listener(mio, &mkinfo, MIO_NULL, MIO_SIZEOF(sck_xtn_t), port);
+	if (sck) ((sck_xtn_t*)mio_dev_sck_getxtn(sck))->role = role;
+	return sck;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	t_peer_t writer = { -1 }, reader = { -1 };
+
+	signal (SIGPIPE, SIG_IGN);
+
+	{
+		mio_dev_sck_t* lsrc, * ldst;
+		int src_port, dst_port;
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+		lsrc = make_listener(mio, ROLE_SRC, &src_port);
+		ldst = make_listener(mio, ROLE_DST, &dst_port);
+		T_ASSERT1 (lsrc && ldst, "listeners");
+
+		T_ASSERT1 (t_peer_start(&writer, run_writer, src_port) == 0, "fork writer");
+		T_ASSERT1 (t_peer_start(&reader, run_reader, dst_port) == 0, "fork reader");
+
+		alarm (20);
+		mio_loop (mio);
+
+		mio_close (mio);
+		mio = MIO_NULL;
+
+		printf ("forwarded %ld bytes, read %lu bytes after forwarding\n", (long)forwarded, (unsigned long)tail_read);
+		T_ASSERT1 (!failed, "unexpected event");
+		T_ASSERT1 (forward_done && forwarded == FWD_LEN, "length forwarded");
+		T_ASSERT1 (tail_read == TAIL_LEN && tail_ok, "data read after forwarding");
+		T_ASSERT1 (src_eof, "EOF on the source");
+
+		T_ASSERT1 (t_peer_join(&reader) == 0, "data forwarded");
+		T_ASSERT1 (t_peer_join(&writer) == 0, "writer");
+	}
+
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	t_peer_kill (&writer);
+	t_peer_kill (&reader);
+	return -1;
+}
@@ -0,0 +1,202 @@
+/* test the write queue watermarks of a device */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include "t.h"
+#include "t-sck.h"
+
+#define CHUNK_LEN (65536 + 17)
+#define HIGH_WMARK (256 * 1024)
+#define LOW_WMARK (64 * 1024)
+#define MAX_WRITE_LEN (256 * 1024 * 1024)
+
+static t_peer_t reader = { -1 };
+static mio_uint8_t chunk[CHUNK_LEN];
+
+static mio_oow_t written = 0; /* bytes requested for writing */
+static mio_oow_t completed = 0; /* bytes reported to on_write */
+static int pressure_count = 0;
+static int drain_count = 0;
+static int writing_done = 0;
+static int failed = 0;
+static mio_oow_t max_wq_bytes = 0;
+static mio_oow_t wq_bytes_at_drain = 0;
+static mio_oow_t wq_bytes_at_end = 1;
+static int in_disabled_at_pressure = 0;
+static int in_disabled_after_drain = 1;
+
+/* don't read until told to, then read all and report the number of bytes */
+static int run_reader (t_peer_t* peer, int port)
+{
+	mio_uint8_t buf[16384];
+	unsigned long total = 0;
+	char tmp[64];
+	ssize_t x;
+	int fd;
+
+	fd = t_connect_to(port);
+	if (fd <= -1) return 1;
+
+	if (t_peer_wait(peer) <= -1) return 2;
+	while ((x = read(fd, buf, sizeof(buf))) > 0) total += x;
+	close (fd);
+
+	snprintf (tmp, sizeof(tmp), "%lu", total);
+	if (t_peer_send(peer, tmp, strlen(tmp)) <= -1) return 3;
+	return 0;
+}
+
+static int on_pressure (mio_dev_t* dev, void* ctx)
+{
+	pressure_count++;
+	if (dev->wq_bytes > max_wq_bytes) max_wq_bytes = dev->wq_bytes;
+
+	/* stop reading from the device, which is a common use */
+	if (mio_dev_wmark_pausereader(dev, ctx) <= -1) return -1;
+	in_disabled_at_pressure = !!(dev->dev_cap & MIO_DEV_CAP_IN_DISABLED);
+
+	/* let the reader drain the data */
+	if (t_peer_post(&reader) <= -1) return -1;
+	return 0;
+}
+
+static int on_drain (mio_dev_t* dev, void* ctx)
+{
+	drain_count++;
+	wq_bytes_at_drain = dev->wq_bytes;
+	if (mio_dev_wmark_resumereader(dev, ctx) <= -1) return -1;
+	in_disabled_after_drain = !!(dev->dev_cap & MIO_DEV_CAP_IN_DISABLED);
+	return 0;
+}
+
+static int on_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	/* EOF from the reader that has received everything */
+	if (dlen > 0) failed = 1;
+	return 0;
+}
+
+static int on_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	if (wrlen <= -1)
+	{
+		failed = 1;
+		mio_dev_sck_halt (dev);
+		return 0;
+	}
+
+	completed += wrlen;
+	if (writing_done && completed == written)
+	{
+		wq_bytes_at_end = dev->wq_bytes;
+		mio_dev_sck_halt (dev);
+	}
+	return 0;
+}
+
+static void on_connect (mio_dev_sck_t* dev)
+{
+	mio_dev_wmark_t wmark;
+
+	if (!(dev->state & MIO_DEV_SCK_ACCEPTED)) return;
+
+	memset (&wmark, 0, MIO_SIZEOF(wmark));
+	wmark.high = HIGH_WMARK;
+	wmark.low = LOW_WMARK;
+	wmark.on_pressure = on_pressure;
+	wmark.on_drain = on_drain;
+	wmark.ctx = dev;
+	mio_dev_setwmark ((mio_dev_t*)dev, &wmark);
+
+	/* write until the queue comes under pressure. the kernel takes some
+	 * data before anything is queued */
+	while (!pressure_count && written < MAX_WRITE_LEN)
+	{
+		if (mio_dev_sck_write(dev, chunk, CHUNK_LEN, MIO_NULL, MIO_NULL) <= -1)
+		{
+			failed = 1;
+			break;
+		}
+		written += CHUNK_LEN;
+	}
+
+	/* write a little more under pressure. it is still queued */
+	if (mio_dev_sck_write(dev, chunk, 100, MIO_NULL, MIO_NULL) <= -1) failed = 1;
+	written += 100;
+	if (dev->wq_bytes > max_wq_bytes) max_wq_bytes = dev->wq_bytes;
+
+	writing_done = 1;
+	if (completed == written) mio_dev_sck_halt (dev);
+}
+
+static void on_disconnect (mio_dev_sck_t* dev)
+{
+	if (dev->state & MIO_DEV_SCK_ACCEPTED) mio_stop (mio_dev_sck_getmio(dev), MIO_STOPREQ_TERMINATION);
+}
+
+static mio_dev_sck_t* make_listener (mio_t* mio, int* port)
+{
+	mio_dev_sck_make_t mkinfo;
+
+	memset (&mkinfo, 0, MIO_SIZEOF(mkinfo));
+	mkinfo.type = MIO_DEV_SCK_TCP4;
+	mkinfo.on_write = on_write;
+	mkinfo.on_read = on_read;
+	mkinfo.on_connect = on_connect;
+	mkinfo.on_disconnect = on_disconnect;
+	return t_make_listener(mio, &mkinfo, MIO_NULL, 0, port);
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+
+	signal (SIGPIPE, SIG_IGN);
+	memset (chunk, 'A', MIO_SIZEOF(chunk));
+
+	{
+		int port;
+		char res[64];
+		ssize_t n;
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+		T_ASSERT1 (make_listener(mio, &port) != MIO_NULL, "listener");
+
+		T_ASSERT1 (t_peer_start(&reader, run_reader, port) == 0, "fork reader");
+
+		alarm (20);
+		mio_loop (mio);
+		mio_close (mio);
+		mio = MIO_NULL;
+
+		n = t_peer_recv(&reader, res, MIO_SIZEOF(res) - 1);
+		T_ASSERT1 (t_peer_join(&reader) == 0, "reader");
+		T_ASSERT1 (n > 0, "reader result");
+		res[n] = '\0';
+
+		printf ("written %lu, completed %lu, received %s, max queued %lu, queued at drain %lu\n",
+			(unsigned long)written, (unsigned long)completed, res, (unsigned long)max_wq_bytes, (unsigned long)wq_bytes_at_drain);
+
+		T_ASSERT1 (!failed, "unexpected event");
+		T_ASSERT1 (pressure_count == 1 && max_wq_bytes >= HIGH_WMARK, "on_pressure");
+		T_ASSERT1 (in_disabled_at_pressure, "reader paused");
+		T_ASSERT1 (drain_count == 1 && wq_bytes_at_drain <= LOW_WMARK, "on_drain");
+		T_ASSERT1 (!in_disabled_after_drain, "reader resumed");
+		T_ASSERT1 (completed == written && strtoul(res, MIO_NULL, 10) == written, "bytes written");
+		T_ASSERT1 (wq_bytes_at_end == 0, "queued bytes at the end");
+	}
+
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	t_peer_kill (&reader);
+	return -1;
+}
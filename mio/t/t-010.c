@@ -0,0 +1,223 @@
+/* test coalescing the data received in a row on a stream socket */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include "t.h"
+#include "t-sck.h"
+
+#define NCONNS 2
+/* the total stays below the initial receive window so that the writer
+ * finishes before the peer starts reading */
+#define NWRITES 1500
+#define WRITE_LEN 37
+
+/* the second connection pauses reading in on_read */
+#define CONN_PAUSE 1
+
+static t_peer_t writer = { -1 };
+static int nconns = 0;
+static int failed = 0;
+static mio_tmridx_t resume_tmridx = MIO_TMRIDX_INVALID;
+
+static struct
+{
+	mio_oow_t received;
+	int data_reads;
+	int eof_reads;
+	int order_ok;
+	int coalesce_cap;
+	int paused;
+	int resumed;
+	int eof_after_resume;
+} conns[NCONNS];
+
+typedef struct sck_xtn_t sck_xtn_t;
+struct sck_xtn_t
+{
+	int conn;
+};
+
+/* send many small pieces and close the writing end before the peer reads */
+static int run_writer (t_peer_t* peer, int port)
+{
+	mio_uint8_t buf[WRITE_LEN];
+	mio_oow_t pos, i;
+	int fd, c, n;
+
+	for (c = 0; c < NCONNS; c++)
+	{
+		fd = t_connect_to(port);
+		if (fd <= -1) return 1;
+
+		for (n = 0, pos = 0; n < NWRITES; n++, pos += WRITE_LEN)
+		{
+			for (i = 0; i < WRITE_LEN; i++) buf[i] = t_pattern(pos + i);
+			if (write(fd, buf, WRITE_LEN) != WRITE_LEN) return 2;
+		}
+		shutdown (fd, SHUT_WR);
+
+		/* let the peer start reading */
+		if (t_peer_post(peer) <= -1) return 3;
+
+		while (read(fd, buf, sizeof(buf)) > 0) /* wait for the peer to close */;
+		close (fd);
+	}
+
+	return 0;
+}
+
+static void resume_reading (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_dev_sck_t* dev = (mio_dev_sck_t*)job->ctx;
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	conns[xtn->conn].resumed = 1;
+	if (mio_dev_sck_read(dev, 1) <= -1) failed = 1;
+}
+
+static int on_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+	mio_iolen_t i;
+
+	if (dlen <= 0)
+	{
+		conns[xtn->conn].eof_reads++;
+		conns[xtn->conn].eof_after_resume = conns[xtn->conn].resumed;
+		mio_dev_sck_halt (dev);
+		return 0;
+	}
+
+	if (conns[xtn->conn].eof_reads > 0) failed = 1;
+
+	for (i = 0; i < dlen; i++)
+	{
+		if (((const mio_uint8_t*)data)[i] != t_pattern(conns[xtn->conn].received + i)) conns[xtn->conn].order_ok = 0;
+	}
+	conns[xtn->conn].received += dlen;
+	conns[xtn->conn].data_reads++;
+
+	if (xtn->conn == CONN_PAUSE && !conns[xtn->conn].paused)
+	{
+		/* the end of the input met in the same round must not get lost
+		 * while reading is disabled */
+		mio_ntime_t after;
+
+		conns[xtn->conn].paused = 1;
+		if (mio_dev_sck_read(dev, 0) <= -1) failed = 1;
+
+		MIO_INIT_NTIME (&after, 0, 10000000);
+		if (mio_schedtmrjobafter(mio_dev_sck_getmio(dev), &after, resume_reading, &resume_tmridx, dev) <= -1) failed = 1;
+	}
+
+	return 0;
+}
+
+static int on_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	failed = 1;
+	return 0;
+}
+
+static void on_connect (mio_dev_sck_t* dev)
+{
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	if (!(dev->state & MIO_DEV_SCK_ACCEPTED)) return;
+
+	if (nconns >= NCONNS)
+	{
+		failed = 1;
+		mio_dev_sck_halt (dev);
+		return;
+	}
+
+	xtn->conn = nconns++;
+	conns[xtn->conn].order_ok = 1;
+	conns[xtn->conn].coalesce_cap = !!(dev->dev_cap & MIO_DEV_CAP_IN_COALESCE);
+
+	/* wait until the peer finishes writing. all the data and the end of
+	 * the input are available when the socket is watched for reading */
+	if (t_peer_wait(&writer) <= -1) failed = 1;
+}
+
+static void on_disconnect (mio_dev_sck_t* dev)
+{
+	sck_xtn_t* xtn = (sck_xtn_t*)mio_dev_sck_getxtn(dev);
+
+	if ((dev->state & MIO_DEV_SCK_ACCEPTED) && xtn->conn == NCONNS - 1)
+	{
+		mio_stop (mio_dev_sck_getmio(dev), MIO_STOPREQ_TERMINATION);
+	}
+}
+
+static mio_dev_sck_t* make_listener (mio_t* mio, int* port)
+{
+	mio_dev_sck_make_t mkinfo;
+	mio_dev_sck_t* sck;
+
+	memset (&mkinfo, 0, MIO_SIZEOF(mkinfo));
+	mkinfo.type = MIO_DEV_SCK_TCP4;
+	mkinfo.options = MIO_DEV_SCK_MAKE_COALESCE_READ;
+	mkinfo.on_write = on_write;
+	mkinfo.on_read = on_read;
+	mkinfo.on_connect = on_connect;
+	mkinfo.on_disconnect = on_disconnect;
+	sck = t_make_listener(mio, &mkinfo, MIO_NULL, MIO_SIZEOF(sck_xtn_t), port);
+	if (sck) ((sck_xtn_t*)mio_dev_sck_getxtn(sck))->conn = -1;
+	return sck;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+
+	signal (SIGPIPE, SIG_IGN);
+
+	{
+		int port, c;
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+		T_ASSERT1 (make_listener(mio, &port) != MIO_NULL, "listener");
+
+		T_ASSERT1 (t_peer_start(&writer, run_writer, port) == 0, "fork writer");
+
+		alarm (20);
+		mio_loop (mio);
+		mio_close (mio);
+		mio = MIO_NULL;
+
+		T_ASSERT1 (t_peer_join(&writer) == 0, "writer");
+
+		T_ASSERT1 (!failed, "unexpected event");
+		T_ASSERT1 (nconns == NCONNS, "connections");
+
+		for (c = 0; c < NCONNS; c++)
+		{
+			printf ("connection %d - received %lu bytes written in %d pieces with %d reads\n",
+				c, (unsigned long)conns[c].received, NWRITES, conns[c].data_reads);
+
+			T_ASSERT1 (conns[c].coalesce_cap, "coalescing inherited by the accepted socket");
+			T_ASSERT1 (conns[c].received == NWRITES * WRITE_LEN && conns[c].order_ok, "data received");
+			/* the data fits in the read buffer and is delivered at once */
+			T_ASSERT1 (conns[c].data_reads == 1, "data merged");
+			T_ASSERT1 (conns[c].eof_reads == 1, "end of input");
+		}
+
+		T_ASSERT1 (conns[CONN_PAUSE].paused && conns[CONN_PAUSE].eof_after_resume, "end of input after resuming");
+	}
+
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	t_peer_kill (&writer);
+	return -1;
+}
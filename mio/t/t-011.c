@@ -0,0 +1,252 @@
+/* test the asynchronous log writer */
+
+#include <mio.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "t.h"
+
+/* many more records than the ring can hold */
+#define NMSGS 50000
+#define NMSGS_AFTER 100
+#define NMSGS_FORK 1000
+
+static char* read_all (int fd, mio_oow_t* len)
+{
+	char* buf = MIO_NULL;
+	mio_oow_t capa = 0;
+	ssize_t n;
+
+	*len = 0;
+	while (1)
+	{
+		if (*len + 65536 + 1 > capa)
+		{
+			char* tmp;
+			capa = (*len + 65536 + 1) * 2;
+			tmp = (char*)realloc(buf, capa);
+			if (!tmp) { free (buf); return MIO_NULL; }
+			buf = tmp;
+		}
+
+		n = read(fd, &buf[*len], 65536);
+		if (n <= 0) break;
+		*len += n;
+	}
+
+	buf[*len] = '\0';
+	return buf;
+}
+
+static char* read_file (const char* path, mio_oow_t* len)
+{
+	char* buf;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd <= -1) return MIO_NULL;
+	buf = read_all(fd, len);
+	close (fd);
+	return buf;
+}
+
+/* count the lines containing "<tag> <number>" with the numbers in the
+ * ascending order and the total of the drop reports */
+static int scan_log (const char* buf, const char* tag, long* count, long* dropped, long* last)
+{
+	const char* ptr = buf;
+	mio_oow_t tlen = strlen(tag);
+
+	*count = 0;
+	*dropped = 0;
+	*last = -1;
+
+	while (*ptr)
+	{
+		const char* eol = strchr(ptr, '\n');
+		const char* p;
+
+		if (!eol) return -1; /* incomplete line */
+
+		if ((p = strstr(ptr, "log messages dropped]")) && p < eol)
+		{
+			p = strchr(ptr, '[');
+			if (!p || p > eol) return -1;
+			*dropped += strtol(p + 1, MIO_NULL, 10);
+		}
+		else if ((p = strstr(ptr, tag)) && p < eol && p[tlen] == ' ')
+		{
+			long n = strtol(p + tlen + 1, MIO_NULL, 10);
+			if (n <= *last) return -1; /* duplicate or out of order */
+			*last = n;
+			(*count)++;
+		}
+
+		ptr = eol + 1;
+	}
+
+	return 0;
+}
+
+static int run_reader (const char* fifo, int ctlfd, int resfd)
+{
+	char* buf;
+	char tmp;
+	mio_oow_t len;
+	long count, dropped, last, after, after_dropped, after_last;
+	int fd;
+
+	/* open it before the logger opens it for writing. but don't read
+	 * till told to so that the writer thread gets blocked */
+	fd = open(fifo, O_RDONLY);
+	if (fd <= -1) return 1;
+	if (read(ctlfd, &tmp, 1) != 1) return 2;
+
+	buf = read_all(fd, &len);
+	close (fd);
+	if (!buf) return 3;
+
+	if (scan_log(buf, "message", &count, &dropped, &last) <= -1) return 4;
+	if (!strstr(buf, "drained")) return 5;
+	if (scan_log(buf, "after", &after, &after_dropped, &after_last) <= -1) return 6;
+	free (buf);
+
+	dprintf (resfd, "%ld %ld %ld\n", count, dropped, after);
+	return 0;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	pid_t reader = -1;
+	char fifo[64], path[64], path2[64];
+	int ctlpipe[2] = { -1, -1 }, respipe[2] = { -1, -1 };
+	int status, i;
+
+	signal (SIGPIPE, SIG_IGN);
+	alarm (30);
+
+	snprintf (fifo, MIO_COUNTOF(fifo), "/tmp/mio-t-011-%d.fifo", (int)getpid());
+	snprintf (path, MIO_COUNTOF(path), "/tmp/mio-t-011-%d-a.log", (int)getpid());
+	snprintf (path2, MIO_COUNTOF(path2), "/tmp/mio-t-011-%d-b.log", (int)getpid());
+
+	{
+		/* records are dropped while the writer thread is blocked. the
+		 * logging side never blocks and the writer reports the drops */
+		mio_bitmask_t mask = MIO_LOG_ALL_LEVELS | MIO_LOG_ALL_TYPES | MIO_LOG_ASYNC;
+		char res[128];
+		long count, dropped, after;
+		ssize_t n;
+
+		T_ASSERT1 (mkfifo(fifo, 0600) == 0, "fifo");
+		T_ASSERT1 (pipe(ctlpipe) == 0 && pipe(respipe) == 0, "pipes");
+
+		reader = fork();
+		T_ASSERT1 (reader >= 0, "fork reader");
+		if (reader == 0) _exit (run_reader(fifo, ctlpipe[0], respipe[1]));
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+		T_ASSERT1 (mio_setoption(mio, MIO_LOG_TARGET_BCSTR, fifo) == 0, "log target");
+		T_ASSERT1 (mio_setoption(mio, MIO_LOG_MASK, &mask) == 0, "log mask");
+
+		/* this finishes only if the logging side doesn't block */
+		for (i = 0; i < NMSGS; i++) MIO_INFO1 (mio, "message %d - the reader is not reading\n", i);
+
+		/* let the reader read. a fatal message is written synchronously
+		 * after all the records pending */
+		T_ASSERT1 (write(ctlpipe[1], "x", 1) == 1, "start reader");
+		MIO_LOG0 (mio, MIO_LOG_FATAL | MIO_LOG_UNTYPED, "drained\n");
+
+		/* the ring has got empty. nothing is dropped from now on and
+		 * the records are written when mio is closed */
+		for (i = 0; i < NMSGS_AFTER; i++) MIO_INFO1 (mio, "after %d\n", i);
+		mio_close (mio);
+		mio = MIO_NULL;
+
+		T_ASSERT1 (waitpid(reader, &status, 0) == reader, "wait for reader");
+		reader = -1;
+		T_ASSERT1 (WIFEXITED(status), "reader exit");
+		if (WEXITSTATUS(status) != 0) printf ("reader - %d\n", WEXITSTATUS(status));
+		T_ASSERT1 (WEXITSTATUS(status) == 0, "log contents");
+
+		n = read(respipe[0], res, MIO_SIZEOF(res) - 1);
+		T_ASSERT1 (n > 0, "reader result");
+		res[n] = '\0';
+		T_ASSERT1 (sscanf(res, "%ld %ld %ld", &count, &dropped, &after) == 3, "reader result");
+		printf ("written %ld, dropped %ld, after %ld\n", count, dropped, after);
+
+		T_ASSERT1 (dropped > 0, "records dropped");
+		T_ASSERT1 (count + dropped == NMSGS, "records written or dropped");
+		T_ASSERT1 (after == NMSGS_AFTER, "records written upon close");
+
+		unlink (fifo);
+		fifo[0] = '\0';
+	}
+
+	{
+		/* the records pending when forked are written by the parent only.
+		 * the child starts its own writer thread */
+		mio_bitmask_t mask = MIO_LOG_ALL_LEVELS | MIO_LOG_ALL_TYPES | MIO_LOG_ASYNC;
+		char* buf;
+		mio_oow_t len;
+		long count, dropped, last;
+		pid_t child;
+
+		mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+		T_ASSERT1 (mio != MIO_NULL, "mio open");
+		T_ASSERT1 (mio_setoption(mio, MIO_LOG_TARGET_BCSTR, path) == 0, "log target");
+		T_ASSERT1 (mio_setoption(mio, MIO_LOG_MASK, &mask) == 0, "log mask");
+
+		for (i = 0; i < NMSGS_FORK; i++) MIO_INFO1 (mio, "parent %d\n", i);
+
+		child = fork();
+		T_ASSERT1 (child >= 0, "fork");
+		if (child == 0)
+		{
+			mio_setoption (mio, MIO_LOG_TARGET_BCSTR, path2);
+			for (i = 0; i < NMSGS_FORK; i++) MIO_INFO1 (mio, "child %d\n", i);
+			mio_close (mio);
+			_exit (0);
+		}
+
+		for (i = NMSGS_FORK; i < NMSGS_FORK * 2; i++) MIO_INFO1 (mio, "parent %d\n", i);
+		T_ASSERT1 (waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0, "child");
+		mio_close (mio);
+		mio = MIO_NULL;
+
+		buf = read_file(path, &len);
+		T_ASSERT1 (buf != MIO_NULL, "parent log");
+		i = scan_log(buf, "parent", &count, &dropped, &last);
+		T_ASSERT1 (i == 0 && count == NMSGS_FORK * 2 && dropped == 0, "parent records");
+		T_ASSERT1 (strstr(buf, "child") == MIO_NULL, "no child records in the parent log");
+		free (buf);
+
+		buf = read_file(path2, &len);
+		T_ASSERT1 (buf != MIO_NULL, "child log");
+		i = scan_log(buf, "child", &count, &dropped, &last);
+		T_ASSERT1 (i == 0 && count == NMSGS_FORK && dropped == 0, "child records");
+		T_ASSERT1 (strstr(buf, "parent") == MIO_NULL, "no parent records in the child log");
+		free (buf);
+
+		unlink (path);
+		unlink (path2);
+	}
+
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	if (reader > 0) { kill (reader, SIGKILL); waitpid (reader, MIO_NULL, 0); }
+	if (fifo[0]) unlink (fifo);
+	unlink (path);
+	unlink (path2);
+	return -1;
+}
@@ -0,0 +1,151 @@
+/* test the time cached by the event loop */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "t.h"
+
+/* time to spend in a timer job. much longer than the coarse clock resolution */
+#define BUSY_NSEC 20000000
+
+static struct
+{
+	int fired_first;
+	int fired_second;
+	int stable;
+	int precise_advanced;
+	int refreshed;
+	int caught_up;
+	mio_ntime_t first;
+	mio_ntime_t first_end;
+} ctx;
+
+static mio_tmridx_t tmridx = MIO_TMRIDX_INVALID;
+
+static void busy_wait (mio_t* mio, const mio_ntime_t* from, mio_ntime_t* end)
+{
+	mio_ntime_t diff;
+
+	do
+	{
+		mio_gettime_precise (mio, end);
+		MIO_SUB_NTIME (&diff, end, from);
+	}
+	while (diff.sec == 0 && diff.nsec < BUSY_NSEC);
+}
+
+static void on_second (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_ntime_t t;
+
+	ctx.fired_second = 1;
+
+	/* the next iteration takes the time again */
+	mio_gettime (mio, &t);
+	ctx.refreshed = MIO_CMP_NTIME(&t, &ctx.first) > 0;
+	ctx.caught_up = MIO_CMP_NTIME(&t, &ctx.first_end) >= 0;
+
+	mio_stop (mio, MIO_STOPREQ_TERMINATION);
+}
+
+static void on_first (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_ntime_t t, after;
+
+	ctx.fired_first = 1;
+
+	/* the time stays the same while the callback runs however long
+	 * it takes but the precise time moves forward */
+	mio_gettime (mio, &ctx.first);
+	busy_wait (mio, &ctx.first, &ctx.first_end);
+	mio_gettime (mio, &t);
+
+	ctx.stable = MIO_CMP_NTIME(&t, &ctx.first) == 0;
+	ctx.precise_advanced = MIO_CMP_NTIME(&ctx.first_end, &ctx.first) > 0;
+
+	MIO_INIT_NTIME (&after, 0, 1000000);
+	if (mio_schedtmrjobafter(mio, &after, on_second, &tmridx, MIO_NULL) <= -1) mio_stop (mio, MIO_STOPREQ_TERMINATION);
+}
+
+static int on_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	return 0;
+}
+
+static int on_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	return 0;
+}
+
+static int run (mio_bitmask_t trait)
+{
+	mio_t* mio;
+	mio_dev_sck_make_t mkinfo;
+	mio_dev_sck_bind_t bi;
+	mio_dev_sck_t* sck;
+	mio_ntime_t after, t1, t2, end;
+	int ret = -1;
+
+	memset (&ctx, 0, MIO_SIZEOF(ctx));
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	if (!mio) return -1;
+	if (mio_setoption(mio, MIO_TRAIT, &trait) <= -1) goto done;
+
+	/* the loop runs while there is a device */
+	memset (&mkinfo, 0, MIO_SIZEOF(mkinfo));
+	mkinfo.type = MIO_DEV_SCK_UDP4;
+	mkinfo.on_write = on_write;
+	mkinfo.on_read = on_read;
+	sck = mio_dev_sck_make(mio, 0, &mkinfo);
+	if (!sck) goto done;
+
+	memset (&bi, 0, MIO_SIZEOF(bi));
+	if (mio_bcstrtoskad(mio, "127.0.0.1:0", &bi.localaddr) <= -1) goto done;
+	if (mio_dev_sck_bind(sck, &bi) <= -1) goto done;
+
+	MIO_INIT_NTIME (&after, 0, 10000000);
+	if (mio_schedtmrjobafter(mio, &after, on_first, &tmridx, MIO_NULL) <= -1) goto done;
+
+	mio_loop (mio);
+
+	/* outside the loop, the time is read every time */
+	mio_gettime (mio, &t1);
+	busy_wait (mio, &t1, &end);
+	mio_gettime (mio, &t2);
+
+	printf ("trait 0x%lx - first %ld.%09ld, busy till %ld.%09ld\n", (unsigned long)trait,
+		(long)ctx.first.sec, (long)ctx.first.nsec, (long)ctx.first_end.sec, (long)ctx.first_end.nsec);
+
+	if (!ctx.fired_first || !ctx.fired_second) { printf ("timer jobs not fired\n"); goto done; }
+	if (!ctx.stable) { printf ("time changed within an iteration\n"); goto done; }
+	if (!ctx.precise_advanced) { printf ("precise time not advanced\n"); goto done; }
+	if (!ctx.refreshed) { printf ("time not refreshed in the next iteration\n"); goto done; }
+	/* the coarse clock may lag behind the precise clock by its resolution */
+	if (!(trait & MIO_TRAIT_COARSE_CLOCK) && !ctx.caught_up) { printf ("time behind the precise time\n"); goto done; }
+	if (MIO_CMP_NTIME(&t2, &t1) <= 0) { printf ("time not advanced outside the loop\n"); goto done; }
+
+	ret = 0;
+
+done:
+	mio_close (mio);
+	return ret;
+}
+
+int main ()
+{
+	alarm (20);
+
+	{
+		T_ASSERT1 (run(0) == 0, "precise clock");
+		T_ASSERT1 (run(MIO_TRAIT_COARSE_CLOCK) == 0, "coarse clock");
+	}
+
+	return 0;
+
+oops:
+	return -1;
+}
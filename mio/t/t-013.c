@@ -0,0 +1,366 @@
+/* test the json writer */
+
+#include <mio.h>
+#include <mio-json.h>
+#include <mio-fmt.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "t.h"
+
+/* long enough for the vectorized scan and for the direct segments of the writev mode */
+#define LONG_LEN 3000
+#define NLONGS 100
+#define SHORT_LEN 600
+#define DEPTH 20
+
+typedef struct out_t out_t;
+struct out_t
+{
+	char* ptr;
+	mio_oow_t len;
+	mio_oow_t capa;
+	mio_oow_t nsegs; /* segments passed to the writev callback */
+	mio_oow_t maxsegs; /* most segments passed at a time */
+	mio_oow_t direct; /* segments referring to the caller's data */
+};
+
+static char long_str[LONG_LEN];
+static char short_strs[NLONGS][SHORT_LEN];
+static const char ctl_str[] = "q\"b\\s/\n\t\r\b\f\x01\x1f\a\v";
+static const char utf8_str[] = "\xc3\xa9\x7f~";
+
+static mio_intmax_t ints[] = { 0, -1, 9, 10, -99, 100, 12345, -1234567, 0, 0 };
+static mio_uintmax_t uints[] = { 0, 99, 100, 65536, 0 };
+
+static int append (out_t* out, const void* ptr, mio_oow_t len)
+{
+	if (out->len + len + 1 > out->capa)
+	{
+		char* tmp;
+		mio_oow_t capa = (out->len + len + 1) * 2;
+		tmp = (char*)realloc(out->ptr, capa);
+		if (!tmp) return -1;
+		out->ptr = tmp;
+		out->capa = capa;
+	}
+
+	memcpy (&out->ptr[out->len], ptr, len);
+	out->len += len;
+	out->ptr[out->len] = '\0';
+	return 0;
+}
+
+static void reset (out_t* out)
+{
+	out->len = 0;
+	out->nsegs = 0;
+	out->maxsegs = 0;
+	out->direct = 0;
+	if (out->ptr) out->ptr[0] = '\0';
+}
+
+static int on_write (mio_jsonwr_t* jsonwr, const mio_bch_t* dptr, mio_oow_t dlen, void* ctx)
+{
+	return append((out_t*)ctx, dptr, dlen);
+}
+
+static int on_writev (mio_jsonwr_t* jsonwr, mio_iovec_t* iov, mio_iolen_t iovcnt, void* ctx)
+{
+	out_t* out = (out_t*)ctx;
+	mio_iolen_t i;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		const char* p = (const char*)iov[i].iov_ptr;
+		if (p < jsonwr->wbuf || p >= jsonwr->wbuf + MIO_COUNTOF(jsonwr->wbuf)) out->direct++;
+		if (append(out, p, iov[i].iov_len) <= -1) return -1;
+	}
+
+	out->nsegs += iovcnt;
+	if (iovcnt > out->maxsegs) out->maxsegs = iovcnt;
+	return 0;
+}
+
+/* ========================================================================= */
+
+/* the escaped form of a string expected */
+static int ref_escape (out_t* out, const char* ptr, mio_oow_t len)
+{
+	mio_oow_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		const char* e;
+		switch (ptr[i])
+		{
+			case '\"': e = "\\\""; break;
+			case '\\': e = "\\\\"; break;
+			case '\n': e = "\\n"; break;
+			case '\t': e = "\\t"; break;
+			case '\r': e = "\\r"; break;
+			case '\b': e = "\\b"; break;
+			case '\f': e = "\\f"; break;
+			default:
+				if ((unsigned char)ptr[i] <= 0x1f)
+				{
+					char tmp[8];
+					snprintf (tmp, MIO_COUNTOF(tmp), "\\u%04x", (unsigned int)ptr[i]);
+					if (append(out, tmp, 6) <= -1) return -1;
+				}
+				else if (append(out, &ptr[i], 1) <= -1) return -1;
+				continue;
+		}
+		if (append(out, e, strlen(e)) <= -1) return -1;
+	}
+
+	return 0;
+}
+
+static int ref_string (out_t* out, const char* ptr, mio_oow_t len)
+{
+	if (append(out, "\"", 1) <= -1 || ref_escape(out, ptr, len) <= -1 || append(out, "\"", 1) <= -1) return -1;
+	return 0;
+}
+
+static int ref_doc (out_t* out)
+{
+	static const char* mid = "true,false,null,{\"k\": \"v\",\"n\": 1.5e3,\"a\": [1,2],\"o\": {}},[";
+	char tmp[64];
+	mio_oow_t i;
+
+	if (append(out, "[", 1) <= -1 ||
+	    ref_string(out, "abc", 3) <= -1 || append(out, ",", 1) <= -1 ||
+	    ref_string(out, ctl_str, strlen(ctl_str)) <= -1 || append(out, ",", 1) <= -1 ||
+	    ref_string(out, utf8_str, strlen(utf8_str)) <= -1 || append(out, ",", 1) <= -1 ||
+	    ref_string(out, long_str, LONG_LEN) <= -1 || append(out, ",", 1) <= -1) return -1;
+
+	for (i = 0; i < MIO_COUNTOF(ints); i++)
+	{
+		mio_fmt_intmax_to_bcstr (tmp, MIO_COUNTOF(tmp), ints[i], 10, 0, '\0', MIO_NULL);
+		if (append(out, tmp, strlen(tmp)) <= -1 || append(out, ",", 1) <= -1) return -1;
+	}
+	for (i = 0; i < MIO_COUNTOF(uints); i++)
+	{
+		mio_fmt_uintmax_to_bcstr (tmp, MIO_COUNTOF(tmp), uints[i], 10, 0, '\0', MIO_NULL);
+		if (append(out, tmp, strlen(tmp)) <= -1 || append(out, ",", 1) <= -1) return -1;
+	}
+
+	if (append(out, mid, strlen(mid)) <= -1) return -1;
+	for (i = 0; i < NLONGS; i++)
+	{
+		if (i > 0 && append(out, ",", 1) <= -1) return -1;
+		if (ref_string(out, short_strs[i], SHORT_LEN) <= -1) return -1;
+	}
+	if (append(out, "]]", 2) <= -1) return -1;
+
+	return 0;
+}
+
+static int write_doc (mio_jsonwr_t* jsonwr)
+{
+	mio_oow_t i;
+
+	if (mio_jsonwr_startarray(jsonwr) <= -1 ||
+	    mio_jsonwr_writestringwithbchars(jsonwr, "abc", 3) <= -1 ||
+	    mio_jsonwr_writestringwithbcstr(jsonwr, ctl_str) <= -1 ||
+	    mio_jsonwr_writestringwithbcstr(jsonwr, utf8_str) <= -1 ||
+	    mio_jsonwr_writestringwithbchars(jsonwr, long_str, LONG_LEN) <= -1) return -1;
+
+	for (i = 0; i < MIO_COUNTOF(ints); i++)
+	{
+		if (mio_jsonwr_writeintmax(jsonwr, ints[i]) <= -1) return -1;
+	}
+	for (i = 0; i < MIO_COUNTOF(uints); i++)
+	{
+		if (mio_jsonwr_writeuintmax(jsonwr, uints[i]) <= -1) return -1;
+	}
+
+	if (mio_jsonwr_writetrue(jsonwr) <= -1 ||
+	    mio_jsonwr_writefalse(jsonwr) <= -1 ||
+	    mio_jsonwr_writenil(jsonwr) <= -1 ||
+	    mio_jsonwr_startobject(jsonwr) <= -1 ||
+	    mio_jsonwr_writekeywithbcstr(jsonwr, "k") <= -1 ||
+	    mio_jsonwr_writestringwithbcstr(jsonwr, "v") <= -1 ||
+	    mio_jsonwr_writekeywithbcstr(jsonwr, "n") <= -1 ||
+	    mio_jsonwr_writenumberwithbcstr(jsonwr, "1.5e3") <= -1 ||
+	    mio_jsonwr_writekeywithbcstr(jsonwr, "a") <= -1 ||
+	    mio_jsonwr_startarray(jsonwr) <= -1 ||
+	    mio_jsonwr_writeintmax(jsonwr, 1) <= -1 ||
+	    mio_jsonwr_writeintmax(jsonwr, 2) <= -1 ||
+	    mio_jsonwr_endarray(jsonwr) <= -1 ||
+	    mio_jsonwr_writekeywithbcstr(jsonwr, "o") <= -1 ||
+	    mio_jsonwr_startobject(jsonwr) <= -1 ||
+	    mio_jsonwr_endobject(jsonwr) <= -1 ||
+	    mio_jsonwr_endobject(jsonwr) <= -1 ||
+	    mio_jsonwr_startarray(jsonwr) <= -1) return -1;
+
+	for (i = 0; i < NLONGS; i++)
+	{
+		if (mio_jsonwr_writestringwithbchars(jsonwr, short_strs[i], SHORT_LEN) <= -1) return -1;
+	}
+
+	if (mio_jsonwr_endarray(jsonwr) <= -1 || mio_jsonwr_endarray(jsonwr) <= -1) return -1;
+	return 0;
+}
+
+/* ========================================================================= */
+
+static void make_strings (void)
+{
+	/* characters to escape around the 16-byte boundaries and the bytes
+	 * that must not be escaped */
+	static mio_oow_t pos[] = { 0, 14, 15, 16, 17, 31, 32, 33, 47, 48, 63, 1000, 1001, 1002, LONG_LEN - 17, LONG_LEN - 16, LONG_LEN - 1 };
+	static const char esc[] = "\"\\\n\t\r\b\f\x01\x1f\a\v";
+	static const char raw[] = "\x7f\x80\xa0\xc3\xff /'";
+	mio_oow_t i, j;
+
+	for (i = 0; i < LONG_LEN; i++) long_str[i] = 'a' + (i % 26);
+	for (i = 0; i < MIO_COUNTOF(pos); i++) long_str[pos[i]] = esc[i % (MIO_COUNTOF(esc) - 1)];
+	for (i = 0; i < MIO_COUNTOF(raw) - 1; i++) long_str[100 + i * 17] = raw[i];
+	long_str[500] = '\0';
+
+	for (i = 0; i < NLONGS; i++)
+	{
+		for (j = 0; j < SHORT_LEN; j++) short_strs[i][j] = 'A' + ((i + j) % 26);
+		/* an escape in the middle splits the string into two runs */
+		if (i % 2) short_strs[i][SHORT_LEN / 2 + i] = '\n';
+	}
+
+	ints[MIO_COUNTOF(ints) - 2] = MIO_TYPE_MIN(mio_intmax_t);
+	ints[MIO_COUNTOF(ints) - 1] = MIO_TYPE_MAX(mio_intmax_t);
+	uints[MIO_COUNTOF(uints) - 1] = MIO_TYPE_MAX(mio_uintmax_t);
+}
+
+static int same_string (mio_json_node_t* node, const char* ptr, mio_oow_t len)
+{
+	return node && node->type == MIO_JSON_NODE_STRING && node->u.str.len == len && memcmp(node->u.str.ptr, ptr, len) == 0;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	mio_jsonwr_t* jsonwr = MIO_NULL;
+	mio_json_doc_t* doc = MIO_NULL;
+	out_t out, ref;
+
+	memset (&out, 0, MIO_SIZEOF(out));
+	memset (&ref, 0, MIO_SIZEOF(ref));
+	make_strings ();
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	T_ASSERT1 (ref_doc(&ref) == 0, "expected output");
+
+	{
+		/* the output of the buffered mode. the strings survive the round trip */
+		mio_json_node_t* root;
+
+		jsonwr = mio_jsonwr_open(mio, 0, 0);
+		T_ASSERT1 (jsonwr != MIO_NULL, "jsonwr open");
+		mio_jsonwr_setwritecb (jsonwr, on_write, &out);
+
+		T_ASSERT1 (write_doc(jsonwr) == 0, "write document");
+		T_ASSERT1 (out.len == ref.len && memcmp(out.ptr, ref.ptr, ref.len) == 0, "output");
+
+		mio_jsonwr_close (jsonwr);
+		jsonwr = MIO_NULL;
+
+		doc = mio_json_parsedoc(mio, out.ptr, out.len);
+		T_ASSERT1 (doc != MIO_NULL, "parse output");
+		root = mio_json_getdocroot(doc);
+		T_ASSERT1 (same_string(mio_json_getitem(root, 1), ctl_str, strlen(ctl_str)), "escaped string");
+		T_ASSERT1 (same_string(mio_json_getitem(root, 2), utf8_str, strlen(utf8_str)), "string not escaped");
+		T_ASSERT1 (same_string(mio_json_getitem(root, 3), long_str, LONG_LEN), "long string");
+		T_ASSERT1 (mio_json_getitem(root, 21) && mio_json_getitem(root, 21)->type == MIO_JSON_NODE_NIL, "null");
+		T_ASSERT1 (mio_json_findvalue(mio_json_getitem(root, 22), "a", 1) && mio_json_findvalue(mio_json_getitem(root, 22), "a", 1)->u.c.count == 2, "array in object");
+		mio_json_freedoc (doc);
+		doc = MIO_NULL;
+	}
+
+	{
+		/* the writev mode produces the same text. long strings are passed
+		 * without copying in no more segments than the limit */
+		reset (&out);
+		jsonwr = mio_jsonwr_open(mio, 0, 0);
+		T_ASSERT1 (jsonwr != MIO_NULL, "jsonwr open");
+		mio_jsonwr_setwritevcb (jsonwr, on_writev, &out);
+
+		T_ASSERT1 (write_doc(jsonwr) == 0, "write document");
+		T_ASSERT1 (out.len == ref.len && memcmp(out.ptr, ref.ptr, ref.len) == 0, "writev output");
+		/* the strings split by an escape are copied in short runs */
+		T_ASSERT1 (out.direct >= NLONGS / 2, "direct segments");
+		T_ASSERT1 (out.nsegs > MIO_JSONWR_IOV_MAX && out.maxsegs <= MIO_JSONWR_IOV_MAX, "segment limit");
+
+		mio_jsonwr_close (jsonwr);
+
+		/* the caller's data is passed before the write function returns */
+		reset (&out);
+		jsonwr = mio_jsonwr_open(mio, 0, 0);
+		T_ASSERT1 (jsonwr != MIO_NULL, "jsonwr open");
+		mio_jsonwr_setwritevcb (jsonwr, on_writev, &out);
+		T_ASSERT1 (mio_jsonwr_startarray(jsonwr) == 0, "start array");
+		T_ASSERT1 (mio_jsonwr_writestringwithbchars(jsonwr, long_str, LONG_LEN) == 0, "write string");
+		reset (&ref);
+		T_ASSERT1 (append(&ref, "[", 1) == 0 && ref_string(&ref, long_str, LONG_LEN) == 0, "expected output");
+		T_ASSERT1 (out.len == ref.len && memcmp(out.ptr, ref.ptr, ref.len) == 0, "data passed before return");
+		T_ASSERT1 (mio_jsonwr_endarray(jsonwr) == 0 && out.len == ref.len + 1 && out.ptr[ref.len] == ']', "end array");
+
+		mio_jsonwr_close (jsonwr);
+		jsonwr = MIO_NULL;
+	}
+
+	{
+		/* indentation deeper than the tab string of the writer */
+		int i;
+
+		reset (&out);
+		reset (&ref);
+		jsonwr = mio_jsonwr_open(mio, 0, MIO_JSONWR_FLAG_PRETTY);
+		T_ASSERT1 (jsonwr != MIO_NULL, "jsonwr open");
+		mio_jsonwr_setwritecb (jsonwr, on_write, &out);
+
+		for (i = 0; i < DEPTH; i++) T_ASSERT1 (mio_jsonwr_startarray(jsonwr) == 0, "start array");
+		T_ASSERT1 (mio_jsonwr_writeintmax(jsonwr, 7) == 0, "write integer");
+		for (i = 0; i < DEPTH; i++) T_ASSERT1 (mio_jsonwr_endarray(jsonwr) == 0, "end array");
+
+		for (i = 0; i < DEPTH; i++)
+		{
+			append (&ref, "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t", i);
+			append (&ref, "[\n", 2);
+		}
+		append (&ref, "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t", DEPTH);
+		append (&ref, "7", 1);
+		for (i = DEPTH; i > 0; )
+		{
+			i--;
+			append (&ref, "\n", 1);
+			append (&ref, "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t", i);
+			append (&ref, "]", 1);
+		}
+		append (&ref, "\n", 1);
+
+		T_ASSERT1 (out.len == ref.len && memcmp(out.ptr, ref.ptr, ref.len) == 0, "pretty output");
+
+		/* an instruction out of place */
+		T_ASSERT1 (mio_jsonwr_endobject(jsonwr) <= -1, "end object without start");
+
+		mio_jsonwr_close (jsonwr);
+		jsonwr = MIO_NULL;
+	}
+
+	free (out.ptr);
+	free (ref.ptr);
+	mio_close (mio);
+	return 0;
+
+oops:
+	if (doc) mio_json_freedoc (doc);
+	if (jsonwr) mio_jsonwr_close (jsonwr);
+	if (mio) mio_close (mio);
+	free (out.ptr);
+	free (ref.ptr);
+	return -1;
+}
@@ -0,0 +1,404 @@
+/* test the dns server service over the loopback interface */
+
+#include <mio.h>
+#include <mio-dns.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "t.h"
+#include "t-sck.h"
+
+#define NBIG 40
+#define MAX_ANSWERS 64
+
+struct rsp_t
+{
+	mio_dns_pkt_cur_t cur;
+	int nans;
+	mio_uint16_t type[MAX_ANSWERS];
+	mio_bch_t name[MAX_ANSWERS][64];
+	mio_bch_t data[MAX_ANSWERS][64]; /* the target name of a CNAME record */
+	mio_uint16_t ns_type; /* the first record in the authority section */
+	mio_bch_t ns_name[64];
+	int edns;
+};
+typedef struct rsp_t rsp_t;
+
+static void add_rr (mio_svc_dns_t* dns, const char* name, mio_dns_rrt_t type, const void* dptr, mio_uint16_t dlen, int* ok)
+{
+	mio_dns_brr_t brr;
+
+	memset (&brr, 0, MIO_SIZEOF(brr));
+	brr.part = MIO_DNS_RR_PART_ANSWER;
+	brr.rrname = (mio_bch_t*)name;
+	brr.rrtype = type;
+	brr.rrclass = MIO_DNS_RRC_IN;
+	brr.ttl = 60;
+	brr.dptr = (void*)dptr;
+	brr.dlen = dlen;
+	if (mio_svc_dns_addrr(dns, &brr) <= -1) *ok = 0;
+}
+
+static int run_server (t_peer_t* peer, int port)
+{
+	static mio_dns_brrd_soa_t soa = { "ns1.example.com", "admin.example.com", 2024, 3600, 600, 86400, 300 };
+	static mio_dns_brrd_mx_t mx = { 10, "mail.example.com" };
+	static mio_uint8_t a1[4] = { 10, 0, 0, 1 }, a2[4] = { 10, 0, 0, 2 };
+	mio_t* mio;
+	mio_svc_dns_t* dns;
+	mio_skad_t skad;
+	mio_bch_t addr[32];
+	int i, ok = 1;
+
+	alarm (20);
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	if (!mio) return 1;
+
+	snprintf (addr, MIO_COUNTOF(addr), "127.0.0.1:%d", port);
+	if (mio_bcstrtoskad(mio, addr, &skad) <= -1) return 2;
+	dns = mio_svc_dns_start(mio, &skad);
+	if (!dns) return 3;
+
+	add_rr (dns, "example.com", MIO_DNS_RRT_SOA, &soa, MIO_SIZEOF(soa), &ok);
+	add_rr (dns, "example.com", MIO_DNS_RRT_MX, &mx, MIO_SIZEOF(mx), &ok);
+	add_rr (dns, "www.example.com", MIO_DNS_RRT_A, a1, 4, &ok);
+	add_rr (dns, "www.example.com", MIO_DNS_RRT_A, a2, 4, &ok);
+	add_rr (dns, "alias.example.com", MIO_DNS_RRT_CNAME, "www.example.com", 16, &ok);
+	add_rr (dns, "alias2.example.com", MIO_DNS_RRT_CNAME, "alias.example.com", 18, &ok);
+	for (i = 0; i < NBIG; i++)
+	{
+		mio_uint8_t a[4];
+		a[0] = 10; a[1] = 1; a[2] = 0; a[3] = i;
+		add_rr (dns, "big.example.com", MIO_DNS_RRT_A, a, 4, &ok);
+	}
+	if (!ok) return 4;
+
+	/* ready to serve. it is killed by the test process */
+	if (t_peer_post(peer) <= -1) return 5;
+	mio_loop (mio);
+	mio_close (mio);
+	return 0;
+}
+
+/* find a port free for both udp and tcp */
+static int pick_port (void)
+{
+	struct sockaddr_in sin;
+	socklen_t sl;
+	int ufd, tfd, port = -1, opt = 1;
+
+	ufd = socket(AF_INET, SOCK_DGRAM, 0);
+	tfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (ufd <= -1 || tfd <= -1) goto done;
+
+	memset (&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sl = sizeof(sin);
+	if (bind(ufd, (struct sockaddr*)&sin, sizeof(sin)) <= -1 ||
+	    getsockname(ufd, (struct sockaddr*)&sin, &sl) <= -1) goto done;
+
+	setsockopt (tfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	if (bind(tfd, (struct sockaddr*)&sin, sizeof(sin)) <= -1) goto done;
+	port = ntohs(sin.sin_port);
+
+done:
+	if (ufd >= 0) close (ufd);
+	if (tfd >= 0) close (tfd);
+	return port;
+}
+
+static mio_oow_t make_query (mio_uint8_t* buf, mio_uint16_t id, const char* name, mio_uint16_t qtype, mio_uint16_t udpsize)
+{
+	mio_oow_t len = 0;
+	const char* seg;
+
+	/* header with rd set */
+	buf[len++] = id >> 8; buf[len++] = id & 0xFF;
+	buf[len++] = 0x01; buf[len++] = 0x00;
+	buf[len++] = 0; buf[len++] = 1; /* qdcount */
+	buf[len++] = 0; buf[len++] = 0;
+	buf[len++] = 0; buf[len++] = 0;
+	buf[len++] = 0; buf[len++] = (udpsize > 0); /* arcount */
+
+	while (*name)
+	{
+		mio_oow_t seglen;
+		seg = name;
+		while (*name && *name != '.') name++;
+		seglen = name - seg;
+		buf[len++] = seglen;
+		memcpy (&buf[len], seg, seglen);
+		len += seglen;
+		if (*name == '.') name++;
+	}
+	buf[len++] = 0;
+	buf[len++] = qtype >> 8; buf[len++] = qtype & 0xFF;
+	buf[len++] = 0; buf[len++] = MIO_DNS_RRC_IN;
+
+	if (udpsize > 0)
+	{
+		/* OPT with the root name */
+		buf[len++] = 0;
+		buf[len++] = 0; buf[len++] = MIO_DNS_RRT_OPT;
+		buf[len++] = udpsize >> 8; buf[len++] = udpsize & 0xFF;
+		buf[len++] = 0; buf[len++] = 0; buf[len++] = 0; buf[len++] = 0;
+		buf[len++] = 0; buf[len++] = 0;
+	}
+
+	return len;
+}
+
+static int parse_response (const mio_uint8_t* pkt, mio_oow_t len, rsp_t* rsp)
+{
+	mio_dns_crr_t crr;
+	mio_dns_brr_t brr;
+	mio_dns_pkt_edns_t edns;
+	mio_uint8_t buf[MIO_DNS_CRR_DECODE_BUF_LEN];
+	int n;
+
+	memset (rsp, 0, MIO_SIZEOF(*rsp));
+	if (mio_dns_init_pkt_cur(&rsp->cur, (const mio_dns_pkt_t*)pkt, len) <= -1) return -1;
+	if (mio_dns_get_edns_in_pkt_cur(&rsp->cur, &edns) <= -1) return -1;
+	rsp->edns = edns.exist;
+
+	while ((n = mio_dns_next_rr_in_pkt_cur(&rsp->cur, &crr)) > 0)
+	{
+		if (mio_dns_decode_rr_in_pkt_cur(&rsp->cur, &crr, &brr, buf, MIO_SIZEOF(buf)) <= -1) return -1;
+
+		if (crr.part == MIO_DNS_RR_PART_ANSWER)
+		{
+			if (rsp->nans >= MAX_ANSWERS) return -1;
+			rsp->type[rsp->nans] = brr.rrtype;
+			snprintf (rsp->name[rsp->nans], MIO_COUNTOF(rsp->name[0]), "%s", brr.rrname);
+			if (brr.rrtype == MIO_DNS_RRT_CNAME) snprintf (rsp->data[rsp->nans], MIO_COUNTOF(rsp->data[0]), "%s", (const char*)brr.dptr);
+			rsp->nans++;
+		}
+		else if (crr.part == MIO_DNS_RR_PART_AUTHORITY && !rsp->ns_type)
+		{
+			rsp->ns_type = brr.rrtype;
+			snprintf (rsp->ns_name, MIO_COUNTOF(rsp->ns_name), "%s", brr.rrname);
+		}
+	}
+
+	return n;
+}
+
+static void set_timeout (int fd)
+{
+	struct timeval tv;
+	tv.tv_sec = 5;
+	tv.tv_usec = 0;
+	setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+static int query_udp (int port, mio_uint16_t id, const char* name, mio_uint16_t qtype, mio_uint16_t udpsize, rsp_t* rsp)
+{
+	static mio_uint8_t pkt[65536];
+	mio_uint8_t req[512];
+	struct sockaddr_in sin;
+	mio_oow_t len;
+	ssize_t n;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd <= -1) return -1;
+	set_timeout (fd);
+
+	memset (&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+
+	len = make_query(req, id, name, qtype, udpsize);
+	if (sendto(fd, req, len, 0, (struct sockaddr*)&sin, sizeof(sin)) != (ssize_t)len) { close (fd); return -1; }
+	n = recv(fd, pkt, MIO_SIZEOF(pkt), 0);
+	close (fd);
+	if (n <= 0) return -1;
+
+	/* the whole response must fit in the payload size */
+	if (n > (udpsize > 0? udpsize: 512)) return -1;
+	return parse_response(pkt, n, rsp);
+}
+
+static int read_fully (int fd, mio_uint8_t* buf, mio_oow_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = read(fd, buf, len);
+		if (n <= 0) return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* read a response prefixed with the length over tcp */
+static int read_tcp_response (int fd, rsp_t* rsp)
+{
+	static mio_uint8_t pkt[65536];
+	mio_uint8_t lenbuf[2];
+	mio_oow_t len;
+
+	if (read_fully(fd, lenbuf, 2) <= -1) return -1;
+	len = ((mio_oow_t)lenbuf[0] << 8) | lenbuf[1];
+	if (read_fully(fd, pkt, len) <= -1) return -1;
+	return parse_response(pkt, len, rsp);
+}
+
+static mio_oow_t make_tcp_query (mio_uint8_t* buf, mio_uint16_t id, const char* name, mio_uint16_t qtype)
+{
+	mio_oow_t len;
+	len = make_query(&buf[2], id, name, qtype, 0);
+	buf[0] = len >> 8;
+	buf[1] = len & 0xFF;
+	return len + 2;
+}
+
+static int check_header (const rsp_t* rsp, mio_uint16_t id, int rcode, int aa)
+{
+	return rsp->cur.hdr.id == id && rsp->cur.hdr.qr && rsp->cur.hdr.rcode == rcode && rsp->cur.hdr.aa == aa && rsp->cur.qdcount == 1;
+}
+
+static int check_soa_authority (const rsp_t* rsp)
+{
+	return rsp->nans == 0 && rsp->cur.ancount == 0 && rsp->cur.nscount == 1 &&
+	       rsp->ns_type == MIO_DNS_RRT_SOA && strcmp(rsp->ns_name, "example.com") == 0;
+}
+
+int main ()
+{
+	t_peer_t server = { -1 };
+	static rsp_t rsp;
+	int port = -1, tries, fd = -1, i;
+
+	signal (SIGPIPE, SIG_IGN);
+	alarm (20);
+
+	/* the port is picked in advance as the service binds udp and tcp
+	 * sockets to the same address */
+	for (tries = 0; tries < 5; tries++)
+	{
+		port = pick_port();
+		T_ASSERT1 (port > 0, "pick port");
+		T_ASSERT1 (t_peer_start(&server, run_server, port) == 0, "start server");
+		if (t_peer_wait(&server) == 0) break;
+		t_peer_join (&server);
+	}
+	T_ASSERT1 (tries < 5, "server ready");
+
+	{
+		/* records in the zone */
+		T_ASSERT1 (query_udp(port, 1, "www.example.com", MIO_DNS_RRT_A, 0, &rsp) == 0, "query www A");
+		T_ASSERT1 (check_header(&rsp, 1, MIO_DNS_RCODE_NOERROR, 1), "www A header");
+		T_ASSERT1 (rsp.nans == 2 && rsp.cur.ancount == 2, "www A answers");
+		for (i = 0; i < rsp.nans; i++)
+		{
+			T_ASSERT1 (rsp.type[i] == MIO_DNS_RRT_A && strcmp(rsp.name[i], "www.example.com") == 0, "www A record");
+		}
+		T_ASSERT1 (rsp.cur.nscount == 0, "www A authority");
+	}
+
+	{
+		/* a name that doesn't exist in the zone */
+		T_ASSERT1 (query_udp(port, 2, "nope.example.com", MIO_DNS_RRT_A, 0, &rsp) == 0, "query nxdomain");
+		T_ASSERT1 (check_header(&rsp, 2, MIO_DNS_RCODE_NXDOMAIN, 1), "nxdomain header");
+		T_ASSERT1 (check_soa_authority(&rsp), "nxdomain soa");
+	}
+
+	{
+		/* a name that exists without the type asked */
+		T_ASSERT1 (query_udp(port, 3, "www.example.com", MIO_DNS_RRT_MX, 0, &rsp) == 0, "query nodata");
+		T_ASSERT1 (check_header(&rsp, 3, MIO_DNS_RCODE_NOERROR, 1), "nodata header");
+		T_ASSERT1 (check_soa_authority(&rsp), "nodata soa");
+	}
+
+	{
+		/* the aliases are followed within the zone */
+		T_ASSERT1 (query_udp(port, 4, "alias2.example.com", MIO_DNS_RRT_A, 0, &rsp) == 0, "query cname");
+		T_ASSERT1 (check_header(&rsp, 4, MIO_DNS_RCODE_NOERROR, 1), "cname header");
+		T_ASSERT1 (rsp.nans == 4, "cname answers");
+		T_ASSERT1 (rsp.type[0] == MIO_DNS_RRT_CNAME && strcmp(rsp.name[0], "alias2.example.com") == 0 && strcmp(rsp.data[0], "alias.example.com") == 0, "first cname");
+		T_ASSERT1 (rsp.type[1] == MIO_DNS_RRT_CNAME && strcmp(rsp.name[1], "alias.example.com") == 0 && strcmp(rsp.data[1], "www.example.com") == 0, "second cname");
+		T_ASSERT1 (rsp.type[2] == MIO_DNS_RRT_A && strcmp(rsp.name[2], "www.example.com") == 0, "cname target");
+		T_ASSERT1 (rsp.type[3] == MIO_DNS_RRT_A && strcmp(rsp.name[3], "www.example.com") == 0, "cname target");
+
+		/* asking for the alias itself */
+		T_ASSERT1 (query_udp(port, 5, "alias.example.com", MIO_DNS_RRT_CNAME, 0, &rsp) == 0, "query cname only");
+		T_ASSERT1 (check_header(&rsp, 5, MIO_DNS_RCODE_NOERROR, 1), "cname only header");
+		T_ASSERT1 (rsp.nans == 1 && rsp.type[0] == MIO_DNS_RRT_CNAME, "cname only answer");
+	}
+
+	{
+		/* a name outside the zone without a forwarder */
+		T_ASSERT1 (query_udp(port, 6, "www.other.net", MIO_DNS_RRT_A, 0, &rsp) == 0, "query outside");
+		T_ASSERT1 (check_header(&rsp, 6, MIO_DNS_RCODE_REFUSED, 0), "outside header");
+		T_ASSERT1 (rsp.nans == 0, "outside answers");
+	}
+
+	{
+		/* too many records for 512 bytes. the records are dropped with
+		 * the truncation bit set */
+		T_ASSERT1 (query_udp(port, 7, "big.example.com", MIO_DNS_RRT_A, 0, &rsp) == 0, "query big");
+		T_ASSERT1 (check_header(&rsp, 7, MIO_DNS_RCODE_NOERROR, 1), "big header");
+		T_ASSERT1 (rsp.cur.hdr.tc == 1, "big truncated");
+		T_ASSERT1 (rsp.nans == 0 && rsp.cur.ancount == 0 && rsp.cur.nscount == 0 && !rsp.edns, "big records dropped");
+
+		/* a small edns payload size still truncates. the opt record stays */
+		T_ASSERT1 (query_udp(port, 8, "big.example.com", MIO_DNS_RRT_A, 600, &rsp) == 0, "query big with edns 600");
+		T_ASSERT1 (rsp.cur.hdr.tc == 1 && rsp.nans == 0 && rsp.edns, "big truncated with edns");
+
+		/* it fits in a large edns payload */
+		T_ASSERT1 (query_udp(port, 9, "big.example.com", MIO_DNS_RRT_A, 4096, &rsp) == 0, "query big with edns");
+		T_ASSERT1 (check_header(&rsp, 9, MIO_DNS_RCODE_NOERROR, 1), "big edns header");
+		T_ASSERT1 (rsp.cur.hdr.tc == 0 && rsp.nans == NBIG && rsp.edns, "big with edns");
+	}
+
+	{
+		/* no truncation over tcp */
+		mio_uint8_t req[1024];
+		mio_oow_t len;
+
+		fd = t_connect_to(port);
+		T_ASSERT1 (fd >= 0, "tcp connect");
+		set_timeout (fd);
+
+		len = make_tcp_query(req, 10, "big.example.com", MIO_DNS_RRT_A);
+		T_ASSERT1 (write(fd, req, len) == (ssize_t)len, "tcp write");
+		T_ASSERT1 (read_tcp_response(fd, &rsp) == 0, "tcp big response");
+		T_ASSERT1 (check_header(&rsp, 10, MIO_DNS_RCODE_NOERROR, 1), "tcp big header");
+		T_ASSERT1 (rsp.cur.hdr.tc == 0 && rsp.nans == NBIG, "tcp big answers");
+
+		/* two queries in a single write */
+		len = make_tcp_query(req, 11, "www.example.com", MIO_DNS_RRT_A);
+		len += make_tcp_query(&req[len], 12, "nope.example.com", MIO_DNS_RRT_A);
+		T_ASSERT1 (write(fd, req, len) == (ssize_t)len, "tcp write pipelined");
+		T_ASSERT1 (read_tcp_response(fd, &rsp) == 0, "tcp first response");
+		T_ASSERT1 (check_header(&rsp, 11, MIO_DNS_RCODE_NOERROR, 1) && rsp.nans == 2, "tcp first answers");
+		T_ASSERT1 (read_tcp_response(fd, &rsp) == 0, "tcp second response");
+		T_ASSERT1 (check_header(&rsp, 12, MIO_DNS_RCODE_NXDOMAIN, 1) && check_soa_authority(&rsp), "tcp second answers");
+
+		/* a query split in the middle of the length and of the message */
+		len = make_tcp_query(req, 13, "alias2.example.com", MIO_DNS_RRT_A);
+		T_ASSERT1 (write(fd, req, 1) == 1, "tcp write partial length");
+		usleep (50000);
+		T_ASSERT1 (write(fd, &req[1], 10) == 10, "tcp write partial message");
+		usleep (50000);
+		T_ASSERT1 (write(fd, &req[11], len - 11) == (ssize_t)(len - 11), "tcp write rest");
+		T_ASSERT1 (read_tcp_response(fd, &rsp) == 0, "tcp split response");
+		T_ASSERT1 (check_header(&rsp, 13, MIO_DNS_RCODE_NOERROR, 1) && rsp.nans == 4, "tcp split answers");
+
+		close (fd);
+		fd = -1;
+	}
+
+	t_peer_kill (&server);
+	return 0;
+
+oops:
+	if (fd >= 0) close (fd);
+	t_peer_kill (&server);
+	return -1;
+}
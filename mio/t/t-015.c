@@ -0,0 +1,144 @@
+/* test draining the accept backlog of a listening socket up to the budget */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include "t.h"
+#include "t-sck.h"
+
+#define NCONNS 20
+#define BUDGET 4
+
+static mio_oow_t accepted = 0;
+static int failed = 0;
+
+/* make all the connections before the test process starts accepting */
+static int run_connector (t_peer_t* peer, int port)
+{
+	int fd[NCONNS];
+	int i;
+
+	for (i = 0; i < NCONNS; i++)
+	{
+		fd[i] = t_connect_to(port);
+		if (fd[i] <= -1) return 1;
+	}
+
+	/* keep the connections until told to finish */
+	if (t_peer_post(peer) <= -1) return 2;
+	t_peer_wait (peer);
+
+	for (i = 0; i < NCONNS; i++) close (fd[i]);
+	return 0;
+}
+
+static int on_read (mio_dev_sck_t* dev, const void* data, mio_iolen_t dlen, const mio_skad_t* srcaddr)
+{
+	return 0;
+}
+
+static int on_write (mio_dev_sck_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_skad_t* dstaddr)
+{
+	return 0;
+}
+
+static void on_connect (mio_dev_sck_t* dev)
+{
+	if (!(dev->state & MIO_DEV_SCK_ACCEPTED))
+	{
+		failed = 1;
+		return;
+	}
+
+	if (++accepted >= NCONNS) mio_stop (mio_dev_sck_getmio(dev), MIO_STOPREQ_TERMINATION);
+}
+
+static void on_disconnect (mio_dev_sck_t* dev)
+{
+}
+
+static int run (mio_oow_t budget, mio_dev_sck_accept_stat_t* stat)
+{
+	mio_t* mio;
+	mio_dev_sck_make_t mkinfo;
+	mio_dev_sck_listen_t li;
+	mio_dev_sck_t* lsck;
+	t_peer_t connector = { -1 };
+	int port, ret = -1;
+
+	accepted = 0;
+	failed = 0;
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	if (!mio) return -1;
+
+	memset (&mkinfo, 0, MIO_SIZEOF(mkinfo));
+	mkinfo.type = MIO_DEV_SCK_TCP4;
+	mkinfo.on_write = on_write;
+	mkinfo.on_read = on_read;
+	mkinfo.on_connect = on_connect;
+	mkinfo.on_disconnect = on_disconnect;
+
+	memset (&li, 0, MIO_SIZEOF(li));
+	li.backlogs = NCONNS * 2;
+	li.accept_budget = budget;
+	lsck = t_make_listener(mio, &mkinfo, &li, 0, &port);
+	if (!lsck) goto done;
+
+	if (t_peer_start(&connector, run_connector, port) <= -1) goto done;
+	if (t_peer_wait(&connector) <= -1) goto done;
+	/* let the last handshake complete on the listening side */
+	usleep (100000);
+
+	mio_loop (mio);
+
+	*stat = *mio_dev_sck_getacceptstat(lsck);
+	printf ("budget %lu - accepted %lu in %lu wakeups, %lu exhausted, max %lu per wakeup\n",
+		(unsigned long)budget, (unsigned long)stat->accepted, (unsigned long)stat->wakeups,
+		(unsigned long)stat->exhausted, (unsigned long)stat->max_per_wakeup);
+
+	t_peer_post (&connector);
+	if (t_peer_join(&connector) == 0 && !failed && accepted == NCONNS) ret = 0;
+
+done:
+	t_peer_kill (&connector);
+	mio_close (mio);
+	return ret;
+}
+
+int main ()
+{
+	signal (SIGPIPE, SIG_IGN);
+	alarm (20);
+
+	{
+		/* the pending connections are taken a budget at a time */
+		mio_dev_sck_accept_stat_t stat;
+
+		T_ASSERT1 (run(BUDGET, &stat) == 0, "accept with a small budget");
+		T_ASSERT1 (stat.accepted == NCONNS, "connections accepted");
+		T_ASSERT1 (stat.max_per_wakeup == BUDGET, "accepted per wakeup");
+		T_ASSERT1 (stat.wakeups == NCONNS / BUDGET, "wakeups");
+		T_ASSERT1 (stat.exhausted == NCONNS / BUDGET, "budget used up");
+	}
+
+	{
+		/* the default budget is large enough to drain them in one go */
+		mio_dev_sck_accept_stat_t stat;
+
+		T_ASSERT1 (run(0, &stat) == 0, "accept with the default budget");
+		T_ASSERT1 (stat.accepted == NCONNS, "connections accepted");
+		T_ASSERT1 (stat.max_per_wakeup == NCONNS, "accepted per wakeup");
+		T_ASSERT1 (stat.wakeups == 1, "wakeups");
+		T_ASSERT1 (stat.exhausted == 0, "budget not used up");
+	}
+
+	return 0;
+
+oops:
+	return -1;
+}
@@ -0,0 +1,385 @@
+/* test the completion accounting of zero-copy writing requests */
+
+#include <mio.h>
+#include <mio-utl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "t.h"
+
+/* how the test device sends the data of a zero-copy request */
+#define ZC_SEND 0 /* without copying. a completion follows */
+#define ZC_COPY 1 /* by copying. no completion follows */
+#define ZC_SEND_ONCE 2 /* send a chunk and report that no more can be sent */
+
+#define MAX_LOG 64
+
+/* a stream device over one end of a socket pair. it doesn't send data
+ * without copying but reports the sending operations as such so that the
+ * test decides when they complete */
+typedef struct zdev_t zdev_t;
+struct zdev_t
+{
+	MIO_DEV_HEADER;
+	int fd;
+	int mode;
+	mio_iolen_t chunk; /* maximum bytes sent per operation */
+	mio_uint32_t seq; /* sequence number of the next zero-copy operation */
+	mio_oow_t nsent; /* number of zero-copy operations */
+};
+
+static struct
+{
+	int id;
+	mio_iolen_t len;
+} wlog[MAX_LOG];
+static int nwlog = 0;
+
+static mio_uint8_t data[1000];
+
+static int zdev_make (mio_dev_t* dev, void* ctx)
+{
+	zdev_t* z = (zdev_t*)dev;
+	z->fd = *(int*)ctx;
+	z->mode = ZC_SEND;
+	z->dev_cap = MIO_DEV_CAP_IN | MIO_DEV_CAP_OUT | MIO_DEV_CAP_STREAM;
+	return 0;
+}
+
+static int zdev_kill (mio_dev_t* dev, int force)
+{
+	zdev_t* z = (zdev_t*)dev;
+	close (z->fd);
+	z->fd = -1;
+	return 0;
+}
+
+static mio_syshnd_t zdev_getsyshnd (mio_dev_t* dev)
+{
+	return ((zdev_t*)dev)->fd;
+}
+
+static int zdev_read (mio_dev_t* dev, void* buf, mio_iolen_t* len, mio_devaddr_t* srcaddr)
+{
+	ssize_t x;
+
+	x = recv(((zdev_t*)dev)->fd, buf, *len, 0);
+	if (x <= -1)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+		mio_seterrwithsyserr (dev->mio, 0, errno);
+		return -1;
+	}
+
+	*len = x;
+	return 1;
+}
+
+static int zdev_write (mio_dev_t* dev, const void* buf, mio_iolen_t* len, const mio_devaddr_t* dstaddr)
+{
+	ssize_t x;
+
+	if (*len <= 0)
+	{
+		shutdown (((zdev_t*)dev)->fd, SHUT_WR);
+		return 1;
+	}
+
+	x = send(((zdev_t*)dev)->fd, buf, *len, 0);
+	if (x <= -1)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+		mio_seterrwithsyserr (dev->mio, 0, errno);
+		return -1;
+	}
+
+	*len = x;
+	return 1;
+}
+
+static int zdev_writezc (mio_dev_t* dev, const void* buf, mio_iolen_t* len, mio_uint32_t* seq)
+{
+	zdev_t* z = (zdev_t*)dev;
+	int x;
+
+	if (z->mode == ZC_SEND_ONCE && z->nsent > 0)
+	{
+		/* let the rest go through the write queue */
+		z->mode = ZC_SEND;
+		return 0;
+	}
+
+	if (z->chunk > 0 && *len > z->chunk) *len = z->chunk;
+	x = zdev_write(dev, buf, len, MIO_NULL);
+	if (x <= 0) return x;
+	if (z->mode == ZC_COPY) return 2;
+
+	*seq = z->seq++;
+	z->nsent++;
+	return 1;
+}
+
+static int zdev_ioctl (mio_dev_t* dev, int cmd, void* arg)
+{
+	mio_seterrnum (dev->mio, MIO_EINVAL);
+	return -1;
+}
+
+static mio_dev_mth_t zdev_mth =
+{
+	zdev_make,
+	zdev_kill,
+	MIO_NULL,
+	zdev_getsyshnd,
+
+	zdev_read,
+	zdev_write,
+	MIO_NULL, /* writev */
+	MIO_NULL, /* sendfile */
+	MIO_NULL, /* splice */
+	zdev_writezc,
+	zdev_ioctl
+};
+
+static int zdev_ready (mio_dev_t* dev, int events)
+{
+	if (events & MIO_DEV_EVENT_ERR)
+	{
+		mio_seterrnum (dev->mio, MIO_EDEVERR);
+		return -1;
+	}
+	return 1;
+}
+
+static int zdev_on_read (mio_dev_t* dev, const void* buf, mio_iolen_t len, const mio_devaddr_t* srcaddr)
+{
+	return 0;
+}
+
+static int zdev_on_write (mio_dev_t* dev, mio_iolen_t wrlen, void* wrctx, const mio_devaddr_t* dstaddr)
+{
+	if (nwlog < MAX_LOG)
+	{
+		wlog[nwlog].id = (int)(mio_intptr_t)wrctx;
+		wlog[nwlog].len = wrlen;
+	}
+	nwlog++;
+	return 0;
+}
+
+static mio_dev_evcb_t zdev_evcb =
+{
+	zdev_ready,
+	zdev_on_read,
+	zdev_on_write
+};
+
+static void stop_loop (mio_t* mio, const mio_ntime_t* now, mio_tmrjob_t* job)
+{
+	mio_stop (mio, MIO_STOPREQ_TERMINATION);
+}
+
+/* let the loop handle the events for a while */
+static int run_loop (mio_t* mio)
+{
+	mio_ntime_t after;
+
+	MIO_INIT_NTIME (&after, 0, 50000000);
+	if (mio_schedtmrjobafter(mio, &after, stop_loop, MIO_NULL, MIO_NULL) <= -1) return -1;
+	return mio_loop(mio);
+}
+
+static int write_zc (zdev_t* z, int id, mio_iolen_t len)
+{
+	return mio_dev_writezc((mio_dev_t*)z, data, len, (void*)(mio_intptr_t)id);
+}
+
+static int write_plain (zdev_t* z, int id, mio_iolen_t len)
+{
+	return mio_dev_write((mio_dev_t*)z, data, len, (void*)(mio_intptr_t)id, MIO_NULL);
+}
+
+/* check the on_write callbacks called since the last check */
+static int check_log (int from, int n, const int* ids, const mio_iolen_t* lens)
+{
+	int i;
+
+	if (nwlog != from + n) return 0;
+	for (i = 0; i < n; i++)
+	{
+		if (wlog[from + i].id != ids[i] || wlog[from + i].len != lens[i]) return 0;
+	}
+	return 1;
+}
+
+/* read the data sent to the other end */
+static mio_oow_t drain (int fd)
+{
+	mio_uint8_t buf[4096];
+	mio_oow_t total = 0;
+	ssize_t n;
+
+	while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) total += n;
+	return total;
+}
+
+int main ()
+{
+	mio_t* mio = MIO_NULL;
+	zdev_t* z = MIO_NULL;
+	int sv[2] = { -1, -1 };
+	mio_oow_t sent = 0, i;
+
+	signal (SIGPIPE, SIG_IGN);
+	alarm (20);
+
+	for (i = 0; i < MIO_COUNTOF(data); i++) data[i] = (mio_uint8_t)i;
+
+	T_ASSERT1 (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "socket pair");
+	T_ASSERT1 (fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK) == 0, "nonblocking");
+
+	mio = mio_open(MIO_NULL, 0, MIO_NULL, MIO_FEATURE_ALL, 64, MIO_NULL);
+	T_ASSERT1 (mio != MIO_NULL, "mio open");
+
+	z = (zdev_t*)mio_dev_make(mio, MIO_SIZEOF(*z), &zdev_mth, &zdev_evcb, &sv[0]);
+	T_ASSERT1 (z != MIO_NULL, "device");
+	sv[0] = -1; /* owned by the device */
+
+	{
+		/* the callback waits for the completion. a plain write after it
+		 * is reported after it */
+		static int ids[] = { 1, 2 };
+		static mio_iolen_t lens[] = { 100, 10 };
+		static int ids2[] = { 3 };
+		static mio_iolen_t lens2[] = { 100 };
+		static int ids3[] = { 4 };
+		static mio_iolen_t lens3[] = { 20 };
+
+		T_ASSERT1 (write_zc(z, 1, 100) == 0, "zero-copy write");
+		T_ASSERT1 (write_plain(z, 2, 10) == 0, "plain write");
+		T_ASSERT1 (write_zc(z, 3, 100) == 0, "zero-copy write");
+		sent += 210;
+		T_ASSERT1 (run_loop(mio) == 0 && nwlog == 0, "no callback before completion");
+
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 0) == 0, "complete 0");
+		T_ASSERT1 (check_log(0, 2, ids, lens), "callbacks up to the completion");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 0) == 0 && nwlog == 2, "duplicate completion");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 1) == 0, "complete 1");
+		T_ASSERT1 (check_log(2, 1, ids2, lens2), "callback of the last request");
+
+		/* nothing to wait for */
+		T_ASSERT1 (write_plain(z, 4, 20) == 0, "plain write");
+		sent += 20;
+		T_ASSERT1 (run_loop(mio) == 0 && check_log(3, 1, ids3, lens3), "plain write not deferred");
+	}
+
+	{
+		/* a request sent in multiple operations completes with the last */
+		static int ids[] = { 5 };
+		static mio_iolen_t lens[] = { 100 };
+		int from = nwlog;
+
+		z->chunk = 30;
+		T_ASSERT1 (write_zc(z, 5, 100) == 0, "zero-copy write in chunks");
+		sent += 100;
+		T_ASSERT1 (z->seq == 6, "sending operations");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 4) == 0 && nwlog == from, "no callback before the last operation completes");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 5) == 0 && check_log(from, 1, ids, lens), "callback after the last operation");
+	}
+
+	{
+		/* the rest of a request goes through the write queue */
+		static int ids[] = { 6, 7 };
+		static mio_iolen_t lens[] = { 100, 10 };
+		int from = nwlog;
+
+		z->mode = ZC_SEND_ONCE;
+		z->nsent = 0;
+		T_ASSERT1 (write_zc(z, 6, 100) == 0, "zero-copy write partially sent");
+		T_ASSERT1 (z->seq == 7, "sent partially");
+		T_ASSERT1 (write_plain(z, 7, 10) == 0, "plain write queued");
+		sent += 110;
+
+		T_ASSERT1 (run_loop(mio) == 0 && z->seq == 10, "rest sent in the loop");
+		T_ASSERT1 (nwlog == from, "no callback before completion");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 8) == 0 && nwlog == from, "no callback before the last operation completes");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 9) == 0 && check_log(from, 2, ids, lens), "callbacks after the last operation");
+	}
+
+	{
+		/* data copied completes without a completion unless a request
+		 * waiting for a completion precedes it */
+		static int ids[] = { 8 };
+		static mio_iolen_t lens[] = { 100 };
+		static int ids2[] = { 9, 10 };
+		static mio_iolen_t lens2[] = { 100, 100 };
+		int from = nwlog;
+
+		z->mode = ZC_COPY;
+		T_ASSERT1 (write_zc(z, 8, 100) == 0, "zero-copy write copied");
+		sent += 100;
+		T_ASSERT1 (run_loop(mio) == 0 && check_log(from, 1, ids, lens), "copied data not waiting for completion");
+
+		from = nwlog;
+		z->mode = ZC_SEND;
+		T_ASSERT1 (write_zc(z, 9, 100) == 0, "zero-copy write");
+		z->mode = ZC_COPY;
+		T_ASSERT1 (write_zc(z, 10, 100) == 0, "zero-copy write copied");
+		sent += 200;
+		T_ASSERT1 (run_loop(mio) == 0 && nwlog == from, "copied data waiting for the preceding request");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, z->seq - 1) == 0 && check_log(from, 2, ids2, lens2), "callbacks in order");
+	}
+
+	{
+		/* the sequence number wraps around */
+		static int ids[] = { 11 };
+		static mio_iolen_t lens[] = { 50 };
+		static int ids2[] = { 12 };
+		static mio_iolen_t lens2[] = { 60 };
+		int from = nwlog;
+
+		z->mode = ZC_SEND;
+		z->chunk = 0;
+		z->seq = 0xFFFFFFFFu;
+		T_ASSERT1 (write_zc(z, 11, 50) == 0 && write_zc(z, 12, 60) == 0, "zero-copy writes around the wrap");
+		sent += 110;
+		T_ASSERT1 (z->seq == 1, "sequence number wrapped");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 0xFFFFFFFEu) == 0 && nwlog == from, "earlier completion");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 0xFFFFFFFFu) == 0 && check_log(from, 1, ids, lens), "completion before the wrap");
+		T_ASSERT1 (mio_dev_completezc((mio_dev_t*)z, 0) == 0 && check_log(from + 1, 1, ids2, lens2), "completion after the wrap");
+	}
+
+	{
+		/* all the data has reached the other end */
+		T_ASSERT1 (drain(sv[1]) == sent, "data received");
+	}
+
+	{
+		/* the requests waiting are reported when the device is killed */
+		static int ids[] = { 13, 14 };
+		static mio_iolen_t lens[] = { 70, 80 };
+		int from = nwlog;
+
+		T_ASSERT1 (write_zc(z, 13, 70) == 0 && write_zc(z, 14, 80) == 0, "zero-copy writes");
+		T_ASSERT1 (nwlog == from, "no callback before completion");
+		mio_dev_kill ((mio_dev_t*)z);
+		z = MIO_NULL;
+		T_ASSERT1 (check_log(from, 2, ids, lens), "callbacks upon kill");
+	}
+
+	T_ASSERT1 (nwlog <= MAX_LOG, "log size");
+
+	mio_close (mio);
+	close (sv[1]);
+	return 0;
+
+oops:
+	if (mio) mio_close (mio);
+	if (sv[0] >= 0) close (sv[0]);
+	if (sv[1] >= 0) close (sv[1]);
+	return -1;
+}
@@ -0,0 +1,178 @@
+#ifndef _MIO_T_T_SCK_H_
+#define _MIO_T_T_SCK_H_
+
+/* common code for the tests talking to a peer process over a stream socket.
+ * the event loop runs in the test process and the peer forked uses plain
+ * blocking sockets. */
+
+#include <mio.h>
+#include <mio-sck.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef struct t_peer_t t_peer_t;
+typedef int (*t_peer_run_t) (t_peer_t* peer, int port);
+
+struct t_peer_t
+{
+	pid_t pid; /* 0 inside the peer */
+	int down[2]; /* the test process to the peer */
+	int up[2]; /* the peer to the test process */
+};
+
+/* the byte pattern of the data at the given position of a stream */
+static MIO_INLINE mio_uint8_t t_pattern (mio_oow_t pos)
+{
+	return (mio_uint8_t)((pos * 7) ^ (pos >> 9));
+}
+
+static MIO_INLINE int t_connect_to (int port)
+{
+	struct sockaddr_in sin;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd <= -1) return -1;
+
+	memset (&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr*)&sin, sizeof(sin)) <= -1)
+	{
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* make a socket listening on a loopback port chosen by the system.
+ * the type and the callbacks must be set in mkinfo. lstn may be MIO_NULL
+ * for the default listening parameters */
+static MIO_INLINE mio_dev_sck_t* t_make_listener (mio_t* mio, const mio_dev_sck_make_t* mkinfo, const mio_dev_sck_listen_t* lstn, mio_oow_t xtnsize, int* port)
+{
+	mio_dev_sck_bind_t bi;
+	mio_dev_sck_listen_t li;
+	mio_dev_sck_t* sck;
+	mio_skad_t skad;
+
+	sck = mio_dev_sck_make(mio, xtnsize, mkinfo);
+	if (!sck) return MIO_NULL;
+
+	memset (&bi, 0, MIO_SIZEOF(bi));
+	if (mio_bcstrtoskad(mio, "127.0.0.1:0", &bi.localaddr) <= -1 ||
+	    mio_dev_sck_bind(sck, &bi) <= -1) goto oops;
+
+	if (lstn) li = *lstn;
+	else
+	{
+		memset (&li, 0, MIO_SIZEOF(li));
+		li.backlogs = 8;
+	}
+	if (mio_dev_sck_listen(sck, &li) <= -1 ||
+	    mio_dev_sck_getsockaddr(sck, &skad) <= -1) goto oops;
+
+	*port = mio_skad_port(&skad);
+	return sck;
+
+oops:
+	mio_dev_sck_kill (sck);
+	return MIO_NULL;
+}
+
+/* fork a peer that runs the given function and exits with its return value */
+static MIO_INLINE int t_peer_start (t_peer_t* peer, t_peer_run_t run, int port)
+{
+	peer->pid = -1;
+	peer->down[0] = peer->down[1] = -1;
+	peer->up[0] = peer->up[1] = -1;
+
+	if (pipe(peer->down) <= -1) return -1;
+	if (pipe(peer->up) <= -1) goto oops;
+
+	peer->pid = fork();
+	if (peer->pid <= -1) goto oops;
+
+	if (peer->pid == 0)
+	{
+		close (peer->down[1]);
+		close (peer->up[0]);
+		_exit (run(peer, port));
+	}
+
+	/* the peer sees the end of the file if the test process dies */
+	close (peer->down[0]);
+	close (peer->up[1]);
+	peer->down[0] = peer->up[1] = -1;
+	return 0;
+
+oops:
+	if (peer->down[0] >= 0) { close (peer->down[0]); close (peer->down[1]); }
+	if (peer->up[0] >= 0) { close (peer->up[0]); close (peer->up[1]); }
+	peer->down[0] = peer->down[1] = -1;
+	peer->up[0] = peer->up[1] = -1;
+	return -1;
+}
+
+/* send data to the other side. it works on both sides */
+static MIO_INLINE int t_peer_send (t_peer_t* peer, const void* data, mio_oow_t len)
+{
+	return (write(peer->pid == 0? peer->up[1]: peer->down[1], data, len) == (ssize_t)len)? 0: -1;
+}
+
+/* receive data from the other side. it returns the number of bytes
+ * received, 0 on the end of the file or -1 on failure */
+static MIO_INLINE ssize_t t_peer_recv (t_peer_t* peer, void* buf, mio_oow_t len)
+{
+	return read(peer->pid == 0? peer->down[0]: peer->up[0], buf, len);
+}
+
+/* let the other side go on */
+static MIO_INLINE int t_peer_post (t_peer_t* peer)
+{
+	return t_peer_send(peer, "x", 1);
+}
+
+/* wait until the other side posts */
+static MIO_INLINE int t_peer_wait (t_peer_t* peer)
+{
+	char tmp;
+	return (t_peer_recv(peer, &tmp, 1) == 1)? 0: -1;
+}
+
+/* wait for the peer to exit. it returns the exit status of the peer or
+ * -1 if the peer has not exited normally */
+static MIO_INLINE int t_peer_join (t_peer_t* peer)
+{
+	int status, n;
+	pid_t pid = peer->pid;
+
+	if (pid <= 0) return -1;
+	peer->pid = -1;
+
+	/* the data not received yet is discarded */
+	if (peer->down[1] >= 0) { close (peer->down[1]); peer->down[1] = -1; }
+	n = waitpid(pid, &status, 0);
+	if (peer->up[0] >= 0) { close (peer->up[0]); peer->up[0] = -1; }
+
+	return (n == pid && WIFEXITED(status))? WEXITSTATUS(status): -1;
+}
+
+/* kill the peer if it is still around */
+static MIO_INLINE void t_peer_kill (t_peer_t* peer)
+{
+	if (peer->pid > 0)
+	{
+		kill (peer->pid, SIGKILL);
+		t_peer_join (peer);
+	}
+}
+
+#endif